@@ -1,4 +1,4 @@
-QT       += core gui xml
+QT       += core gui xml concurrent network svg
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -11,23 +11,65 @@ CONFIG += c++11
 SOURCES += \
     addcommand.cpp \
     arrowlineitem.cpp \
+    conveyorrouter.cpp \
     customdelegate.cpp \
     customgraphicsview.cpp \
     custompixmapitem.cpp \
+    groupitem.cpp \
+    lazyicon.cpp \
     main.cpp \
-    mainwindow.cpp
+    mainwindow.cpp \
+    memorypanel.cpp \
+    minimapwidget.cpp \
+    nodeindex.cpp \
+    pngstreamwriter.cpp \
+    sceneexporter.cpp \
+    scenepager.cpp \
+    sensitivitydialog.cpp \
+    startupprobe.cpp \
+    telemetry.cpp \
+    timeseriesstore.cpp \
+    trenddialog.cpp
 
 HEADERS += \
     addcommand.h \
     arrowlineitem.h \
+    conveyorrouter.h \
     customdelegate.h \
     customgraphicsview.h \
     custompixmapitem.h \
-    mainwindow.h
+    groupitem.h \
+    lazyicon.h \
+    mainwindow.h \
+    memorypanel.h \
+    minimapwidget.h \
+    nodeindex.h \
+    pngstreamwriter.h \
+    sceneexporter.h \
+    scenepager.h \
+    sensitivitydialog.h \
+    spscringbuffer.h \
+    startupprobe.h \
+    telemetry.h \
+    timeseriesstore.h \
+    trenddialog.h
 
 FORMS += \
     mainwindow.ui
 
+# Solver, file formats and analysis live in the widget-free flowsheetcore
+# library, built first by aggflow.pro.
+INCLUDEPATH += $$PWD/flowsheetcore
+DEPENDPATH += $$PWD/flowsheetcore
+CORE_OUT = $$OUT_PWD/flowsheetcore
+win32 {
+    CONFIG(debug, debug|release): CORE_OUT = $$CORE_OUT/debug
+    else: CORE_OUT = $$CORE_OUT/release
+}
+LIBS += -L$$CORE_OUT -lflowsheetcore
+win32-msvc*: PRE_TARGETDEPS += $$CORE_OUT/flowsheetcore.lib
+else: PRE_TARGETDEPS += $$CORE_OUT/libflowsheetcore.a
+
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
 else: unix:!android: target.path = /opt/$${TARGET}/bin
@@ -35,3 +77,22 @@ else: unix:!android: target.path = /opt/$${TARGET}/bin
 
 RESOURCES += \
     images.qrc
+
+# The equipment art is not linked in. It is built into a compressed binary
+# bundle beside the executable and registered at startup, see main.cpp.
+EQUIPMENT_RCC = $$OUT_PWD/equipment.rcc
+win32 {
+    CONFIG(debug, debug|release): EQUIPMENT_RCC = $$OUT_PWD/debug/equipment.rcc
+    else: EQUIPMENT_RCC = $$OUT_PWD/release/equipment.rcc
+}
+equipment_rcc.target = $$EQUIPMENT_RCC
+equipment_rcc.commands = $$shell_path($$[QT_HOST_BINS]/rcc) -binary -compress 9 -threshold 0 \
+    $$shell_path($$PWD/equipment.qrc) -o $$shell_path($$EQUIPMENT_RCC)
+equipment_rcc.depends = $$PWD/equipment.qrc $$files($$PWD/images/*.png, true)
+QMAKE_EXTRA_TARGETS += equipment_rcc
+PRE_TARGETDEPS += $$EQUIPMENT_RCC
+
+equipment_install.files = $$EQUIPMENT_RCC
+equipment_install.path = $$target.path
+equipment_install.CONFIG += no_check_exist
+!isEmpty(target.path): INSTALLS += equipment_install
@@ -1,57 +1,302 @@
 #include <addcommand.h>
 
-AddCommand::AddCommand(QGraphicsScene* scene, QGraphicsItem* item, QUndoCommand* parent)
-    : QUndoCommand(parent), GScene(scene), Item(item)
+namespace
 {
+    // a held item back in a scene belongs to it again
+    void DeleteHeld(QGraphicsItem* item)
+    {
+        if (item && !item->scene())
+        {
+            delete item;
+        }
+    }
+}
+
+AddCommand::AddCommand(UndoResolver* resolver, QGraphicsItem* item, QUndoCommand* parent)
+    : QUndoCommand(parent), Resolver(resolver), Target(resolver->TargetOf(item)), Held(nullptr)
+    , Counted(MemoryAccount::UndoHistory, sizeof(AddCommand), 1)
+{
+
+}
 
+AddCommand::~AddCommand()
+{
+    DeleteHeld(Held);
 }
 
 void AddCommand::undo()
 {
-    GScene->removeItem(Item);
-    emit PublishUndoData(QString("(%1, %2)").arg(Item->pos().x()).arg(Item->pos().y()));
+    QGraphicsItem* item = Resolver->Resolve(Target);
+    if (!item)
+    {
+        Resolver->ReportDangling(Target);
+        return;
+    }
+    Resolver->Detach(item);
+    Held = item;
+    emit PublishUndoData(QString("(%1, %2)").arg(Held->pos().x()).arg(Held->pos().y()));
     emit NotifyUndoCompleted();
 }
 
 void AddCommand::redo()
 {
-    GScene->addItem(Item);
-    emit PublishRedoData(QString("(%1, %2)").arg(Item->pos().x()).arg(Item->pos().y()));
+    // the first redo runs on push, with the item still in the scene
+    if (Held)
+    {
+        QGraphicsItem* item = Held;
+        Held = nullptr;
+        if (!Resolver->Attach(item, Target))
+        {
+            Resolver->ReportDangling(Target);
+            return;
+        }
+    }
+    QGraphicsItem* item = Resolver->Resolve(Target);
+    if (item)
+    {
+        emit PublishRedoData(QString("(%1, %2)").arg(item->pos().x()).arg(item->pos().y()));
+    }
+    emit NotifyRedoCompleted();
+}
+
+AddItemsCommand::AddItemsCommand(UndoResolver* resolver, const QList<QGraphicsItem*>& items, QUndoCommand* parent)
+    : QUndoCommand(parent), Resolver(resolver), Held(items)
+    , Counted(MemoryAccount::UndoHistory, sizeof(AddItemsCommand), 1)
+{
+    for (QGraphicsItem* item : items)
+    {
+        Targets.append(resolver->TargetOf(item));
+    }
+    Counted.Add(Targets.size() * qint64(sizeof(UndoTarget) + sizeof(QGraphicsItem*)));
+    setText(QString("Add %1 items").arg(Held.size()));
+}
+
+AddItemsCommand::~AddItemsCommand()
+{
+    // lines before the units whose circles they end on
+    for (int i = Held.size() - 1; i >= 0; --i)
+    {
+        DeleteHeld(Held.at(i));
+    }
+}
+
+void AddItemsCommand::undo()
+{
+    // lines first, they are found through their units
+    for (int i = Targets.size() - 1; i >= 0; --i)
+    {
+        QGraphicsItem* item = Resolver->Resolve(Targets.at(i));
+        if (!item)
+        {
+            Resolver->ReportDangling(Targets.at(i));
+            continue;
+        }
+        Resolver->Detach(item);
+        Held[i] = item;
+    }
+    emit PublishUndoData(QString("%1 items").arg(Targets.size()));
+    emit NotifyUndoCompleted();
+}
+
+void AddItemsCommand::redo()
+{
+    for (int i = 0; i < Targets.size(); ++i)
+    {
+        QGraphicsItem* item = Held.at(i);
+        Held[i] = nullptr;
+        if (item && !Resolver->Attach(item, Targets.at(i)))
+        {
+            Resolver->ReportDangling(Targets.at(i));
+        }
+    }
+    emit PublishRedoData(QString("%1 items").arg(Targets.size()));
     emit NotifyRedoCompleted();
 }
 
-RemoveCommand::RemoveCommand(QGraphicsScene* scene, QGraphicsItem* item, QUndoCommand* parent)
-        : QUndoCommand(parent), GScene(scene), Item(item)
+RemoveCommand::RemoveCommand(UndoResolver* resolver, QGraphicsItem* item, QUndoCommand* parent)
+        : QUndoCommand(parent), Resolver(resolver), Target(resolver->TargetOf(item)), Held(nullptr)
+    , Counted(MemoryAccount::UndoHistory, sizeof(RemoveCommand), 1)
 {
 
 }
 
+RemoveCommand::~RemoveCommand()
+{
+    DeleteHeld(Held);
+}
+
 void RemoveCommand::undo()
 {
-    GScene->addItem(Item);
+    if (Held)
+    {
+        QGraphicsItem* item = Held;
+        Held = nullptr;
+        if (!Resolver->Attach(item, Target))
+        {
+            Resolver->ReportDangling(Target);
+            return;
+        }
+    }
+    emit NotifyUndoCompleted();
 }
 
 void RemoveCommand::redo()
 {
-    GScene->removeItem(Item);
+    QGraphicsItem* item = Resolver->Resolve(Target);
+    if (!item)
+    {
+        Resolver->ReportDangling(Target);
+        return;
+    }
+    Resolver->Detach(item);
+    Held = item;
+    emit NotifyRedoCompleted();
 }
 
-MoveCommand::MoveCommand(QGraphicsItem* item, const QPointF& oldPos, const QPointF& newPos, QUndoCommand* parent)
-    : QUndoCommand(parent), Item(item), OldPos(oldPos), NewPos(newPos)
+MoveCommand::MoveCommand(UndoResolver* resolver, QGraphicsItem* item, const QPointF& oldPos, const QPointF& newPos,
+                         QUndoCommand* parent)
+    : QUndoCommand(parent), Resolver(resolver), Target(resolver->TargetOf(item)), OldPos(oldPos), NewPos(newPos)
+    , Counted(MemoryAccount::UndoHistory, sizeof(MoveCommand), 1)
 {
 
 }
 
 void MoveCommand::undo()
 {
-    Item->setPos(OldPos);
+    MoveTo(OldPos);
     emit PublishUndoData(QString("(%1, %2)").arg(OldPos.x()).arg(OldPos.y()));
     emit NotifyUndoCompleted();
 }
 
 void MoveCommand::redo()
 {
-    Item->setPos(NewPos);
+    MoveTo(NewPos);
     emit PublishRedoData(QString("(%1, %2)").arg(NewPos.x()).arg(NewPos.y()));
     emit NotifyRedoCompleted();
 }
+
+void MoveCommand::MoveTo(const QPointF& pos)
+{
+    QGraphicsItem* item = Resolver->Resolve(Target);
+    if (item)
+    {
+        item->setPos(pos);
+    }
+    else
+    {
+        Resolver->ReportDangling(Target);
+    }
+}
+
+MoveItemsCommand::MoveItemsCommand(UndoResolver* resolver, const QList<QGraphicsItem*>& items, const QVector<QPointF>& oldPositions,
+                                   const QVector<QPointF>& newPositions, QUndoCommand* parent)
+    : QUndoCommand(parent), Resolver(resolver), OldPositions(oldPositions), NewPositions(newPositions)
+    , Counted(MemoryAccount::UndoHistory, sizeof(MoveItemsCommand), 1)
+{
+    for (QGraphicsItem* item : items)
+    {
+        Targets.append(resolver->TargetOf(item));
+    }
+    Counted.Add(Targets.size() * qint64(sizeof(UndoTarget) + 2 * sizeof(QPointF)));
+    setText(QString("Move %1 items").arg(Targets.size()));
+}
+
+void MoveItemsCommand::undo()
+{
+    MoveTo(OldPositions);
+    emit PublishUndoData(QString("%1 items").arg(Targets.size()));
+    emit NotifyUndoCompleted();
+}
+
+void MoveItemsCommand::redo()
+{
+    MoveTo(NewPositions);
+    emit PublishRedoData(QString("%1 items").arg(Targets.size()));
+    emit NotifyRedoCompleted();
+}
+
+void MoveItemsCommand::MoveTo(const QVector<QPointF>& positions)
+{
+    for (int i = 0; i < Targets.size(); ++i)
+    {
+        QGraphicsItem* item = Resolver->Resolve(Targets.at(i));
+        if (item)
+        {
+            item->setPos(positions.at(i));
+        }
+        else
+        {
+            Resolver->ReportDangling(Targets.at(i));
+        }
+    }
+}
+
+GroupCommand::GroupCommand(UndoResolver* resolver, const QVector<quint64>& itemIds, const QString& name, QUndoCommand* parent)
+    : QUndoCommand(parent), Resolver(resolver), ItemIds(itemIds), Name(name), GroupId(0)
+    , Counted(MemoryAccount::UndoHistory, sizeof(GroupCommand), 1)
+{
+    Counted.Add(ItemIds.size() * qint64(sizeof(quint64)) + Name.size() * qint64(sizeof(QChar)));
+    setText(QString("Group %1 units").arg(ItemIds.size()));
+}
+
+void GroupCommand::undo()
+{
+    if (Resolver->UngroupUnits(GroupId).isEmpty())
+    {
+        Resolver->ReportDangling({false, GroupId, 0, false, false});
+        return;
+    }
+    emit PublishUndoData(QString("%1 units").arg(ItemIds.size()));
+    emit NotifyUndoCompleted();
+}
+
+void GroupCommand::redo()
+{
+    // the group keeps its first id, later commands refer to it by that
+    const quint64 groupId = Resolver->GroupUnits(ItemIds, Name, GroupId);
+    if (groupId == 0)
+    {
+        Resolver->ReportDangling({false, ItemIds.value(0), 0, false, false});
+        return;
+    }
+    GroupId = groupId;
+    emit PublishRedoData(QString("%1 units").arg(ItemIds.size()));
+    emit NotifyRedoCompleted();
+}
+
+UngroupCommand::UngroupCommand(UndoResolver* resolver, quint64 groupId, const QString& name, QUndoCommand* parent)
+    : QUndoCommand(parent), Resolver(resolver), Name(name), GroupId(groupId)
+    , Counted(MemoryAccount::UndoHistory, sizeof(UngroupCommand), 1)
+{
+    Counted.Add(Name.size() * qint64(sizeof(QChar)));
+    setText(QString("Expand %1").arg(Name));
+}
+
+void UngroupCommand::undo()
+{
+    if (Resolver->GroupUnits(ItemIds, Name, GroupId) == 0)
+    {
+        Resolver->ReportDangling({false, GroupId, 0, false, false});
+        return;
+    }
+    emit PublishUndoData(QString("%1 units").arg(ItemIds.size()));
+    emit NotifyUndoCompleted();
+}
+
+void UngroupCommand::redo()
+{
+    QVector<quint64> itemIds = Resolver->UngroupUnits(GroupId);
+    if (itemIds.isEmpty())
+    {
+        Resolver->ReportDangling({false, GroupId, 0, false, false});
+        return;
+    }
+    // the units are known once the group is opened
+    if (ItemIds.isEmpty())
+    {
+        ItemIds = itemIds;
+        Counted.Add(ItemIds.size() * qint64(sizeof(quint64)));
+    }
+    emit PublishRedoData(QString("%1 units").arg(ItemIds.size()));
+    emit NotifyRedoCompleted();
+}
@@ -5,11 +5,77 @@
 #include <QGraphicsScene>
 #include <QGraphicsItem>
 #include <QPointF>
+#include <QList>
+#include <QString>
+#include <QVector>
+#include "memoryaccount.h"
+
+// What an undo command acts on. Units are named by item id and lines by the
+// units and circles at their ends, since the scene deletes and recreates its
+// items when units are paged, grouped or deleted.
+struct UndoTarget
+{
+    bool IsLine;
+    quint64 ItemId;
+    quint64 EndItemId;
+    bool StartOnStartCircle;
+    bool EndOnStartCircle;
+};
+
+// Every command charges the undo history for itself; items it holds while
+// they are out of the scene stay charged to their own categories, and are
+// deleted with the command when the stack drops it.
+
+// Implemented by the view that owns the item index.
+class UndoResolver
+{
+public:
+    virtual ~UndoResolver() {}
+    virtual UndoTarget TargetOf(QGraphicsItem *item) const = 0;
+    // the item in the scene, a paged out unit is read back first; null once it is gone
+    virtual QGraphicsItem *Resolve(const UndoTarget &target) = 0;
+    // takes the item out of the scene, the command holds it until it is attached again
+    virtual void Detach(QGraphicsItem *item) = 0;
+    // false, and the item deleted, when a line's ends no longer exist
+    virtual bool Attach(QGraphicsItem *item, const UndoTarget &target) = 0;
+    virtual void ReportDangling(const UndoTarget &target) = 0;
+    // collapses the units into a group, with the given id unless it is 0;
+    // returns the group's id, 0 when fewer than two of the units exist
+    virtual quint64 GroupUnits(const QVector<quint64> &itemIds, const QString &name, quint64 groupId) = 0;
+    // expands the group and returns the ids of its units, empty once it is gone
+    virtual QVector<quint64> UngroupUnits(quint64 groupId) = 0;
+};
 
 class AddCommand : public QObject, public QUndoCommand {
     Q_OBJECT
 public:
-    AddCommand(QGraphicsScene* scene, QGraphicsItem* item, QUndoCommand* parent = nullptr);
+    // item is already in the scene
+    AddCommand(UndoResolver* resolver, QGraphicsItem* item, QUndoCommand* parent = nullptr);
+    ~AddCommand() override;
+
+protected:
+    void undo() override;
+    void redo() override;
+
+signals:
+    void NotifyUndoCompleted();
+    void NotifyRedoCompleted();
+    void PublishUndoData(QString data);
+    void PublishRedoData(QString data);
+
+private:
+    UndoResolver* Resolver;
+    UndoTarget Target;
+    QGraphicsItem* Held;
+    MemoryCharge Counted;
+};
+
+class AddItemsCommand : public QObject, public QUndoCommand {
+    Q_OBJECT
+public:
+    // items are not in the scene yet, units before the lines between them
+    AddItemsCommand(UndoResolver* resolver, const QList<QGraphicsItem*>& items, QUndoCommand* parent = nullptr);
+    ~AddItemsCommand() override;
 
 protected:
     void undo() override;
@@ -22,14 +88,17 @@ signals:
     void PublishRedoData(QString data);
 
 private:
-    QGraphicsScene* GScene;
-    QGraphicsItem* Item;
+    UndoResolver* Resolver;
+    QVector<UndoTarget> Targets;
+    QList<QGraphicsItem*> Held;
+    MemoryCharge Counted;
 };
 
 class RemoveCommand : public QObject, public QUndoCommand {
     Q_OBJECT
 public:
-    RemoveCommand(QGraphicsScene* scene, QGraphicsItem* item, QUndoCommand* parent = nullptr);
+    RemoveCommand(UndoResolver* resolver, QGraphicsItem* item, QUndoCommand* parent = nullptr);
+    ~RemoveCommand() override;
 
 protected:
     void undo() override;
@@ -42,14 +111,17 @@ signals:
     void PublishRedoData(QString data);
 
 private:
-    QGraphicsScene* GScene;
-    QGraphicsItem* Item;
+    UndoResolver* Resolver;
+    UndoTarget Target;
+    QGraphicsItem* Held;
+    MemoryCharge Counted;
 };
 
 class MoveCommand : public QObject, public QUndoCommand {
     Q_OBJECT
 public:
-    MoveCommand(QGraphicsItem* item, const QPointF& oldPos, const QPointF& newPos, QUndoCommand* parent = nullptr);
+    MoveCommand(UndoResolver* resolver, QGraphicsItem* item, const QPointF& oldPos, const QPointF& newPos,
+                QUndoCommand* parent = nullptr);
 
 protected:
     void undo() override;
@@ -62,9 +134,87 @@ signals:
     void PublishRedoData(QString data);
 
 private:
-    QGraphicsItem* Item;
+    void MoveTo(const QPointF& pos);
+
+    UndoResolver* Resolver;
+    UndoTarget Target;
     QPointF OldPos;
     QPointF NewPos;
+    MemoryCharge Counted;
+};
+
+class MoveItemsCommand : public QObject, public QUndoCommand {
+    Q_OBJECT
+public:
+    MoveItemsCommand(UndoResolver* resolver, const QList<QGraphicsItem*>& items, const QVector<QPointF>& oldPositions,
+                     const QVector<QPointF>& newPositions, QUndoCommand* parent = nullptr);
+
+protected:
+    void undo() override;
+    void redo() override;
+
+signals:
+    void NotifyUndoCompleted();
+    void NotifyRedoCompleted();
+    void PublishUndoData(QString data);
+    void PublishRedoData(QString data);
+
+private:
+    void MoveTo(const QVector<QPointF>& positions);
+
+    UndoResolver* Resolver;
+    QVector<UndoTarget> Targets;
+    QVector<QPointF> OldPositions;
+    QVector<QPointF> NewPositions;
+    MemoryCharge Counted;
+};
+
+class GroupCommand : public QObject, public QUndoCommand {
+    Q_OBJECT
+public:
+    // the units are grouped by the first redo, on push
+    GroupCommand(UndoResolver* resolver, const QVector<quint64>& itemIds, const QString& name, QUndoCommand* parent = nullptr);
+
+protected:
+    void undo() override;
+    void redo() override;
+
+signals:
+    void NotifyUndoCompleted();
+    void NotifyRedoCompleted();
+    void PublishUndoData(QString data);
+    void PublishRedoData(QString data);
+
+private:
+    UndoResolver* Resolver;
+    QVector<quint64> ItemIds;
+    QString Name;
+    quint64 GroupId;
+    MemoryCharge Counted;
+};
+
+class UngroupCommand : public QObject, public QUndoCommand {
+    Q_OBJECT
+public:
+    // the group is expanded by the first redo, on push
+    UngroupCommand(UndoResolver* resolver, quint64 groupId, const QString& name, QUndoCommand* parent = nullptr);
+
+protected:
+    void undo() override;
+    void redo() override;
+
+signals:
+    void NotifyUndoCompleted();
+    void NotifyRedoCompleted();
+    void PublishUndoData(QString data);
+    void PublishRedoData(QString data);
+
+private:
+    UndoResolver* Resolver;
+    QVector<quint64> ItemIds;
+    QString Name;
+    quint64 GroupId;
+    MemoryCharge Counted;
 };
 
 #endif // ADDCOMMAND_H
@@ -0,0 +1,16 @@
+# Builds the flowsheet core library, then the editor and the tests that link
+# it, and the example equipment model plugin.
+TEMPLATE = subdirs
+
+SUBDIRS = \
+    flowsheetcore \
+    editor \
+    examplemodel \
+    tests
+
+editor.file = FinalAggFlowTest.pro
+editor.depends = flowsheetcore
+
+tests.depends = flowsheetcore
+
+examplemodel.subdir = plugins/examplemodel
@@ -1,10 +1,20 @@
 #include "ArrowLineItem.h"
 #include <custompixmapitem.h>
+#include "itemid.h"
 #include <QColor>
+#include <QPainterPathStroker>
 
 ArrowLineItem::ArrowLineItem(QLineF line, QGraphicsItem* parent)
     : QGraphicsLineItem(line, parent)
     , lineWidth(2)
+    , StartCircle(nullptr)
+    , EndCircle(nullptr)
+    , CircleSidesKnown(false)
+    , StartOnStartCircle(false)
+    , EndOnStartCircle(false)
+    , Tear(false)
+    , ConnectionId(0)
+    , Counted(MemoryAccount::Lines, sizeof(ArrowLineItem), 1)
 {
     QPen pen(Qt::black, lineWidth, Qt::DotLine); // Set pen to dotted line
     setPen(pen);
@@ -12,9 +22,18 @@ ArrowLineItem::ArrowLineItem(QLineF line, QGraphicsItem* parent)
 
 void ArrowLineItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
 {
-    QGraphicsLineItem::paint(painter, option, widget);
-
     QLineF line = this->line();
+    if (Route.size() >= 2)
+    {
+        painter->setPen(pen());
+        painter->drawPolyline(Route);
+        line = QLineF(Route.at(Route.size() - 2), Route.last());
+    }
+    else
+    {
+        QGraphicsLineItem::paint(painter, option, widget);
+    }
+
     double angle = std::atan2(-line.dy(), line.dx());
 
     // Define the arrowhead points
@@ -31,10 +50,30 @@ void ArrowLineItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* opt
     QPolygonF arrowHead;
     arrowHead << line.p2() << arrowP1 << arrowP2;
     painter->drawPolygon(arrowHead);
+
+    if (Tear)
+    {
+        QPointF middle = line.pointAt(0.5);
+        QLineF direction = line.unitVector();
+        QLineF normal = line.normalVector().unitVector();
+        QPointF along = (direction.p2() - direction.p1()) * 3;
+        QPointF across = (normal.p2() - normal.p1()) * 6;
+        painter->setPen(QPen(Qt::black, lineWidth));
+        painter->drawLine(middle - along - across, middle - along + across);
+        painter->drawLine(middle + along - across, middle + along + across);
+    }
 }
 
 void ArrowLineItem::write(QDataStream &out) const {
     out << line();
+    // a line read from a record and not connected yet writes back what it read
+    if (!StartCircle || !EndCircle) {
+        out << StartCircleItemId << IsStartCircleStartConnected << IsStartCircleEndConnected;
+        out << EndCircleItemId << IsEndCircleStartConnected << IsEndCircleEndConnected;
+        out << StartOnStartCircle << EndOnStartCircle;
+        out << Tear;
+        return;
+    }
     out << dynamic_cast<CustomPixmapItem *>(StartCircle->parentItem())->GetItemId();
     out << dynamic_cast<CustomPixmapItem *>(StartCircle->parentItem())->GetStartConnected();
     out << dynamic_cast<CustomPixmapItem *>(StartCircle->parentItem())->GetEndConnected();
@@ -42,16 +81,22 @@ void ArrowLineItem::write(QDataStream &out) const {
     out << dynamic_cast<CustomPixmapItem *>(EndCircle->parentItem())->GetItemId();
     out << dynamic_cast<CustomPixmapItem *>(EndCircle->parentItem())->GetStartConnected();
     out << dynamic_cast<CustomPixmapItem *>(EndCircle->parentItem())->GetEndConnected();
+
+    out << (dynamic_cast<CustomPixmapItem *>(StartCircle->parentItem())->GetStartCircle() == StartCircle);
+    out << (dynamic_cast<CustomPixmapItem *>(EndCircle->parentItem())->GetStartCircle() == EndCircle);
+    out << Tear;
 }
 
-void ArrowLineItem::read(QDataStream &in) {
+void ArrowLineItem::read(QDataStream &in, int version) {
     QLineF line;
     in >> line;
     setLine(line);
 
-    int itemIdStart, itemIdEnd;
     bool startCircleStartItem, EndCircleStartItem, startCircleEndItem, EndCircleEndItem;
-    in >> itemIdStart >> startCircleStartItem >> EndCircleStartItem >> itemIdEnd >> startCircleEndItem >> EndCircleEndItem;
+    quint64 itemIdStart = ReadItemId(in, version);
+    in >> startCircleStartItem >> EndCircleStartItem;
+    quint64 itemIdEnd = ReadItemId(in, version);
+    in >> startCircleEndItem >> EndCircleEndItem;
 
     StartCircleItemId = itemIdStart;
     IsStartCircleStartConnected = startCircleStartItem;
@@ -59,6 +104,17 @@ void ArrowLineItem::read(QDataStream &in) {
     EndCircleItemId = itemIdEnd;
     IsEndCircleStartConnected = startCircleEndItem;
     IsEndCircleEndConnected = EndCircleEndItem;
+
+    CircleSidesKnown = version >= 3;
+    if (CircleSidesKnown)
+    {
+        in >> StartOnStartCircle >> EndOnStartCircle;
+    }
+    Tear = false;
+    if (version >= 5)
+    {
+        in >> Tear;
+    }
 }
 
 void ArrowLineItem::SetStartCircle(QGraphicsEllipseItem *circle)
@@ -85,24 +141,30 @@ QGraphicsEllipseItem *ArrowLineItem::GetEndCircle()
 
 void ArrowLineItem::SetStartCircleAttributes()
 {
-    CustomPixmapItem *parentItem = dynamic_cast<CustomPixmapItem *>(StartCircle->parentItem());
-    QColor clr = StartCircle->brush().color();
-    clr == Qt::red ? parentItem->SetStartConnected(true) : parentItem->SetEndConnected(true);
+    CustomPixmapItem *parentItem = static_cast<CustomPixmapItem *>(StartCircle->parentItem());
+    parentItem->PortOf(StartCircle) == FlowsheetModel::Port::Inlet ? parentItem->SetStartConnected(true)
+                                                                   : parentItem->SetEndConnected(true);
 }
 
 void ArrowLineItem::SetEndCircleAttributes()
 {
-    CustomPixmapItem *parentItem = dynamic_cast<CustomPixmapItem *>(EndCircle->parentItem());
-    QColor clr = EndCircle->brush().color();
-    clr == Qt::red ? parentItem->SetStartConnected(true) : parentItem->SetEndConnected(true);
+    CustomPixmapItem *parentItem = static_cast<CustomPixmapItem *>(EndCircle->parentItem());
+    parentItem->PortOf(EndCircle) == FlowsheetModel::Port::Inlet ? parentItem->SetStartConnected(true)
+                                                                 : parentItem->SetEndConnected(true);
 }
 
-int ArrowLineItem::GetStartCircleItemId() const
+void ArrowLineItem::RemapItemIds(const QHash<quint64, quint64> &itemIds)
+{
+    StartCircleItemId = itemIds.value(StartCircleItemId, StartCircleItemId);
+    EndCircleItemId = itemIds.value(EndCircleItemId, EndCircleItemId);
+}
+
+quint64 ArrowLineItem::GetStartCircleItemId() const
 {
     return StartCircleItemId;
 }
 
-int ArrowLineItem::GetEndCircleItemId() const
+quint64 ArrowLineItem::GetEndCircleItemId() const
 {
     return EndCircleItemId;
 }
@@ -126,3 +188,85 @@ bool ArrowLineItem::GetIsEndCircleEndConnected() const
 {
     return IsEndCircleEndConnected;
 }
+
+void ArrowLineItem::SetTear(bool tear)
+{
+    Tear = tear;
+    update();
+}
+
+bool ArrowLineItem::IsTear() const
+{
+    return Tear;
+}
+
+void ArrowLineItem::SetRoute(const QPolygonF &route)
+{
+    prepareGeometryChange();
+    Route = route;
+    Counted.Set(sizeof(ArrowLineItem) + Route.size() * sizeof(QPointF));
+}
+
+void ArrowLineItem::ClearRoute()
+{
+    if (!Route.isEmpty())
+    {
+        prepareGeometryChange();
+        Route.clear();
+        Counted.Set(sizeof(ArrowLineItem));
+    }
+}
+
+const QPolygonF &ArrowLineItem::GetRoute() const
+{
+    return Route;
+}
+
+void ArrowLineItem::SetConnectionId(quint64 connectionId)
+{
+    ConnectionId = connectionId;
+}
+
+quint64 ArrowLineItem::GetConnectionId() const
+{
+    return ConnectionId;
+}
+
+QRectF ArrowLineItem::boundingRect() const
+{
+    // leave room for the arrowhead
+    qreal extra = lineWidth + 10;
+    if (Route.size() >= 2)
+    {
+        return Route.boundingRect().adjusted(-extra, -extra, extra, extra);
+    }
+    return QGraphicsLineItem::boundingRect().adjusted(-extra, -extra, extra, extra);
+}
+
+QPainterPath ArrowLineItem::shape() const
+{
+    if (Route.size() >= 2)
+    {
+        QPainterPath path;
+        path.addPolygon(Route);
+        QPainterPathStroker stroker;
+        stroker.setWidth(lineWidth + 4);
+        return stroker.createStroke(path);
+    }
+    return QGraphicsLineItem::shape();
+}
+
+bool ArrowLineItem::HasCircleSides() const
+{
+    return CircleSidesKnown;
+}
+
+bool ArrowLineItem::IsStartOnStartCircle() const
+{
+    return StartOnStartCircle;
+}
+
+bool ArrowLineItem::IsEndOnStartCircle() const
+{
+    return EndOnStartCircle;
+}
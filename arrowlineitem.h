@@ -2,10 +2,13 @@
 #define ARROWLINEITEM_H
 
 #include <QGraphicsLineItem>
+#include <QHash>
 #include <QPainter>
 #include <QPen>
 #include <QPointF>
+#include <QPolygonF>
 #include <cmath>
+#include "memoryaccount.h"
 
 class ArrowLineItem : public QGraphicsLineItem
 {
@@ -13,7 +16,7 @@ public:
     ArrowLineItem(QLineF line, QGraphicsItem* parent = nullptr);
     int lineWidth;
     void write(QDataStream &out) const;
-    void read(QDataStream &in);
+    void read(QDataStream &in, int version);
 
     void SetStartCircle(QGraphicsEllipseItem* circle);
     void SetEndCircle(QGraphicsEllipseItem* circle);
@@ -23,23 +26,52 @@ public:
 
     void SetStartCircleAttributes();
     void SetEndCircleAttributes();
-    int GetStartCircleItemId() const;
-    int GetEndCircleItemId() const;
+    // unit ids of a line that is not connected yet, used when pasting
+    void RemapItemIds(const QHash<quint64, quint64> &itemIds);
+    quint64 GetStartCircleItemId() const;
+    quint64 GetEndCircleItemId() const;
     bool GetIsStartCircleStartConnected() const;
     bool GetIsStartCircleEndConnected() const;
     bool GetIsEndCircleStartConnected() const;
     bool GetIsEndCircleEndConnected() const;
+    // files from version 3 on record which circle of each unit the line is attached to
+    bool HasCircleSides() const;
+    bool IsStartOnStartCircle() const;
+    bool IsEndOnStartCircle() const;
+
+    // a tear stream is where the solver opens a recycle loop, drawn with two strokes across it
+    void SetTear(bool tear);
+    bool IsTear() const;
+
+    // orthogonal path published by the router, the straight line is drawn while it is empty
+    void SetRoute(const QPolygonF &route);
+    void ClearRoute();
+    const QPolygonF &GetRoute() const;
+
+    // id of the flowsheet model connection the line draws, 0 while it draws none
+    void SetConnectionId(quint64 connectionId);
+    quint64 GetConnectionId() const;
+
+    QRectF boundingRect() const override;
+    QPainterPath shape() const override;
 
 private:
     QGraphicsEllipseItem* StartCircle;
     QGraphicsEllipseItem* EndCircle;
 
-    int StartCircleItemId;
+    quint64 StartCircleItemId;
     bool IsStartCircleStartConnected;
     bool IsStartCircleEndConnected;
-    int EndCircleItemId;
+    quint64 EndCircleItemId;
     bool IsEndCircleStartConnected;
     bool IsEndCircleEndConnected;
+    bool CircleSidesKnown;
+    bool StartOnStartCircle;
+    bool EndOnStartCircle;
+    bool Tear;
+    QPolygonF Route;
+    quint64 ConnectionId;
+    MemoryCharge Counted;
 
 protected:
     void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget = nullptr) override;
@@ -0,0 +1,399 @@
+#include "conveyorrouter.h"
+#include <QtConcurrent>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+
+namespace
+{
+    const qreal OBSTACLE_MARGIN = 12.0;
+    const qreal SEARCH_MARGIN = 150.0;
+    const qreal BEND_PENALTY = 40.0;
+    const int MAX_BATCH_SIZE = 256;
+
+    enum Direction { None = 0, Horizontal = 1, Vertical = 2 };
+
+    struct OpenNode
+    {
+        qreal Estimate;
+        qreal Cost;
+        int Cell;
+        int Dir;
+        bool operator<(const OpenNode &other) const { return Estimate > other.Estimate; }
+    };
+
+    QVector<qreal> SortedUnique(QVector<qreal> values)
+    {
+        std::sort(values.begin(), values.end());
+        values.erase(std::unique(values.begin(), values.end()), values.end());
+        return values;
+    }
+
+    // leave the obstacle a port sits in horizontally, towards the closer side
+    QPointF PortStub(const QPointF &port, const QVector<QRectF> &obstacles, int *owner)
+    {
+        *owner = -1;
+        for (int i = 0; i < obstacles.size(); ++i)
+        {
+            const QRectF &rect = obstacles.at(i);
+            if (rect.contains(port))
+            {
+                *owner = i;
+                qreal x = (port.x() - rect.left() < rect.right() - port.x()) ? rect.left() : rect.right();
+                return QPointF(x, port.y());
+            }
+        }
+        return port;
+    }
+
+    QPolygonF Simplify(const QPolygonF &path)
+    {
+        QPolygonF result;
+        for (const QPointF &point : path)
+        {
+            if (!result.isEmpty() && result.last() == point)
+            {
+                continue;
+            }
+            if (result.size() >= 2)
+            {
+                const QPointF &a = result.at(result.size() - 2);
+                const QPointF &b = result.last();
+                if ((a.x() == b.x() && b.x() == point.x()) || (a.y() == b.y() && b.y() == point.y()))
+                {
+                    result.last() = point;
+                    continue;
+                }
+            }
+            result << point;
+        }
+        return result;
+    }
+
+    QPolygonF Search(const QPointF &from, const QPointF &to, const QVector<QRectF> &obstacles)
+    {
+        QVector<qreal> xs {from.x(), to.x()};
+        QVector<qreal> ys {from.y(), to.y()};
+        for (const QRectF &rect : obstacles)
+        {
+            xs << rect.left() << rect.right();
+            ys << rect.top() << rect.bottom();
+        }
+        xs = SortedUnique(xs);
+        ys = SortedUnique(ys);
+
+        const int nx = xs.size();
+        const int ny = ys.size();
+        const int cells = nx * ny;
+        QVector<char> blocked(cells, 0);
+        QVector<char> hBlocked(cells, 0);
+        QVector<char> vBlocked(cells, 0);
+
+        // every obstacle border is a grid line, so a cell or a segment between
+        // neighbouring grid lines is either fully inside an obstacle or outside
+        for (const QRectF &rect : obstacles)
+        {
+            int x0 = std::lower_bound(xs.begin(), xs.end(), rect.left()) - xs.begin();
+            int x1 = std::upper_bound(xs.begin(), xs.end(), rect.right()) - xs.begin() - 1;
+            int y0 = std::lower_bound(ys.begin(), ys.end(), rect.top()) - ys.begin();
+            int y1 = std::upper_bound(ys.begin(), ys.end(), rect.bottom()) - ys.begin() - 1;
+            for (int j = y0; j <= y1; ++j)
+            {
+                for (int i = x0; i <= x1; ++i)
+                {
+                    bool innerX = i > x0 && i < x1;
+                    bool innerY = j > y0 && j < y1;
+                    if (innerX && innerY)
+                    {
+                        blocked[j * nx + i] = 1;
+                    }
+                    if (innerY && i < x1)
+                    {
+                        hBlocked[j * nx + i] = 1;
+                    }
+                    if (innerX && j < y1)
+                    {
+                        vBlocked[j * nx + i] = 1;
+                    }
+                }
+            }
+        }
+
+        auto indexOf = [](const QVector<qreal> &values, qreal value) {
+            return int(std::lower_bound(values.begin(), values.end(), value) - values.begin());
+        };
+        const int start = indexOf(ys, from.y()) * nx + indexOf(xs, from.x());
+        const int goal = indexOf(ys, to.y()) * nx + indexOf(xs, to.x());
+        if (blocked.at(start) || blocked.at(goal))
+        {
+            return QPolygonF();
+        }
+
+        const qreal infinity = std::numeric_limits<qreal>::max();
+        QVector<qreal> cost(cells * 3, infinity);
+        QVector<int> parent(cells * 3, -1);
+        std::priority_queue<OpenNode> open;
+
+        auto heuristic = [&](int cell) {
+            return std::abs(xs.at(cell % nx) - to.x()) + std::abs(ys.at(cell / nx) - to.y());
+        };
+
+        cost[start * 3 + None] = 0;
+        open.push({heuristic(start), 0, start, None});
+        int reached = -1;
+
+        while (!open.empty())
+        {
+            OpenNode node = open.top();
+            open.pop();
+            const int state = node.Cell * 3 + node.Dir;
+            if (node.Cell == goal)
+            {
+                reached = state;
+                break;
+            }
+            if (node.Cost > cost.at(state))
+            {
+                continue;
+            }
+
+            const int i = node.Cell % nx;
+            const int j = node.Cell / nx;
+            const int neighbours[4][3] = {
+                {i - 1, j, Horizontal}, {i + 1, j, Horizontal},
+                {i, j - 1, Vertical}, {i, j + 1, Vertical}
+            };
+            for (const auto &n : neighbours)
+            {
+                if (n[0] < 0 || n[0] >= nx || n[1] < 0 || n[1] >= ny)
+                {
+                    continue;
+                }
+                const int next = n[1] * nx + n[0];
+                if (blocked.at(next))
+                {
+                    continue;
+                }
+                if (n[2] == Horizontal && hBlocked.at(j * nx + qMin(i, n[0])))
+                {
+                    continue;
+                }
+                if (n[2] == Vertical && vBlocked.at(qMin(j, n[1]) * nx + i))
+                {
+                    continue;
+                }
+
+                qreal step = std::abs(xs.at(n[0]) - xs.at(i)) + std::abs(ys.at(n[1]) - ys.at(j));
+                if (node.Dir != None && node.Dir != n[2])
+                {
+                    step += BEND_PENALTY;
+                }
+                const int nextState = next * 3 + n[2];
+                const qreal nextCost = cost.at(state) + step;
+                if (nextCost < cost.at(nextState))
+                {
+                    cost[nextState] = nextCost;
+                    parent[nextState] = state;
+                    open.push({nextCost + heuristic(next), nextCost, next, n[2]});
+                }
+            }
+        }
+
+        if (reached < 0)
+        {
+            return QPolygonF();
+        }
+
+        QPolygonF path;
+        for (int state = reached; state >= 0; state = parent.at(state))
+        {
+            int cell = state / 3;
+            path.prepend(QPointF(xs.at(cell % nx), ys.at(cell / nx)));
+        }
+        return path;
+    }
+
+    QVector<RouteResult> RouteBatch(const QVector<RouteJob> &jobs, const QVector<QRectF> &obstacles)
+    {
+        QVector<RouteResult> results;
+        results.reserve(jobs.size());
+        for (const RouteJob &job : jobs)
+        {
+            results.append({job.Line, job.Generation, job.Start, job.End, RouteOrthogonal(job.Start, job.End, obstacles)});
+        }
+        return results;
+    }
+}
+
+QPolygonF RouteOrthogonal(const QPointF &start, const QPointF &end, const QVector<QRectF> &obstacles)
+{
+    // only obstacles near the two ports take part, so the grid stays small on
+    // large plants
+    QRectF window = QRectF(start, end).normalized().adjusted(-SEARCH_MARGIN, -SEARCH_MARGIN, SEARCH_MARGIN, SEARCH_MARGIN);
+    QVector<QRectF> local;
+    for (const QRectF &rect : obstacles)
+    {
+        if (window.intersects(rect))
+        {
+            local.append(rect.adjusted(-OBSTACLE_MARGIN, -OBSTACLE_MARGIN, OBSTACLE_MARGIN, OBSTACLE_MARGIN));
+        }
+    }
+
+    int startOwner, endOwner;
+    QPointF startStub = PortStub(start, local, &startOwner);
+    QPointF endStub = PortStub(end, local, &endOwner);
+
+    // a stub may still sit inside an overlapping neighbour, give up on routing then
+    for (int i = 0; i < local.size(); ++i)
+    {
+        const QRectF &rect = local.at(i);
+        QRectF inner = rect.adjusted(0.01, 0.01, -0.01, -0.01);
+        if ((i != startOwner && inner.contains(startStub)) || (i != endOwner && inner.contains(endStub)))
+        {
+            return QPolygonF();
+        }
+    }
+
+    QPolygonF path = Search(startStub, endStub, local);
+    if (path.isEmpty())
+    {
+        return path;
+    }
+    path.prepend(start);
+    path.append(end);
+    return Simplify(path);
+}
+
+ConveyorRouter::ConveyorRouter(QObject *parent)
+    : QObject(parent)
+    , ObstaclesDirty(false)
+    , ObstacleRevision(0)
+    , BatchRevision(0)
+    , NextGeneration(0)
+{
+    connect(&Watcher, &QFutureWatcher<QVector<RouteResult>>::finished, this, &ConveyorRouter::onBatchFinished);
+}
+
+ConveyorRouter::~ConveyorRouter()
+{
+    Watcher.waitForFinished();
+}
+
+void ConveyorRouter::Request(ArrowLineItem *line, const QPointF &start, const QPointF &end)
+{
+    auto failed = Failures.constFind(line);
+    if (failed != Failures.constEnd() && failed->Start == start && failed->End == end
+            && failed->Revision == ObstacleRevision)
+    {
+        // nothing it depends on changed, it would fail again
+        Generations.remove(line);
+        Pending.remove(line);
+        return;
+    }
+
+    int generation = ++NextGeneration;
+    Generations[line] = generation;
+    Pending[line] = {line, generation, start, end};
+    if (!IsBusy())
+    {
+        StartBatch();
+    }
+}
+
+void ConveyorRouter::Forget(ArrowLineItem *line)
+{
+    Generations.remove(line);
+    Pending.remove(line);
+    Failures.remove(line);
+}
+
+void ConveyorRouter::Clear()
+{
+    Generations.clear();
+    Pending.clear();
+    Failures.clear();
+}
+
+void ConveyorRouter::SetObstacle(const void *owner, const QRectF &rect)
+{
+    auto it = Obstacles.find(owner);
+    if (it != Obstacles.end() && it.value() == rect)
+    {
+        return;
+    }
+    Obstacles.insert(owner, rect);
+    ObstaclesDirty = true;
+    ++ObstacleRevision;
+}
+
+void ConveyorRouter::RemoveObstacle(const void *owner)
+{
+    if (Obstacles.remove(owner) > 0)
+    {
+        ObstaclesDirty = true;
+        ++ObstacleRevision;
+    }
+}
+
+void ConveyorRouter::ClearObstacles()
+{
+    Obstacles.clear();
+    ObstacleList.clear();
+    ObstaclesDirty = false;
+    ++ObstacleRevision;
+}
+
+bool ConveyorRouter::IsBusy() const
+{
+    return Watcher.isRunning();
+}
+
+void ConveyorRouter::StartBatch()
+{
+    if (Pending.isEmpty())
+    {
+        return;
+    }
+
+    QVector<RouteJob> jobs;
+    jobs.reserve(qMin(Pending.size(), MAX_BATCH_SIZE));
+    for (auto it = Pending.begin(); it != Pending.end() && jobs.size() < MAX_BATCH_SIZE;)
+    {
+        jobs.append(it.value());
+        it = Pending.erase(it);
+    }
+    // the flat copy handed to the workers is rebuilt only after a change
+    if (ObstaclesDirty)
+    {
+        ObstacleList = Obstacles.values().toVector();
+        ObstaclesDirty = false;
+    }
+    BatchRevision = ObstacleRevision;
+    Watcher.setFuture(QtConcurrent::run(RouteBatch, jobs, ObstacleList));
+}
+
+void ConveyorRouter::onBatchFinished()
+{
+    const QVector<RouteResult> results = Watcher.result();
+    for (const RouteResult &result : results)
+    {
+        // the line was removed or moved again while this batch was running
+        auto it = Generations.find(result.Line);
+        if (it == Generations.end() || it.value() != result.Generation)
+        {
+            continue;
+        }
+        Generations.erase(it);
+        if (result.Path.isEmpty())
+        {
+            Failures.insert(result.Line, {result.Start, result.End, BatchRevision});
+        }
+        else
+        {
+            Failures.remove(result.Line);
+        }
+        emit RouteReady(result.Line, result.Path);
+    }
+    StartBatch();
+}
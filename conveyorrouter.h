@@ -0,0 +1,81 @@
+#ifndef CONVEYORROUTER_H
+#define CONVEYORROUTER_H
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QPolygonF>
+#include <QRectF>
+#include <QVector>
+
+class ArrowLineItem;
+
+struct RouteJob
+{
+    ArrowLineItem *Line;
+    int Generation;
+    QPointF Start;
+    QPointF End;
+};
+
+struct RouteResult
+{
+    ArrowLineItem *Line;
+    int Generation;
+    QPointF Start;
+    QPointF End;
+    QPolygonF Path;
+};
+
+// Orthogonal A* over the visibility grid formed by the padded obstacle borders.
+// Pure function, safe to call from worker threads.
+QPolygonF RouteOrthogonal(const QPointF &start, const QPointF &end, const QVector<QRectF> &obstacles);
+
+// Routes lines on the global thread pool. Only one batch is in flight at a
+// time, requests arriving meanwhile replace older requests for the same line.
+// Obstacles are kept per unit; a line that could not be routed is not tried
+// again until its ends or an obstacle change.
+class ConveyorRouter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ConveyorRouter(QObject *parent = nullptr);
+    ~ConveyorRouter();
+
+    void Request(ArrowLineItem *line, const QPointF &start, const QPointF &end);
+    void Forget(ArrowLineItem *line);
+    void Clear();
+    void SetObstacle(const void *owner, const QRectF &rect);
+    void RemoveObstacle(const void *owner);
+    void ClearObstacles();
+    bool IsBusy() const;
+
+signals:
+    void RouteReady(ArrowLineItem *line, const QPolygonF &path);
+
+private slots:
+    void onBatchFinished();
+
+private:
+    struct RouteFailure
+    {
+        QPointF Start;
+        QPointF End;
+        int Revision;
+    };
+
+    void StartBatch();
+
+    QFutureWatcher<QVector<RouteResult>> Watcher;
+    QHash<ArrowLineItem *, int> Generations;
+    QHash<ArrowLineItem *, RouteJob> Pending;
+    QHash<ArrowLineItem *, RouteFailure> Failures;
+    QHash<const void *, QRectF> Obstacles;
+    QVector<QRectF> ObstacleList;
+    bool ObstaclesDirty;
+    int ObstacleRevision;
+    int BatchRevision;
+    int NextGeneration;
+};
+
+#endif // CONVEYORROUTER_H
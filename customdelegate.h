@@ -4,6 +4,7 @@
 #include <QStyledItemDelegate>
 #include <QStandardItem>
 #include <QLabel>
+#include "lazyicon.h"
 
 class IconListModel : public QStandardItemModel
 {
@@ -13,14 +14,15 @@ public:
 
     }
 
-    void setData(const QStringList& labels, const QList<QIcon>& icons)
+    void setData(const QStringList& labels, const QStringList& iconFiles)
     {
-        Q_ASSERT(labels.size() == icons.size());
+        Q_ASSERT(labels.size() == iconFiles.size());
 
         for (int i = 0; i < labels.size(); ++i)
         {
-            QStandardItem* item = new QStandardItem(icons.at(i), QString());
-            item->setData(icons.at(i), Qt::UserRole + 1); // Store the icon for drag and drop
+            QStandardItem* item = new QStandardItem(LazyIcon(iconFiles.at(i)), QString());
+            item->setData(iconFiles.at(i), Qt::UserRole + 1); // Icon file for drag and drop, lazy icons do not serialize
+            item->setData(i + 1, Qt::UserRole + 2);       // Equipment type, see ParameterBlock::Schema
             item->setData(labels.at(i), Qt::ToolTipRole);
 
             appendRow(item);
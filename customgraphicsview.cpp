@@ -6,38 +6,168 @@
 #include <arrowlineitem.h>
 #include <QMessageBox>
 #include <QIcon>
+#include "lazyicon.h"
 #include <QInputDialog>
 #include <addcommand.h>
 #include <QDebug>
 #include <QApplication>
 #include <QDomDocument>
-#include <QBuffer>
+#include <QTimer>
+#include <QClipboard>
+#include <QFileDialog>
+#include <QPainter>
+#include <QtNumeric>
+#include <QStandardPaths>
+#include <cmath>
+#include <limits>
+#include "trenddialog.h"
+#include "montecarlo.h"
+#include "sensitivitydialog.h"
+#include "resultwriter.h"
+#include "scenediff.h"
+#include "sceneexporter.h"
+#include <layeredlayout.h>
+
+namespace
+{
+    const char* SCENE_HEADER = "AggFlowScene";
+    // 1: files without a header, 2: typed parameter blocks,
+    // 3: group items and the circle each line end is attached to, 4: saved result cache,
+    // 5: tear streams
+    const qint32 SCENE_FORMAT_VERSION = 6;
+    const char* SUBGRAPH_MIME_TYPE = "application/x-aggflow-subgraph";
+    const qreal PASTE_OFFSET = 30;
+    const qint64 STALE_READING_MS = 5000;
+    const double SIMULATION_REPORT_SECONDS = 60.0;
+    // drawn size of a unit known only from a record
+    const QSizeF NOMINAL_UNIT_SIZE(100, 120);
+    const int SEARCH_HIGHLIGHT_MS = 3000;
+
+    QColor ReadingColour(const ParameterBlock &parameters, const QVector<double> &readings)
+    {
+        // load against the rated capacity where the schema has one
+        int capacity = -1;
+        const QStringList &names = parameters.GetSchema().DoubleNames;
+        for (int i = 0; i < names.size(); ++i)
+        {
+            if (names.at(i).startsWith("Capacity") && parameters.IsDoubleAssigned(i) && parameters.GetDouble(i) > 0)
+            {
+                capacity = i;
+            }
+        }
+        int signal = parameters.GetSchema().Role == EquipmentRole::Storage ? TelemetrySample::Level : TelemetrySample::Tonnage;
+        if (capacity < 0 || qIsNaN(readings.at(signal)))
+        {
+            return Qt::darkGreen;
+        }
+
+        double load = readings.at(signal) / parameters.GetDouble(capacity);
+        if (load >= 0.95)
+        {
+            return Qt::red;
+        }
+        return load >= 0.8 ? QColor(255, 140, 0) : QColor(Qt::darkGreen);
+    }
+
+    QString ReadingText(const QVector<double> &readings)
+    {
+        QStringList parts;
+        for (int i = 0; i < readings.size(); ++i)
+        {
+            if (!qIsNaN(readings.at(i)))
+            {
+                parts.append(QString("%1 %2").arg(readings.at(i), 0, 'f', 1).arg(TelemetrySample::SignalUnit(i)));
+            }
+        }
+        return parts.join("  ");
+    }
+
+    FlowsheetValidator::Edge EdgeOf(const FlowsheetModel::Connection &connection)
+    {
+        return {connection.First, connection.FirstPort == FlowsheetModel::Port::Outlet,
+                connection.Second, connection.SecondPort == FlowsheetModel::Port::Outlet, connection.Tear};
+    }
+
+    // the connection a line draws, false until both of its ends are joined
+    bool ConnectionOf(ArrowLineItem *line, FlowsheetModel::Connection *connection)
+    {
+        QGraphicsEllipseItem *start = line->GetStartCircle();
+        QGraphicsEllipseItem *end = line->GetEndCircle();
+        if (!start || !end)
+        {
+            return false;
+        }
+        CustomPixmapItem *first = static_cast<CustomPixmapItem *>(start->parentItem());
+        CustomPixmapItem *second = static_cast<CustomPixmapItem *>(end->parentItem());
+        // an end at a collapsed group is evaluated against the hidden unit the line came from
+        auto evalOf = [line](CustomPixmapItem *unit) {
+            GroupItem *group = dynamic_cast<GroupItem *>(unit);
+            const GroupLink *link = group ? group->LinkForLine(line) : nullptr;
+            return link ? link->EvalItemId : unit->GetItemId();
+        };
+        *connection = {first->GetItemId(), first->PortOf(start), second->GetItemId(), second->PortOf(end),
+                       line->IsTear(), evalOf(first), evalOf(second)};
+        return true;
+    }
+
+    void SetModelNode(FlowsheetModel &model, CustomPixmapItem *node)
+    {
+        GroupItem *group = dynamic_cast<GroupItem *>(node);
+        if (!group)
+        {
+            model.SetNode(node->GetItemId(), node->GetParameters());
+            return;
+        }
+        QVector<FlowsheetModel::GroupLink> links;
+        for (const GroupLink &link : group->GetLinks())
+        {
+            links.append({link.EvalItemId, link.InnerParameters});
+        }
+        model.SetGroup(group->GetItemId(), group->GetParameters(), group->GetCachedResult(), links);
+    }
+}
 
 CustomGraphicsView::CustomGraphicsView(QWidget *parent)
     : QGraphicsView(parent)
     , scene(new QGraphicsScene(this))
     , currentLine(nullptr)
+    , router(new ConveyorRouter(this))
+    , monitor(new TelemetryMonitor(this))
+    , history(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/history")
     , UndoStack(new QUndoStack(this))
 {
     setScene(scene);
     setAcceptDrops(true);
     setRenderHints(QPainter::HighQualityAntialiasing);
+    setDragMode(QGraphicsView::RubberBandDrag);
+    setRubberBandSelectionMode(Qt::IntersectsItemShape);
     scene->setSceneRect(0, 0,600,400);
 
     acnSave = new QAction(tr("Save Not Yet Implemented"), this);
-    acnDel = new QAction(QIcon(":/icons/images/delete.png"),"Delete line", this);
-    acnSetVal = new QAction(QIcon(":/icons/images/assign-id.png"),"Assign Machine Id...", this);
-    acnCutVal = new QAction(QIcon(":/icons/images/scissor.png"),"Cut",this);
-    acnCopyVal = new QAction(QIcon(":/icons/images/copy.png"),"Copy",this);
-    acnDelItem = new QAction(QIcon(":/icons/images/delete.png"),"Delete",this);
-    acnMonitor = new QAction(QIcon(":/icons/images/monitor.png"),"Monitor",this);
-    acnFlipView = new QAction(QIcon(":/icons/images/flip.png"),"Flip",this);
-    acnAddCustomText = new QAction(QIcon(":/icons/images/assign-text.png"),"Assign Name",this);
-    acnMaxPlantProd = new QAction(QIcon(":/icons/images/plant.png"),"Maximize Plant Production",this);
-    acnViewResult = new QAction(QIcon(":/icons/images/result.png"),"View Results",this);
-    acnAdjFeedStream = new QAction(QIcon(":/icons/images/adjust.png"),"Adjust Feed Stream",this);
+    acnDel = new QAction(LazyIcon(":/icons/images/delete.png"),"Delete line", this);
+    acnSetVal = new QAction(LazyIcon(":/icons/images/assign-id.png"),"Assign Machine Id...", this);
+    acnCutVal = new QAction(LazyIcon(":/icons/images/scissor.png"),"Cut",this);
+    acnCopyVal = new QAction(LazyIcon(":/icons/images/copy.png"),"Copy",this);
+    acnDelItem = new QAction(LazyIcon(":/icons/images/delete.png"),"Delete",this);
+    acnMonitor = new QAction(LazyIcon(":/icons/images/monitor.png"),"Monitor",this);
+    acnTrend = new QAction(tr("Trend..."),this);
+    acnFlipView = new QAction(LazyIcon(":/icons/images/flip.png"),"Flip",this);
+    acnAddCustomText = new QAction(LazyIcon(":/icons/images/assign-text.png"),"Assign Name",this);
+    acnMaxPlantProd = new QAction(LazyIcon(":/icons/images/plant.png"),"Maximize Plant Production",this);
+    acnViewResult = new QAction(LazyIcon(":/icons/images/result.png"),"View Results",this);
+    acnAdjFeedStream = new QAction(LazyIcon(":/icons/images/adjust.png"),"Adjust Feed Stream",this);
     acnfrontEndLoader = new QAction(tr(">>> Front End Loader <<<"),this);
     acnPasteVal = new QAction(tr("Paste"),this);
+    acnCopyVal->setShortcut(QKeySequence::Copy);
+    acnPasteVal->setShortcut(QKeySequence::Paste);
+    acnCopyVal->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+    acnPasteVal->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+    addAction(acnCopyVal);
+    addAction(acnPasteVal);
+    acnGroup = new QAction(tr("Group Selection..."),this);
+    acnExpandGroup = new QAction(tr("Expand Group"),this);
+    acnTear = new QAction(tr("Tear Stream"),this);
+    acnTear->setCheckable(true);
 
     connect(acnSave, &QAction::triggered, this, &CustomGraphicsView::onActionSave);
     connect(acnDel, &QAction::triggered, this, &CustomGraphicsView::onActionDelete);
@@ -45,15 +175,23 @@ CustomGraphicsView::CustomGraphicsView(QWidget *parent)
     connect(acnCutVal, &QAction::triggered, this, &CustomGraphicsView::onSetValue);
     connect(acnCopyVal, &QAction::triggered, this, &CustomGraphicsView::onCopyVal);
     connect(acnDelItem, &QAction::triggered, this, &CustomGraphicsView::onActionDelete);
-    connect(acnMonitor, &QAction::triggered, this, &CustomGraphicsView::onSetValue);
+    connect(acnMonitor, &QAction::triggered, this, &CustomGraphicsView::onMonitor);
+    connect(acnTrend, &QAction::triggered, this, &CustomGraphicsView::onTrend);
+    connect(acnAdjFeedStream, &QAction::triggered, this, &CustomGraphicsView::onAdjustFeedStream);
     connect(acnFlipView, &QAction::triggered, this, &CustomGraphicsView::onSetValue);
     connect(acnAddCustomText, &QAction::triggered, this, &CustomGraphicsView::onAddCustomText);
     connect(acnMaxPlantProd, &QAction::triggered, this, &CustomGraphicsView::onSetValue);
     connect(acnViewResult, &QAction::triggered, this, &CustomGraphicsView::onSetValue);
     connect(acnPasteVal, &QAction::triggered, this, &CustomGraphicsView::onPasteVal);
+    connect(acnGroup, &QAction::triggered, this, &CustomGraphicsView::onGroupSelection);
+    connect(acnExpandGroup, &QAction::triggered, this, &CustomGraphicsView::onExpandGroup);
+    connect(acnTear, &QAction::triggered, this, &CustomGraphicsView::onToggleTear);
 
     connect(this, &CustomGraphicsView::UndoTriggered, UndoStack, &QUndoStack::undo);
     connect(this, &CustomGraphicsView::RedoTriggered, UndoStack, &QUndoStack::redo);
+    connect(router, &ConveyorRouter::RouteReady, this, &CustomGraphicsView::onRouteReady);
+    connect(monitor, &TelemetryMonitor::SamplesDrained, this, &CustomGraphicsView::onTelemetrySamples);
+    connect(monitor, &TelemetryMonitor::Stopped, this, &CustomGraphicsView::onTelemetryStopped);
 }
 
 void CustomGraphicsView::dragEnterEvent(QDragEnterEvent *event)
@@ -83,12 +221,14 @@ void CustomGraphicsView::dropEvent(QDropEvent *event)
         QMap<int, QVariant> roleDataMap;
         stream >> row >> col >> roleDataMap;
 
-        QIcon icon = qvariant_cast<QIcon>(roleDataMap[Qt::UserRole + 1]);
-        QPixmap pixmap = icon.pixmap(64, 64);
-        CustomPixmapItem* item = new CustomPixmapItem(pixmap);
+        QString iconFile = roleDataMap.value(Qt::UserRole + 1).toString();
+        int equipmentType = roleDataMap.value(Qt::UserRole + 2).toInt();
+        QPixmap pixmap = LazyIcon(iconFile).pixmap(64, 64);
+        CustomPixmapItem* item = new CustomPixmapItem(pixmap, equipmentType);
         item->setPos(mapToScene(event->pos()));
         scene->addItem(item);
-        connect(item, &CustomPixmapItem::positionChanged, this, &CustomGraphicsView::updateLinePosition);
+        WireNode(item);
+        TrackNode(item);
 
         EmitDebugData(event->pos());
         AddItemToAddStack(item);
@@ -107,7 +247,6 @@ void CustomGraphicsView::mousePressEvent(QMouseEvent *event)
         lineStartPoint = scenePos;
         currentLine = new ArrowLineItem(QLineF(lineStartPoint, lineStartPoint));
         scene->addItem(currentLine);
-        lineConnections[currentLine].first = dynamic_cast<QGraphicsEllipseItem *>(item);
         currentLine->SetStartCircle(dynamic_cast<QGraphicsEllipseItem *>(item));
         item->parentItem()->setFlag(QGraphicsItem::ItemIsMovable, false);
         currentLine->SetStartCircleAttributes();
@@ -120,6 +259,11 @@ void CustomGraphicsView::mousePressEvent(QMouseEvent *event)
     }
 
     QGraphicsView::mousePressEvent(event);
+
+    if (!currentLine && event->button() == Qt::LeftButton)
+    {
+        RecordSelectionStart();
+    }
 }
 
 void CustomGraphicsView::mouseMoveEvent(QMouseEvent *event)
@@ -138,7 +282,7 @@ void CustomGraphicsView::mouseReleaseEvent(QMouseEvent *event)
 {
     if (currentLine)
     {
-        lineConnections[currentLine].first->parentItem()->setFlag(QGraphicsItem::ItemIsMovable, true);
+        currentLine->GetStartCircle()->parentItem()->setFlag(QGraphicsItem::ItemIsMovable, true);
 
         QPointF scenePos = mapToScene(event->pos());
         QList<QGraphicsItem *>items = scene->items(scenePos);
@@ -151,7 +295,6 @@ void CustomGraphicsView::mouseReleaseEvent(QMouseEvent *event)
             {
                 QLineF newLine(lineStartPoint, scenePos);
                 currentLine->setLine(newLine);
-                lineConnections[currentLine].second = dynamic_cast<QGraphicsEllipseItem *>(item);
                 currentLine->SetEndCircle(dynamic_cast<QGraphicsEllipseItem *>(item));
                 currentLine->SetEndCircleAttributes();
                 lineDrawn = true;
@@ -159,14 +302,17 @@ void CustomGraphicsView::mouseReleaseEvent(QMouseEvent *event)
             }
         }
 
-        if(!lineDrawn || (lineConnections[currentLine].first->parentItem() == lineConnections[currentLine].second->parentItem()))
+        // collapsed groups only keep the lines they had when they were collapsed
+        if(!lineDrawn || (currentLine->GetStartCircle()->parentItem() == currentLine->GetEndCircle()->parentItem())
+                || dynamic_cast<GroupItem *>(currentLine->GetStartCircle()->parentItem())
+                || dynamic_cast<GroupItem *>(currentLine->GetEndCircle()->parentItem()))
         {
             scene->removeItem(currentLine);
-            lineConnections.remove(currentLine);
             delete currentLine;
         }
         else
         {
+            TrackLine(currentLine);
             AddItemToAddStack(currentLine);
         }
 
@@ -174,18 +320,9 @@ void CustomGraphicsView::mouseReleaseEvent(QMouseEvent *event)
     }
     else
     {
-        QPointF scenePos = mapToScene(event->pos());
-        QList<QGraphicsItem *>items = scene->items(scenePos);
-        for(QGraphicsItem *itm:items)
-        {
-            CustomPixmapItem *cpItm = dynamic_cast<CustomPixmapItem *>(itm);
-            if(cpItm)
-            {
-                emit PublishNewData(QString("(%1, %2)").arg(cpItm->pos().x()).arg(cpItm->pos().y()));
-                AddItemToMoveStack(cpItm);
-                break;
-            }
-        }
+        QGraphicsView::mouseReleaseEvent(event);
+        AddSelectionToMoveStack();
+        return;
     }
 
     QGraphicsView::mouseReleaseEvent(event);
@@ -211,7 +348,9 @@ void CustomGraphicsView::mouseDoubleClickEvent(QMouseEvent *event)
             contextMenu.addAction(acnMaxPlantProd);
             contextMenu.addSeparator();
 
+            acnMonitor->setText(monitor->IsRunning() ? tr("Stop Monitoring") : tr("Monitor"));
             contextMenu.addAction(acnMonitor);
+            contextMenu.addAction(acnTrend);
             contextMenu.addAction(acnFlipView);
             contextMenu.addAction(acnAddCustomText);
             contextMenu.addAction(acnSetVal);
@@ -221,6 +360,13 @@ void CustomGraphicsView::mouseDoubleClickEvent(QMouseEvent *event)
             contextMenu.addAction(acnCopyVal);
             contextMenu.addAction(acnPasteVal);
             contextMenu.addAction(acnDelItem);
+            contextMenu.addSeparator();
+
+            contextMenu.addAction(acnGroup);
+            if (dynamic_cast<GroupItem *>(widget))
+            {
+                contextMenu.addAction(acnExpandGroup);
+            }
             selectedItem = widget;
         }
     }
@@ -229,316 +375,2064 @@ void CustomGraphicsView::mouseDoubleClickEvent(QMouseEvent *event)
 
 void CustomGraphicsView::updateLinePosition()
 {
-    for (auto it = lineConnections.begin(); it != lineConnections.end(); ++it)
+    if (bulkDepth > 0)
     {
-        QGraphicsLineItem *line = it.key();
-        QGraphicsEllipseItem *StartCircle = it.value().first;
-        QGraphicsEllipseItem *EndCircle = it.value().second;
+        linesDirty = true;
+        return;
+    }
 
-        if (StartCircle && EndCircle)
-        {
-            line->setLine(QLineF(StartCircle->scenePos(), EndCircle->scenePos()));
-        }
+    // units placed during a bulk load did not report their moves
+    for (CustomPixmapItem *node : unitIndex.ResidentNodes())
+    {
+        router->SetObstacle(node, node->sceneBoundingRect());
     }
-}
 
-void CustomGraphicsView::ClearScene()
-{
-    RemoveAllLines();
-    scene->clear();
-    UndoStack->clear();
-    emit PublishUndoData(QString());
-    emit PublishRedoData(QString());
-    emit PublishNewData(QString());
-    emit PublishOldData(QString());
+    for (ArrowLineItem *line : linesByConnection)
+    {
+        RefreshLine(line);
+    }
 }
 
-void CustomGraphicsView::contextMenuEvent(QContextMenuEvent *event)
+void CustomGraphicsView::BeginBulkUpdate()
 {
-    contextMenu.clear();
-    ArrowLineItem *line = dynamic_cast<ArrowLineItem *>(itemAt(event->pos()));
-    if (line)
+    if (bulkDepth++ > 0)
     {
-        // Add actions to the context menu
-        contextMenu.addAction(acnSave);
-        contextMenu.addAction(acnDel);
-        selectedItem = line;
-        // Show the context menu at the cursor position
+        return;
     }
-    contextMenu.exec(event->globalPos());
+
+    // every insert or removal would otherwise update the BSP tree
+    savedIndexMethod = scene->itemIndexMethod();
+    scene->setItemIndexMethod(QGraphicsScene::NoIndex);
 }
 
-void CustomGraphicsView::wheelEvent(QWheelEvent *event)
+void CustomGraphicsView::EndBulkUpdate()
 {
-    setTransformationAnchor(AnchorUnderMouse);
-    double scalefactor = 1.5;
+    if (--bulkDepth > 0)
+    {
+        return;
+    }
 
-    if(event->modifiers() & Qt::ControlModifier)
+    for (const QPointer<CustomPixmapItem> &node : pendingNodes)
     {
-        if(event->delta() > 0)
-        {
-           scale(scalefactor,scalefactor);
-        }
-        else
+        if (node)
         {
-            scale(1/scalefactor,1/scalefactor);
+            connect(node, &CustomPixmapItem::positionChanged, this, &CustomGraphicsView::onItemMoved);
         }
     }
-    else
+    pendingNodes.clear();
+
+    scene->setItemIndexMethod(savedIndexMethod);
+    if (linesDirty)
     {
-        QGraphicsView::wheelEvent(event);
+        linesDirty = false;
+        updateLinePosition();
     }
 }
 
-void CustomGraphicsView::onActionSave()
+void CustomGraphicsView::WireNode(CustomPixmapItem *node)
 {
-    // Action 1 triggered
+    // setPos during a load would report every unit as moved
+    if (bulkDepth > 0)
+    {
+        pendingNodes.append(node);
+    }
+    else
+    {
+        connect(node, &CustomPixmapItem::positionChanged, this, &CustomGraphicsView::onItemMoved);
+    }
 }
 
-//remove lines and break connections . Remember to delete pointers
-void CustomGraphicsView::RemoveLines()
+void CustomGraphicsView::onItemMoved()
 {
-    ArrowLineItem * arrowLine = dynamic_cast<ArrowLineItem *>(selectedItem);
-    lineConnections.remove(arrowLine);
-}
+    CustomPixmapItem *item = qobject_cast<CustomPixmapItem *>(sender());
+    if (item)
+    {
+        movedItems.insert(item);
+    }
 
-//remove lines and break connections . Remember to delete pointers
-void CustomGraphicsView::RemoveAllLines()
-{
-    for (auto it = lineConnections.begin(); it != lineConnections.end(); ++it)
+    // dragging a selection moves every selected item within one mouse event,
+    // coalesce them into a single pass over the lines
+    if (!lineFlushPending)
     {
-        delete it.key();
+        lineFlushPending = true;
+        QTimer::singleShot(0, this, &CustomGraphicsView::flushLinePositions);
     }
-    lineConnections.clear();
 }
 
-void CustomGraphicsView::onActionDelete()
+void CustomGraphicsView::flushLinePositions()
 {
-    if (selectedItem)
+    lineFlushPending = false;
+    if (movedItems.isEmpty())
     {
-        scene->removeItem(selectedItem);
-        RemoveLines();
-        delete selectedItem;
-        selectedItem = nullptr;
+        return;
     }
-}
 
-void CustomGraphicsView::onSetValue()
-{
-    CustomPixmapItem* item = dynamic_cast<CustomPixmapItem *>(selectedItem);
-    if(item)
+    QList<CustomPixmapItem *> moved;
+    for (CustomPixmapItem *item : movedItems)
+    {
+        if (unitIndex.Find(item->GetItemId()) == item)
+        {
+            router->SetObstacle(item, item->sceneBoundingRect());
+            moved.append(item);
+        }
+    }
+
+    for (ArrowLineItem *line : LinesAt(moved))
     {
-        double value = QInputDialog::getDouble(this, "Enter Value:", "Operation:", 0, 0, 1000, 2, nullptr);
-        item->SetText(QString::number(value));
+        RefreshLine(line);
     }
+    movedItems.clear();
 }
 
-void CustomGraphicsView::onAddCustomText()
+void CustomGraphicsView::RefreshLine(ArrowLineItem *arrowLine)
 {
-    CustomPixmapItem* item = dynamic_cast<CustomPixmapItem *>(selectedItem);
-    if(item){
-        bool ok;
-        QString value = QInputDialog::getText(this, "Enter Text", "Name:", QLineEdit::Normal, QString(), &ok);
-        if (ok && !value.isEmpty()){
-            item->SetText(value);
-        }
+    QLineF newLine(arrowLine->GetStartCircle()->scenePos(), arrowLine->GetEndCircle()->scenePos());
+    if (newLine == arrowLine->line() && (!orthogonalRouting || !arrowLine->GetRoute().isEmpty()))
+    {
+        return;
+    }
+
+    // straight line until the router publishes the new path
+    arrowLine->setLine(newLine);
+    arrowLine->ClearRoute();
+    if (orthogonalRouting)
+    {
+        router->Request(arrowLine, newLine.p1(), newLine.p2());
     }
 }
-void CustomGraphicsView::onCopyVal()
+
+void CustomGraphicsView::onRouteReady(ArrowLineItem *line, const QPolygonF &path)
 {
-    if (selectedItem) {
-        CustomPixmapItem* itemToCopy = dynamic_cast<CustomPixmapItem*>(selectedItem);
-        if (itemToCopy) {
-            CustomPixmapItem* copied = itemToCopy->clone();
-            //CustomPixmapItem* copied = new CustomPixmapItem(itemToCopy);
-            if(copied){
-
-                copied->setPos(mapToScene(selectedItem->scenePos().x(),selectedItem->scenePos().y() ));
-                scene->addItem(copied);
-                emit PublishNewData(QString("(%1, %2)").arg(copied->pos().x()).arg(copied->pos().y()));
-                AddItemToMoveStack(copied);
-            }
-        }
+    if (orthogonalRouting && linesByConnection.value(line->GetConnectionId()) == line)
+    {
+        line->SetRoute(path);
     }
 }
 
-void CustomGraphicsView::onPasteVal()
+void CustomGraphicsView::SetOrthogonalRouting(bool enabled)
 {
-    if (copiedItem)
+    orthogonalRouting = enabled;
+    router->Clear();
+    if (!enabled)
     {
-        AddItemToMoveStack(copiedItem);
-        scene->addItem(copiedItem);
-        copiedItem = nullptr;
+        for (ArrowLineItem *line : linesByConnection)
+        {
+            line->ClearRoute();
+        }
     }
+    updateLinePosition();
 }
 
-void CustomGraphicsView::onResult()
+void CustomGraphicsView::AutoLayout()
 {
-    double result = 0.0;
-    QSet<CustomPixmapItem*> visitItems;
+    BulkSceneUpdate bulk(this);
+
+    // the layout needs the whole plant, paging resumes at the new viewport
+    MaterializeChunks(pager.Chunks());
 
-    for (auto it = lineConnections.begin(); it != lineConnections.end(); ++it)
+    const int rows = flowsheetModel.NodeCount();
+    QVector<int> layoutIndex(rows, -1);
+    QList<QGraphicsItem *> nodes;
+    for (int row = 0; row < rows; ++row)
+    {
+        if (CustomPixmapItem *node = unitIndex.Find(flowsheetModel.GetItemId(row)))
+        {
+            layoutIndex[row] = nodes.size();
+            nodes.append(node);
+        }
+    }
+    if (nodes.isEmpty())
     {
-        QGraphicsEllipseItem *startEllipse = it.value().first;
-        QGraphicsEllipseItem *endEllipse = it.value().second;
+        return;
+    }
 
-        if (startEllipse && endEllipse)
+    const FlowsheetModel::Adjacency &flow = flowsheetModel.Downstream();
+    QVector<QPair<int, int>> edges;
+    for (int row = 0; row < rows; ++row)
+    {
+        for (int i = flow.Offsets.at(row); i < flow.Offsets.at(row + 1); ++i)
         {
-            CustomPixmapItem *startItem = dynamic_cast<CustomPixmapItem *>(startEllipse->parentItem());
-            CustomPixmapItem *endItem = dynamic_cast<CustomPixmapItem *>(endEllipse->parentItem());
+            int from = layoutIndex.at(row);
+            int to = layoutIndex.at(flow.Targets.at(i));
+            if (from >= 0 && to >= 0)
+            {
+                edges.append(qMakePair(from, to));
+            }
+        }
+    }
 
-            int endId = endItem->GetItemId();
-            int n;
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    QVector<QPointF> positions = ComputeLayeredLayout(nodes.size(), edges, QSizeF(180, 160));
+    QApplication::restoreOverrideCursor();
 
-            if(endId > 4){
-                n = endId % 4;
-            }else{
-                n = endId;
-            }
+    QVector<QPointF> oldPositions;
+    oldPositions.reserve(nodes.size());
+    for (QGraphicsItem *item : nodes)
+    {
+        oldPositions.append(item->pos());
+    }
 
-            switch(n){
-            case 1 :
-                result += startItem->GetText().toDouble() +  endItem->GetText().toDouble();
-                visitItems.insert(startItem);
-                break;
-            case 2 :
-                result += startItem->GetText().toDouble() * endItem->GetText().toDouble();
-                visitItems.insert(endItem);
-                break;
-            case 3 :
-                result += startItem->GetText().toDouble() / endItem->GetText().toDouble();
-                visitItems.insert(endItem);
-                break;
-            default:
-                result += startItem->GetText().toDouble() - endItem->GetText().toDouble();
-                break;
+    MoveItemsCommand* command = new MoveItemsCommand(this, nodes, oldPositions, positions);
+    command->setText(tr("Auto Layout"));
+    connect(command, &MoveItemsCommand::PublishUndoData, this, &CustomGraphicsView::PublishUndoData);
+    connect(command, &MoveItemsCommand::PublishRedoData, this, &CustomGraphicsView::PublishRedoData);
+    UndoStack->push(command);
+
+    // the fixed scene rect would clip anything but a small plant
+    scene->setSceneRect(scene->sceneRect().united(scene->itemsBoundingRect()));
+    fitInView(scene->itemsBoundingRect(), Qt::KeepAspectRatio);
+}
+
+QList<ArrowLineItem *> CustomGraphicsView::LinesAt(const QList<CustomPixmapItem *> &nodes) const
+{
+    const FlowsheetModel::Adjacency &ports = flowsheetModel.PortConnections();
+    QList<ArrowLineItem *> lines;
+    // a line between two of the units is listed once
+    QSet<int> listed;
+    for (CustomPixmapItem *node : nodes)
+    {
+        int row = flowsheetModel.NodeOf(node->GetItemId());
+        if (row < 0)
+        {
+            continue;
+        }
+        const int first = ports.Offsets.at(PortSlot(row, FlowsheetModel::Port::Inlet));
+        const int last = ports.Offsets.at(PortSlot(row, FlowsheetModel::Port::Outlet) + 1);
+        for (int i = first; i < last; ++i)
+        {
+            int connection = ports.Targets.at(i);
+            ArrowLineItem *line = linesByConnection.value(flowsheetModel.GetConnectionId(connection));
+            if (line && !listed.contains(connection))
+            {
+                listed.insert(connection);
+                lines.append(line);
             }
         }
     }
-    emit resultUpdated(QString::number(result));
+    return lines;
 }
 
-void CustomGraphicsView::saveToFile(const QString &fileName)
+CustomPixmapItem *CustomGraphicsView::ResolveUnit(quint64 itemId)
 {
-    QFile file(fileName);
-    if (!file.open(QIODevice::WriteOnly)) {
-        qWarning("Could not open file for writing");
-        return;
-    }
-    QDataStream out(&file);
-    // Save all CustomPixmapItems
-    QList<QGraphicsItem *> items = scene->items();
-    for (QGraphicsItem *item : items) {
-        if (CustomPixmapItem *pixmapItem = dynamic_cast<CustomPixmapItem *>(item)) {
-            out << QString("CustomPixmapItem");
-            pixmapItem->write(out);
-        } else if (ArrowLineItem *lineItem = dynamic_cast<ArrowLineItem *>(item)) {
-            out << QString("ArrowLineItem");
-            lineItem->write(out);
+    if (unitIndex.StateOf(itemId) == NodeIndex::Paged)
+    {
+        QPointF pos;
+        if (pager.NodePosition(itemId, &pos))
+        {
+            MaterializeChunks({pager.ChunkOf(pos)});
         }
     }
-    QMessageBox msgBox;
-    msgBox.setText("Data Saved Succesfully!!!");
-    msgBox.exec();
+    return unitIndex.Find(itemId);
 }
 
-void CustomGraphicsView::loadFromFile(const QString &fileName)
+void CustomGraphicsView::SetTiledMode(bool enabled)
 {
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly)) {
-        qWarning("Could not open file for reading");
-        return;
+    tiledMode = enabled;
+    if (enabled)
+    {
+        UpdateResidency();
     }
-    QDataStream in(&file);
-    scene->clear();
-    lineConnections.clear();
-
-    QList<ArrowLineItem*> lineItems;
-    QMap<int, CustomPixmapItem*> customItems;
-    while (!in.atEnd()) {
-        QString itemType;
-        in >> itemType;
-
-        if (itemType == "CustomPixmapItem") {
-            CustomPixmapItem *pixmapItem = new CustomPixmapItem(QPixmap());
-            pixmapItem->read(in);
-            pixmapItem->HideLabelIfNeeded();
-            scene->addItem(pixmapItem);
-            customItems.insert(pixmapItem->GetItemId(), pixmapItem);
-            connect(pixmapItem, &CustomPixmapItem::positionChanged, this, &CustomGraphicsView::updateLinePosition);
-        } else if (itemType == "ArrowLineItem") {
-            ArrowLineItem *lineItem = new ArrowLineItem(QLineF());
-            lineItem->read(in);
-            scene->addItem(lineItem);
-            lineItems.append(lineItem);
-        }
+    else
+    {
+        MaterializeChunks(pager.Chunks());
     }
-    reconnectLines(lineItems, customItems);
 }
 
-void CustomGraphicsView::saveToXml(const QString &fileName)
+void CustomGraphicsView::scrollContentsBy(int dx, int dy)
 {
-    QDomDocument doc;
-    QDomElement root = doc.createElement("Scene");
-    doc.appendChild(root);
+    QGraphicsView::scrollContentsBy(dx, dy);
+    ScheduleResidencyUpdate();
+}
 
-    QList<QGraphicsItem *> items = scene->items();
+void CustomGraphicsView::resizeEvent(QResizeEvent *event)
+{
+    QGraphicsView::resizeEvent(event);
+    ScheduleResidencyUpdate();
+}
 
-    for (QGraphicsItem *item : items)
+void CustomGraphicsView::drawForeground(QPainter *painter, const QRectF &rect)
+{
+    QGraphicsView::drawForeground(painter, rect);
+    for (const DiffMark &mark : diffMarks)
     {
-        QDomElement element;
-
-        if (auto pixmapItem = dynamic_cast<CustomPixmapItem *>(item))
+        QRectF bounds = mark.Rect.isNull() ? QRectF(mark.Line.p1(), mark.Line.p2()).normalized() : mark.Rect;
+        if (!bounds.adjusted(-2, -2, 2, 2).intersects(rect))
         {
-            element = doc.createElement("CustomPixmapItem");
-            element.setAttribute("id", pixmapItem->GetItemId());
-            element.setAttribute("x", pixmapItem->pos().x());
-            element.setAttribute("y", pixmapItem->pos().y());
-
-            // Save pixmap width and height
-//            QPixmap pixmap = pixmapItem->PixmapLabel->pixmap()->scaled(pixmapItem->pixmapWidth(), pixmapItem->pixmapHeight());
-//            element.setAttribute("width", pixmap.width());
-//            element.setAttribute("height", pixmap.height());
-            // Save text
-//            element.setAttribute("text", pixmapItem->TextLabel->text());
-
-            // Save pixmap data
-            QByteArray byteArray;
-            QBuffer buffer(&byteArray);
-            buffer.open(QIODevice::WriteOnly);
-//            pixmap.save(&buffer, "PNG"); // Save pixmap to PNG format
-            buffer.close();
-            element.setAttribute("pixmapData", QString(byteArray.toBase64()));
-            root.appendChild(element);
+            continue;
         }
-        else if (auto lineItem = dynamic_cast<ArrowLineItem *>(item))
+        QPen pen(mark.Colour, 3, mark.Style);
+        pen.setCosmetic(true);
+        painter->setPen(pen);
+        painter->setBrush(Qt::NoBrush);
+        if (mark.Rect.isNull())
         {
-            element = doc.createElement("ArrowLineItem");
-            element.setAttribute("startX", lineItem->line().x1());
-            element.setAttribute("startY", lineItem->line().y1());
-            element.setAttribute("endX", lineItem->line().x2());
-            element.setAttribute("endY", lineItem->line().y2());
-            root.appendChild(element);
+            painter->drawLine(mark.Line);
+        }
+        else
+        {
+            painter->drawRoundedRect(mark.Rect, 6, 6);
         }
     }
-
-    QFile file(fileName);
-    if (!file.open(QIODevice::WriteOnly))
+    if (searchHit && searchHit->scene() == scene)
     {
-        qWarning() << "Could not open file for writing";
-        return;
+        QPen pen(QColor(255, 160, 0), 3);
+        pen.setCosmetic(true);
+        painter->setPen(pen);
+        painter->setBrush(Qt::NoBrush);
+        painter->drawRoundedRect(searchHit->sceneBoundingRect().adjusted(-6, -6, 6, 6), 6, 6);
     }
-
-    QTextStream stream(&file);
-    stream << doc.toString();
-    file.close();
-
-    QMessageBox msgBox;
-    msgBox.setText("Data in Xml Saved Successfully!");
-    msgBox.exec();
 }
 
-void CustomGraphicsView::loadFromXml(const QString &fileName)
+void CustomGraphicsView::ScheduleResidencyUpdate()
+{
+    if (tiledMode && !residencyUpdatePending)
+    {
+        residencyUpdatePending = true;
+        QTimer::singleShot(0, this, &CustomGraphicsView::UpdateResidency);
+    }
+}
+
+void CustomGraphicsView::UpdateResidency()
+{
+    residencyUpdatePending = false;
+    if (!tiledMode)
+    {
+        return;
+    }
+
+    // keep one chunk around the viewport so short scrolls do not page
+    qreal margin = pager.GetChunkSize();
+    QRectF visible = mapToScene(viewport()->rect()).boundingRect().adjusted(-margin, -margin, margin, margin);
+    QSet<quint64> wanted = pager.ChunksIn(visible);
+
+    QList<CustomPixmapItem *> evict;
+    for (QGraphicsItem *item : scene->items())
+    {
+        CustomPixmapItem *cpItm = dynamic_cast<CustomPixmapItem *>(item);
+        if (cpItm && cpItm->parentItem() == nullptr && !cpItm->isSelected()
+                && !wanted.contains(pager.ChunkOf(cpItm->pos())))
+        {
+            evict.append(cpItm);
+        }
+    }
+    EvictNodes(evict);
+
+    QList<quint64> chunks;
+    for (quint64 chunk : wanted)
+    {
+        if (pager.HasChunk(chunk))
+        {
+            chunks.append(chunk);
+        }
+    }
+    MaterializeChunks(chunks);
+}
+
+void CustomGraphicsView::EvictNodes(const QList<CustomPixmapItem *> &nodes)
+{
+    if (nodes.isEmpty())
+    {
+        return;
+    }
+
+    BulkSceneUpdate bulk(this);
+    const QList<ArrowLineItem *> lines = LinesAt(nodes);
+
+    // groups are recorded while their lines are still bound
+    for (CustomPixmapItem *node : nodes)
+    {
+        PagedNode record;
+        record.ItemId = node->GetItemId();
+        record.Pos = node->pos();
+        record.Parameters = node->GetParameters();
+        QDataStream out(&record.Record, QIODevice::WriteOnly);
+        WriteItemRecord(out, node);
+        pager.StoreNode(record);
+    }
+
+    // the connections stay in the model and the validator, only their lines go
+    for (ArrowLineItem *line : lines)
+    {
+        PagedEdge edge;
+        edge.StartItemId = static_cast<CustomPixmapItem *>(line->GetStartCircle()->parentItem())->GetItemId();
+        edge.EndItemId = static_cast<CustomPixmapItem *>(line->GetEndCircle()->parentItem())->GetItemId();
+        edge.ConnectionId = line->GetConnectionId();
+        QDataStream out(&edge.Record, QIODevice::WriteOnly);
+        WriteItemRecord(out, line);
+        pager.StoreEdge(edge);
+
+        for (QGraphicsEllipseItem *circle : {line->GetStartCircle(), line->GetEndCircle()})
+        {
+            if (GroupItem *group = dynamic_cast<GroupItem *>(circle->parentItem()))
+            {
+                group->UnbindLine(line);
+            }
+        }
+        router->Forget(line);
+        if (selectedItem == line)
+        {
+            selectedItem = nullptr;
+        }
+        linesByConnection.remove(line->GetConnectionId());
+        scene->removeItem(line);
+        delete line;
+    }
+
+    // paged out units keep their rule state, only the badge target goes
+    for (CustomPixmapItem *node : nodes)
+    {
+        if (unitIndex.Find(node->GetItemId()) == node)
+        {
+            unitIndex.MarkPaged(node->GetItemId());
+        }
+        router->RemoveObstacle(node);
+        if (selectedItem == node)
+        {
+            selectedItem = nullptr;
+        }
+        selectionStartPositions.remove(node);
+        movedItems.remove(node);
+        scene->removeItem(node);
+        delete node;
+    }
+}
+
+void CustomGraphicsView::MaterializeChunks(const QList<quint64> &chunks)
+{
+    QList<CustomPixmapItem *> nodes;
+    QList<quint64> itemIds;
+    for (quint64 chunk : chunks)
+    {
+        for (const PagedNode &record : pager.TakeChunk(chunk))
+        {
+            QDataStream in(record.Record);
+            QList<ArrowLineItem *> noLines;
+            ReadItemRecords(in, nodes, noLines, SCENE_FORMAT_VERSION);
+            itemIds.append(record.ItemId);
+        }
+    }
+    if (nodes.isEmpty())
+    {
+        return;
+    }
+
+    BulkSceneUpdate bulk(this);
+    for (CustomPixmapItem *node : nodes)
+    {
+        scene->addItem(node);
+        unitIndex.Insert(node);
+        WireNode(node);
+        if (monitor->IsRunning() && liveReadings.contains(node->GetItemId()))
+        {
+            const QVector<double> &readings = liveReadings.value(node->GetItemId());
+            node->SetStatus(ReadingText(readings), staleReadings.contains(node->GetItemId())
+                            ? QColor(Qt::gray) : ReadingColour(node->GetParameters(), readings));
+        }
+    }
+
+    QList<CustomPixmapItem *> noNodes;
+    QList<ArrowLineItem *> lines;
+    for (const PagedEdge &edge : pager.TakeResidentEdges(itemIds))
+    {
+        QDataStream in(edge.Record);
+        int read = lines.size();
+        ReadItemRecords(in, noNodes, lines, SCENE_FORMAT_VERSION);
+        // TrackLine hands the connection left in the model back to the line
+        for (int i = read; i < lines.size(); ++i)
+        {
+            lines.at(i)->SetConnectionId(edge.ConnectionId);
+        }
+    }
+    for (ArrowLineItem *line : lines)
+    {
+        scene->addItem(line);
+    }
+
+    reconnectLines(lines, unitIndex);
+    BindLinesToGroups(lines);
+    TrackItems(nodes, lines);
+}
+
+void CustomGraphicsView::onGroupSelection()
+{
+    GroupSelection();
+}
+
+void CustomGraphicsView::onExpandGroup()
+{
+    GroupItem *group = dynamic_cast<GroupItem *>(selectedItem);
+    if (group)
+    {
+        ExpandGroup(group);
+        selectedItem = nullptr;
+    }
+}
+
+void CustomGraphicsView::GroupSelection()
+{
+    QVector<quint64> itemIds;
+    for (QGraphicsItem *item : scene->selectedItems())
+    {
+        CustomPixmapItem *cpItm = dynamic_cast<CustomPixmapItem *>(item);
+        if (cpItm && cpItm->parentItem() == nullptr)
+        {
+            itemIds.append(cpItm->GetItemId());
+        }
+    }
+    if (itemIds.size() < 2)
+    {
+        QMessageBox::information(this, tr("Group"), tr("Select at least two units to group."));
+        return;
+    }
+
+    bool ok;
+    QString name = QInputDialog::getText(this, tr("Group"), tr("Name:"), QLineEdit::Normal, tr("Sub-circuit"), &ok);
+    if (!ok)
+    {
+        return;
+    }
+
+    GroupCommand* command = new GroupCommand(this, itemIds, name);
+    connect(command, &GroupCommand::PublishUndoData, this, &CustomGraphicsView::PublishUndoData);
+    connect(command, &GroupCommand::PublishRedoData, this, &CustomGraphicsView::PublishRedoData);
+    UndoStack->push(command);
+}
+
+quint64 CustomGraphicsView::GroupUnits(const QVector<quint64> &itemIds, const QString &name, quint64 groupId)
+{
+    QList<CustomPixmapItem *> members;
+    QSet<QGraphicsItem *> memberSet;
+    // the sub-circuit on its own, to solve for the group's cached result
+    FlowsheetModel contents;
+    for (quint64 itemId : itemIds)
+    {
+        CustomPixmapItem *cpItm = ResolveUnit(itemId);
+        if (cpItm && cpItm->parentItem() == nullptr)
+        {
+            members.append(cpItm);
+            memberSet.insert(cpItm);
+            SetModelNode(contents, cpItm);
+        }
+    }
+    if (members.size() < 2)
+    {
+        return 0;
+    }
+
+    BulkSceneUpdate bulk(this);
+    QList<ArrowLineItem *> internalLines;
+    QList<ArrowLineItem *> externalLines;
+    for (ArrowLineItem *line : LinesAt(members))
+    {
+        bool firstInside = memberSet.contains(line->GetStartCircle()->parentItem());
+        bool secondInside = memberSet.contains(line->GetEndCircle()->parentItem());
+        if (firstInside && secondInside)
+        {
+            internalLines.append(line);
+            FlowsheetModel::Connection connection;
+            ConnectionOf(line, &connection);
+            contents.AddConnection(connection);
+        }
+        else
+        {
+            externalLines.append(line);
+        }
+    }
+
+    // the sub-circuit is stored in the scene file format, lines refer to units by id
+    QByteArray contents;
+    QDataStream out(&contents, QIODevice::WriteOnly);
+    out << QString(SCENE_HEADER) << SCENE_FORMAT_VERSION;
+    QRectF bounds;
+    for (CustomPixmapItem *member : members)
+    {
+        WriteItemRecord(out, member);
+        bounds = bounds.united(member->sceneBoundingRect());
+    }
+    for (ArrowLineItem *line : internalLines)
+    {
+        WriteItemRecord(out, line);
+    }
+
+    GroupItem *group = new GroupItem();
+    if (groupId != 0)
+    {
+        group->SetItemId(groupId);
+    }
+    group->SetText(name);
+    group->setPos(bounds.center() - QPointF(50, 60));
+    group->SetContents(contents, members.size(), group->pos());
+    group->SetCachedResult(resultCache.Evaluate(contents.Compile()));
+
+    for (ArrowLineItem *arrowLine : externalLines)
+    {
+        bool firstInside = memberSet.contains(arrowLine->GetStartCircle()->parentItem());
+        QGraphicsEllipseItem *innerCircle = firstInside ? arrowLine->GetStartCircle() : arrowLine->GetEndCircle();
+        QGraphicsEllipseItem *outerCircle = firstInside ? arrowLine->GetEndCircle() : arrowLine->GetStartCircle();
+        CustomPixmapItem *inner = static_cast<CustomPixmapItem *>(innerCircle->parentItem());
+        CustomPixmapItem *outer = static_cast<CustomPixmapItem *>(outerCircle->parentItem());
+        GroupItem *nested = dynamic_cast<GroupItem *>(inner);
+        const GroupLink *nestedLink = nested ? nested->LinkForLine(arrowLine) : nullptr;
+
+        GroupLink link;
+        link.InnerItemId = inner->GetItemId();
+        link.InnerIsStartCircle = inner->GetStartCircle() == innerCircle;
+        link.GroupIsFirst = firstInside;
+        link.OuterItemId = outer->GetItemId();
+        link.OuterIsStartCircle = outer->GetStartCircle() == outerCircle;
+        link.EvalItemId = nestedLink ? nestedLink->EvalItemId : inner->GetItemId();
+        link.InnerParameters = nestedLink ? nestedLink->InnerParameters : inner->GetParameters();
+        group->AddLink(link, arrowLine);
+
+        QGraphicsEllipseItem *groupCircle = link.InnerIsStartCircle ? group->GetStartCircle() : group->GetEndCircle();
+        if (firstInside)
+        {
+            arrowLine->SetStartCircle(groupCircle);
+            arrowLine->SetStartCircleAttributes();
+        }
+        else
+        {
+            arrowLine->SetEndCircle(groupCircle);
+            arrowLine->SetEndCircleAttributes();
+        }
+    }
+
+    for (ArrowLineItem *line : internalLines)
+    {
+        ForgetLine(line);
+        router->Forget(line);
+        scene->removeItem(line);
+        delete line;
+    }
+    for (CustomPixmapItem *member : members)
+    {
+        if (selectedItem == member)
+        {
+            selectedItem = nullptr;
+        }
+        ForgetNode(member);
+        selectionStartPositions.remove(member);
+        movedItems.remove(member);
+        scene->removeItem(member);
+        delete member;
+    }
+
+    scene->addItem(group);
+    WireNode(group);
+    TrackNode(group);
+    for (ArrowLineItem *line : externalLines)
+    {
+        TrackLine(line);
+    }
+
+    updateLinePosition();
+    return group->GetItemId();
+}
+
+void CustomGraphicsView::ExpandGroup(GroupItem *group)
+{
+    UngroupCommand* command = new UngroupCommand(this, group->GetItemId(), group->GetText());
+    connect(command, &UngroupCommand::PublishUndoData, this, &CustomGraphicsView::PublishUndoData);
+    connect(command, &UngroupCommand::PublishRedoData, this, &CustomGraphicsView::PublishRedoData);
+    UndoStack->push(command);
+}
+
+QVector<quint64> CustomGraphicsView::UngroupUnits(quint64 groupId)
+{
+    GroupItem *group = dynamic_cast<GroupItem *>(ResolveUnit(groupId));
+    if (!group)
+    {
+        return QVector<quint64>();
+    }
+    QByteArray contents = group->GetContents();
+    QDataStream in(&contents, QIODevice::ReadOnly);
+    QList<CustomPixmapItem *> nodes;
+    QList<ArrowLineItem *> lines;
+    if (!ReadItemRecords(in, nodes, lines))
+    {
+        qWarning() << "Group" << group->GetText() << "has a newer format version";
+        return QVector<quint64>();
+    }
+
+    BulkSceneUpdate bulk(this);
+
+    // the group may have been moved while it was collapsed
+    QPointF offset = group->pos() - group->GetOrigin();
+    NodeIndex members;
+    for (CustomPixmapItem *node : nodes)
+    {
+        node->setPos(node->pos() + offset);
+        scene->addItem(node);
+        members.Insert(node);
+        WireNode(node);
+    }
+    for (ArrowLineItem *line : lines)
+    {
+        scene->addItem(line);
+    }
+    reconnectLines(lines, members);
+
+    QList<ArrowLineItem *> orphanLines;
+    QList<ArrowLineItem *> reattachedLines;
+    for (ArrowLineItem *arrowLine : LinesAt({group}))
+    {
+        bool firstOnGroup = arrowLine->GetStartCircle()->parentItem() == group;
+        reattachedLines.append(arrowLine);
+
+        const GroupLink *link = group->LinkForLine(arrowLine);
+        CustomPixmapItem *inner = link ? members.Find(link->InnerItemId) : nullptr;
+        if (!inner)
+        {
+            orphanLines.append(arrowLine);
+            continue;
+        }
+
+        QGraphicsEllipseItem *innerCircle = link->InnerIsStartCircle ? inner->GetStartCircle() : inner->GetEndCircle();
+        if (firstOnGroup)
+        {
+            arrowLine->SetStartCircle(innerCircle);
+            arrowLine->SetStartCircleAttributes();
+        }
+        else
+        {
+            arrowLine->SetEndCircle(innerCircle);
+            arrowLine->SetEndCircleAttributes();
+        }
+    }
+
+    for (ArrowLineItem *line : orphanLines)
+    {
+        ForgetLine(line);
+        reattachedLines.removeOne(line);
+        router->Forget(line);
+        scene->removeItem(line);
+        delete line;
+    }
+    // expanded nested groups take their lines back
+    BindLinesToGroups(lines);
+    BindLinesToGroups(reattachedLines);
+
+    if (selectedItem == group)
+    {
+        selectedItem = nullptr;
+    }
+    ForgetNode(group);
+    selectionStartPositions.remove(group);
+    movedItems.remove(group);
+    scene->removeItem(group);
+    delete group;
+    TrackItems(nodes, lines);
+    for (ArrowLineItem *line : reattachedLines)
+    {
+        TrackLine(line);
+    }
+
+    updateLinePosition();
+    QVector<quint64> itemIds;
+    for (CustomPixmapItem *node : nodes)
+    {
+        itemIds.append(node->GetItemId());
+    }
+    return itemIds;
+}
+
+void CustomGraphicsView::ClearScene()
+{
+    BulkSceneUpdate bulk(this);
+    RemoveAllLines();
+    ResetTracking();
+    selectionStartPositions.clear();
+    movedItems.clear();
+    selectedItem = nullptr;
+    scene->clear();
+    pager.Clear();
+    history.Clear();
+    diffMarks.clear();
+    emit PublishUndoData(QString());
+    emit PublishRedoData(QString());
+    emit PublishNewData(QString());
+    emit PublishOldData(QString());
+}
+
+const ResultCache &CustomGraphicsView::GetResultCache() const
+{
+    return resultCache;
+}
+
+QVector<SearchMatch> CustomGraphicsView::SearchUnits(const QString &query, int limit) const
+{
+    return searchIndex.Find(query, limit);
+}
+
+QVector<QRectF> CustomGraphicsView::PagedUnitRects(const QRectF &rect) const
+{
+    QVector<QRectF> rects;
+    for (const PagedNode &node : pager.NodesIn(rect.adjusted(-NOMINAL_UNIT_SIZE.width(), -NOMINAL_UNIT_SIZE.height(), 0, 0)))
+    {
+        rects.append(QRectF(node.Pos, NOMINAL_UNIT_SIZE));
+    }
+    return rects;
+}
+
+void CustomGraphicsView::PanTo(const QPointF &pos)
+{
+    // the scroll bars stop at the scene rect, which units may lie far outside of
+    QRectF visible = mapToScene(viewport()->rect()).boundingRect();
+    visible.moveCenter(pos);
+    if (!scene->sceneRect().contains(visible))
+    {
+        scene->setSceneRect(scene->sceneRect().united(visible));
+    }
+    centerOn(pos);
+}
+
+void CustomGraphicsView::contextMenuEvent(QContextMenuEvent *event)
+{
+    contextMenu.clear();
+    ArrowLineItem *line = dynamic_cast<ArrowLineItem *>(itemAt(event->pos()));
+    if (line)
+    {
+        // Add actions to the context menu
+        contextMenu.addAction(acnSave);
+        contextMenu.addAction(acnDel);
+        acnTear->setChecked(line->IsTear());
+        contextMenu.addAction(acnTear);
+        selectedItem = line;
+        // Show the context menu at the cursor position
+    }
+    contextMenu.exec(event->globalPos());
+}
+
+void CustomGraphicsView::wheelEvent(QWheelEvent *event)
+{
+    setTransformationAnchor(AnchorUnderMouse);
+    double scalefactor = 1.5;
+
+    if(event->modifiers() & Qt::ControlModifier)
+    {
+        if(event->delta() > 0)
+        {
+           scale(scalefactor,scalefactor);
+        }
+        else
+        {
+            scale(1/scalefactor,1/scalefactor);
+        }
+        ScheduleResidencyUpdate();
+    }
+    else
+    {
+        QGraphicsView::wheelEvent(event);
+    }
+}
+
+void CustomGraphicsView::onActionSave()
+{
+    // Action 1 triggered
+}
+
+//remove lines and break connections . Remember to delete pointers
+void CustomGraphicsView::RemoveAllLines()
+{
+    qDeleteAll(linesByConnection);
+    linesByConnection.clear();
+    router->Clear();
+}
+
+void CustomGraphicsView::onActionDelete()
+{
+    if (!selectedItem)
+    {
+        return;
+    }
+    // a unit's lines are taken out before it and put back after it
+    QList<QGraphicsItem *> items;
+    if (CustomPixmapItem *unit = dynamic_cast<CustomPixmapItem *>(selectedItem))
+    {
+        for (ArrowLineItem *line : LinesAt({unit}))
+        {
+            items.append(line);
+        }
+    }
+    items.append(selectedItem);
+
+    UndoStack->beginMacro(tr("Delete %1 items").arg(items.size()));
+    for (QGraphicsItem *item : items)
+    {
+        AddItemToRemoveStack(item);
+    }
+    UndoStack->endMacro();
+}
+
+void CustomGraphicsView::onSetValue()
+{
+    CustomPixmapItem* item = dynamic_cast<CustomPixmapItem *>(selectedItem);
+    if(item)
+    {
+        const ParameterBlock &parameters = item->GetParameters();
+        const QStringList &names = parameters.GetSchema().DoubleNames;
+        int index = ParameterBlock::Value;
+        bool ok = true;
+        if (names.size() > 1)
+        {
+            QString name = QInputDialog::getItem(this, "Select Parameter", "Parameter:", names, 0, false, &ok);
+            index = names.indexOf(name);
+        }
+        if (!ok || index < 0)
+        {
+            return;
+        }
+
+        double value = QInputDialog::getDouble(this, "Enter Value:", names.at(index) + ":",
+                                               parameters.GetDouble(index), 0, 1000, 2, &ok);
+        if (ok)
+        {
+            item->SetDoubleParameter(index, value);
+            TrackNode(item);
+        }
+    }
+}
+
+void CustomGraphicsView::onAddCustomText()
+{
+    CustomPixmapItem* item = dynamic_cast<CustomPixmapItem *>(selectedItem);
+    if(item){
+        bool ok;
+        QString value = QInputDialog::getText(this, "Enter Text", "Name:", QLineEdit::Normal, QString(), &ok);
+        if (ok && !value.isEmpty()){
+            item->SetText(value);
+            TrackNode(item);
+        }
+    }
+}
+void CustomGraphicsView::onCopyVal()
+{
+    QList<CustomPixmapItem *> members;
+    QSet<QGraphicsItem *> memberSet;
+    for (QGraphicsItem *item : scene->selectedItems())
+    {
+        CustomPixmapItem *cpItm = dynamic_cast<CustomPixmapItem *>(item);
+        if (cpItm && cpItm->parentItem() == nullptr)
+        {
+            members.append(cpItm);
+            memberSet.insert(cpItm);
+        }
+    }
+    CustomPixmapItem *clicked = dynamic_cast<CustomPixmapItem *>(selectedItem);
+    if (members.isEmpty() && clicked)
+    {
+        members.append(clicked);
+        memberSet.insert(clicked);
+    }
+    if (members.isEmpty())
+    {
+        return;
+    }
+
+    // same record stream as a scene file, with compact unit records and
+    // only the lines inside the selection
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << QString(SCENE_HEADER) << SCENE_FORMAT_VERSION;
+    for (CustomPixmapItem *member : members)
+    {
+        WriteCompactRecord(out, member);
+    }
+    for (ArrowLineItem *line : LinesAt(members))
+    {
+        if (memberSet.contains(line->GetStartCircle()->parentItem()) && memberSet.contains(line->GetEndCircle()->parentItem()))
+        {
+            WriteItemRecord(out, line);
+        }
+    }
+
+    QMimeData *mimeData = new QMimeData();
+    mimeData->setData(SUBGRAPH_MIME_TYPE, payload);
+    QApplication::clipboard()->setMimeData(mimeData);
+    emit PublishNewData(QString("Copied %1 items").arg(members.size()));
+}
+
+void CustomGraphicsView::onPasteVal()
+{
+    const QMimeData *mimeData = QApplication::clipboard()->mimeData();
+    if (!mimeData || !mimeData->hasFormat(SUBGRAPH_MIME_TYPE))
+    {
+        return;
+    }
+
+    BulkSceneUpdate bulk(this);
+    QByteArray payload = mimeData->data(SUBGRAPH_MIME_TYPE);
+    QDataStream in(payload);
+    QList<CustomPixmapItem *> nodes;
+    QList<ArrowLineItem *> lines;
+    if (!ReadItemRecords(in, nodes, lines))
+    {
+        QMessageBox::warning(this, tr("Paste"), tr("The clipboard holds units from a newer version."));
+        return;
+    }
+    if (nodes.isEmpty())
+    {
+        qDeleteAll(lines);
+        return;
+    }
+
+    QHash<quint64, quint64> itemIds;
+    RemapItemIds(nodes, lines, itemIds);
+
+    NodeIndex pastedUnits;
+    QList<QGraphicsItem *> pasted;
+    for (CustomPixmapItem *node : nodes)
+    {
+        node->setPos(node->pos() + QPointF(PASTE_OFFSET, PASTE_OFFSET));
+        pastedUnits.Insert(node);
+        WireNode(node);
+        pasted.append(node);
+    }
+    reconnectLines(lines, pastedUnits);
+    BindLinesToGroups(lines);
+    for (ArrowLineItem *line : lines)
+    {
+        if (line->GetStartCircle() && line->GetEndCircle())
+        {
+            pasted.append(line);
+        }
+    }
+
+    AddItemsCommand* command = new AddItemsCommand(this, pasted);
+    command->setText(tr("Paste %1 items").arg(nodes.size()));
+    connect(command, &AddItemsCommand::PublishUndoData, this, &CustomGraphicsView::PublishUndoData);
+    connect(command, &AddItemsCommand::PublishRedoData, this, &CustomGraphicsView::PublishRedoData);
+    connect(command, &AddItemsCommand::NotifyUndoCompleted, this, &CustomGraphicsView::updateLinePosition);
+    connect(command, &AddItemsCommand::NotifyRedoCompleted, this, &CustomGraphicsView::updateLinePosition);
+    UndoStack->push(command);
+
+    scene->clearSelection();
+    for (CustomPixmapItem *node : nodes)
+    {
+        node->setSelected(true);
+    }
+}
+
+void CustomGraphicsView::RemapItemIds(const QList<CustomPixmapItem *> &nodes, const QList<ArrowLineItem *> &lines,
+                                      QHash<quint64, quint64> &itemIds)
+{
+    for (CustomPixmapItem *node : nodes)
+    {
+        quint64 itemId = CustomPixmapItem::AllocateItemId();
+        itemIds.insert(node->GetItemId(), itemId);
+        node->SetItemId(itemId);
+    }
+    for (ArrowLineItem *line : lines)
+    {
+        line->RemapItemIds(itemIds);
+    }
+
+    // units inside a group would collide with the originals once expanded
+    for (CustomPixmapItem *node : nodes)
+    {
+        GroupItem *group = dynamic_cast<GroupItem *>(node);
+        if (!group)
+        {
+            continue;
+        }
+
+        QByteArray contents = group->GetContents();
+        QDataStream in(contents);
+        QList<CustomPixmapItem *> innerNodes;
+        QList<ArrowLineItem *> innerLines;
+        ReadItemRecords(in, innerNodes, innerLines);
+        RemapItemIds(innerNodes, innerLines, itemIds);
+
+        QByteArray remapped;
+        QDataStream out(&remapped, QIODevice::WriteOnly);
+        out << QString(SCENE_HEADER) << SCENE_FORMAT_VERSION;
+        for (CustomPixmapItem *inner : innerNodes)
+        {
+            WriteItemRecord(out, inner);
+        }
+        for (ArrowLineItem *line : innerLines)
+        {
+            WriteItemRecord(out, line);
+        }
+        qDeleteAll(innerLines);
+        qDeleteAll(innerNodes);
+
+        group->SetContents(remapped, group->GetChildCount(), group->GetOrigin());
+        group->RemapLinks(itemIds);
+    }
+}
+
+void CustomGraphicsView::onMonitor()
+{
+    if (monitor->IsRunning())
+    {
+        monitor->Stop();
+        return;
+    }
+
+    QStringList sources = {tr("Replay capture file..."), tr("Local socket...")};
+    bool ok;
+    QString source = QInputDialog::getItem(this, tr("Monitor"), tr("Readings from:"), sources, 0, false, &ok);
+    if (!ok)
+    {
+        return;
+    }
+
+    liveReadings.clear();
+    liveReadingTimes.clear();
+    staleReadings.clear();
+    liveClock.start();
+    if (source == sources.first())
+    {
+        QString fileName = QFileDialog::getOpenFileName(this, tr("Replay Capture"), QString(), tr("Capture (*.csv *.txt);;All Files (*)"));
+        if (fileName.isEmpty())
+        {
+            return;
+        }
+        double speed = QInputDialog::getDouble(this, tr("Replay"), tr("Speed (0 = as fast as possible):"), 1.0, 0.0, 1000.0, 1, &ok);
+        if (ok)
+        {
+            monitor->StartReplay(fileName, speed);
+        }
+    }
+    else
+    {
+        QString serverName = QInputDialog::getText(this, tr("Monitor"), tr("Server name:"), QLineEdit::Normal, "aggflow-telemetry", &ok);
+        if (ok && !serverName.isEmpty())
+        {
+            monitor->StartSocket(serverName);
+        }
+    }
+}
+
+void CustomGraphicsView::onTelemetrySamples(const QVector<TelemetrySample> &samples)
+{
+    qint64 now = liveClock.elapsed();
+    QSet<quint64> changed;
+    for (const TelemetrySample &sample : samples)
+    {
+        QVector<double> &readings = liveReadings[sample.ItemId];
+        if (readings.isEmpty())
+        {
+            readings.fill(qQNaN(), TelemetrySample::SignalCount);
+        }
+        readings[sample.SignalId] = sample.Value;
+        history.Append(sample.ItemId, sample.SignalId, sample.Timestamp, sample.Value);
+        liveReadingTimes.insert(sample.ItemId, now);
+        changed.insert(sample.ItemId);
+    }
+
+    for (auto it = liveReadingTimes.constBegin(); it != liveReadingTimes.constEnd(); ++it)
+    {
+        if (now - it.value() > STALE_READING_MS && !staleReadings.contains(it.key()))
+        {
+            staleReadings.insert(it.key());
+            changed.insert(it.key());
+        }
+        else if (changed.contains(it.key()))
+        {
+            staleReadings.remove(it.key());
+        }
+    }
+    if (changed.isEmpty())
+    {
+        return;
+    }
+
+    // only units in the scene are repainted, paged out ones pick up the reading when they return
+    for (quint64 itemId : changed)
+    {
+        CustomPixmapItem *item = unitIndex.Find(itemId);
+        if (item)
+        {
+            const QVector<double> &readings = liveReadings.value(itemId);
+            QColor colour = staleReadings.contains(itemId) ? QColor(Qt::gray) : ReadingColour(item->GetParameters(), readings);
+            item->SetStatus(ReadingText(readings), colour);
+        }
+    }
+}
+
+void CustomGraphicsView::onTelemetryStopped(const QString &message)
+{
+    for (CustomPixmapItem *item : unitIndex.ResidentNodes())
+    {
+        item->ClearStatus();
+    }
+    emit PublishNewData(QString("Monitor: %1 samples").arg(monitor->GetSampleCount()));
+    if (!message.isEmpty())
+    {
+        QMessageBox::warning(this, tr("Monitor"), message);
+    }
+}
+
+void CustomGraphicsView::onTrend()
+{
+    CustomPixmapItem *item = dynamic_cast<CustomPixmapItem *>(selectedItem);
+    if (!item)
+    {
+        return;
+    }
+    if (history.Signals(item->GetItemId()).isEmpty())
+    {
+        QMessageBox::information(this, tr("Trend"), tr("No readings have been received for this unit."));
+        return;
+    }
+
+    TrendDialog *dialog = new TrendDialog(&history, item->GetItemId(), item->GetText(), this);
+    dialog->show();
+}
+
+void CustomGraphicsView::onAdjustFeedStream()
+{
+    CustomPixmapItem *item = dynamic_cast<CustomPixmapItem *>(selectedItem);
+    CompiledFlowsheet flowsheet = flowsheetModel.Compile();
+    if (flowsheet.NodeCount() == 0)
+    {
+        QMessageBox::information(this, tr("Adjust Feed Stream"), tr("There are no connected units."));
+        return;
+    }
+
+    SensitivityDialog *dialog = new SensitivityDialog(flowsheet, item ? item->GetItemId() : 0, this);
+    dialog->show();
+}
+
+void CustomGraphicsView::RunSimulation()
+{
+    if (simulation && simulation->IsRunning())
+    {
+        simulation->Cancel();
+        return;
+    }
+
+    // collapsed groups and paged out units are not part of the run
+    SimulationModel model;
+    const int rows = flowsheetModel.NodeCount();
+    QVector<int> units(rows, -1);
+    for (int row = 0; row < rows; ++row)
+    {
+        CustomPixmapItem *item = flowsheetModel.IsOpaque(row) ? nullptr : unitIndex.Find(flowsheetModel.GetItemId(row));
+        if (item)
+        {
+            units[row] = model.AddUnit(item->GetItemId(), item->GetText(), flowsheetModel.GetParameters(row));
+        }
+    }
+    const FlowsheetModel::Adjacency &flow = flowsheetModel.Downstream();
+    for (int row = 0; row < rows; ++row)
+    {
+        for (int i = flow.Offsets.at(row); i < flow.Offsets.at(row + 1); ++i)
+        {
+            if (units.at(row) >= 0 && units.at(flow.Targets.at(i)) >= 0)
+            {
+                model.AddFlow(units.at(row), units.at(flow.Targets.at(i)));
+            }
+        }
+    }
+    if (model.GetUnits().isEmpty())
+    {
+        QMessageBox::information(this, tr("Simulate"), tr("There are no units to simulate."));
+        return;
+    }
+
+    bool ok;
+    double hours = QInputDialog::getDouble(this, tr("Simulate"), tr("Simulated time (hours):"), 10.0, 0.1, 24.0 * 366, 1, &ok);
+    if (!ok)
+    {
+        return;
+    }
+    double step = QInputDialog::getDouble(this, tr("Simulate"), tr("Time step (seconds):"), 1.0, 0.1, SIMULATION_REPORT_SECONDS, 1, &ok);
+    if (!ok)
+    {
+        return;
+    }
+    QString events = QInputDialog::getMultiLineText(this, tr("Simulate"),
+                                                    tr("On/off events, one per line as minute,machine id,on|off:"),
+                                                    QString(), &ok);
+    if (!ok)
+    {
+        return;
+    }
+    for (const QString &line : events.split('\n', QString::SkipEmptyParts))
+    {
+        QStringList fields = line.split(',');
+        bool timeOk = false;
+        bool idOk = false;
+        QString state = fields.value(2).trimmed().toLower();
+        SimulationEvent event = {fields.value(0).toDouble(&timeOk) * 60.0, fields.value(1).toULongLong(&idOk), state == "on"};
+        if (fields.size() != 3 || !timeOk || !idOk || (state != "on" && state != "off"))
+        {
+            QMessageBox::warning(this, tr("Simulate"), tr("Could not read the event \"%1\".").arg(line.trimmed()));
+            return;
+        }
+        model.AddEvent(event);
+    }
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Simulation Results"), QString(), ResultWriter::FileFilter());
+
+    delete simulation;
+    simulation = new DynamicSimulation(model, step, hours * 3600.0, SIMULATION_REPORT_SECONDS, this);
+    connect(simulation, &DynamicSimulation::Report, this, &CustomGraphicsView::onSimulationReport);
+    connect(simulation, &DynamicSimulation::Finished, this, &CustomGraphicsView::onSimulationFinished);
+    for (const SimulationModel::Unit &unit : model.GetUnits())
+    {
+        // the dialogs above run an event loop, a unit may have gone meanwhile
+        if (CustomPixmapItem *item = unitIndex.Find(unit.ItemId))
+        {
+            item->ClearStatus();
+        }
+    }
+    simulation->Start(fileName);
+}
+
+void CustomGraphicsView::onSimulationReport(double time, const QVector<double> &row)
+{
+    const QVector<SimulationColumn> &columns = simulation->GetColumns();
+    for (int c = 0; c < columns.size() && c < row.size(); ++c)
+    {
+        CustomPixmapItem *item = unitIndex.Find(columns.at(c).ItemId);
+        if (!item)
+        {
+            continue;
+        }
+        QVector<double> readings(TelemetrySample::SignalCount, qQNaN());
+        readings[columns.at(c).IsLevel ? TelemetrySample::Level : TelemetrySample::Tonnage] = row.at(c);
+        item->SetStatus(ReadingText(readings), ReadingColour(item->GetParameters(), readings));
+    }
+    emit PublishNewData(QString("Simulated %1 h").arg(time / 3600.0, 0, 'f', 1));
+}
+
+void CustomGraphicsView::onSimulationFinished(bool completed, const QString &message)
+{
+    if (!completed)
+    {
+        QMessageBox::warning(this, tr("Simulate"), message);
+    }
+}
+
+void CustomGraphicsView::RunMonteCarlo()
+{
+    CompiledFlowsheet flowsheet = flowsheetModel.Compile();
+    QStringList lines;
+    QSet<quint64> listed;
+    for (int node = 0; node < flowsheet.NodeCount(); ++node)
+    {
+        quint64 itemId = flowsheet.GetItemId(node);
+        if (ParameterBlock::Schema(flowsheet.GetEquipmentType(node)).Role == EquipmentRole::Feed && !listed.contains(itemId))
+        {
+            // starts from the current feed rate with a 10 % spread
+            double value = flowsheet.GetValues().at(node);
+            FeedDistribution distribution = {itemId, FeedDistribution::Normal, value, std::fabs(value) * 0.1, 0.0};
+            lines.append(distribution.ToString());
+            listed.insert(itemId);
+        }
+    }
+    if (lines.isEmpty())
+    {
+        QMessageBox::information(this, tr("Monte Carlo"), tr("There are no connected feed units to vary."));
+        return;
+    }
+
+    bool ok;
+    QString text = QInputDialog::getMultiLineText(this, tr("Monte Carlo"),
+                                                  tr("Feed distributions, one per line as\n"
+                                                     "id,normal,mean,sd / id,uniform,min,max / id,triangular,min,mode,max:"),
+                                                  lines.join('\n'), &ok);
+    if (!ok)
+    {
+        return;
+    }
+    QVector<FeedDistribution> feeds;
+    for (const QString &line : text.split('\n', QString::SkipEmptyParts))
+    {
+        FeedDistribution distribution;
+        if (!FeedDistribution::Parse(line, distribution))
+        {
+            QMessageBox::warning(this, tr("Monte Carlo"), tr("Could not read the distribution \"%1\".").arg(line.trimmed()));
+            return;
+        }
+        feeds.append(distribution);
+    }
+
+    int samples = QInputDialog::getInt(this, tr("Monte Carlo"), tr("Samples:"), 10000, 1, 10000000, 1000, &ok);
+    if (!ok)
+    {
+        return;
+    }
+    int seed = QInputDialog::getInt(this, tr("Monte Carlo"), tr("Seed:"), 1, 0, std::numeric_limits<int>::max(), 1, &ok);
+    if (!ok)
+    {
+        return;
+    }
+    double result = flowsheet.Evaluate();
+    double low = QInputDialog::getDouble(this, tr("Monte Carlo"), tr("Specification, lowest product:"),
+                                         result * 0.9, -1e12, 1e12, 3, &ok);
+    if (!ok)
+    {
+        return;
+    }
+    double high = QInputDialog::getDouble(this, tr("Monte Carlo"), tr("Specification, highest product:"),
+                                          result * 1.1, low, 1e12, 3, &ok);
+    if (!ok)
+    {
+        return;
+    }
+
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Monte Carlo Samples"), QString(), ResultWriter::FileFilter());
+
+    MonteCarloAnalysis analysis(flowsheet, feeds);
+    analysis.SetSpecification(low, high);
+    QScopedPointer<ResultWriter> writer(fileName.isEmpty() ? nullptr : ResultWriter::Create(fileName));
+    if (writer)
+    {
+        writer->SetIntegerColumns(analysis.IntegerSampleColumns());
+    }
+    if (writer && !writer->Open(fileName, analysis.SampleColumns()))
+    {
+        QMessageBox::warning(this, tr("Monte Carlo"), writer->GetErrorString());
+        return;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    StreamingStatistics statistics = analysis.Run(samples, quint64(seed), writer.data());
+    bool written = !writer || writer->Close();
+    QApplication::restoreOverrideCursor();
+    if (!written)
+    {
+        QMessageBox::warning(this, tr("Monte Carlo"),
+                             tr("The samples file is incomplete, the statistics below cover every sample.\n\n%1")
+                                 .arg(writer->GetErrorString()));
+    }
+
+    QString summary = tr("%1 samples in %2 ms\n\n"
+                         "Mean %3, standard deviation %4\n"
+                         "Min %5, max %6\n"
+                         "P5 %7, P50 %8, P95 %9\n\n"
+                         "In specification: %10 %")
+                          .arg(samples).arg(timer.elapsed())
+                          .arg(statistics.GetMean(), 0, 'f', 2).arg(statistics.GetStandardDeviation(), 0, 'f', 2)
+                          .arg(statistics.GetMin(), 0, 'f', 2).arg(statistics.GetMax(), 0, 'f', 2)
+                          .arg(statistics.Percentile(0.05), 0, 'f', 2).arg(statistics.Percentile(0.5), 0, 'f', 2)
+                          .arg(statistics.Percentile(0.95), 0, 'f', 2)
+                          .arg(statistics.GetCompliance() * 100.0, 0, 'f', 1);
+    if (statistics.GetNonFinite() > 0)
+    {
+        summary += tr("\n%1 samples could not be solved").arg(statistics.GetNonFinite());
+    }
+    emit PublishNewData(QString("Monte Carlo: P50 %1").arg(statistics.Percentile(0.5), 0, 'f', 2));
+    QMessageBox::information(this, tr("Monte Carlo"), summary);
+}
+
+void CustomGraphicsView::ExportResults(const QString &fileName)
+{
+    CompiledFlowsheet flowsheet = flowsheetModel.Compile();
+    QScopedPointer<ResultWriter> writer(ResultWriter::Create(fileName));
+    QStringList columns = {"stream", "from_id", "to_id", "from_value", "to_value", "tonnage"};
+    writer->SetIntegerColumns({0, 1, 2});
+    if (!writer->Open(fileName, columns))
+    {
+        QMessageBox::warning(this, tr("Export Results"), writer->GetErrorString());
+        return;
+    }
+
+    // one row per connection, handed over in blocks so the table is never held whole
+    const int BLOCK_ROWS = 4096;
+    const QVector<double> &values = flowsheet.GetValues();
+    const QVector<CompiledFlowsheet::Edge> &edges = flowsheet.GetEdges();
+    const QVector<double> tonnages = flowsheet.EdgeResults(values);
+    QVector<double> rows;
+    rows.reserve(BLOCK_ROWS * columns.size());
+    bool ok = true;
+    for (int e = 0; e < edges.size() && ok; ++e)
+    {
+        const CompiledFlowsheet::Edge &edge = edges.at(e);
+        double from = values.at(edge.Start);
+        double to = values.at(edge.End);
+        rows << e << flowsheet.GetItemId(edge.Start) << flowsheet.GetItemId(edge.End) << from << to
+             << tonnages.at(e);
+        if (rows.size() == BLOCK_ROWS * columns.size() || e == edges.size() - 1)
+        {
+            ok = writer->WriteRows(rows.constData(), rows.size() / columns.size());
+            rows.resize(0);
+        }
+    }
+    if (!writer->Close() || !ok)
+    {
+        QMessageBox::warning(this, tr("Export Results"), writer->GetErrorString());
+        return;
+    }
+    emit PublishNewData(QString("Exported %1 streams").arg(edges.size()));
+}
+
+bool CustomGraphicsView::ExportDrawing(const QString &fileName, int dpi, QString *error)
+{
+    if (tiledMode)
+    {
+        MaterializeChunks(pager.Chunks());
+    }
+    // selection outlines are not part of the drawing
+    QList<QGraphicsItem *> selected = scene->selectedItems();
+    scene->clearSelection();
+
+    const qreal margin = 20;
+    SceneExporter exporter(scene);
+    bool ok = exporter.Export(fileName, scene->itemsBoundingRect().adjusted(-margin, -margin, margin, margin), dpi);
+
+    for (QGraphicsItem *item : selected)
+    {
+        item->setSelected(true);
+    }
+    ScheduleResidencyUpdate();
+    if (!ok)
+    {
+        *error = exporter.GetErrorString();
+        return false;
+    }
+    emit PublishNewData(QString("Exported drawing to %1").arg(fileName));
+    return true;
+}
+
+void CustomGraphicsView::CompareWithFile(const QString &fileName)
+{
+    QByteArray current;
+    QDataStream out(&current, QIODevice::WriteOnly);
+    WriteScene(out);
+
+    QString error;
+    SceneSnapshot before, after;
+    if (!before.Load(fileName, &error) || !after.LoadScene(current, &error))
+    {
+        QMessageBox::warning(this, tr("Compare"), error);
+        return;
+    }
+    SceneDiff diff = SceneDiff::Compare(before, after);
+
+    // units in view are outlined where they are drawn, paged out and removed ones at their stored position
+    auto rectOf = [&](const DiffNode &node, bool live) {
+        CustomPixmapItem *item = live ? unitIndex.Find(node.ItemId) : nullptr;
+        return item ? item->sceneBoundingRect() : QRectF(node.Pos, NOMINAL_UNIT_SIZE);
+    };
+    diffMarks.clear();
+    for (quint64 itemId : diff.RemovedNodes)
+    {
+        diffMarks.append({rectOf(before.GetNodes()[itemId], false), QLineF(), Qt::red, Qt::DashLine});
+    }
+    for (quint64 itemId : diff.AddedNodes)
+    {
+        diffMarks.append({rectOf(after.GetNodes()[itemId], true), QLineF(), QColor(0, 160, 0), Qt::SolidLine});
+    }
+    for (quint64 itemId : diff.MovedNodes)
+    {
+        diffMarks.append({rectOf(after.GetNodes()[itemId], true), QLineF(), Qt::blue, Qt::DotLine});
+    }
+    for (quint64 itemId : diff.ChangedNodes)
+    {
+        diffMarks.append({rectOf(after.GetNodes()[itemId], true), QLineF(), QColor(255, 140, 0), Qt::SolidLine});
+    }
+    for (const DiffEdge &edge : diff.RemovedEdges)
+    {
+        diffMarks.append({QRectF(), edge.Line, Qt::red, Qt::DashLine});
+    }
+    for (const DiffEdge &edge : diff.AddedEdges)
+    {
+        diffMarks.append({QRectF(), edge.Line, QColor(0, 160, 0), Qt::SolidLine});
+    }
+    viewport()->update();
+
+    QString report = diff.ToText(before, after);
+    emit PublishNewData(report.section('\n', -2, -2));
+    QMessageBox box(QMessageBox::Information, tr("Compare"),
+                    diff.IsEmpty() ? tr("The scene matches %1.").arg(fileName) : report.section('\n', -2, -2), QMessageBox::Ok, this);
+    if (!diff.IsEmpty())
+    {
+        box.setDetailedText(report);
+    }
+    box.exec();
+}
+
+void CustomGraphicsView::ClearComparison()
+{
+    diffMarks.clear();
+    viewport()->update();
+}
+
+void CustomGraphicsView::onToggleTear()
+{
+    ArrowLineItem *line = dynamic_cast<ArrowLineItem *>(selectedItem);
+    if (line)
+    {
+        line->SetTear(acnTear->isChecked());
+        TrackLine(line);
+    }
+}
+
+void CustomGraphicsView::TrackNode(CustomPixmapItem *node)
+{
+    // a unit taken out by undo is treated as removed
+    if (!node->scene() || node->parentItem())
+    {
+        ForgetNode(node);
+        return;
+    }
+    // a second unit on a taken id was reported by its loader
+    if (!unitIndex.Insert(node))
+    {
+        return;
+    }
+    router->SetObstacle(node, node->sceneBoundingRect());
+    bool group = dynamic_cast<GroupItem *>(node) != nullptr;
+    validator.SetNode(node->GetItemId(), node->GetParameters(), group);
+    SetModelNode(flowsheetModel, node);
+    searchIndex.SetUnit(node->GetItemId(), node->HasDefaultText() ? QString() : node->GetText(),
+                        node->GetParameters().GetEquipmentType());
+    ScheduleValidation();
+}
+
+void CustomGraphicsView::TrackLine(ArrowLineItem *line)
+{
+    FlowsheetModel::Connection connection;
+    bool live = line->scene() && ConnectionOf(line, &connection)
+            && line->GetStartCircle()->scene() && line->GetEndCircle()->scene();
+    int row = flowsheetModel.ConnectionOf(line->GetConnectionId());
+    if (live && row >= 0 && flowsheetModel.GetConnection(row) == connection)
+    {
+        // a line read back from the pager draws the connection it left behind
+        linesByConnection.insert(line->GetConnectionId(), line);
+        return;
+    }
+
+    ForgetLine(line);
+    if (!live)
+    {
+        return;
+    }
+    quint64 connectionId = flowsheetModel.AddConnection(connection);
+    line->SetConnectionId(connectionId);
+    linesByConnection.insert(connectionId, line);
+    validator.AddEdge(EdgeOf(connection));
+    ScheduleValidation();
+}
+
+void CustomGraphicsView::TrackItems(const QList<CustomPixmapItem *> &nodes, const QList<ArrowLineItem *> &lines)
+{
+    for (CustomPixmapItem *node : nodes)
+    {
+        TrackNode(node);
+    }
+    for (ArrowLineItem *line : lines)
+    {
+        TrackLine(line);
+    }
+}
+
+void CustomGraphicsView::ForgetNode(CustomPixmapItem *node)
+{
+    router->RemoveObstacle(node);
+    if (unitIndex.Find(node->GetItemId()) == node)
+    {
+        // connections still at the unit go with it, whoever takes it out deals with their lines
+        for (quint64 connectionId : flowsheetModel.ConnectionsAt(node->GetItemId()))
+        {
+            if (ArrowLineItem *line = linesByConnection.value(connectionId))
+            {
+                ForgetLine(line);
+            }
+            else
+            {
+                validator.RemoveEdge(EdgeOf(flowsheetModel.GetConnection(flowsheetModel.ConnectionOf(connectionId))));
+                flowsheetModel.RemoveConnection(connectionId);
+            }
+        }
+        unitIndex.Remove(node->GetItemId());
+        validator.RemoveNode(node->GetItemId());
+        flowsheetModel.RemoveNode(node->GetItemId());
+        searchIndex.RemoveUnit(node->GetItemId());
+        node->SetViolations(QStringList());
+        ScheduleValidation();
+    }
+}
+
+void CustomGraphicsView::ForgetLine(ArrowLineItem *line)
+{
+    const quint64 connectionId = line->GetConnectionId();
+    int row = flowsheetModel.ConnectionOf(connectionId);
+    if (row >= 0)
+    {
+        validator.RemoveEdge(EdgeOf(flowsheetModel.GetConnection(row)));
+        flowsheetModel.RemoveConnection(connectionId);
+        ScheduleValidation();
+    }
+    linesByConnection.remove(connectionId);
+    line->SetConnectionId(0);
+}
+
+void CustomGraphicsView::ResetTracking()
+{
+    validator.Clear();
+    validator.TakeChanged();
+    flowsheetModel.Clear();
+    searchIndex.Clear();
+    unitIndex.Clear();
+    linesByConnection.clear();
+    router->ClearObstacles();
+    // ids in the history name units of the scene being replaced, a loaded file may reuse them
+    UndoStack->clear();
+    emit sceneReset();
+}
+
+void CustomGraphicsView::ScheduleValidation()
+{
+    // badges are repainted once per event, however many rules an edit touched
+    if (!validationPending)
+    {
+        validationPending = true;
+        QTimer::singleShot(0, this, &CustomGraphicsView::flushValidation);
+    }
+}
+
+void CustomGraphicsView::flushValidation()
+{
+    validationPending = false;
+    for (quint64 itemId : validator.TakeChanged())
+    {
+        if (CustomPixmapItem *node = unitIndex.Find(itemId))
+        {
+            node->SetViolations(validator.GetMessages(itemId));
+        }
+    }
+}
+
+bool CustomGraphicsView::FocusUnit(quint64 itemId)
+{
+    CustomPixmapItem *node = unitIndex.Find(itemId);
+    if (!node)
+    {
+        // page the unit's chunk in first, the scroll alone would only schedule it
+        QPointF pos;
+        if (!pager.NodePosition(itemId, &pos))
+        {
+            return false;
+        }
+        PanTo(pos);
+        UpdateResidency();
+        node = unitIndex.Find(itemId);
+        if (!node)
+        {
+            return false;
+        }
+    }
+
+    PanTo(node->sceneBoundingRect().center());
+    scene->clearSelection();
+    node->setSelected(true);
+    selectedItem = node;
+    searchHit = node;
+    viewport()->update();
+    QPointer<CustomPixmapItem> hit = node;
+    QTimer::singleShot(SEARCH_HIGHLIGHT_MS, this, [this, hit]() {
+        // a later jump keeps its own highlight
+        if (searchHit == hit)
+        {
+            searchHit = nullptr;
+            viewport()->update();
+        }
+    });
+    return true;
+}
+
+void CustomGraphicsView::onResult()
+{
+    CompiledFlowsheet flowsheet = flowsheetModel.Compile();
+    QStringList divisors;
+    for (quint64 itemId : flowsheet.ZeroDivisors())
+    {
+        divisors.append(QString::number(itemId));
+    }
+    if (!divisors.isEmpty())
+    {
+        emit resultUpdated(tr("undefined"));
+        emit PublishNewData(tr("No result: units %1 divide by an empty value").arg(divisors.join(", ")));
+        return;
+    }
+
+    double result = resultCache.Evaluate(flowsheet);
+    emit resultUpdated(QString::number(result));
+    emit PublishNewData(QString("Result cache: %1 hits, %2 misses, %3 entries")
+                        .arg(resultCache.GetHits()).arg(resultCache.GetMisses()).arg(resultCache.GetSize()));
+}
+
+void CustomGraphicsView::saveToFile(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning("Could not open file for writing");
+        return;
+    }
+    QDataStream out(&file);
+    WriteScene(out);
+    QMessageBox msgBox;
+    msgBox.setText("Data Saved Succesfully!!!");
+    msgBox.exec();
+}
+
+void CustomGraphicsView::loadFromFile(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning("Could not open file for reading");
+        return;
+    }
+    QDataStream in(&file);
+    BulkSceneUpdate bulk(this);
+    ResetTracking();
+    scene->clear();
+    router->Clear();
+    pager.Clear();
+    selectedItem = nullptr;
+
+    QList<ArrowLineItem*> lineItems;
+    QList<CustomPixmapItem*> nodes;
+    if (!ReadItemRecords(in, nodes, lineItems)) {
+        qWarning() << "Scene file" << fileName << "has a newer format version";
+        return;
+    }
+
+    for (CustomPixmapItem *pixmapItem : nodes) {
+        scene->addItem(pixmapItem);
+        if (!unitIndex.Insert(pixmapItem)) {
+            qWarning() << "Scene file" << fileName << "uses unit id" << pixmapItem->GetItemId() << "twice";
+        }
+        WireNode(pixmapItem);
+    }
+    for (ArrowLineItem *lineItem : lineItems) {
+        scene->addItem(lineItem);
+    }
+    reconnectLines(lineItems, unitIndex);
+    BindLinesToGroups(lineItems);
+    TrackItems(nodes, lineItems);
+    ScheduleResidencyUpdate();
+}
+
+void CustomGraphicsView::WriteScene(QDataStream &out) const
+{
+    out << QString(SCENE_HEADER) << SCENE_FORMAT_VERSION;
+    // Save all CustomPixmapItems
+    QList<QGraphicsItem *> items = scene->items();
+    for (QGraphicsItem *item : items) {
+        WriteItemRecord(out, item);
+    }
+    pager.writeRecords(out);
+    out << QString("ResultCache");
+    resultCache.write(out);
+}
+
+void CustomGraphicsView::WriteItemRecord(QDataStream &out, QGraphicsItem *item) const
+{
+    if (GroupItem *groupItem = dynamic_cast<GroupItem *>(item)) {
+        out << QString("GroupItem");
+        groupItem->write(out);
+        groupItem->writeGroup(out);
+    } else if (CustomPixmapItem *pixmapItem = dynamic_cast<CustomPixmapItem *>(item)) {
+        out << QString("CustomPixmapItem");
+        pixmapItem->write(out);
+    } else if (ArrowLineItem *lineItem = dynamic_cast<ArrowLineItem *>(item)) {
+        out << QString("ArrowLineItem");
+        lineItem->write(out);
+    }
+}
+
+void CustomGraphicsView::WriteCompactRecord(QDataStream &out, QGraphicsItem *item)
+{
+    if (GroupItem *groupItem = dynamic_cast<GroupItem *>(item)) {
+        out << QString("CompactGroupItem");
+        groupItem->writeCompact(out);
+        groupItem->writeGroup(out, CompactRecords(groupItem->GetContents()));
+    } else if (CustomPixmapItem *pixmapItem = dynamic_cast<CustomPixmapItem *>(item)) {
+        out << QString("CompactPixmapItem");
+        pixmapItem->writeCompact(out);
+    } else {
+        WriteItemRecord(out, item);
+    }
+}
+
+QByteArray CustomGraphicsView::CompactRecords(const QByteArray &records)
+{
+    QDataStream in(records);
+    QList<CustomPixmapItem *> nodes;
+    QList<ArrowLineItem *> lines;
+    ReadItemRecords(in, nodes, lines);
+
+    QByteArray compact;
+    QDataStream out(&compact, QIODevice::WriteOnly);
+    out << QString(SCENE_HEADER) << SCENE_FORMAT_VERSION;
+    for (CustomPixmapItem *node : nodes)
+    {
+        WriteCompactRecord(out, node);
+    }
+    for (ArrowLineItem *line : lines)
+    {
+        WriteItemRecord(out, line);
+    }
+    qDeleteAll(lines);
+    qDeleteAll(nodes);
+    return compact;
+}
+
+bool CustomGraphicsView::ReadItemRecords(QDataStream &in, QList<CustomPixmapItem *> &nodes, QList<ArrowLineItem *> &lines, qint32 version)
+{
+    while (!in.atEnd()) {
+        QString itemType;
+        in >> itemType;
+
+        if (itemType == SCENE_HEADER) {
+            in >> version;
+            if (version > SCENE_FORMAT_VERSION) {
+                qDeleteAll(nodes);
+                qDeleteAll(lines);
+                nodes.clear();
+                lines.clear();
+                return false;
+            }
+        } else if (itemType == "GroupItem") {
+            GroupItem *groupItem = new GroupItem();
+            groupItem->read(in, version);
+            groupItem->readGroup(in, version);
+            groupItem->HideLabelIfNeeded();
+            nodes.append(groupItem);
+        } else if (itemType == "CustomPixmapItem") {
+            CustomPixmapItem *pixmapItem = new CustomPixmapItem(QPixmap());
+            pixmapItem->read(in, version);
+            pixmapItem->HideLabelIfNeeded();
+            nodes.append(pixmapItem);
+        } else if (itemType == "CompactGroupItem") {
+            GroupItem *groupItem = new GroupItem();
+            groupItem->readCompact(in, version);
+            groupItem->readGroup(in, version);
+            groupItem->HideLabelIfNeeded();
+            nodes.append(groupItem);
+        } else if (itemType == "CompactPixmapItem") {
+            CustomPixmapItem *pixmapItem = new CustomPixmapItem(QPixmap());
+            pixmapItem->readCompact(in, version);
+            pixmapItem->HideLabelIfNeeded();
+            nodes.append(pixmapItem);
+        } else if (itemType == "ArrowLineItem") {
+            ArrowLineItem *lineItem = new ArrowLineItem(QLineF());
+            lineItem->read(in, version);
+            lines.append(lineItem);
+        } else if (itemType == "ResultCache") {
+            resultCache.read(in);
+        }
+    }
+    return true;
+}
+
+void CustomGraphicsView::BindLinesToGroups(const QList<ArrowLineItem *> &lines)
+{
+    for (ArrowLineItem *line : lines) {
+        // a line joined at one end only is not drawn to anything
+        if (!line->GetStartCircle() || !line->GetEndCircle()) {
+            continue;
+        }
+        for (QGraphicsEllipseItem *circle : {line->GetStartCircle(), line->GetEndCircle()}) {
+            GroupItem *group = dynamic_cast<GroupItem *>(circle->parentItem());
+            if (group) {
+                group->BindLine(line);
+            }
+        }
+    }
+}
+
+void CustomGraphicsView::saveToXml(const QString &fileName)
+{
+    QDomDocument doc;
+    QDomElement root = doc.createElement("Scene");
+    root.setAttribute("version", SCENE_FORMAT_VERSION);
+    doc.appendChild(root);
+
+    // paged out units and lines are part of the file too
+    if (tiledMode)
+    {
+        MaterializeChunks(pager.Chunks());
+    }
+    QList<QGraphicsItem *> items = scene->items();
+
+    for (QGraphicsItem *item : items)
+    {
+        QDomElement element;
+
+        if (auto pixmapItem = dynamic_cast<CustomPixmapItem *>(item))
+        {
+            element = doc.createElement("CustomPixmapItem");
+            element.setAttribute("id", pixmapItem->GetItemId());
+            element.setAttribute("x", pixmapItem->pos().x());
+            element.setAttribute("y", pixmapItem->pos().y());
+            element.setAttribute("text", pixmapItem->GetText());
+            if (auto groupItem = dynamic_cast<GroupItem *>(pixmapItem))
+            {
+                QByteArray groupData;
+                QDataStream groupStream(&groupData, QIODevice::WriteOnly);
+                groupItem->writeGroup(groupStream);
+                element.setAttribute("group", QString(groupData.toBase64()));
+            }
+
+            const ParameterBlock &parameters = pixmapItem->GetParameters();
+            QDomElement paramElement = doc.createElement("Parameters");
+            paramElement.setAttribute("type", parameters.GetEquipmentType());
+            for (int i = 0; i < parameters.DoubleCount(); ++i)
+            {
+                if (parameters.IsDoubleAssigned(i))
+                {
+                    QDomElement value = doc.createElement("Double");
+                    value.setAttribute("name", parameters.GetSchema().DoubleNames.at(i));
+                    value.setAttribute("value", parameters.GetDouble(i));
+                    paramElement.appendChild(value);
+                }
+            }
+            for (int i = 0; i < parameters.IntCount(); ++i)
+            {
+                if (parameters.IsIntAssigned(i))
+                {
+                    QDomElement value = doc.createElement("Int");
+                    value.setAttribute("name", parameters.GetSchema().IntNames.at(i));
+                    value.setAttribute("value", parameters.GetInt(i));
+                    paramElement.appendChild(value);
+                }
+            }
+            // the icon follows from the equipment type, it is not stored
+            element.appendChild(paramElement);
+            root.appendChild(element);
+        }
+        else if (auto lineItem = dynamic_cast<ArrowLineItem *>(item))
+        {
+            element = doc.createElement("ArrowLineItem");
+            element.setAttribute("startX", lineItem->line().x1());
+            element.setAttribute("startY", lineItem->line().y1());
+            element.setAttribute("endX", lineItem->line().x2());
+            element.setAttribute("endY", lineItem->line().y2());
+            if (lineItem->IsTear())
+            {
+                element.setAttribute("tear", 1);
+            }
+            root.appendChild(element);
+        }
+    }
+    ScheduleResidencyUpdate();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning() << "Could not open file for writing";
+        return;
+    }
+
+    QTextStream stream(&file);
+    stream << doc.toString();
+    file.close();
+
+    QMessageBox msgBox;
+    msgBox.setText("Data in Xml Saved Successfully!");
+    msgBox.exec();
+}
+
+void CustomGraphicsView::loadFromXml(const QString &fileName)
 {
     QDomDocument doc;
     QFile file(fileName);
@@ -556,43 +2450,76 @@ void CustomGraphicsView::loadFromXml(const QString &fileName)
     }
 
     QDomElement root = doc.documentElement();
+    // files written before the ids were widened carry no version
+    const int version = root.attribute("version", "5").toInt();
     QDomNodeList pixmapNodes = root.elementsByTagName("CustomPixmapItem");
     QDomNodeList lineNodes = root.elementsByTagName("ArrowLineItem");
 
     // Clear existing scene and connections
+    BulkSceneUpdate bulk(this);
+    ResetTracking();
     scene->clear();
-    lineConnections.clear();
-    QMap<int, CustomPixmapItem*> customItems;
+    router->Clear();
+    pager.Clear();
+    selectedItem = nullptr;
+    QList<CustomPixmapItem*> nodes;
     QList<ArrowLineItem*> lineItems;
 
     // Load pixmap items
     for (int i = 0; i < pixmapNodes.count(); i++)
     {
         QDomElement element = pixmapNodes.at(i).toElement();
-        CustomPixmapItem *pixmapItem = new CustomPixmapItem(QPixmap());
+        CustomPixmapItem *pixmapItem = nullptr;
+        if (element.hasAttribute("group"))
+        {
+            GroupItem *groupItem = new GroupItem();
+            QByteArray groupData = QByteArray::fromBase64(element.attribute("group").toUtf8());
+            QDataStream groupStream(&groupData, QIODevice::ReadOnly);
+            groupItem->readGroup(groupStream, version);
+            pixmapItem = groupItem;
+        }
+        else
+        {
+            pixmapItem = new CustomPixmapItem(QPixmap());
+        }
 
         // Set position
         pixmapItem->setPos(element.attribute("x").toDouble(), element.attribute("y").toDouble());
 
-        // Load pixmap data
-        QByteArray byteArray = QByteArray::fromBase64(element.attribute("pixmapData").toUtf8());
-        QPixmap pixmap;
-        if (!pixmap.loadFromData(byteArray, "PNG"))
-        {
-            qWarning() << "Failed to load pixmap from data for item with ID:" << element.attribute("id");
-            delete pixmapItem; // Clean up the item
-            continue;
-        }
-//        pixmapItem->PixmapLabel = new QLabel();
-//        pixmapItem->PixmapLabel->setPixmap(pixmap);
-
         // Set text and item ID
         pixmapItem->SetText(element.attribute("text"));
-        pixmapItem->SetItemId(element.attribute("id").toInt());
+        pixmapItem->SetItemId(element.attribute("id").toULongLong());
+        pixmapItem->HideLabelIfNeeded();
+
+        QDomElement paramElement = element.firstChildElement("Parameters");
+        ParameterBlock parameters(paramElement.attribute("type").toInt());
+        for (QDomElement value = paramElement.firstChildElement("Double"); !value.isNull(); value = value.nextSiblingElement("Double"))
+        {
+            int index = parameters.DoubleIndex(value.attribute("name"));
+            if (index >= 0)
+            {
+                parameters.SetDouble(index, value.attribute("value").toDouble());
+            }
+        }
+        for (QDomElement value = paramElement.firstChildElement("Int"); !value.isNull(); value = value.nextSiblingElement("Int"))
+        {
+            int index = parameters.IntIndex(value.attribute("name"));
+            if (index >= 0)
+            {
+                parameters.SetInt(index, value.attribute("value").toInt());
+            }
+        }
+        pixmapItem->SetParameters(parameters);
+        // older files carry a pixmapData attribute, it is ignored
+        pixmapItem->RestoreIcon();
 
         scene->addItem(pixmapItem);
-        customItems.insert(pixmapItem->GetItemId(), pixmapItem);
-        connect(pixmapItem, &CustomPixmapItem::positionChanged, this, &CustomGraphicsView::updateLinePosition);
+        if (!unitIndex.Insert(pixmapItem))
+        {
+            qWarning() << "Scene file" << fileName << "uses unit id" << pixmapItem->GetItemId() << "twice";
+        }
+        nodes.append(pixmapItem);
+        WireNode(pixmapItem);
     }
     // Load line items
     for (int i = 0; i < lineNodes.count(); i++)
@@ -602,40 +2529,72 @@ void CustomGraphicsView::loadFromXml(const QString &fileName)
                                                         QPointF(element.attribute("startX").toDouble(), element.attribute("startY").toDouble()),
                                                         QPointF(element.attribute("endX").toDouble(), element.attribute("endY").toDouble())
                                                         ));
+        lineItem->SetTear(element.attribute("tear").toInt() != 0);
         scene->addItem(lineItem);
         lineItems.append(lineItem);
     }
     // Reconnect lines after all items are loaded
-    reconnectLines(lineItems, customItems);
+    reconnectLines(lineItems, unitIndex);
+    TrackItems(nodes, lineItems);
 }
 
-void CustomGraphicsView::reconnectLines(QList<ArrowLineItem*> lineItems, QMap<int, CustomPixmapItem*> customItems)
+void CustomGraphicsView::reconnectLines(QList<ArrowLineItem *> &lineItems, const NodeIndex &units)
 {
+    int dropped = 0;
+    // a line read back from the pager takes its connection with it
+    auto drop = [&](ArrowLineItem *line) {
+        qWarning() << "Dropping line between missing units" << line->GetStartCircleItemId() << line->GetEndCircleItemId();
+        ForgetLine(line);
+        delete line;
+        ++dropped;
+    };
+    QList<ArrowLineItem *> kept;
     for (ArrowLineItem* line : lineItems) {
+        CustomPixmapItem *startItem = units.Find(line->GetStartCircleItemId());
+        CustomPixmapItem *endItem = units.Find(line->GetEndCircleItemId());
+        if (line->HasCircleSides()) {
+            if (!startItem || !endItem) {
+                drop(line);
+                continue;
+            }
+            line->SetStartCircle(line->IsStartOnStartCircle() ? startItem->GetStartCircle() : startItem->GetEndCircle());
+            line->SetEndCircle(line->IsEndOnStartCircle() ? endItem->GetStartCircle() : endItem->GetEndCircle());
+            kept.append(line);
+            continue;
+        }
+
+        bool startNamed = line->GetIsStartCircleStartConnected() || line->GetIsStartCircleEndConnected();
+        bool endNamed = line->GetIsEndCircleStartConnected() || line->GetIsEndCircleEndConnected();
+        if ((startNamed && !startItem) || (endNamed && !endItem)) {
+            drop(line);
+            continue;
+        }
+
         if(line->GetIsStartCircleStartConnected())
         {
-            line->SetStartCircle(customItems[line->GetStartCircleItemId()]->GetStartCircle());
+            line->SetStartCircle(startItem->GetStartCircle());
         }
 
         if(line->GetIsStartCircleEndConnected())
         {
-            line->SetStartCircle(customItems[line->GetStartCircleItemId()]->GetEndCircle());
+            line->SetStartCircle(startItem->GetEndCircle());
         }
 
         if(line->GetIsEndCircleStartConnected())
         {
-            line->SetEndCircle(customItems[line->GetEndCircleItemId()]->GetStartCircle());
+            line->SetEndCircle(endItem->GetStartCircle());
         }
 
         if(line->GetIsEndCircleEndConnected())
         {
-            line->SetEndCircle(customItems[line->GetEndCircleItemId()]->GetEndCircle());
+            line->SetEndCircle(endItem->GetEndCircle());
         }
 
-        if (line->GetStartCircle() && line->GetEndCircle()) {
-            lineConnections[line].first = line->GetStartCircle();
-            lineConnections[line].second = line->GetEndCircle();
-        }
+        kept.append(line);
+    }
+    lineItems = kept;
+    if (dropped > 0) {
+        emit PublishNewData(QString("Dropped %1 lines to missing units").arg(dropped));
     }
     updateLinePosition();
 }
@@ -651,7 +2610,7 @@ void CustomGraphicsView::EmitDebugData(QPoint pos)
 
 void CustomGraphicsView::AddItemToAddStack(QGraphicsItem* item)
 {
-    AddCommand* command = new AddCommand(scene, item);
+    AddCommand* command = new AddCommand(this, item);
     connect(command, &AddCommand::PublishUndoData, this, &CustomGraphicsView::PublishUndoData);
     connect(command, &AddCommand::PublishRedoData, this, &CustomGraphicsView::PublishRedoData);
     connect(command, &AddCommand::NotifyUndoCompleted, this, &CustomGraphicsView::updateLinePosition);
@@ -659,9 +2618,17 @@ void CustomGraphicsView::AddItemToAddStack(QGraphicsItem* item)
     UndoStack->push(command);
 }
 
+void CustomGraphicsView::AddItemToRemoveStack(QGraphicsItem* item)
+{
+    RemoveCommand* command = new RemoveCommand(this, item);
+    connect(command, &RemoveCommand::NotifyUndoCompleted, this, &CustomGraphicsView::updateLinePosition);
+    connect(command, &RemoveCommand::NotifyRedoCompleted, this, &CustomGraphicsView::updateLinePosition);
+    UndoStack->push(command);
+}
+
 void CustomGraphicsView::AddItemToMoveStack(QGraphicsItem* item)
 {
-    MoveCommand* command = new MoveCommand(item, itemStartPosition, item->scenePos());
+    MoveCommand* command = new MoveCommand(this, item, itemStartPosition, item->scenePos());
     connect(command, &MoveCommand::PublishUndoData, this, &CustomGraphicsView::PublishUndoData);
     connect(command, &MoveCommand::PublishRedoData, this, &CustomGraphicsView::PublishRedoData);
 
@@ -670,3 +2637,169 @@ void CustomGraphicsView::AddItemToMoveStack(QGraphicsItem* item)
 
     UndoStack->push(command);
 }
+
+void CustomGraphicsView::RecordSelectionStart()
+{
+    selectionStartPositions.clear();
+    for (QGraphicsItem *item : scene->selectedItems())
+    {
+        CustomPixmapItem *cpItm = dynamic_cast<CustomPixmapItem *>(item);
+        if (cpItm)
+        {
+            selectionStartPositions.insert(cpItm, cpItm->pos());
+        }
+    }
+}
+
+void CustomGraphicsView::AddSelectionToMoveStack()
+{
+    QList<QGraphicsItem *> items;
+    QVector<QPointF> oldPositions;
+    QVector<QPointF> newPositions;
+    for (auto it = selectionStartPositions.constBegin(); it != selectionStartPositions.constEnd(); ++it)
+    {
+        if (it.key()->pos() != it.value())
+        {
+            items.append(it.key());
+            oldPositions.append(it.value());
+            newPositions.append(it.key()->pos());
+        }
+    }
+    selectionStartPositions.clear();
+
+    if (items.isEmpty())
+    {
+        return;
+    }
+
+    emit PublishNewData(QString("%1 items").arg(items.size()));
+    MoveItemsCommand* command = new MoveItemsCommand(this, items, oldPositions, newPositions);
+    connect(command, &MoveItemsCommand::PublishUndoData, this, &CustomGraphicsView::PublishUndoData);
+    connect(command, &MoveItemsCommand::PublishRedoData, this, &CustomGraphicsView::PublishRedoData);
+    UndoStack->push(command);
+}
+
+UndoTarget CustomGraphicsView::TargetOf(QGraphicsItem *item) const
+{
+    UndoTarget target = {false, 0, 0, false, false};
+    if (CustomPixmapItem *node = dynamic_cast<CustomPixmapItem *>(item))
+    {
+        target.ItemId = node->GetItemId();
+        return target;
+    }
+
+    ArrowLineItem *line = static_cast<ArrowLineItem *>(item);
+    FlowsheetModel::Connection connection;
+    if (ConnectionOf(line, &connection))
+    {
+        target = {true, connection.First, connection.Second,
+                  connection.FirstPort == FlowsheetModel::Port::Inlet, connection.SecondPort == FlowsheetModel::Port::Inlet};
+    }
+    return target;
+}
+
+QGraphicsItem *CustomGraphicsView::Resolve(const UndoTarget &target)
+{
+    CustomPixmapItem *first = ResolveUnit(target.ItemId);
+    if (!target.IsLine || !first)
+    {
+        return first;
+    }
+    CustomPixmapItem *second = ResolveUnit(target.EndItemId);
+    if (!second)
+    {
+        return nullptr;
+    }
+
+    // lines carry no id in the file and are matched by the ports they join
+    int row = flowsheetModel.NodeOf(first->GetItemId());
+    if (row < 0)
+    {
+        return nullptr;
+    }
+    FlowsheetModel::Port firstPort = target.StartOnStartCircle ? FlowsheetModel::Port::Inlet : FlowsheetModel::Port::Outlet;
+    FlowsheetModel::Port secondPort = target.EndOnStartCircle ? FlowsheetModel::Port::Inlet : FlowsheetModel::Port::Outlet;
+    const FlowsheetModel::Adjacency &ports = flowsheetModel.PortConnections();
+    const int slot = PortSlot(row, firstPort);
+    for (int i = ports.Offsets.at(slot); i < ports.Offsets.at(slot + 1); ++i)
+    {
+        const int connection = ports.Targets.at(i);
+        const FlowsheetModel::Connection &joined = flowsheetModel.GetConnection(connection);
+        if (joined.First == target.ItemId && joined.FirstPort == firstPort
+                && joined.Second == target.EndItemId && joined.SecondPort == secondPort)
+        {
+            if (ArrowLineItem *line = linesByConnection.value(flowsheetModel.GetConnectionId(connection)))
+            {
+                return line;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void CustomGraphicsView::Detach(QGraphicsItem *item)
+{
+    if (selectedItem == item)
+    {
+        selectedItem = nullptr;
+    }
+    scene->removeItem(item);
+
+    if (CustomPixmapItem *node = dynamic_cast<CustomPixmapItem *>(item))
+    {
+        ForgetNode(node);
+        selectionStartPositions.remove(node);
+        movedItems.remove(node);
+        return;
+    }
+
+    // a held line is out of the model, so nothing else deletes it while it waits
+    ArrowLineItem *line = static_cast<ArrowLineItem *>(item);
+    ForgetLine(line);
+    router->Forget(line);
+    for (QGraphicsEllipseItem *circle : {line->GetStartCircle(), line->GetEndCircle()})
+    {
+        GroupItem *group = circle ? dynamic_cast<GroupItem *>(circle->parentItem()) : nullptr;
+        if (group)
+        {
+            group->UnbindLine(line);
+        }
+    }
+}
+
+bool CustomGraphicsView::Attach(QGraphicsItem *item, const UndoTarget &target)
+{
+    if (CustomPixmapItem *node = dynamic_cast<CustomPixmapItem *>(item))
+    {
+        scene->addItem(node);
+        TrackNode(node);
+        return true;
+    }
+
+    ArrowLineItem *line = static_cast<ArrowLineItem *>(item);
+    CustomPixmapItem *first = ResolveUnit(target.ItemId);
+    CustomPixmapItem *second = first ? ResolveUnit(target.EndItemId) : nullptr;
+    if (!second)
+    {
+        delete line;
+        return false;
+    }
+    line->SetStartCircle(target.StartOnStartCircle ? first->GetStartCircle() : first->GetEndCircle());
+    line->SetEndCircle(target.EndOnStartCircle ? second->GetStartCircle() : second->GetEndCircle());
+    if (!line->scene())
+    {
+        scene->addItem(line);
+    }
+    BindLinesToGroups({line});
+    TrackLine(line);
+    return true;
+}
+
+void CustomGraphicsView::ReportDangling(const UndoTarget &target)
+{
+    QString message = target.IsLine
+            ? QString("Undo skipped the line from unit %1 to unit %2, one of them no longer exists").arg(target.ItemId).arg(target.EndItemId)
+            : QString("Undo skipped unit %1, it no longer exists").arg(target.ItemId);
+    qWarning().noquote() << message;
+    emit PublishNewData(message);
+}
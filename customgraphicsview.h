@@ -12,16 +12,42 @@
 #include <QAction>
 #include <QContextMenuEvent>
 #include <QUndoStack>
+#include <QHash>
+#include <QSet>
+#include <QPointer>
+#include "conveyorrouter.h"
+#include "compiledflowsheet.h"
+#include "groupitem.h"
+#include "scenepager.h"
+#include "telemetry.h"
+#include "timeseriesstore.h"
+#include "dynamicsimulation.h"
+#include "resultcache.h"
+#include "flowsheetvalidator.h"
+#include "flowsheetmodel.h"
+#include "searchindex.h"
+#include "nodeindex.h"
+#include "addcommand.h"
+#include <QElapsedTimer>
 
-using LineConnectionsMap = QMap<QGraphicsLineItem *, QPair<QGraphicsEllipseItem *, QGraphicsEllipseItem *>>;
-
-class CustomGraphicsView : public QGraphicsView
+class CustomGraphicsView : public QGraphicsView, private UndoResolver
 {
     Q_OBJECT
 
 public:
     CustomGraphicsView(QWidget *parent = nullptr);
     void ClearScene();
+    const ResultCache &GetResultCache() const;
+    QVector<SearchMatch> SearchUnits(const QString &query, int limit) const;
+    QVector<QRectF> PagedUnitRects(const QRectF &rect) const;
+    // centres on pos, growing the scene rect when pos lies outside it
+    void PanTo(const QPointF &pos);
+    // drawing of every unit, paged out ones included, see SceneExporter
+    bool ExportDrawing(const QString &fileName, int dpi, QString *error);
+    // batches scene mutations: the item index is off, new units are wired and
+    // lines refreshed once when the outermost batch ends
+    void BeginBulkUpdate();
+    void EndBulkUpdate();
 
 protected:
     void dragEnterEvent(QDragEnterEvent *event) override;
@@ -33,6 +59,9 @@ protected:
     void mouseDoubleClickEvent(QMouseEvent *event) override;
     void contextMenuEvent(QContextMenuEvent *event) override;
     virtual void wheelEvent(QWheelEvent *event)override;
+    void scrollContentsBy(int dx, int dy) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void drawForeground(QPainter *painter, const QRectF &rect) override;
 
 signals:
     void UndoTriggered();
@@ -42,9 +71,26 @@ signals:
     void PublishUndoData(QString data);
     void PublishRedoData(QString data);
     void resultUpdated(const QString &result);
+    // the scene was cleared or replaced by a load
+    void sceneReset();
 
 private slots:
     void updateLinePosition();
+    void onItemMoved();
+    void flushLinePositions();
+    void onRouteReady(ArrowLineItem *line, const QPolygonF &path);
+    void onGroupSelection();
+    void onExpandGroup();
+    void UpdateResidency();
+    void onMonitor();
+    void onTelemetrySamples(const QVector<TelemetrySample> &samples);
+    void onTelemetryStopped(const QString &message);
+    void onTrend();
+    void onAdjustFeedStream();
+    void onSimulationReport(double time, const QVector<double> &row);
+    void onSimulationFinished(bool completed, const QString &message);
+    void onToggleTear();
+    void flushValidation();
     void onActionSave();
     void onActionDelete();
     void onSetValue();
@@ -58,27 +104,109 @@ public slots:
     void onResult();
     void saveToXml(const QString &fileName);
     void loadFromXml(const QString &fileName);
+    void SetOrthogonalRouting(bool enabled);
+    void AutoLayout();
+    void GroupSelection();
+    void ExpandGroup(GroupItem *group);
+    void SetTiledMode(bool enabled);
+    void RunSimulation();
+    void RunMonteCarlo();
+    void ExportResults(const QString &fileName);
+    void CompareWithFile(const QString &fileName);
+    void ClearComparison();
+    bool FocusUnit(quint64 itemId);
 
 private:
-    void RemoveLines();
     void RemoveAllLines();
-    void reconnectLines(QList<ArrowLineItem*> lineItems, QMap<int, CustomPixmapItem*> customItems);
+    // lines that cannot be joined to their units are deleted and taken out of lineItems
+    void reconnectLines(QList<ArrowLineItem *> &lineItems, const NodeIndex &units);
     void EmitDebugData(QPoint pos);
     void AddItemToAddStack(QGraphicsItem *item);
+    void AddItemToRemoveStack(QGraphicsItem *item);
     void AddItemToMoveStack(QGraphicsItem *item);
+    void RecordSelectionStart();
+    void AddSelectionToMoveStack();
+    void RefreshLine(ArrowLineItem *line);
+    // resident lines at any port of the units, found through the model
+    QList<ArrowLineItem *> LinesAt(const QList<CustomPixmapItem *> &nodes) const;
+    void WriteItemRecord(QDataStream &out, QGraphicsItem *item) const;
+    void WriteCompactRecord(QDataStream &out, QGraphicsItem *item);
+    QByteArray CompactRecords(const QByteArray &records);
+    void WriteScene(QDataStream &out) const;
+    bool ReadItemRecords(QDataStream &in, QList<CustomPixmapItem *> &nodes, QList<ArrowLineItem *> &lines, qint32 version = 1);
+    void BindLinesToGroups(const QList<ArrowLineItem *> &lines);
+    void WireNode(CustomPixmapItem *node);
+    void RemapItemIds(const QList<CustomPixmapItem *> &nodes, const QList<ArrowLineItem *> &lines, QHash<quint64, quint64> &itemIds);
+    void ScheduleResidencyUpdate();
+    void EvictNodes(const QList<CustomPixmapItem *> &nodes);
+    void MaterializeChunks(const QList<quint64> &chunks);
+    CustomPixmapItem *ResolveUnit(quint64 itemId);
+    void TrackNode(CustomPixmapItem *node);
+    void TrackLine(ArrowLineItem *line);
+    void TrackItems(const QList<CustomPixmapItem *> &nodes, const QList<ArrowLineItem *> &lines);
+    void ForgetNode(CustomPixmapItem *node);
+    void ForgetLine(ArrowLineItem *line);
+    void ResetTracking();
+    void ScheduleValidation();
+    UndoTarget TargetOf(QGraphicsItem *item) const override;
+    QGraphicsItem *Resolve(const UndoTarget &target) override;
+    void Detach(QGraphicsItem *item) override;
+    bool Attach(QGraphicsItem *item, const UndoTarget &target) override;
+    void ReportDangling(const UndoTarget &target) override;
+    quint64 GroupUnits(const QVector<quint64> &itemIds, const QString &name, quint64 groupId) override;
+    QVector<quint64> UngroupUnits(quint64 groupId) override;
 
     QGraphicsScene *scene;
     ArrowLineItem *currentLine;
     QPointF lineStartPoint;
-    LineConnectionsMap lineConnections;
     QMenu contextMenu;
     QAction *acnSave;
     QAction *acnDel;
     QAction *acnSetVal;
     QAction *acnResult;
     QGraphicsItem *selectedItem = nullptr;
-    CustomPixmapItem *copiedItem;
     QPointF itemStartPosition;
+    QHash<CustomPixmapItem *, QPointF> selectionStartPositions;
+    QSet<CustomPixmapItem *> movedItems;
+    bool lineFlushPending = false;
+    ConveyorRouter *router;
+    bool orthogonalRouting = true;
+    ScenePager pager;
+    bool tiledMode = false;
+    bool residencyUpdatePending = false;
+    int bulkDepth = 0;
+    bool linesDirty = false;
+    QGraphicsScene::ItemIndexMethod savedIndexMethod = QGraphicsScene::BspTreeIndex;
+    QList<QPointer<CustomPixmapItem>> pendingNodes;
+    TelemetryMonitor *monitor;
+    // latest reading per unit, indexed by TelemetrySample::Signal, NaN when not reported
+    QHash<quint64, QVector<double>> liveReadings;
+    QHash<quint64, qint64> liveReadingTimes;
+    QSet<quint64> staleReadings;
+    QElapsedTimer liveClock;
+    TimeSeriesStore history;
+    DynamicSimulation *simulation = nullptr;
+    ResultCache resultCache;
+    FlowsheetValidator validator;
+    SearchIndex searchIndex;
+    // every unit by item id, resident or paged out; also what the validator and
+    // the search index were told about, so an edit only sends the difference
+    NodeIndex unitIndex;
+    // the flowsheet as plain data, what the solver, the validator and layout read
+    FlowsheetModel flowsheetModel;
+    // the resident line drawing each model connection, paged out connections have none
+    QHash<quint64, ArrowLineItem *> linesByConnection;
+    bool validationPending = false;
+    QPointer<CustomPixmapItem> searchHit;
+    // outlines of a comparison, in scene coordinates as they were when it was made
+    struct DiffMark
+    {
+        QRectF Rect;
+        QLineF Line;
+        QColor Colour;
+        Qt::PenStyle Style;
+    };
+    QVector<DiffMark> diffMarks;
     QUndoStack* UndoStack;
 
     //dropdown
@@ -89,12 +217,27 @@ private:
     QAction *acnSetVal;
     QAction *acnDelItem;
     QAction *acnMonitor;
+    QAction *acnTrend;
     QAction *acnFlipView;
     QAction *acnAddCustomText;
     QAction *acnMaxPlantProd;
     QAction *acnViewResult;
     QAction *acnAdjFeedStream;
+    QAction *acnGroup;
+    QAction *acnExpandGroup;
+    QAction *acnTear;
+
+};
 
+class BulkSceneUpdate
+{
+public:
+    explicit BulkSceneUpdate(CustomGraphicsView *view) : View(view) { View->BeginBulkUpdate(); }
+    ~BulkSceneUpdate() { View->EndBulkUpdate(); }
+
+private:
+    Q_DISABLE_COPY(BulkSceneUpdate)
+    CustomGraphicsView *View;
 };
 
 #endif // CUSTOMGRAPHICSVIEW_H
@@ -1,22 +1,103 @@
 #include "CustomPixmapItem.h"
+#include "itemid.h"
+#include "lazyicon.h"
 #include <QGraphicsScene>
+#include <QHash>
 #include <QPen>
 #include <QWidget>
 #include <QLabel>
 #include <QGraphicsProxyWidget>
 #include <QVBoxLayout>
+#include <QPainter>
+#include <QPixmapCache>
+#include <QCryptographicHash>
 
 namespace
 {
     const char* DEFAULT_TEXT = "Text";
+    const qreal STATUS_HEIGHT = 16;
+    const qreal BADGE_RADIUS = 8;
+    const int ICON_SIZE = 64;
+    const int PALETTE_TYPE_COUNT = 14;
+
+    // the proxy, its container and three labels, shallow; Qt's private data is not visible here
+    const qint64 WIDGET_BYTES = sizeof(QGraphicsProxyWidget) + sizeof(QWidget) + 3 * sizeof(QLabel);
+
+    struct PixmapHold
+    {
+        int Holders;
+        qint64 Bytes;
+    };
+    QHash<qint64, PixmapHold> PixmapHolds;
+
+    qint64 HoldPixmap(const QPixmap &pixmap)
+    {
+        if (pixmap.isNull())
+        {
+            return 0;
+        }
+        PixmapHold &hold = PixmapHolds[pixmap.cacheKey()];
+        if (hold.Holders++ == 0)
+        {
+            hold.Bytes = qint64(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+            MemoryAccount::Charge(MemoryAccount::UnitPixmaps, hold.Bytes, 1);
+        }
+        return pixmap.cacheKey();
+    }
+
+    void ReleasePixmap(qint64 key)
+    {
+        auto hold = PixmapHolds.find(key);
+        if (hold == PixmapHolds.end())
+        {
+            return;
+        }
+        if (--hold->Holders == 0)
+        {
+            MemoryAccount::Charge(MemoryAccount::UnitPixmaps, -hold->Bytes, -1);
+            PixmapHolds.erase(hold);
+        }
+    }
+
+    // units read from a file all carry their own copy of the icon; identical
+    // images are turned back into one shared pixmap
+    QPixmap SharedPixmap(const QImage &image)
+    {
+        if (image.isNull())
+        {
+            return QPixmap();
+        }
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        hash.addData(reinterpret_cast<const char *>(image.constBits()), int(image.sizeInBytes()));
+        const QString key = QString("unitimage:%1x%2:%3:%4").arg(image.width()).arg(image.height())
+                                .arg(int(image.format())).arg(QString::fromLatin1(hash.result().toHex()));
+        QPixmap pixmap;
+        if (!QPixmapCache::find(key, &pixmap))
+        {
+            pixmap = QPixmap::fromImage(image);
+            QPixmapCache::insert(key, pixmap);
+        }
+        return pixmap;
+    }
+}
+
+quint64 CustomPixmapItem::GlobalItemId = 0;
+
+quint64 CustomPixmapItem::AllocateItemId()
+{
+    return ++GlobalItemId;
 }
 
-int CustomPixmapItem::GlobalItemId = 0;
+void CustomPixmapItem::ReserveItemId(quint64 itemId)
+{
+    GlobalItemId = qMax(GlobalItemId, itemId);
+}
 
-CustomPixmapItem::CustomPixmapItem(const QPixmap &pixmap)
+CustomPixmapItem::CustomPixmapItem(const QPixmap &pixmap, int equipmentType)
     : IsDraggingInProgress(false)
     , ContainerWidget(new QWidget)
     , TextLabel(new QLabel(DEFAULT_TEXT))
+    , ParameterLabel(new QLabel)
     , PixmapLabel(new QLabel)
     , ProxyWid(new QGraphicsProxyWidget)
     , StartCircle (new QGraphicsEllipseItem(-10, -10, 10, 10, this))
@@ -24,16 +105,34 @@ CustomPixmapItem::CustomPixmapItem(const QPixmap &pixmap)
     , ItemId(0)
     , IsStartConnected(false)
     , IsEndConnected(false)
+    , Parameters(equipmentType)
+    , Counted(MemoryAccount::Units, sizeof(CustomPixmapItem) + 2 * sizeof(QGraphicsEllipseItem), 1)
+    , WidgetCharge(MemoryAccount::UnitWidgets, WIDGET_BYTES, 1)
+    , PixmapKey(0)
 {
-    ItemId = ++GlobalItemId;
+    ItemId = AllocateItemId();
     setFlag(ItemIsMovable);
-//    setFlag(ItemIsSelectable);
+    setFlag(ItemIsSelectable);
+    setFlag(ItemSendsGeometryChanges);
     setAcceptHoverEvents(true);
 
-    PixmapLabel->setPixmap(pixmap);
+    SetPixmap(pixmap);
     AddEndCircles();
 }
 
+CustomPixmapItem::~CustomPixmapItem()
+{
+    ReleasePixmap(PixmapKey);
+}
+
+void CustomPixmapItem::SetPixmap(const QPixmap &pixmap)
+{
+    PixmapLabel->setPixmap(pixmap);
+    qint64 key = HoldPixmap(pixmap);
+    ReleasePixmap(PixmapKey);
+    PixmapKey = key;
+}
+
 void CustomPixmapItem::AddEndCircles()
 {
 //  this way also we can add widget also depending on future requirement might need it so keeping commented code
@@ -51,13 +150,16 @@ void CustomPixmapItem::AddEndCircles()
     QVBoxLayout *layout = new QVBoxLayout();
     layout->addWidget(TextLabel);
     layout->addWidget(PixmapLabel);
+    layout->addWidget(ParameterLabel);
     ContainerWidget->setLayout(layout);
-    ContainerWidget->setFixedSize(100,100);
+    ContainerWidget->setFixedSize(100,120);
     ContainerWidget->setAttribute(Qt::WA_TranslucentBackground);
     ProxyWid->setWidget(ContainerWidget);
     TextLabel->setFont(QFont("Arial", 16));
     TextLabel->hide();
     TextLabel->setObjectName("LABEL");
+    ParameterLabel->setFont(QFont("Arial", 8));
+    ParameterLabel->hide();
 
     addToGroup(ProxyWid);
     addToGroup(StartCircle);
@@ -77,6 +179,11 @@ QGraphicsEllipseItem *CustomPixmapItem::GetEndCircle() const
     return EndCircle;
 }
 
+FlowsheetModel::Port CustomPixmapItem::PortOf(const QGraphicsEllipseItem *circle) const
+{
+    return circle == StartCircle ? FlowsheetModel::Port::Inlet : FlowsheetModel::Port::Outlet;
+}
+
 QGraphicsEllipseItem *CustomPixmapItem::GetStartCircle() const
 {
     return StartCircle;
@@ -93,6 +200,78 @@ QString CustomPixmapItem::GetText() const
     return TextLabel->text();
 }
 
+void CustomPixmapItem::SetStatus(const QString &text, const QColor &colour)
+{
+    if (text == StatusText && colour == StatusColour)
+    {
+        return;
+    }
+    if (StatusText.isEmpty() != text.isEmpty())
+    {
+        prepareGeometryChange();
+    }
+    StatusText = text;
+    StatusColour = colour;
+    update();
+}
+
+void CustomPixmapItem::ClearStatus()
+{
+    SetStatus(QString(), QColor());
+}
+
+void CustomPixmapItem::SetViolations(const QStringList &messages)
+{
+    if (messages == Violations)
+    {
+        return;
+    }
+    Violations = messages;
+    ContainerWidget->setToolTip(messages.join("\n"));
+    update();
+}
+
+QRectF CustomPixmapItem::boundingRect() const
+{
+    QRectF rect = QGraphicsItemGroup::boundingRect();
+    if (!StatusText.isEmpty())
+    {
+        rect.setBottom(rect.bottom() + STATUS_HEIGHT);
+    }
+    return rect;
+}
+
+void CustomPixmapItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    if (StatusColour.isValid())
+    {
+        QRectF frame = ProxyWid->geometry();
+        painter->setPen(QPen(StatusColour, 3));
+        painter->setBrush(Qt::NoBrush);
+        painter->drawRoundedRect(frame.adjusted(1, 1, -1, -1), 6, 6);
+        if (!StatusText.isEmpty())
+        {
+            QRectF textRect(frame.left(), frame.bottom(), frame.width(), STATUS_HEIGHT);
+            painter->setPen(Qt::black);
+            painter->setFont(QFont("Arial", 8));
+            painter->drawText(textRect, Qt::AlignCenter, StatusText);
+        }
+    }
+    QGraphicsItemGroup::paint(painter, option, widget);
+    if (!Violations.isEmpty())
+    {
+        // inside the frame so the bounding rectangle does not change with it
+        QRectF frame = ProxyWid->geometry();
+        QRectF badge(frame.right() - 2 * BADGE_RADIUS, frame.top(), 2 * BADGE_RADIUS, 2 * BADGE_RADIUS);
+        painter->setPen(Qt::NoPen);
+        painter->setBrush(QColor(200, 0, 0));
+        painter->drawEllipse(badge);
+        painter->setPen(Qt::white);
+        painter->setFont(QFont("Arial", 8, QFont::Bold));
+        painter->drawText(badge, Qt::AlignCenter, QString::number(Violations.size()));
+    }
+}
+
 void CustomPixmapItem::mousePressEvent(QGraphicsSceneMouseEvent *event)
 {
     if (event->button() == Qt::LeftButton)
@@ -105,13 +284,8 @@ void CustomPixmapItem::mousePressEvent(QGraphicsSceneMouseEvent *event)
 
 void CustomPixmapItem::mouseMoveEvent(QGraphicsSceneMouseEvent *event)
 {
-    if (IsDraggingInProgress)
-    {
-        QPointF newPos = pos() + event->pos() - DragStartPosition;
-        setPos(newPos);
-        emit positionChanged();
-    }
-    update();
+    // the base implementation moves every selected item, positionChanged is
+    // emitted from itemChange for each of them
     QGraphicsItemGroup::mouseMoveEvent(event);
 }
 
@@ -126,8 +300,7 @@ void CustomPixmapItem::mouseReleaseEvent(QGraphicsSceneMouseEvent *event)
 
 QVariant CustomPixmapItem::itemChange(GraphicsItemChange change, const QVariant &value)
 {
-    if ((change == ItemPositionChange || change == ItemSelectedChange
-         || change == ItemPositionHasChanged) && scene())
+    if (change == ItemPositionHasChanged && scene())
     {
         emit positionChanged();
     }
@@ -142,27 +315,92 @@ void CustomPixmapItem::write(QDataStream &out) const {
     out << ItemId;
     out << IsStartConnected;
     out << IsEndConnected;
+    Parameters.write(out);
 }
 
-void CustomPixmapItem::read(QDataStream &in) {
+void CustomPixmapItem::writeCompact(QDataStream &out) const
+{
+    out << pos() << TextLabel->text() << ItemId;
+    Parameters.write(out);
+}
+
+void CustomPixmapItem::readCompact(QDataStream &in, int version)
+{
+    QPointF position;
+    QString text;
+    ParameterBlock parameters;
+    in >> position >> text;
+    quint64 itemId = ReadItemId(in, version);
+    parameters.read(in);
+
+    setPos(position);
+    SetText(text);
+    ItemId = itemId;
+    ReserveItemId(itemId);
+    SetParameters(parameters);
+    RestoreIcon();
+}
+
+QString CustomPixmapItem::IconFileFor(int equipmentType)
+{
+    if (equipmentType < 1 || equipmentType > PALETTE_TYPE_COUNT)
+    {
+        return QString();
+    }
+    return QString(":/icons/images/parent/parent_%1.png").arg(equipmentType);
+}
+
+void CustomPixmapItem::RestoreIcon()
+{
+    if (PixmapLabel->pixmap() && !PixmapLabel->pixmap()->isNull())
+    {
+        return;
+    }
+    QString iconFile = IconFileFor(Parameters.GetEquipmentType());
+    if (!iconFile.isEmpty())
+    {
+        SetPixmap(LazyIcon(iconFile).pixmap(ICON_SIZE, ICON_SIZE));
+    }
+}
+
+void CustomPixmapItem::read(QDataStream &in, int version) {
     QPointF position;
     QImage image;
     QString text;
-    int globalItemId;
-    int itemId;
     bool isStartConn;
     bool isEndConn;
 
-    in >> position >> image >> text >> globalItemId >> itemId >> isStartConn >> isEndConn;
+    in >> position >> image >> text;
+    quint64 globalItemId = ReadItemId(in, version);
+    quint64 itemId = ReadItemId(in, version);
+    in >> isStartConn >> isEndConn;
 
     setPos(position);
-    PixmapLabel->setPixmap(QPixmap::fromImage(image));
+    SetPixmap(SharedPixmap(image));
     SetText(text);
     ItemId = itemId;
-    GlobalItemId = GlobalItemId > globalItemId ? GlobalItemId : globalItemId;
-    ItemId = itemId;
+    ReserveItemId(globalItemId);
+    ReserveItemId(itemId);
     SetStartConnected(isStartConn);
     SetEndConnected(isEndConn);
+
+    if (version >= 2)
+    {
+        ParameterBlock parameters;
+        parameters.read(in);
+        SetParameters(parameters);
+    }
+    else
+    {
+        // older files kept the assigned value in the label text
+        bool isNumber = false;
+        double value = text.toDouble(&isNumber);
+        if (isNumber)
+        {
+            SetDoubleParameter(ParameterBlock::Value, value);
+            TextLabel->setText(DEFAULT_TEXT);
+        }
+    }
 }
 
 void CustomPixmapItem::SetStartConnected(bool connected)
@@ -185,20 +423,56 @@ bool CustomPixmapItem::GetEndConnected()
     return IsEndConnected;
 }
 
-void CustomPixmapItem::SetItemId(int itemId)
+void CustomPixmapItem::SetItemId(quint64 itemId)
 {
     ItemId = itemId;
+    ReserveItemId(itemId);
 }
 
-int CustomPixmapItem::GetItemId()
+quint64 CustomPixmapItem::GetItemId()
 {
     return ItemId;
 }
 
 void CustomPixmapItem::HideLabelIfNeeded()
 {
-    if(TextLabel->text().compare(DEFAULT_TEXT) == 0)
+    if(HasDefaultText())
     {
         TextLabel->hide();
     }
 }
+
+bool CustomPixmapItem::HasDefaultText() const
+{
+    return TextLabel->text().compare(DEFAULT_TEXT) == 0;
+}
+
+const ParameterBlock &CustomPixmapItem::GetParameters() const
+{
+    return Parameters;
+}
+
+void CustomPixmapItem::SetParameters(const ParameterBlock &parameters)
+{
+    Parameters = parameters;
+    UpdateParameterLabel();
+}
+
+void CustomPixmapItem::SetDoubleParameter(int index, double value)
+{
+    Parameters.SetDouble(index, value);
+    UpdateParameterLabel();
+}
+
+void CustomPixmapItem::SetIntParameter(int index, int value)
+{
+    Parameters.SetInt(index, value);
+    UpdateParameterLabel();
+}
+
+void CustomPixmapItem::UpdateParameterLabel()
+{
+    QString text = Parameters.ToDisplayString();
+    ParameterLabel->setText(text);
+    ParameterLabel->setVisible(!text.isEmpty());
+}
@@ -5,42 +5,62 @@
 #include <QGraphicsSceneMouseEvent>
 #include <QObject>
 #include <QLabel>
+#include "parameterblock.h"
+#include "flowsheetmodel.h"
+#include "memoryaccount.h"
 
 class CustomPixmapItem : public QObject, public QGraphicsItemGroup
 {
     Q_OBJECT
 public:
-    static int GlobalItemId;
-    CustomPixmapItem(const QPixmap &pixmap);
-    CustomPixmapItem(const CustomPixmapItem& other)    : QObject(), QGraphicsItemGroup(), ItemId(other.ItemId + 1),
-        IsStartConnected(other.IsStartConnected),
-        IsEndConnected(other.IsEndConnected),
-        ContainerWidget(nullptr), TextLabel(new QLabel()),
-        PixmapLabel(new QLabel()),
-        StartCircle(new QGraphicsEllipseItem()), EndCircle(new QGraphicsEllipseItem())
-    {
+    // ids are handed out once per session and never reused, whatever is
+    // cleared or deleted; loaded and pasted ids are reserved so later units
+    // cannot collide with them
+    static quint64 AllocateItemId();
+    static void ReserveItemId(quint64 itemId);
 
-    }
-    CustomPixmapItem* clone() const {
-        return new CustomPixmapItem(*this);
-    }
+    CustomPixmapItem(const QPixmap &pixmap, int equipmentType = 0);
+    ~CustomPixmapItem() override;
     void SetText(const QString &text);
     QString GetText() const;
     void write(QDataStream &out) const;
-    void read(QDataStream &in);
+    void read(QDataStream &in, int version);
+    // clipboard form: no image, the icon is rebuilt from the equipment type
+    void writeCompact(QDataStream &out) const;
+    void readCompact(QDataStream &in, int version);
+    // palette icon of an equipment type, empty when the type has none
+    static QString IconFileFor(int equipmentType);
+    // sets that icon unless the unit already shows one, as groups do
+    void RestoreIcon();
     void SetStartConnected(bool connected);
     void SetEndConnected(bool connected);
     bool GetStartConnected();
     bool GetEndConnected();
-    void SetItemId(int itemId);
-    int GetItemId();
+    void SetItemId(quint64 itemId);
+    quint64 GetItemId();
     void HideLabelIfNeeded();
+    bool HasDefaultText() const;
+
+    const ParameterBlock &GetParameters() const;
+    void SetParameters(const ParameterBlock &parameters);
+    void SetDoubleParameter(int index, double value);
+    void SetIntParameter(int index, int value);
 
     int pixmapWidth() const { return PixmapLabel->pixmap()->width(); }
     int pixmapHeight() const { return PixmapLabel->pixmap()->height(); }
 
     QGraphicsEllipseItem *GetStartCircle() const;
     QGraphicsEllipseItem *GetEndCircle() const;
+    FlowsheetModel::Port PortOf(const QGraphicsEllipseItem *circle) const;
+
+    // live reading painted under the unit while monitoring, cheaper than a label relayout
+    void SetStatus(const QString &text, const QColor &colour);
+    void ClearStatus();
+    // validation findings, counted on a badge in the corner and listed in the tool tip
+    void SetViolations(const QStringList &messages);
+
+    QRectF boundingRect() const override;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = nullptr) override;
 
 signals:
     void positionChanged();
@@ -52,19 +72,32 @@ protected:
     QVariant itemChange(GraphicsItemChange change, const QVariant &value) override;
 
 private:
+    static quint64 GlobalItemId;
+
     void AddEndCircles();
+    void UpdateParameterLabel();
+    void SetPixmap(const QPixmap &pixmap);
 
     QPointF DragStartPosition;
     bool IsDraggingInProgress;
     QWidget* ContainerWidget;
     QLabel* TextLabel;
+    QLabel* ParameterLabel;
     QLabel* PixmapLabel;
     QGraphicsProxyWidget* ProxyWid;
     QGraphicsEllipseItem *StartCircle;
     QGraphicsEllipseItem *EndCircle;
-    int ItemId;
+    quint64 ItemId;
     bool IsStartConnected;
     bool IsEndConnected;
+    ParameterBlock Parameters;
+    QString StatusText;
+    QColor StatusColour;
+    QStringList Violations;
+    MemoryCharge Counted;
+    MemoryCharge WidgetCharge;
+    // cache key of the pixmap shown, units sharing one image are charged for it once
+    qint64 PixmapKey;
 };
 
 #endif // CUSTOMPIXMAPITEM_H
@@ -0,0 +1,412 @@
+#include "compiledflowsheet.h"
+#include <QtNumeric>
+#include <algorithm>
+
+int CompiledFlowsheet::AddNode(quint64 itemId, const ParameterBlock &parameters)
+{
+    ItemIds.append(itemId);
+    EquipmentTypes.append(parameters.GetEquipmentType());
+    Models.append(EquipmentModelRegistry::Instance().ModelFor(parameters.GetEquipmentType()));
+    Values.append(parameters.DoubleData()[ParameterBlock::Value]);
+    Operations.append(Operation(itemId));
+    DoubleOffsets.append(Doubles.size());
+    for (int i = 0; i < parameters.DoubleCount(); ++i)
+    {
+        Doubles.append(parameters.IsDoubleAssigned(i) ? parameters.GetDouble(i) : qQNaN());
+    }
+    IntOffsets.append(Ints.size());
+    for (int i = 0; i < parameters.IntCount(); ++i)
+    {
+        Ints.append(parameters.GetInt(i));
+    }
+    Charge.Add(sizeof(quint64) + 4 * sizeof(int) + sizeof(double) + sizeof(const EquipmentModel *)
+               + parameters.DoubleCount() * sizeof(double) + parameters.IntCount() * sizeof(int));
+    return ItemIds.size() - 1;
+}
+
+void CompiledFlowsheet::AddEdge(int start, int end)
+{
+    Edges.append({start, end});
+    AddToBatch(Batches, BatchOfType, Edges.size() - 1);
+    int doubles = 0;
+    int ints = 0;
+    GetDoubles(end, doubles);
+    GetInts(end, ints);
+    Charge.Add(sizeof(Edge) + sizeof(int) + sizeof(quint64) + doubles * sizeof(double) + ints * sizeof(int));
+}
+
+void CompiledFlowsheet::AddToBatch(QVector<Batch> &batches, QHash<int, int> &batchOfType, int edge) const
+{
+    const int end = Edges.at(edge).End;
+    const int equipmentType = EquipmentTypes.at(end);
+    auto it = batchOfType.constFind(equipmentType);
+    int index = it != batchOfType.constEnd() ? it.value() : -1;
+    if (index < 0)
+    {
+        index = batches.size();
+        batchOfType.insert(equipmentType, index);
+        int doubleCount = 0;
+        int intCount = 0;
+        GetDoubles(end, doubleCount);
+        GetInts(end, intCount);
+        batches.append({equipmentType, Models.at(end), QVector<int>(), QVector<quint64>(),
+                        doubleCount, intCount, QVector<double>(), QVector<int>()});
+    }
+    Batch &batch = batches[index];
+    batch.Edges.append(edge);
+    batch.ItemIds.append(ItemIds.at(end));
+    // every unit of a type has the schema's parameters, so the strides hold
+    const double *doubles = Doubles.constData() + DoubleOffsets.at(end);
+    for (int i = 0; i < batch.DoubleCount; ++i)
+    {
+        batch.Doubles.append(doubles[i]);
+    }
+    const int *ints = Ints.constData() + IntOffsets.at(end);
+    for (int i = 0; i < batch.IntCount; ++i)
+    {
+        batch.Ints.append(ints[i]);
+    }
+}
+
+void CompiledFlowsheet::RunBatch(const Batch &batch, const QVector<double> &values, QVector<double> &scratch,
+                                 double *outputs, double *byInlet, double *byUnit, double *byDoubles) const
+{
+    const int count = batch.Edges.size();
+    scratch.resize(2 * count);
+    double *inlets = scratch.data();
+    double *units = inlets + count;
+    for (int i = 0; i < count; ++i)
+    {
+        const Edge &edge = Edges.at(batch.Edges.at(i));
+        inlets[i] = values.at(edge.Start);
+        units[i] = values.at(edge.End);
+    }
+    const EquipmentBatch columns = {count, batch.ItemIds.constData(), inlets, units,
+                                    batch.DoubleCount, batch.Doubles.constData(),
+                                    batch.IntCount, batch.Ints.constData()};
+    batch.Model->Evaluate(batch.EquipmentType, columns, outputs);
+    if (byInlet)
+    {
+        batch.Model->Differentiate(batch.EquipmentType, columns, byInlet, byUnit, byDoubles);
+    }
+}
+
+void CompiledFlowsheet::AddConstant(double value)
+{
+    Constant += value;
+}
+
+int CompiledFlowsheet::NodeCount() const
+{
+    return ItemIds.size();
+}
+
+int CompiledFlowsheet::EdgeCount() const
+{
+    return Edges.size();
+}
+
+quint64 CompiledFlowsheet::GetItemId(int node) const
+{
+    return ItemIds.at(node);
+}
+
+int CompiledFlowsheet::GetEquipmentType(int node) const
+{
+    return EquipmentTypes.at(node);
+}
+
+const QVector<double> &CompiledFlowsheet::GetValues() const
+{
+    return Values;
+}
+
+const double *CompiledFlowsheet::GetDoubles(int node, int &count) const
+{
+    const int end = node + 1 < DoubleOffsets.size() ? DoubleOffsets.at(node + 1) : Doubles.size();
+    count = end - DoubleOffsets.at(node);
+    return Doubles.constData() + DoubleOffsets.at(node);
+}
+
+const int *CompiledFlowsheet::GetInts(int node, int &count) const
+{
+    const int end = node + 1 < IntOffsets.size() ? IntOffsets.at(node + 1) : Ints.size();
+    count = end - IntOffsets.at(node);
+    return Ints.constData() + IntOffsets.at(node);
+}
+
+int CompiledFlowsheet::ParameterIndex(int node, int parameter) const
+{
+    return DoubleOffsets.at(node) + parameter;
+}
+
+int CompiledFlowsheet::ParameterNode(int index, int &parameter) const
+{
+    // nodes without parameters share their offset with the next one, the last of a run owns the index
+    const int node = int(std::upper_bound(DoubleOffsets.begin(), DoubleOffsets.end(), index) - DoubleOffsets.begin()) - 1;
+    parameter = index - DoubleOffsets.at(node);
+    return node;
+}
+
+const QVector<CompiledFlowsheet::Edge> &CompiledFlowsheet::GetEdges() const
+{
+    return Edges;
+}
+
+double CompiledFlowsheet::GetConstant() const
+{
+    return Constant;
+}
+
+int CompiledFlowsheet::Operation(quint64 endItemId)
+{
+    return int(endItemId > 4 ? endItemId % 4 : endItemId);
+}
+
+const EquipmentModel *CompiledFlowsheet::GetModel(int node) const
+{
+    return Models.at(node);
+}
+
+QVector<double> CompiledFlowsheet::EdgeResults(const QVector<double> &values) const
+{
+    QVector<double> results(Edges.size());
+    QVector<double> scratch;
+    QVector<double> outputs;
+    for (const Batch &batch : Batches)
+    {
+        outputs.resize(batch.Edges.size());
+        RunBatch(batch, values, scratch, outputs.data());
+        for (int i = 0; i < batch.Edges.size(); ++i)
+        {
+            results[batch.Edges.at(i)] = outputs.at(i);
+        }
+    }
+    return results;
+}
+
+QVector<double> CompiledFlowsheet::EdgeResults(const QVector<int> &edges, const QVector<double> &values) const
+{
+    QVector<Batch> batches;
+    QHash<int, int> batchOfType;
+    for (int edge : edges)
+    {
+        AddToBatch(batches, batchOfType, edge);
+    }
+    // where each edge of a batch goes in the result
+    QVector<QVector<int>> positions(batches.size());
+    for (int i = 0; i < edges.size(); ++i)
+    {
+        positions[batchOfType.value(EquipmentTypes.at(Edges.at(edges.at(i)).End))].append(i);
+    }
+
+    QVector<double> results(edges.size());
+    QVector<double> scratch;
+    QVector<double> outputs;
+    for (int b = 0; b < batches.size(); ++b)
+    {
+        outputs.resize(batches.at(b).Edges.size());
+        RunBatch(batches.at(b), values, scratch, outputs.data());
+        for (int i = 0; i < outputs.size(); ++i)
+        {
+            results[positions.at(b).at(i)] = outputs.at(i);
+        }
+    }
+    return results;
+}
+
+void CompiledFlowsheet::EdgePartials(const QVector<double> &values, double *outputs, double *byInlet, double *byUnit,
+                                     double *byParameters) const
+{
+    std::fill(byParameters, byParameters + Doubles.size(), 0.0);
+    QVector<double> scratch;
+    QVector<double> columns;
+    for (const Batch &batch : Batches)
+    {
+        const int count = batch.Edges.size();
+        columns.resize((3 + batch.DoubleCount) * count);
+        double *byDoubles = columns.data() + 3 * count;
+        RunBatch(batch, values, scratch, columns.data(), columns.data() + count, columns.data() + 2 * count, byDoubles);
+        for (int i = 0; i < count; ++i)
+        {
+            const int edge = batch.Edges.at(i);
+            const int end = Edges.at(edge).End;
+            outputs[edge] = columns.at(i);
+            byInlet[edge] = columns.at(count + i);
+            byUnit[edge] = columns.at(2 * count + i);
+            for (int parameter = 0; parameter < batch.DoubleCount; ++parameter)
+            {
+                const double partial = byDoubles[i * batch.DoubleCount + parameter];
+                // the Value slot is the unit's value
+                if (parameter == ParameterBlock::Value)
+                {
+                    byUnit[edge] += partial;
+                }
+                else
+                {
+                    byParameters[ParameterIndex(end, parameter)] += partial;
+                }
+            }
+        }
+    }
+}
+
+double CompiledFlowsheet::Evaluate(const QVector<double> &values) const
+{
+    // batches are summed in turn, the order does not depend on threads or hashing
+    double result = Constant;
+    QVector<double> scratch;
+    QVector<double> outputs;
+    for (const Batch &batch : Batches)
+    {
+        outputs.resize(batch.Edges.size());
+        RunBatch(batch, values, scratch, outputs.data());
+        for (double output : outputs)
+        {
+            result += output;
+        }
+    }
+    return result;
+}
+
+double CompiledFlowsheet::Evaluate() const
+{
+    return Evaluate(Values);
+}
+
+double CompiledFlowsheet::Gradient(QVector<double> &gradient, QVector<double> *parameterGradient) const
+{
+    QVector<double> outputs(Edges.size());
+    QVector<double> byInlet(Edges.size());
+    QVector<double> byUnit(Edges.size());
+    QVector<double> byParameters(Doubles.size());
+    EdgePartials(Values, outputs.data(), byInlet.data(), byUnit.data(), byParameters.data());
+
+    gradient.fill(0.0, ItemIds.size());
+    double result = Constant;
+    for (int e = 0; e < Edges.size(); ++e)
+    {
+        result += outputs.at(e);
+        gradient[Edges.at(e).Start] += byInlet.at(e);
+        gradient[Edges.at(e).End] += byUnit.at(e);
+    }
+    if (parameterGradient)
+    {
+        *parameterGradient = byParameters;
+    }
+    return result;
+}
+
+QVector<double> CompiledFlowsheet::ProductGradients(const QVector<int> &productNodes, QVector<SparseGradient> &gradients,
+                                                    QVector<SparseGradient> *parameterGradients) const
+{
+    QVector<double> outputs(Edges.size());
+    QVector<double> byInlet(Edges.size());
+    QVector<double> byUnit(Edges.size());
+    QVector<double> byParameters(Doubles.size());
+    EdgePartials(Values, outputs.data(), byInlet.data(), byUnit.data(), byParameters.data());
+
+    QVector<int> slot(ItemIds.size(), -1);
+    for (int i = 0; i < productNodes.size(); ++i)
+    {
+        slot[productNodes.at(i)] = i;
+    }
+    QVector<QVector<int>> productEdges(productNodes.size());
+    for (int e = 0; e < Edges.size(); ++e)
+    {
+        if (slot.at(Edges.at(e).End) >= 0)
+        {
+            productEdges[slot.at(Edges.at(e).End)].append(e);
+        }
+    }
+
+    // one dense row reused for every product, only the entries touched are read back and cleared
+    QVector<double> row(ItemIds.size(), 0.0);
+    QVector<bool> touched(ItemIds.size(), false);
+    QVector<int> nodes;
+    QVector<double> results(productNodes.size(), 0.0);
+    gradients.fill(SparseGradient(), productNodes.size());
+    for (int product = 0; product < productNodes.size(); ++product)
+    {
+        nodes.resize(0);
+        for (int e : productEdges.at(product))
+        {
+            results[product] += outputs.at(e);
+            for (int node : {Edges.at(e).Start, Edges.at(e).End})
+            {
+                if (!touched.at(node))
+                {
+                    touched[node] = true;
+                    nodes.append(node);
+                }
+            }
+            row[Edges.at(e).Start] += byInlet.at(e);
+            row[Edges.at(e).End] += byUnit.at(e);
+        }
+        std::sort(nodes.begin(), nodes.end());
+        SparseGradient &gradient = gradients[product];
+        gradient.reserve(nodes.size());
+        for (int node : nodes)
+        {
+            gradient.append(qMakePair(node, row.at(node)));
+            row[node] = 0.0;
+            touched[node] = false;
+        }
+    }
+
+    if (parameterGradients)
+    {
+        // every edge of a product ends at its node, so its parameter partials are already summed there
+        parameterGradients->fill(SparseGradient(), productNodes.size());
+        for (int product = 0; product < productNodes.size(); ++product)
+        {
+            int count = 0;
+            GetDoubles(productNodes.at(product), count);
+            for (int parameter = 0; parameter < count; ++parameter)
+            {
+                const int index = ParameterIndex(productNodes.at(product), parameter);
+                if (byParameters.at(index) != 0.0)
+                {
+                    (*parameterGradients)[product].append(qMakePair(index, byParameters.at(index)));
+                }
+            }
+        }
+    }
+    return results;
+}
+
+QVector<quint64> CompiledFlowsheet::ZeroDivisors() const
+{
+    const EquipmentModel *builtIn = EquipmentModelRegistry::Instance().BuiltIn();
+    QVector<bool> reported(ItemIds.size(), false);
+    QVector<quint64> divisors;
+    for (const Edge &edge : Edges)
+    {
+        if (Models.at(edge.End) == builtIn && Operations.at(edge.End) == 3 && Values.at(edge.End) == 0.0 && !reported.at(edge.End))
+        {
+            reported[edge.End] = true;
+            divisors.append(ItemIds.at(edge.End));
+        }
+    }
+    return divisors;
+}
+
+QVector<int> CompiledFlowsheet::ProductNodes() const
+{
+    QVector<bool> hasOutlet(ItemIds.size(), false);
+    QVector<bool> hasInlet(ItemIds.size(), false);
+    for (const Edge &edge : Edges)
+    {
+        hasOutlet[edge.Start] = true;
+        hasInlet[edge.End] = true;
+    }
+    QVector<int> products;
+    for (int node = 0; node < ItemIds.size(); ++node)
+    {
+        if (hasInlet.at(node) && !hasOutlet.at(node))
+        {
+            products.append(node);
+        }
+    }
+    return products;
+}
@@ -0,0 +1,114 @@
+#ifndef COMPILEDFLOWSHEET_H
+#define COMPILEDFLOWSHEET_H
+
+#include <QHash>
+#include <QPair>
+#include <QVector>
+#include "equipmentmodel.h"
+#include "memoryaccount.h"
+#include "parameterblock.h"
+
+// Flat snapshot of the connected units the solver works on. Node values are
+// copied out of the parameter blocks into one array, edges refer to nodes by
+// index. Constants hold results of collapsed groups that are not expanded.
+// Edges are also bucketed by the equipment type they end at, so each model is
+// called once per solve with all of its streams.
+class CompiledFlowsheet
+{
+public:
+    struct Edge
+    {
+        int Start;
+        int End;
+    };
+
+    int AddNode(quint64 itemId, const ParameterBlock &parameters);
+    void AddEdge(int start, int end);
+    void AddConstant(double value);
+
+    int NodeCount() const;
+    int EdgeCount() const;
+    quint64 GetItemId(int node) const;
+    int GetEquipmentType(int node) const;
+    const EquipmentModel *GetModel(int node) const;
+    const QVector<double> &GetValues() const;
+    // parameters of the node in schema order, as models are given them
+    const double *GetDoubles(int node, int &count) const;
+    const int *GetInts(int node, int &count) const;
+    // where a node's parameter is in the flat parameter arrays, and back
+    int ParameterIndex(int node, int parameter) const;
+    int ParameterNode(int index, int &parameter) const;
+    const QVector<Edge> &GetEdges() const;
+    double GetConstant() const;
+
+    // built-in operation of a unit, chosen by its id
+    static int Operation(quint64 endItemId);
+
+    // what every edge delivers into its unit, in edge order
+    QVector<double> EdgeResults(const QVector<double> &values) const;
+    // the same for the given edges only, in the order given
+    QVector<double> EdgeResults(const QVector<int> &edges, const QVector<double> &values) const;
+
+    double Evaluate(const QVector<double> &values) const;
+    double Evaluate() const;
+
+    // item ids of dividing units whose value is zero or was never set, the result is undefined with any
+    QVector<quint64> ZeroDivisors() const;
+
+    // units no edge leaves, the streams the plant delivers
+    QVector<int> ProductNodes() const;
+
+    typedef QVector<QPair<int, double>> SparseGradient;
+
+    // Derivatives of the result with respect to every node value and, when
+    // asked for, every parameter by ParameterIndex. A stream depends on the
+    // values at its two ends and the parameters of the unit it enters only, so
+    // one pass over the models' partials adds its entries into dense arrays.
+    double Gradient(QVector<double> &gradient, QVector<double> *parameterGradient = nullptr) const;
+    // the same for the share of the result contributed by the edges ending at
+    // each product node, with only the nodes a product depends on, by node,
+    // and only the parameters of the product node, by ParameterIndex
+    QVector<double> ProductGradients(const QVector<int> &productNodes, QVector<SparseGradient> &gradients,
+                                     QVector<SparseGradient> *parameterGradients = nullptr) const;
+
+private:
+    // edges ending at units of one equipment type, with the ids and
+    // parameters of those units, stream by stream
+    struct Batch
+    {
+        int EquipmentType;
+        const EquipmentModel *Model;
+        QVector<int> Edges;
+        QVector<quint64> ItemIds;
+        int DoubleCount;
+        int IntCount;
+        QVector<double> Doubles;
+        QVector<int> Ints;
+    };
+
+    void AddToBatch(QVector<Batch> &batches, QHash<int, int> &batchOfType, int edge) const;
+    // outputs and, when asked for, partials of the batch's edges in batch order
+    void RunBatch(const Batch &batch, const QVector<double> &values, QVector<double> &scratch,
+                  double *outputs, double *byInlet = nullptr, double *byUnit = nullptr, double *byDoubles = nullptr) const;
+    // partials by parameters are summed per unit into byParameters, indexed like Doubles
+    void EdgePartials(const QVector<double> &values, double *outputs, double *byInlet, double *byUnit,
+                      double *byParameters) const;
+
+    QVector<quint64> ItemIds;
+    QVector<int> EquipmentTypes;
+    QVector<const EquipmentModel *> Models;
+    QVector<double> Values;
+    QVector<int> Operations;
+    // every node's parameters back to back, a node's start at its offset
+    QVector<double> Doubles;
+    QVector<int> DoubleOffsets;
+    QVector<int> Ints;
+    QVector<int> IntOffsets;
+    QVector<Edge> Edges;
+    QVector<Batch> Batches;
+    QHash<int, int> BatchOfType;
+    double Constant = 0.0;
+    MemoryCharge Charge{MemoryAccount::SolverBuffers, 0, 1};
+};
+
+#endif // COMPILEDFLOWSHEET_H
@@ -0,0 +1,118 @@
+#ifndef DUALNUMBER_H
+#define DUALNUMBER_H
+
+#include <QPair>
+#include <QVector>
+
+// Forward mode automatic differentiation. A value carries its partial
+// derivatives with respect to numbered inputs; only inputs it depends on are
+// stored, sorted by index. Models write their arithmetic once as a template
+// and run it on doubles to evaluate and on dual numbers to differentiate.
+template <typename T>
+class DualNumber
+{
+public:
+    typedef QVector<QPair<int, T>> Derivatives;
+
+    DualNumber(T value = T())
+        : Value(value)
+    {
+    }
+
+    static DualNumber Variable(T value, int input)
+    {
+        DualNumber variable(value);
+        variable.Partials.append(qMakePair(input, T(1)));
+        return variable;
+    }
+
+    T GetValue() const
+    {
+        return Value;
+    }
+
+    const Derivatives &GetDerivatives() const
+    {
+        return Partials;
+    }
+
+    T Derivative(int input) const
+    {
+        for (const QPair<int, T> &partial : Partials)
+        {
+            if (partial.first == input)
+            {
+                return partial.second;
+            }
+        }
+        return T(0);
+    }
+
+    friend DualNumber operator+(const DualNumber &a, const DualNumber &b)
+    {
+        return DualNumber(a.Value + b.Value, Combine(a, T(1), b, T(1)));
+    }
+
+    friend DualNumber operator-(const DualNumber &a, const DualNumber &b)
+    {
+        return DualNumber(a.Value - b.Value, Combine(a, T(1), b, T(-1)));
+    }
+
+    friend DualNumber operator*(const DualNumber &a, const DualNumber &b)
+    {
+        return DualNumber(a.Value * b.Value, Combine(a, b.Value, b, a.Value));
+    }
+
+    friend DualNumber operator/(const DualNumber &a, const DualNumber &b)
+    {
+        const T quotient = a.Value / b.Value;
+        return DualNumber(quotient, Combine(a, T(1) / b.Value, b, -quotient / b.Value));
+    }
+
+    // branches such as qMin follow the values, the derivative is that of the branch taken
+    friend bool operator<(const DualNumber &a, const DualNumber &b)
+    {
+        return a.Value < b.Value;
+    }
+
+private:
+    DualNumber(T value, const Derivatives &partials)
+        : Value(value)
+        , Partials(partials)
+    {
+    }
+
+    // merge of the two sorted lists: scaleA * a' + scaleB * b'
+    static Derivatives Combine(const DualNumber &a, T scaleA, const DualNumber &b, T scaleB)
+    {
+        Derivatives result;
+        result.reserve(a.Partials.size() + b.Partials.size());
+        int i = 0;
+        int j = 0;
+        while (i < a.Partials.size() || j < b.Partials.size())
+        {
+            if (j == b.Partials.size() || (i < a.Partials.size() && a.Partials.at(i).first < b.Partials.at(j).first))
+            {
+                result.append(qMakePair(a.Partials.at(i).first, scaleA * a.Partials.at(i).second));
+                ++i;
+            }
+            else if (i == a.Partials.size() || b.Partials.at(j).first < a.Partials.at(i).first)
+            {
+                result.append(qMakePair(b.Partials.at(j).first, scaleB * b.Partials.at(j).second));
+                ++j;
+            }
+            else
+            {
+                result.append(qMakePair(a.Partials.at(i).first, scaleA * a.Partials.at(i).second + scaleB * b.Partials.at(j).second));
+                ++i;
+                ++j;
+            }
+        }
+        return result;
+    }
+
+    T Value;
+    Derivatives Partials;
+};
+
+#endif // DUALNUMBER_H
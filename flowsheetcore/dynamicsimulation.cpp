@@ -0,0 +1,545 @@
+#include "dynamicsimulation.h"
+#include "resultwriter.h"
+#include <QHash>
+#include <QScopedPointer>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // a bin or pile about to fill stops the units upstream of it until it has drawn down again
+    const double STORAGE_FULL = 0.98;
+    const double STORAGE_RESTART = 0.80;
+    const int REPORTS_PER_CHUNK = 60;
+    const int SPLIT_TYPE = 3;
+
+    double NamedDouble(const ParameterBlock &parameters, const char *name)
+    {
+        int index = parameters.DoubleIndex(name);
+        return index >= 0 && parameters.IsDoubleAssigned(index) ? parameters.GetDouble(index) : 0.0;
+    }
+}
+
+int SimulationModel::AddUnit(quint64 itemId, const QString &name, const ParameterBlock &parameters)
+{
+    Units.append({itemId, name, parameters});
+    return Units.size() - 1;
+}
+
+void SimulationModel::AddFlow(int from, int to)
+{
+    Flows.append(qMakePair(from, to));
+}
+
+void SimulationModel::AddEvent(const SimulationEvent &event)
+{
+    Events.append(event);
+}
+
+const QVector<SimulationModel::Unit> &SimulationModel::GetUnits() const
+{
+    return Units;
+}
+
+const QVector<QPair<int, int>> &SimulationModel::GetFlows() const
+{
+    return Flows;
+}
+
+const QVector<SimulationEvent> &SimulationModel::GetEvents() const
+{
+    return Events;
+}
+
+QVector<QVector<int>> SimulationModel::Circuits() const
+{
+    QVector<int> parent(Units.size());
+    for (int i = 0; i < parent.size(); ++i)
+    {
+        parent[i] = i;
+    }
+    auto find = [&parent](int unit) {
+        while (parent.at(unit) != unit)
+        {
+            parent[unit] = parent.at(parent.at(unit));
+            unit = parent.at(unit);
+        }
+        return unit;
+    };
+    for (const QPair<int, int> &flow : Flows)
+    {
+        parent[find(flow.first)] = find(flow.second);
+    }
+
+    QHash<int, int> circuitOf;
+    QVector<QVector<int>> circuits;
+    for (int unit = 0; unit < Units.size(); ++unit)
+    {
+        int root = find(unit);
+        if (!circuitOf.contains(root))
+        {
+            circuitOf.insert(root, circuits.size());
+            circuits.append(QVector<int>());
+        }
+        circuits[circuitOf.value(root)].append(unit);
+    }
+    return circuits;
+}
+
+// State of one circuit. Units are kept in topological order so a step is one
+// forward pass; flows that close a loop are carried into the next step.
+class CircuitSimulation
+{
+public:
+    CircuitSimulation(const SimulationModel &model, const QVector<int> &units, double stepSeconds,
+                      QVector<SimulationColumn> &columns);
+
+    // advances steps from firstStep, firstStep is a multiple of stepsPerReport
+    void Run(int firstStep, int steps, int stepsPerReport, double *rows, int rowStride);
+
+private:
+    struct UnitState
+    {
+        EquipmentRole Role;
+        int EquipmentType;
+        double Rate = 0.0;          // feed rate, discharge rate or processing limit in tph, 0 is unlimited
+        double Capacity = 0.0;      // tonnes
+        double SplitRatio = -1.0;
+        bool ScheduledOn = true;
+        int Interlocks = 0;
+        bool Full = false;
+        double Level = 0.0;
+        double Held = 0.0;          // tonnes a stopped or saturated unit holds back
+        QVector<int> Upstream;      // units stopped with this one, up to and including the nearest bins or piles
+        double Product = 0.0;       // tonnes since the last report
+        QVector<double> Belt;
+        int BeltHead = 0;
+        QVector<int> Successors;
+        int Column = -1;
+    };
+
+    struct LocalEvent
+    {
+        double Time;
+        int Unit;
+        bool On;
+    };
+
+    void Step();
+    void Send(int from, int to, double rate);
+    void Interlock(int unit, bool stop);
+
+    QVector<UnitState> Units;
+    QVector<double> Inflow;
+    QVector<double> Carry;
+    QVector<LocalEvent> Events;
+    int NextEvent;
+    double StepSeconds;
+};
+
+CircuitSimulation::CircuitSimulation(const SimulationModel &model, const QVector<int> &units, double stepSeconds,
+                                     QVector<SimulationColumn> &columns)
+    : NextEvent(0)
+    , StepSeconds(stepSeconds)
+{
+    QHash<int, int> member;
+    for (int i = 0; i < units.size(); ++i)
+    {
+        member.insert(units.at(i), i);
+    }
+    QVector<QVector<int>> successors(units.size());
+    QVector<QVector<int>> predecessors(units.size());
+    QVector<int> inDegree(units.size(), 0);
+    for (const QPair<int, int> &flow : model.GetFlows())
+    {
+        if (member.contains(flow.first) && member.contains(flow.second))
+        {
+            int from = member.value(flow.first);
+            int to = member.value(flow.second);
+            successors[from].append(to);
+            predecessors[to].append(from);
+            ++inDegree[to];
+        }
+    }
+
+    // Kahn's order, units left on a loop follow in model order
+    QVector<int> order;
+    QVector<bool> placed(units.size(), false);
+    for (int i = 0; i < units.size(); ++i)
+    {
+        if (inDegree.at(i) == 0)
+        {
+            order.append(i);
+            placed[i] = true;
+        }
+    }
+    for (int next = 0; order.size() < units.size(); ++next)
+    {
+        if (next == order.size())
+        {
+            int unit = int(std::find(placed.begin(), placed.end(), false) - placed.begin());
+            order.append(unit);
+            placed[unit] = true;
+        }
+        for (int to : successors.at(order.at(next)))
+        {
+            if (!placed.at(to) && --inDegree[to] == 0)
+            {
+                order.append(to);
+                placed[to] = true;
+            }
+        }
+    }
+    QVector<int> position(units.size());
+    for (int i = 0; i < order.size(); ++i)
+    {
+        position[order.at(i)] = i;
+    }
+
+    Units.resize(units.size());
+    for (int i = 0; i < order.size(); ++i)
+    {
+        const SimulationModel::Unit &unit = model.GetUnits().at(units.at(order.at(i)));
+        const ParameterBlock &parameters = unit.Parameters;
+        UnitState &state = Units[i];
+        state.Role = parameters.GetSchema().Role;
+        state.EquipmentType = parameters.GetEquipmentType();
+        for (int to : successors.at(order.at(i)))
+        {
+            state.Successors.append(position.at(to));
+        }
+
+        double value = parameters.IsDoubleAssigned(ParameterBlock::Value) ? parameters.GetDouble(ParameterBlock::Value) : 0.0;
+        switch (state.Role)
+        {
+        case EquipmentRole::Feed:
+            state.Rate = qMax(NamedDouble(parameters, "Feed Rate (tph)"), NamedDouble(parameters, "Capacity (tph)"));
+            if (state.Rate <= 0.0)
+            {
+                state.Rate = qMax(value, 0.0);
+            }
+            break;
+        case EquipmentRole::Conveyor:
+        {
+            double speed = NamedDouble(parameters, "Belt Speed (m/s)");
+            double length = NamedDouble(parameters, "Length (m)");
+            int delay = speed > 0.0 ? int(std::lround(length / speed / stepSeconds)) : 0;
+            state.Belt.fill(0.0, delay);
+            break;
+        }
+        case EquipmentRole::Storage:
+            state.Capacity = NamedDouble(parameters, "Capacity (t)");
+            state.Rate = qMax(value, 0.0);
+            break;
+        default:
+            state.Rate = NamedDouble(parameters, "Capacity (tph)");
+            if (state.EquipmentType == SPLIT_TYPE && parameters.IsDoubleAssigned(parameters.DoubleIndex("Split Ratio")))
+            {
+                state.SplitRatio = qBound(0.0, NamedDouble(parameters, "Split Ratio"), 1.0);
+            }
+            break;
+        }
+
+        if (state.Role == EquipmentRole::Storage || state.Successors.isEmpty())
+        {
+            state.Column = columns.size();
+            columns.append({unit.ItemId, unit.Name, state.Role == EquipmentRole::Storage});
+        }
+    }
+
+    // a stopped or full unit stops everything feeding it; a bin or pile on the
+    // way stops discharging and buffers what is above it
+    for (int i = 0; i < Units.size(); ++i)
+    {
+        QVector<bool> seen(Units.size(), false);
+        seen[i] = true;
+        QVector<int> pending = predecessors.at(order.at(i));
+        while (!pending.isEmpty())
+        {
+            int p = position.at(pending.takeLast());
+            if (seen.at(p))
+            {
+                continue;
+            }
+            seen[p] = true;
+            Units[i].Upstream.append(p);
+            if (Units.at(p).Role != EquipmentRole::Storage)
+            {
+                pending += predecessors.at(order.at(p));
+            }
+        }
+    }
+
+    QHash<quint64, int> unitOfItem;
+    for (int i = 0; i < order.size(); ++i)
+    {
+        unitOfItem.insert(model.GetUnits().at(units.at(order.at(i))).ItemId, i);
+    }
+    for (const SimulationEvent &event : model.GetEvents())
+    {
+        if (unitOfItem.contains(event.ItemId))
+        {
+            Events.append({event.Time, unitOfItem.value(event.ItemId), event.On});
+        }
+    }
+    std::stable_sort(Events.begin(), Events.end(), [](const LocalEvent &a, const LocalEvent &b) { return a.Time < b.Time; });
+
+    Inflow.fill(0.0, Units.size());
+    Carry.fill(0.0, Units.size());
+}
+
+void CircuitSimulation::Run(int firstStep, int steps, int stepsPerReport, double *rows, int rowStride)
+{
+    const double reportHours = stepsPerReport * StepSeconds / 3600.0;
+    for (int s = 0; s < steps; ++s)
+    {
+        const double time = (firstStep + s) * StepSeconds;
+        while (NextEvent < Events.size() && Events.at(NextEvent).Time <= time)
+        {
+            UnitState &unit = Units[Events.at(NextEvent).Unit];
+            // a stopped bin or pile keeps filling, it only stops upstream once full
+            if (unit.ScheduledOn != Events.at(NextEvent).On)
+            {
+                unit.ScheduledOn = Events.at(NextEvent).On;
+                if (unit.Role != EquipmentRole::Storage)
+                {
+                    Interlock(Events.at(NextEvent).Unit, !unit.ScheduledOn);
+                }
+            }
+            ++NextEvent;
+        }
+
+        Step();
+
+        if ((s + 1) % stepsPerReport == 0)
+        {
+            double *row = rows + ((s + 1) / stepsPerReport - 1) * rowStride;
+            for (UnitState &unit : Units)
+            {
+                if (unit.Column >= 0)
+                {
+                    row[unit.Column] = unit.Role == EquipmentRole::Storage ? unit.Level : unit.Product / reportHours;
+                    unit.Product = 0.0;
+                }
+            }
+        }
+    }
+}
+
+void CircuitSimulation::Step()
+{
+    const double hours = StepSeconds / 3600.0;
+    Inflow.swap(Carry);
+    Carry.fill(0.0);
+
+    for (int i = 0; i < Units.size(); ++i)
+    {
+        UnitState &unit = Units[i];
+        const double in = Inflow.at(i);
+        Inflow[i] = 0.0;
+        const bool running = unit.ScheduledOn && unit.Interlocks == 0;
+        double out = 0.0;
+
+        switch (unit.Role)
+        {
+        case EquipmentRole::Feed:
+            out = in + (running ? unit.Rate : 0.0);
+            break;
+        case EquipmentRole::Conveyor:
+            // a stopped belt keeps its load, whatever still reaches it waits at the tail
+            if (!running)
+            {
+                unit.Held += in * hours;
+            }
+            else if (unit.Belt.isEmpty())
+            {
+                out = in + unit.Held / hours;
+                unit.Held = 0.0;
+            }
+            else
+            {
+                out = unit.Belt.at(unit.BeltHead);
+                unit.Belt[unit.BeltHead] = in + unit.Held / hours;
+                unit.Held = 0.0;
+                unit.BeltHead = (unit.BeltHead + 1) % unit.Belt.size();
+            }
+            break;
+        case EquipmentRole::Storage:
+        {
+            unit.Level += in * hours;
+            double stock = unit.Level / hours;
+            out = running ? (unit.Rate > 0.0 ? qMin(unit.Rate, stock) : stock) : 0.0;
+            unit.Level = qMax(unit.Level - out * hours, 0.0);
+            if (unit.Capacity > 0.0)
+            {
+                // tripped a step ahead; nothing is spilled, what is already on its way still lands
+                if (!unit.Full && unit.Level + in * hours >= STORAGE_FULL * unit.Capacity)
+                {
+                    unit.Full = true;
+                    Interlock(i, true);
+                }
+                else if (unit.Full && unit.Level <= STORAGE_RESTART * unit.Capacity)
+                {
+                    unit.Full = false;
+                    Interlock(i, false);
+                }
+            }
+            break;
+        }
+        default:
+        {
+            // material beyond the processing limit or arriving while stopped waits in the unit
+            const double available = in + unit.Held / hours;
+            out = running ? (unit.Rate > 0.0 ? qMin(available, unit.Rate) : available) : 0.0;
+            unit.Held = (available - out) * hours;
+            break;
+        }
+        }
+
+        const int outlets = unit.Successors.size();
+        if (outlets == 0)
+        {
+            unit.Product += out * hours;
+        }
+        else if (unit.SplitRatio >= 0.0 && outlets > 1)
+        {
+            Send(i, unit.Successors.first(), out * unit.SplitRatio);
+            for (int k = 1; k < outlets; ++k)
+            {
+                Send(i, unit.Successors.at(k), out * (1.0 - unit.SplitRatio) / (outlets - 1));
+            }
+        }
+        else
+        {
+            for (int to : unit.Successors)
+            {
+                Send(i, to, out / outlets);
+            }
+        }
+    }
+}
+
+void CircuitSimulation::Interlock(int unit, bool stop)
+{
+    for (int up : Units.at(unit).Upstream)
+    {
+        Units[up].Interlocks += stop ? 1 : -1;
+    }
+}
+
+void CircuitSimulation::Send(int from, int to, double rate)
+{
+    if (to > from)
+    {
+        Inflow[to] += rate;
+    }
+    else
+    {
+        Carry[to] += rate;
+    }
+}
+
+DynamicSimulation::DynamicSimulation(const SimulationModel &model, double stepSeconds, double durationSeconds,
+                                     double reportSeconds, QObject *parent)
+    : QObject(parent)
+    , StepSeconds(stepSeconds)
+    , DurationSeconds(durationSeconds)
+    , StepsPerReport(qMax(1, int(std::lround(reportSeconds / stepSeconds))))
+{
+    for (const QVector<int> &circuit : model.Circuits())
+    {
+        Circuits.append(new CircuitSimulation(model, circuit, stepSeconds, Columns));
+    }
+    connect(&Watcher, &QFutureWatcher<QString>::finished, this, &DynamicSimulation::onRunFinished);
+}
+
+DynamicSimulation::~DynamicSimulation()
+{
+    Cancel();
+    Watcher.waitForFinished();
+    qDeleteAll(Circuits);
+}
+
+const QVector<SimulationColumn> &DynamicSimulation::GetColumns() const
+{
+    return Columns;
+}
+
+bool DynamicSimulation::Start(const QString &fileName)
+{
+    if (IsRunning() || Columns.isEmpty())
+    {
+        return false;
+    }
+    Cancelled.store(0);
+    Watcher.setFuture(QtConcurrent::run([this, fileName]() { return Run(fileName); }));
+    return true;
+}
+
+void DynamicSimulation::Cancel()
+{
+    Cancelled.store(1);
+}
+
+bool DynamicSimulation::IsRunning() const
+{
+    return Watcher.isRunning();
+}
+
+QString DynamicSimulation::Run(const QString &fileName)
+{
+    QStringList names("time_s");
+    for (const SimulationColumn &column : Columns)
+    {
+        names.append(column.Name + (column.IsLevel ? " level (t)" : " product (tph)"));
+    }
+    QScopedPointer<ResultWriter> writer(fileName.isEmpty() ? nullptr : ResultWriter::Create(fileName));
+    if (writer && !writer->Open(fileName, names))
+    {
+        return writer->GetErrorString();
+    }
+
+    // rows carry the time in front of the unit columns
+    const int columnCount = Columns.size();
+    const int stride = columnCount + 1;
+    const int totalReports = qMax(1, int(DurationSeconds / (StepsPerReport * StepSeconds)));
+    QVector<double> rows;
+    for (int report = 0; report < totalReports; report += REPORTS_PER_CHUNK)
+    {
+        if (Cancelled.load())
+        {
+            return tr("Simulation cancelled");
+        }
+
+        const int count = qMin(REPORTS_PER_CHUNK, totalReports - report);
+        const int firstStep = report * StepsPerReport;
+        rows.fill(0.0, count * stride);
+        double *data = rows.data() + 1;
+        QtConcurrent::blockingMap(Circuits, [=](CircuitSimulation *circuit) {
+            circuit->Run(firstStep, count * StepsPerReport, StepsPerReport, data, stride);
+        });
+
+        for (int r = 0; r < count; ++r)
+        {
+            rows[r * stride] = (firstStep + (r + 1) * StepsPerReport) * StepSeconds;
+        }
+        if (writer && !writer->WriteRows(rows.constData(), count))
+        {
+            return writer->GetErrorString();
+        }
+        emit Report(rows.at((count - 1) * stride), rows.mid((count - 1) * stride + 1, columnCount));
+    }
+
+    if (writer && !writer->Close())
+    {
+        return writer->GetErrorString();
+    }
+    return QString();
+}
+
+void DynamicSimulation::onRunFinished()
+{
+    QString message = Watcher.result();
+    emit Finished(message.isEmpty(), message);
+}
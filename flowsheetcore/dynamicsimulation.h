@@ -0,0 +1,90 @@
+#ifndef DYNAMICSIMULATION_H
+#define DYNAMICSIMULATION_H
+
+#include <QAtomicInt>
+#include <QFutureWatcher>
+#include <QObject>
+#include <QStringList>
+#include <QVector>
+#include "parameterblock.h"
+
+struct SimulationEvent
+{
+    double Time;    // seconds from the start of the run
+    quint64 ItemId;
+    bool On;
+};
+
+struct SimulationColumn
+{
+    quint64 ItemId;
+    QString Name;
+    bool IsLevel;   // stored tonnes of a bin or pile, otherwise a product rate in tph
+};
+
+// Units and material flows of the plant for the dynamic simulation. Flows run
+// from the unit a line leaves at its output circle to the unit it enters.
+class SimulationModel
+{
+public:
+    struct Unit
+    {
+        quint64 ItemId;
+        QString Name;
+        ParameterBlock Parameters;
+    };
+
+    int AddUnit(quint64 itemId, const QString &name, const ParameterBlock &parameters);
+    void AddFlow(int from, int to);
+    void AddEvent(const SimulationEvent &event);
+
+    const QVector<Unit> &GetUnits() const;
+    const QVector<QPair<int, int>> &GetFlows() const;
+    const QVector<SimulationEvent> &GetEvents() const;
+    // weakly connected groups of units, they share no material and are stepped independently
+    QVector<QVector<int>> Circuits() const;
+
+private:
+    QVector<Unit> Units;
+    QVector<QPair<int, int>> Flows;
+    QVector<SimulationEvent> Events;
+};
+
+class CircuitSimulation;
+
+// Fixed-step run of a model on a worker thread. Circuits are stepped in
+// parallel one report chunk at a time, finished rows go to the result file and
+// the last row of every chunk is published, nothing else is kept.
+class DynamicSimulation : public QObject
+{
+    Q_OBJECT
+public:
+    DynamicSimulation(const SimulationModel &model, double stepSeconds, double durationSeconds,
+                      double reportSeconds, QObject *parent = nullptr);
+    ~DynamicSimulation();
+
+    const QVector<SimulationColumn> &GetColumns() const;
+    bool Start(const QString &fileName);
+    void Cancel();
+    bool IsRunning() const;
+
+signals:
+    void Report(double time, const QVector<double> &row);
+    void Finished(bool completed, const QString &message);
+
+private slots:
+    void onRunFinished();
+
+private:
+    QString Run(const QString &fileName);
+
+    QVector<CircuitSimulation *> Circuits;
+    QVector<SimulationColumn> Columns;
+    double StepSeconds;
+    double DurationSeconds;
+    int StepsPerReport;
+    QAtomicInt Cancelled;
+    QFutureWatcher<QString> Watcher;
+};
+
+#endif // DYNAMICSIMULATION_H
@@ -0,0 +1,142 @@
+#include "equipmentmodel.h"
+#include "compiledflowsheet.h"
+#include "dualnumber.h"
+#include <QDebug>
+#include <QDir>
+#include <QLibrary>
+#include <QPluginLoader>
+
+namespace
+{
+    // what every unit did before models could be plugged in
+    class ArithmeticModel : public EquipmentModel
+    {
+    public:
+        QString Name() const override
+        {
+            return QStringLiteral("built-in");
+        }
+
+        QString Version() const override
+        {
+            return QStringLiteral("1");
+        }
+
+        QVector<int> EquipmentTypes() const override
+        {
+            return QVector<int>();
+        }
+
+        void Evaluate(int, const EquipmentBatch &batch, double *outputs) const override
+        {
+            for (int i = 0; i < batch.Count; ++i)
+            {
+                outputs[i] = Apply(CompiledFlowsheet::Operation(batch.ItemIds[i]), batch.Inlets[i], batch.Units[i]);
+            }
+        }
+
+        // the operations read no parameters, their partials are all 0
+        void Differentiate(int, const EquipmentBatch &batch, double *byInlet, double *byUnit, double *byDoubles) const override
+        {
+            for (int i = 0; i < batch.Count; ++i)
+            {
+                const DualNumber<double> output = Apply(CompiledFlowsheet::Operation(batch.ItemIds[i]),
+                                                        DualNumber<double>::Variable(batch.Inlets[i], 0),
+                                                        DualNumber<double>::Variable(batch.Units[i], 1));
+                byInlet[i] = output.Derivative(0);
+                byUnit[i] = output.Derivative(1);
+            }
+            std::fill(byDoubles, byDoubles + batch.Count * batch.DoubleCount, 0.0);
+        }
+
+    private:
+        template <typename T>
+        static T Apply(int operation, const T &start, const T &end)
+        {
+            switch (operation)
+            {
+            case 1:
+                return start + end;
+            case 2:
+                return start * end;
+            case 3:
+                return start / end;
+            default:
+                return start - end;
+            }
+        }
+    };
+
+    const ArithmeticModel BUILT_IN_MODEL{};
+}
+
+EquipmentModelRegistry::EquipmentModelRegistry()
+{
+}
+
+EquipmentModelRegistry &EquipmentModelRegistry::Instance()
+{
+    static EquipmentModelRegistry registry;
+    return registry;
+}
+
+int EquipmentModelRegistry::LoadPlugins(const QString &directory)
+{
+    QDir dir(directory);
+    int loaded = 0;
+    for (const QString &name : dir.entryList(QDir::Files, QDir::Name))
+    {
+        const QString path = dir.absoluteFilePath(name);
+        if (!QLibrary::isLibrary(path))
+        {
+            continue;
+        }
+        QPluginLoader loader(path);
+        QObject *instance = loader.instance();
+        const EquipmentModel *model = qobject_cast<EquipmentModel *>(instance);
+        if (!model)
+        {
+            qWarning() << "Could not load equipment model" << path
+                       << (instance ? QStringLiteral("does not implement " EquipmentModel_iid) : loader.errorString());
+            continue;
+        }
+        Register(model);
+        ++loaded;
+    }
+    return loaded;
+}
+
+void EquipmentModelRegistry::Register(const EquipmentModel *model)
+{
+    Registered.append(model);
+    for (int equipmentType : model->EquipmentTypes())
+    {
+        const EquipmentModel *owner = Models.value(equipmentType);
+        if (owner)
+        {
+            qWarning() << "Equipment type" << equipmentType << "of" << model->Name() << "is already modelled by" << owner->Name();
+            continue;
+        }
+        Models.insert(equipmentType, model);
+    }
+}
+
+const EquipmentModel *EquipmentModelRegistry::ModelFor(int equipmentType) const
+{
+    return Models.value(equipmentType, &BUILT_IN_MODEL);
+}
+
+const EquipmentModel *EquipmentModelRegistry::BuiltIn() const
+{
+    return &BUILT_IN_MODEL;
+}
+
+QStringList EquipmentModelRegistry::ModelNames() const
+{
+    QStringList names;
+    for (const EquipmentModel *model : Registered)
+    {
+        names.append(model->Name());
+    }
+    return names;
+}
@@ -0,0 +1,137 @@
+#ifndef EQUIPMENTMODEL_H
+#define EQUIPMENTMODEL_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QtPlugin>
+#include <algorithm>
+#include <cmath>
+
+// Every stream entering units of one equipment type, laid out as columns so a
+// model can run over all of them in one tight loop.
+struct EquipmentBatch
+{
+    int Count;
+    // unit each stream enters
+    const quint64 *ItemIds;
+    // value of the unit each stream leaves
+    const double *Inlets;
+    // value of the unit each stream enters
+    const double *Units;
+    // parameters of the unit each stream enters in schema order, those of
+    // stream i start at Doubles + i * DoubleCount; never assigned is NaN.
+    // Slot Value holds the compiled value, Units the one being solved with
+    int DoubleCount;
+    const double *Doubles;
+    // likewise, never assigned is 0
+    int IntCount;
+    const int *Ints;
+};
+
+// Behaviour of one or more equipment types. Plugins implement it and are
+// called once per type and solve with every stream of that type, possibly
+// from several threads at once, so Evaluate must not change the model.
+class EquipmentModel
+{
+public:
+    virtual ~EquipmentModel() {}
+
+    virtual QString Name() const = 0;
+    // changes whenever the results may, cached results of other versions are
+    // recomputed
+    virtual QString Version() const = 0;
+    virtual QVector<int> EquipmentTypes() const = 0;
+    // outputs[i] is what stream i delivers into its unit
+    virtual void Evaluate(int equipmentType, const EquipmentBatch &batch, double *outputs) const = 0;
+
+    // Partials of each output by its inlet and unit value and by every
+    // parameter of its unit, byDoubles laid out like batch.Doubles, used by
+    // the sensitivity analysis. Models that write their arithmetic as a
+    // template over DualNumber get them exactly; this fallback takes central
+    // differences, and parameters never assigned have none.
+    virtual void Differentiate(int equipmentType, const EquipmentBatch &batch,
+                               double *byInlet, double *byUnit, double *byDoubles) const
+    {
+        QVector<double> shifted(batch.Count);
+        QVector<double> up(batch.Count);
+        QVector<double> down(batch.Count);
+        const double *columns[2] = {batch.Inlets, batch.Units};
+        double *partials[2] = {byInlet, byUnit};
+        for (int column = 0; column < 2; ++column)
+        {
+            EquipmentBatch probe = batch;
+            (column == 0 ? probe.Inlets : probe.Units) = shifted.constData();
+            for (int sign = 0; sign < 2; ++sign)
+            {
+                for (int i = 0; i < batch.Count; ++i)
+                {
+                    double step = 1e-6 * qMax(1.0, std::fabs(columns[column][i]));
+                    shifted[i] = columns[column][i] + (sign == 0 ? step : -step);
+                }
+                Evaluate(equipmentType, probe, sign == 0 ? up.data() : down.data());
+            }
+            for (int i = 0; i < batch.Count; ++i)
+            {
+                double step = 1e-6 * qMax(1.0, std::fabs(columns[column][i]));
+                partials[column][i] = (up.at(i) - down.at(i)) / (2.0 * step);
+            }
+        }
+
+        // each output only reads its own stream's parameters, so one column is shifted for all streams at once
+        QVector<double> doubles(batch.Count * batch.DoubleCount);
+        EquipmentBatch probe = batch;
+        probe.Doubles = doubles.constData();
+        for (int parameter = 0; parameter < batch.DoubleCount; ++parameter)
+        {
+            for (int sign = 0; sign < 2; ++sign)
+            {
+                std::copy(batch.Doubles, batch.Doubles + doubles.size(), doubles.begin());
+                for (int i = 0; i < batch.Count; ++i)
+                {
+                    double &value = doubles[i * batch.DoubleCount + parameter];
+                    double step = 1e-6 * qMax(1.0, std::fabs(value));
+                    value += sign == 0 ? step : -step;
+                }
+                Evaluate(equipmentType, probe, sign == 0 ? up.data() : down.data());
+            }
+            for (int i = 0; i < batch.Count; ++i)
+            {
+                const double value = batch.Doubles[i * batch.DoubleCount + parameter];
+                double step = 1e-6 * qMax(1.0, std::fabs(value));
+                byDoubles[i * batch.DoubleCount + parameter] = std::isnan(value) ? 0.0 : (up.at(i) - down.at(i)) / (2.0 * step);
+            }
+        }
+    }
+};
+
+#define EquipmentModel_iid "org.aggflow.EquipmentModel/3.0"
+Q_DECLARE_INTERFACE(EquipmentModel, EquipmentModel_iid)
+
+// Models by equipment type. Types no plugin claims keep the built-in model,
+// the four arithmetic operations picked by the id of the receiving unit.
+// Plugins are loaded at startup and never unloaded, after that the registry
+// is only read and may be used from worker threads.
+class EquipmentModelRegistry
+{
+public:
+    static EquipmentModelRegistry &Instance();
+
+    // loads every plugin in the directory, returns how many models were registered
+    int LoadPlugins(const QString &directory);
+    // not owned; the first model to claim a type keeps it
+    void Register(const EquipmentModel *model);
+
+    const EquipmentModel *ModelFor(int equipmentType) const;
+    const EquipmentModel *BuiltIn() const;
+    QStringList ModelNames() const;
+
+private:
+    EquipmentModelRegistry();
+
+    QHash<int, const EquipmentModel *> Models;
+    QVector<const EquipmentModel *> Registered;
+};
+
+#endif // EQUIPMENTMODEL_H
@@ -0,0 +1,39 @@
+# Flowsheet model, solver, file formats and analysis. Nothing here may pull in
+# gui or widgets, so the core runs headless and in tools without a display.
+QT       = core concurrent xml
+
+TEMPLATE = lib
+CONFIG += staticlib c++11
+TARGET = flowsheetcore
+
+SOURCES += \
+    compiledflowsheet.cpp \
+    dynamicsimulation.cpp \
+    equipmentmodel.cpp \
+    flowsheetmodel.cpp \
+    flowsheetvalidator.cpp \
+    layeredlayout.cpp \
+    memoryaccount.cpp \
+    montecarlo.cpp \
+    parameterblock.cpp \
+    resultcache.cpp \
+    resultwriter.cpp \
+    scenediff.cpp \
+    searchindex.cpp
+
+HEADERS += \
+    compiledflowsheet.h \
+    dualnumber.h \
+    dynamicsimulation.h \
+    equipmentmodel.h \
+    flowsheetmodel.h \
+    flowsheetvalidator.h \
+    itemid.h \
+    layeredlayout.h \
+    memoryaccount.h \
+    montecarlo.h \
+    parameterblock.h \
+    resultcache.h \
+    resultwriter.h \
+    scenediff.h \
+    searchindex.h
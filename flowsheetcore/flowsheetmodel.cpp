@@ -0,0 +1,335 @@
+#include "flowsheetmodel.h"
+#include <algorithm>
+
+bool FlowsheetModel::Connection::operator==(const Connection &other) const
+{
+    return First == other.First && FirstPort == other.FirstPort && Second == other.Second
+            && SecondPort == other.SecondPort && Tear == other.Tear
+            && FirstEval == other.FirstEval && SecondEval == other.SecondEval;
+}
+
+void FlowsheetModel::SetNode(quint64 itemId, const ParameterBlock &parameters)
+{
+    auto row = Rows.constFind(itemId);
+    if (row != Rows.constEnd())
+    {
+        Parameters[row.value()] = parameters;
+        Opaque[row.value()] = false;
+        CachedResults[row.value()] = 0.0;
+        Links.remove(itemId);
+        return;
+    }
+    Rows.insert(itemId, ItemIds.size());
+    ItemIds.append(itemId);
+    Parameters.append(parameters);
+    Opaque.append(false);
+    CachedResults.append(0.0);
+    PortsDirty = true;
+    FlowDirty = true;
+}
+
+void FlowsheetModel::SetGroup(quint64 itemId, const ParameterBlock &parameters, double cachedResult, const QVector<GroupLink> &links)
+{
+    SetNode(itemId, parameters);
+    const int row = Rows.value(itemId);
+    Opaque[row] = true;
+    CachedResults[row] = cachedResult;
+    Links.insert(itemId, links);
+}
+
+void FlowsheetModel::RemoveNode(quint64 itemId)
+{
+    auto row = Rows.find(itemId);
+    if (row == Rows.end())
+    {
+        return;
+    }
+    // backwards, so the row swapped into a gap has been looked at already
+    for (int connection = Connections.size() - 1; connection >= 0; --connection)
+    {
+        if (Connections.at(connection).First == itemId || Connections.at(connection).Second == itemId)
+        {
+            RemoveConnection(ConnectionIds.at(connection));
+        }
+    }
+
+    // the last row fills the gap, so the arrays stay dense
+    const int index = row.value();
+    const int last = ItemIds.size() - 1;
+    Rows.erase(row);
+    Links.remove(itemId);
+    if (index != last)
+    {
+        ItemIds[index] = ItemIds.at(last);
+        Parameters[index] = Parameters.at(last);
+        Opaque[index] = Opaque.at(last);
+        CachedResults[index] = CachedResults.at(last);
+        Rows[ItemIds.at(index)] = index;
+    }
+    ItemIds.removeLast();
+    Parameters.removeLast();
+    Opaque.removeLast();
+    CachedResults.removeLast();
+    PortsDirty = true;
+    FlowDirty = true;
+}
+
+quint64 FlowsheetModel::AddConnection(const Connection &connection)
+{
+    const quint64 connectionId = NextConnectionId++;
+    ConnectionRows.insert(connectionId, Connections.size());
+    Connections.append(connection);
+    ConnectionIds.append(connectionId);
+    PortsDirty = true;
+    FlowDirty = true;
+    return connectionId;
+}
+
+void FlowsheetModel::RemoveConnection(quint64 connectionId)
+{
+    auto row = ConnectionRows.find(connectionId);
+    if (row == ConnectionRows.end())
+    {
+        return;
+    }
+    const int index = row.value();
+    const int last = Connections.size() - 1;
+    ConnectionRows.erase(row);
+    if (index != last)
+    {
+        Connections[index] = Connections.at(last);
+        ConnectionIds[index] = ConnectionIds.at(last);
+        ConnectionRows[ConnectionIds.at(index)] = index;
+    }
+    Connections.removeLast();
+    ConnectionIds.removeLast();
+    PortsDirty = true;
+    FlowDirty = true;
+}
+
+void FlowsheetModel::Clear()
+{
+    ItemIds.clear();
+    Parameters.clear();
+    Opaque.clear();
+    CachedResults.clear();
+    Rows.clear();
+    Links.clear();
+    Connections.clear();
+    ConnectionIds.clear();
+    ConnectionRows.clear();
+    PortsDirty = true;
+    FlowDirty = true;
+}
+
+int FlowsheetModel::NodeCount() const
+{
+    return ItemIds.size();
+}
+
+int FlowsheetModel::NodeOf(quint64 itemId) const
+{
+    return Rows.value(itemId, -1);
+}
+
+quint64 FlowsheetModel::GetItemId(int node) const
+{
+    return ItemIds.at(node);
+}
+
+const ParameterBlock &FlowsheetModel::GetParameters(int node) const
+{
+    return Parameters.at(node);
+}
+
+bool FlowsheetModel::IsOpaque(int node) const
+{
+    return Opaque.at(node);
+}
+
+int FlowsheetModel::ConnectionCount() const
+{
+    return Connections.size();
+}
+
+int FlowsheetModel::ConnectionOf(quint64 connectionId) const
+{
+    return ConnectionRows.value(connectionId, -1);
+}
+
+quint64 FlowsheetModel::GetConnectionId(int connection) const
+{
+    return ConnectionIds.at(connection);
+}
+
+const FlowsheetModel::Connection &FlowsheetModel::GetConnection(int connection) const
+{
+    return Connections.at(connection);
+}
+
+QVector<quint64> FlowsheetModel::ConnectionsAt(quint64 itemId) const
+{
+    QVector<quint64> connectionIds;
+    const int node = NodeOf(itemId);
+    if (node < 0)
+    {
+        return connectionIds;
+    }
+    const Adjacency &ports = PortConnections();
+    const int first = ports.Offsets.at(PortSlot(node, Port::Inlet));
+    const int last = ports.Offsets.at(PortSlot(node, Port::Outlet) + 1);
+    for (int i = first; i < last; ++i)
+    {
+        const quint64 connectionId = ConnectionIds.at(ports.Targets.at(i));
+        // a line from one port of the unit to the other is at both
+        if (!connectionIds.contains(connectionId))
+        {
+            connectionIds.append(connectionId);
+        }
+    }
+    return connectionIds;
+}
+
+const FlowsheetModel::Adjacency &FlowsheetModel::PortConnections() const
+{
+    if (!PortsDirty)
+    {
+        return Ports;
+    }
+
+    const int slotCount = ItemIds.size() * PORTS_PER_NODE;
+    QVector<int> firstSlots(Connections.size(), -1);
+    QVector<int> secondSlots(Connections.size(), -1);
+    Ports.Offsets.fill(0, slotCount + 1);
+    for (int i = 0; i < Connections.size(); ++i)
+    {
+        const Connection &connection = Connections.at(i);
+        int first = NodeOf(connection.First);
+        int second = NodeOf(connection.Second);
+        if (first >= 0)
+        {
+            firstSlots[i] = PortSlot(first, connection.FirstPort);
+            ++Ports.Offsets[firstSlots.at(i) + 1];
+        }
+        // a line from a port back to itself is listed there once
+        if (second >= 0 && PortSlot(second, connection.SecondPort) != firstSlots.at(i))
+        {
+            secondSlots[i] = PortSlot(second, connection.SecondPort);
+            ++Ports.Offsets[secondSlots.at(i) + 1];
+        }
+    }
+    for (int slot = 0; slot < slotCount; ++slot)
+    {
+        Ports.Offsets[slot + 1] += Ports.Offsets.at(slot);
+    }
+
+    QVector<int> next = Ports.Offsets;
+    Ports.Targets.resize(Ports.Offsets.at(slotCount));
+    for (int i = 0; i < Connections.size(); ++i)
+    {
+        for (int slot : {firstSlots.at(i), secondSlots.at(i)})
+        {
+            if (slot >= 0)
+            {
+                Ports.Targets[next[slot]++] = i;
+            }
+        }
+    }
+    PortsDirty = false;
+    return Ports;
+}
+
+const FlowsheetModel::Adjacency &FlowsheetModel::Downstream() const
+{
+    if (!FlowDirty)
+    {
+        return Flow;
+    }
+
+    QVector<QPair<int, int>> flows;
+    flows.reserve(Connections.size());
+    for (const Connection &connection : Connections)
+    {
+        int first = NodeOf(connection.First);
+        int second = NodeOf(connection.Second);
+        if (first < 0 || second < 0)
+        {
+            continue;
+        }
+        bool reversed = connection.SecondPort == Port::Outlet && connection.FirstPort != Port::Outlet;
+        flows.append(reversed ? qMakePair(second, first) : qMakePair(first, second));
+    }
+    // removals reorder the connection rows, sorted rows keep layouts reproducible
+    std::sort(flows.begin(), flows.end());
+
+    Flow.Offsets.fill(0, ItemIds.size() + 1);
+    Flow.Targets.resize(flows.size());
+    for (const QPair<int, int> &flow : flows)
+    {
+        ++Flow.Offsets[flow.first + 1];
+    }
+    for (int row = 0; row < ItemIds.size(); ++row)
+    {
+        Flow.Offsets[row + 1] += Flow.Offsets.at(row);
+    }
+    for (int i = 0; i < flows.size(); ++i)
+    {
+        Flow.Targets[i] = flows.at(i).second;
+    }
+    FlowDirty = false;
+    return Flow;
+}
+
+CompiledFlowsheet FlowsheetModel::Compile() const
+{
+    CompiledFlowsheet flowsheet;
+    // one solver node per unit, and per hidden unit a group's connections are evaluated against
+    QHash<QPair<quint64, quint64>, int> nodes;
+    auto nodeFor = [&](int row, quint64 evalId) {
+        const quint64 itemId = ItemIds.at(row);
+        const QPair<quint64, quint64> key(itemId, evalId);
+        auto it = nodes.constFind(key);
+        if (it != nodes.constEnd())
+        {
+            return it.value();
+        }
+        const ParameterBlock *parameters = &Parameters.at(row);
+        auto links = Links.constFind(itemId);
+        if (evalId != itemId && links != Links.constEnd())
+        {
+            for (const GroupLink &link : links.value())
+            {
+                if (link.EvalItemId == evalId)
+                {
+                    parameters = &link.InnerParameters;
+                    break;
+                }
+            }
+        }
+        int index = flowsheet.AddNode(evalId, *parameters);
+        nodes.insert(key, index);
+        return index;
+    };
+
+    for (const Connection &connection : Connections)
+    {
+        int first = NodeOf(connection.First);
+        int second = NodeOf(connection.Second);
+        if (first < 0 || second < 0)
+        {
+            continue;
+        }
+        int start = nodeFor(first, connection.FirstEval);
+        int end = nodeFor(second, connection.SecondEval);
+        flowsheet.AddEdge(start, end);
+    }
+
+    for (int row = 0; row < ItemIds.size(); ++row)
+    {
+        if (Opaque.at(row))
+        {
+            flowsheet.AddConstant(CachedResults.at(row));
+        }
+    }
+    return flowsheet;
+}
@@ -0,0 +1,108 @@
+#ifndef FLOWSHEETMODEL_H
+#define FLOWSHEETMODEL_H
+
+#include <QHash>
+#include <QPair>
+#include <QVector>
+#include "compiledflowsheet.h"
+#include "parameterblock.h"
+
+// The flowsheet as data: units are rows of parallel arrays, each with an inlet
+// and an outlet port, and connections name the ports they join by item id.
+// This is what the solver, layout and checks read; the editor keeps it up to
+// date edit by edit, paged out units and lines included, and each of its lines
+// holds the id of the connection it draws. Adjacency is compressed on demand
+// and kept until the next edit.
+class FlowsheetModel
+{
+public:
+    // material enters a unit at its inlet (the red start circle) and leaves at its outlet
+    enum class Port : quint8
+    {
+        Inlet,
+        Outlet
+    };
+    static const int PORTS_PER_NODE = 2;
+
+    // Eval ids name the unit the solver evaluates at each end: the unit itself,
+    // or for an end at a collapsed group the hidden unit the line came from.
+    struct Connection
+    {
+        quint64 First;
+        Port FirstPort;
+        quint64 Second;
+        Port SecondPort;
+        bool Tear;
+        quint64 FirstEval;
+        quint64 SecondEval;
+
+        bool operator==(const Connection &other) const;
+    };
+
+    // hidden unit of a collapsed group that a connection to the group is evaluated against
+    struct GroupLink
+    {
+        quint64 EvalItemId;
+        ParameterBlock InnerParameters;
+    };
+
+    // CSR: the entries of slot n are Targets[Offsets[n]] .. Targets[Offsets[n + 1] - 1]
+    struct Adjacency
+    {
+        QVector<int> Offsets;
+        QVector<int> Targets;
+    };
+
+    void SetNode(quint64 itemId, const ParameterBlock &parameters);
+    // collapsed groups are opaque, their contents are not in the model and their cached result stands in for them
+    void SetGroup(quint64 itemId, const ParameterBlock &parameters, double cachedResult, const QVector<GroupLink> &links);
+    // the unit's connections go with it
+    void RemoveNode(quint64 itemId);
+    // the id stays with the connection until it is removed, rows move
+    quint64 AddConnection(const Connection &connection);
+    void RemoveConnection(quint64 connectionId);
+    void Clear();
+
+    int NodeCount() const;
+    int NodeOf(quint64 itemId) const;
+    quint64 GetItemId(int node) const;
+    const ParameterBlock &GetParameters(int node) const;
+    bool IsOpaque(int node) const;
+    int ConnectionCount() const;
+    int ConnectionOf(quint64 connectionId) const;
+    quint64 GetConnectionId(int connection) const;
+    const Connection &GetConnection(int connection) const;
+    // ids of the connections at either port of the unit
+    QVector<quint64> ConnectionsAt(quint64 itemId) const;
+
+    // connections at each port, by slot node * PORTS_PER_NODE + port, as connection rows
+    const Adjacency &PortConnections() const;
+    // connections between units both in the model, from the outlet end however they were drawn
+    const Adjacency &Downstream() const;
+    // connections in row order with both ends in the model, and the cached results of the groups
+    CompiledFlowsheet Compile() const;
+
+private:
+    QVector<quint64> ItemIds;
+    QVector<ParameterBlock> Parameters;
+    QVector<bool> Opaque;
+    QVector<double> CachedResults;
+    QHash<quint64, int> Rows;
+    QHash<quint64, QVector<GroupLink>> Links;
+    // lines drawn twice are two connections
+    QVector<Connection> Connections;
+    QVector<quint64> ConnectionIds;
+    QHash<quint64, int> ConnectionRows;
+    quint64 NextConnectionId = 1;
+    mutable Adjacency Ports;
+    mutable bool PortsDirty = true;
+    mutable Adjacency Flow;
+    mutable bool FlowDirty = true;
+};
+
+inline int PortSlot(int node, FlowsheetModel::Port port)
+{
+    return node * FlowsheetModel::PORTS_PER_NODE + static_cast<int>(port);
+}
+
+#endif // FLOWSHEETMODEL_H
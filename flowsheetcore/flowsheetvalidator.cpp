@@ -0,0 +1,517 @@
+#include "flowsheetvalidator.h"
+#include <QObject>
+
+bool FlowsheetValidator::Edge::operator==(const Edge &other) const
+{
+    return First == other.First && FirstOutput == other.FirstOutput && Second == other.Second
+            && SecondOutput == other.SecondOutput && Tear == other.Tear;
+}
+
+uint qHash(const FlowsheetValidator::Edge &edge, uint seed)
+{
+    uint flags = (edge.FirstOutput ? 1u : 0u) | (edge.SecondOutput ? 2u : 0u) | (edge.Tear ? 4u : 0u);
+    return qHash(qMakePair(edge.First, edge.Second), seed) ^ flags;
+}
+
+void FlowsheetValidator::SetNode(quint64 itemId, const ParameterBlock &parameters, bool opaque)
+{
+    Node &node = Nodes[itemId];
+    const bool wasLive = node.Present;
+    const bool wasSource = IsSource(node);
+    node.Present = true;
+    node.Opaque = opaque;
+    node.Role = parameters.GetSchema().Role;
+    node.MissingParameters.clear();
+    for (int i = 0; i < parameters.DoubleCount() && !opaque; ++i)
+    {
+        if (!parameters.IsDoubleAssigned(i))
+        {
+            node.MissingParameters.append(parameters.GetSchema().DoubleNames.at(i));
+        }
+    }
+    MarkDirty(itemId);
+
+    if (!wasLive)
+    {
+        // connections drawn to the unit while it was out of the scene take effect now
+        const QVector<quint64> downstream = node.UntornDownstream;
+        const QVector<quint64> upstream = node.UntornUpstream;
+        for (quint64 next : downstream)
+        {
+            JoinCycle(itemId, next);
+        }
+        for (quint64 previous : upstream)
+        {
+            JoinCycle(previous, itemId);
+        }
+        SpreadFeed(QVector<quint64>() << itemId);
+    }
+    else if (wasSource != IsSource(node))
+    {
+        WithdrawFeed(QVector<quint64>() << itemId);
+    }
+}
+
+void FlowsheetValidator::RemoveNode(quint64 itemId)
+{
+    auto it = Nodes.find(itemId);
+    if (it == Nodes.end() || !it->Present)
+    {
+        return;
+    }
+    it->Present = false;
+    if (it->Violations)
+    {
+        --ViolatingUnits;
+    }
+    it->Violations = 0;
+    it->Messages.clear();
+    MarkDirty(itemId);
+
+    WithdrawFeed(QVector<quint64>() << itemId);
+    if (Nodes.value(itemId).Cycle)
+    {
+        SplitCycle(Nodes.value(itemId).Cycle);
+    }
+    ReleaseIfUnused(itemId);
+}
+
+void FlowsheetValidator::AddEdge(const Edge &edge)
+{
+    ++Edges[edge];
+    Node &first = Nodes[edge.First];
+    edge.FirstOutput ? ++first.OutletConnections : ++first.InletConnections;
+    Node &second = Nodes[edge.Second];
+    edge.SecondOutput ? ++second.OutletConnections : ++second.InletConnections;
+    MarkDirty(edge.First);
+    MarkDirty(edge.Second);
+
+    if (edge.FirstOutput == edge.SecondOutput)
+    {
+        ++Nodes[edge.First].WrongDirections;
+        ++Nodes[edge.Second].WrongDirections;
+        return;
+    }
+    if (edge.FirstOutput)
+    {
+        ConnectFlow(edge.First, edge.Second, edge.Tear);
+    }
+    else
+    {
+        ConnectFlow(edge.Second, edge.First, edge.Tear);
+    }
+}
+
+void FlowsheetValidator::RemoveEdge(const Edge &edge)
+{
+    auto count = Edges.find(edge);
+    if (count == Edges.end())
+    {
+        return;
+    }
+    if (--count.value() == 0)
+    {
+        Edges.erase(count);
+    }
+
+    Node &first = Nodes[edge.First];
+    edge.FirstOutput ? --first.OutletConnections : --first.InletConnections;
+    Node &second = Nodes[edge.Second];
+    edge.SecondOutput ? --second.OutletConnections : --second.InletConnections;
+    MarkDirty(edge.First);
+    MarkDirty(edge.Second);
+
+    if (edge.FirstOutput == edge.SecondOutput)
+    {
+        --Nodes[edge.First].WrongDirections;
+        --Nodes[edge.Second].WrongDirections;
+    }
+    else if (edge.FirstOutput)
+    {
+        DisconnectFlow(edge.First, edge.Second, edge.Tear);
+    }
+    else
+    {
+        DisconnectFlow(edge.Second, edge.First, edge.Tear);
+    }
+    ReleaseIfUnused(edge.First);
+    ReleaseIfUnused(edge.Second);
+}
+
+void FlowsheetValidator::Clear()
+{
+    for (auto it = Nodes.constBegin(); it != Nodes.constEnd(); ++it)
+    {
+        if (it->Violations)
+        {
+            Dirty.insert(it.key());
+        }
+    }
+    Nodes.clear();
+    Edges.clear();
+    CycleMembers.clear();
+    ViolatingUnits = 0;
+}
+
+QList<quint64> FlowsheetValidator::TakeChanged()
+{
+    QList<quint64> changed;
+    for (quint64 itemId : Dirty)
+    {
+        auto it = Nodes.find(itemId);
+        if (it == Nodes.end())
+        {
+            // released units were cleared when they were removed
+            changed.append(itemId);
+            continue;
+        }
+
+        Node &node = *it;
+        quint32 violations = 0;
+        QStringList messages;
+        if (node.Present && !node.Opaque)
+        {
+            const bool needsInlet = node.Role != EquipmentRole::Feed;
+            const bool needsOutlet = node.Role == EquipmentRole::Feed || node.Role == EquipmentRole::Process
+                    || node.Role == EquipmentRole::Conveyor;
+            if (node.Role == EquipmentRole::Generic)
+            {
+                if (node.InletConnections + node.OutletConnections == 0)
+                {
+                    violations |= DanglingPort;
+                    messages.append(QObject::tr("Not connected"));
+                }
+            }
+            else
+            {
+                if (needsInlet && node.InletConnections == 0)
+                {
+                    violations |= DanglingPort;
+                    messages.append(QObject::tr("Inlet not connected"));
+                }
+                if (needsOutlet && node.OutletConnections == 0)
+                {
+                    violations |= DanglingPort;
+                    messages.append(QObject::tr("Outlet not connected"));
+                }
+            }
+            if (needsInlet && node.InletConnections > 0 && !node.Fed)
+            {
+                violations |= NoFeed;
+                messages.append(QObject::tr("No feed reaches this unit"));
+            }
+            if (node.Cycle)
+            {
+                violations |= UntornCycle;
+                messages.append(QObject::tr("Recycle loop without a tear stream"));
+            }
+            if (node.WrongDirections > 0)
+            {
+                violations |= PortDirection;
+                messages.append(QObject::tr("%1 connection(s) join two inlets or two outlets").arg(node.WrongDirections));
+            }
+            if (!node.MissingParameters.isEmpty())
+            {
+                violations |= MissingParameter;
+                messages.append(QObject::tr("Missing %1").arg(node.MissingParameters.join(", ")));
+            }
+        }
+
+        if (violations != node.Violations || messages != node.Messages || !node.Present)
+        {
+            ViolatingUnits += (violations ? 1 : 0) - (node.Violations ? 1 : 0);
+            node.Violations = violations;
+            node.Messages = messages;
+            changed.append(itemId);
+        }
+    }
+    Dirty.clear();
+    return changed;
+}
+
+quint32 FlowsheetValidator::GetViolations(quint64 itemId) const
+{
+    return Nodes.value(itemId).Violations;
+}
+
+QStringList FlowsheetValidator::GetMessages(quint64 itemId) const
+{
+    return Nodes.value(itemId).Messages;
+}
+
+int FlowsheetValidator::ViolatingUnitCount() const
+{
+    return ViolatingUnits;
+}
+
+bool FlowsheetValidator::IsLive(quint64 itemId) const
+{
+    auto it = Nodes.constFind(itemId);
+    return it != Nodes.constEnd() && it->Present;
+}
+
+bool FlowsheetValidator::IsSource(const Node &node) const
+{
+    return node.Present && (node.Role == EquipmentRole::Feed || node.Opaque);
+}
+
+void FlowsheetValidator::SpreadFeed(const QVector<quint64> &starts)
+{
+    QVector<quint64> queue = starts;
+    while (!queue.isEmpty())
+    {
+        const quint64 itemId = queue.takeLast();
+        auto it = Nodes.find(itemId);
+        if (it == Nodes.end() || !it->Present || it->Fed)
+        {
+            continue;
+        }
+        bool fed = IsSource(*it);
+        for (int i = 0; i < it->Upstream.size() && !fed; ++i)
+        {
+            auto previous = Nodes.constFind(it->Upstream.at(i));
+            fed = previous != Nodes.constEnd() && previous->Present && previous->Fed;
+        }
+        if (fed)
+        {
+            it->Fed = true;
+            MarkDirty(itemId);
+            queue += it->Downstream;
+        }
+    }
+}
+
+// reachability is not a fixed point: a loop must not keep itself fed, so the
+// units below the change are cleared and fed again from what is left upstream
+void FlowsheetValidator::WithdrawFeed(const QVector<quint64> &starts)
+{
+    QVector<quint64> queue = starts;
+    QVector<quint64> region;
+    while (!queue.isEmpty())
+    {
+        const quint64 itemId = queue.takeLast();
+        auto it = Nodes.find(itemId);
+        if (it == Nodes.end() || !it->Fed)
+        {
+            continue;
+        }
+        it->Fed = false;
+        MarkDirty(itemId);
+        region.append(itemId);
+        queue += it->Downstream;
+    }
+    SpreadFeed(region + starts);
+}
+
+QVector<quint64> FlowsheetValidator::Reach(quint64 start, bool downstream) const
+{
+    QVector<quint64> reached;
+    QSet<quint64> seen;
+    QVector<quint64> queue(1, start);
+    while (!queue.isEmpty())
+    {
+        const quint64 itemId = queue.takeLast();
+        auto it = Nodes.constFind(itemId);
+        if (it == Nodes.constEnd() || !it->Present || seen.contains(itemId))
+        {
+            continue;
+        }
+        seen.insert(itemId);
+        reached.append(itemId);
+        queue += downstream ? it->UntornDownstream : it->UntornUpstream;
+    }
+    return reached;
+}
+
+void FlowsheetValidator::JoinCycle(quint64 from, quint64 to)
+{
+    if (!IsLive(from) || !IsLive(to))
+    {
+        return;
+    }
+    const int cycle = Nodes.value(from).Cycle;
+    if (from != to && cycle && cycle == Nodes.value(to).Cycle)
+    {
+        return;
+    }
+
+    // the new connection closes a loop when it can get back to where it starts
+    const QVector<quint64> forward = Reach(to, true);
+    QSet<quint64> ahead;
+    for (quint64 itemId : forward)
+    {
+        ahead.insert(itemId);
+    }
+    if (!ahead.contains(from))
+    {
+        return;
+    }
+
+    const int joined = NextCycle++;
+    QVector<quint64> &members = CycleMembers[joined];
+    for (quint64 itemId : Reach(from, false))
+    {
+        if (ahead.contains(itemId))
+        {
+            // loops met on the way are absorbed whole
+            CycleMembers.remove(Nodes.value(itemId).Cycle);
+            members.append(itemId);
+        }
+    }
+    for (quint64 itemId : members)
+    {
+        SetCycle(itemId, joined);
+    }
+}
+
+// Tarjan's algorithm over the members of the broken loop only
+void FlowsheetValidator::SplitCycle(int cycle)
+{
+    const QVector<quint64> members = CycleMembers.take(cycle);
+    auto inCycle = [&](quint64 itemId) {
+        auto it = Nodes.constFind(itemId);
+        return it != Nodes.constEnd() && it->Present && it->Cycle == cycle;
+    };
+
+    struct Frame
+    {
+        quint64 ItemId;
+        int Next;
+    };
+    QHash<quint64, int> index;
+    QHash<quint64, int> low;
+    QVector<quint64> stack;
+    QSet<quint64> onStack;
+    int counter = 0;
+    QVector<quint64> found;
+    QVector<QVector<quint64>> loops;
+    for (quint64 root : members)
+    {
+        if (!inCycle(root) || index.contains(root))
+        {
+            continue;
+        }
+        QVector<Frame> frames;
+        frames.append({root, 0});
+        index[root] = low[root] = counter++;
+        stack.append(root);
+        onStack.insert(root);
+        while (!frames.isEmpty())
+        {
+            const quint64 itemId = frames.last().ItemId;
+            const QVector<quint64> &next = Nodes[itemId].UntornDownstream;
+            if (frames.last().Next < next.size())
+            {
+                const quint64 target = next.at(frames.last().Next++);
+                if (!inCycle(target))
+                {
+                    continue;
+                }
+                if (!index.contains(target))
+                {
+                    index[target] = low[target] = counter++;
+                    stack.append(target);
+                    onStack.insert(target);
+                    frames.append({target, 0});
+                }
+                else if (onStack.contains(target))
+                {
+                    low[itemId] = qMin(low.value(itemId), index.value(target));
+                }
+                continue;
+            }
+
+            frames.removeLast();
+            if (!frames.isEmpty())
+            {
+                const quint64 parent = frames.last().ItemId;
+                low[parent] = qMin(low.value(parent), low.value(itemId));
+            }
+            if (low.value(itemId) != index.value(itemId))
+            {
+                continue;
+            }
+            found.clear();
+            quint64 member;
+            do
+            {
+                member = stack.takeLast();
+                onStack.remove(member);
+                found.append(member);
+            } while (member != itemId);
+            // ids change only after the walk, inCycle still has to see the old one
+            if (found.size() > 1 || Nodes.value(itemId).UntornDownstream.contains(itemId))
+            {
+                loops.append(found);
+            }
+        }
+    }
+
+    for (quint64 itemId : members)
+    {
+        SetCycle(itemId, 0);
+    }
+    for (const QVector<quint64> &loop : loops)
+    {
+        const int split = NextCycle++;
+        CycleMembers.insert(split, loop);
+        for (quint64 itemId : loop)
+        {
+            SetCycle(itemId, split);
+        }
+    }
+}
+
+void FlowsheetValidator::SetCycle(quint64 itemId, int cycle)
+{
+    auto it = Nodes.find(itemId);
+    if (it != Nodes.end() && it->Cycle != cycle)
+    {
+        it->Cycle = cycle;
+        MarkDirty(itemId);
+    }
+}
+
+void FlowsheetValidator::ConnectFlow(quint64 from, quint64 to, bool tear)
+{
+    Nodes[from].Downstream.append(to);
+    Nodes[to].Upstream.append(from);
+    if (!tear)
+    {
+        Nodes[from].UntornDownstream.append(to);
+        Nodes[to].UntornUpstream.append(from);
+        JoinCycle(from, to);
+    }
+    SpreadFeed(QVector<quint64>() << to);
+}
+
+void FlowsheetValidator::DisconnectFlow(quint64 from, quint64 to, bool tear)
+{
+    Nodes[from].Downstream.removeOne(to);
+    Nodes[to].Upstream.removeOne(from);
+    if (!tear)
+    {
+        Nodes[from].UntornDownstream.removeOne(to);
+        Nodes[to].UntornUpstream.removeOne(from);
+        const int cycle = Nodes.value(from).Cycle;
+        if (cycle && cycle == Nodes.value(to).Cycle)
+        {
+            SplitCycle(cycle);
+        }
+    }
+    WithdrawFeed(QVector<quint64>() << to);
+}
+
+void FlowsheetValidator::MarkDirty(quint64 itemId)
+{
+    Dirty.insert(itemId);
+}
+
+void FlowsheetValidator::ReleaseIfUnused(quint64 itemId)
+{
+    auto it = Nodes.find(itemId);
+    if (it != Nodes.end() && !it->Present && it->InletConnections + it->OutletConnections == 0)
+    {
+        Nodes.erase(it);
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef FLOWSHEETVALIDATOR_H
+#define FLOWSHEETVALIDATOR_H
+
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+#include "parameterblock.h"
+
+// Rule state of the flowsheet kept up to date edit by edit. Units are known by
+// item id and connections by the circles they join, so the validator outlives
+// the items of paged out units. Feed reachability and untorn cycles are
+// repaired around the changed connection only: an edit costs the units
+// downstream of it, or the cycle it was part of, never the whole plant.
+class FlowsheetValidator
+{
+public:
+    enum Rule
+    {
+        DanglingPort = 0x01,
+        NoFeed = 0x02,
+        UntornCycle = 0x04,
+        PortDirection = 0x08,
+        MissingParameter = 0x10
+    };
+
+    // a connection as drawn: output is the blue end circle material leaves by
+    struct Edge
+    {
+        quint64 First;
+        bool FirstOutput;
+        quint64 Second;
+        bool SecondOutput;
+        bool Tear;
+
+        bool operator==(const Edge &other) const;
+    };
+
+    // groups hide their contents, they are taken as fed and are not checked themselves
+    void SetNode(quint64 itemId, const ParameterBlock &parameters, bool opaque = false);
+    void RemoveNode(quint64 itemId);
+    void AddEdge(const Edge &edge);
+    void RemoveEdge(const Edge &edge);
+    void Clear();
+
+    // units whose violations changed since the last call
+    QList<quint64> TakeChanged();
+    quint32 GetViolations(quint64 itemId) const;
+    QStringList GetMessages(quint64 itemId) const;
+    int ViolatingUnitCount() const;
+
+private:
+    struct Node
+    {
+        bool Present = false;
+        bool Opaque = false;
+        EquipmentRole Role = EquipmentRole::Generic;
+        QStringList MissingParameters;
+        int InletConnections = 0;
+        int OutletConnections = 0;
+        int WrongDirections = 0;
+        // flow adjacency, one entry per connection; untorn lists leave out tear streams
+        QVector<quint64> Downstream;
+        QVector<quint64> Upstream;
+        QVector<quint64> UntornDownstream;
+        QVector<quint64> UntornUpstream;
+        bool Fed = false;
+        int Cycle = 0;
+        quint32 Violations = 0;
+        QStringList Messages;
+    };
+
+    bool IsLive(quint64 itemId) const;
+    bool IsSource(const Node &node) const;
+    void SpreadFeed(const QVector<quint64> &starts);
+    void WithdrawFeed(const QVector<quint64> &starts);
+    QVector<quint64> Reach(quint64 start, bool downstream) const;
+    void JoinCycle(quint64 from, quint64 to);
+    void SplitCycle(int cycle);
+    void SetCycle(quint64 itemId, int cycle);
+    void ConnectFlow(quint64 from, quint64 to, bool tear);
+    void DisconnectFlow(quint64 from, quint64 to, bool tear);
+    void MarkDirty(quint64 itemId);
+    void ReleaseIfUnused(quint64 itemId);
+
+    QHash<quint64, Node> Nodes;
+    QHash<Edge, int> Edges;
+    QHash<int, QVector<quint64>> CycleMembers;
+    int NextCycle = 1;
+    QSet<quint64> Dirty;
+    int ViolatingUnits = 0;
+};
+
+uint qHash(const FlowsheetValidator::Edge &edge, uint seed = 0);
+
+#endif // FLOWSHEETVALIDATOR_H
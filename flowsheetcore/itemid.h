@@ -0,0 +1,22 @@
+#ifndef ITEMID_H
+#define ITEMID_H
+
+#include <QDataStream>
+
+// Unit ids are 64 bit from scene format 6 on, older records hold 32 bit ones.
+const qint32 WIDE_ITEM_ID_VERSION = 6;
+
+inline quint64 ReadItemId(QDataStream &in, int version)
+{
+    if (version >= WIDE_ITEM_ID_VERSION)
+    {
+        quint64 itemId = 0;
+        in >> itemId;
+        return itemId;
+    }
+    qint32 itemId = 0;
+    in >> itemId;
+    return quint64(quint32(itemId));
+}
+
+#endif // ITEMID_H
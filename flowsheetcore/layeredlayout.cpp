@@ -0,0 +1,244 @@
+#include "layeredlayout.h"
+#include <QtConcurrent>
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    // reverses the back edges found by an iterative depth first search
+    std::vector<QPair<int, int>> BreakCycles(int nodeCount, const QVector<QPair<int, int>> &edges)
+    {
+        std::vector<std::vector<int>> out(nodeCount);
+        for (int e = 0; e < edges.size(); ++e)
+        {
+            out[edges.at(e).first].push_back(e);
+        }
+
+        std::vector<char> state(nodeCount, 0);
+        std::vector<char> reversed(edges.size(), 0);
+        std::vector<QPair<int, int>> stack;
+        for (int root = 0; root < nodeCount; ++root)
+        {
+            if (state[root])
+            {
+                continue;
+            }
+            state[root] = 1;
+            stack.push_back(qMakePair(root, 0));
+            while (!stack.empty())
+            {
+                QPair<int, int> &top = stack.back();
+                const std::vector<int> &adj = out[top.first];
+                if (top.second == int(adj.size()))
+                {
+                    state[top.first] = 2;
+                    stack.pop_back();
+                    continue;
+                }
+                int e = adj[top.second++];
+                int next = edges.at(e).second;
+                if (state[next] == 1)
+                {
+                    reversed[e] = 1;
+                }
+                else if (state[next] == 0)
+                {
+                    state[next] = 1;
+                    stack.push_back(qMakePair(next, 0));
+                }
+            }
+        }
+
+        std::vector<QPair<int, int>> dag;
+        dag.reserve(edges.size());
+        for (int e = 0; e < edges.size(); ++e)
+        {
+            const QPair<int, int> &edge = edges.at(e);
+            if (edge.first == edge.second)
+            {
+                continue;
+            }
+            dag.push_back(reversed[e] ? qMakePair(edge.second, edge.first) : edge);
+        }
+        return dag;
+    }
+
+    // longest path layering, sources end up in layer 0
+    std::vector<int> AssignLayers(int nodeCount, const std::vector<QPair<int, int>> &dag)
+    {
+        std::vector<std::vector<int>> out(nodeCount);
+        std::vector<int> inDegree(nodeCount, 0);
+        for (const QPair<int, int> &edge : dag)
+        {
+            out[edge.first].push_back(edge.second);
+            ++inDegree[edge.second];
+        }
+
+        std::vector<int> layer(nodeCount, 0);
+        std::vector<int> ready;
+        for (int v = 0; v < nodeCount; ++v)
+        {
+            if (inDegree[v] == 0)
+            {
+                ready.push_back(v);
+            }
+        }
+        while (!ready.empty())
+        {
+            int v = ready.back();
+            ready.pop_back();
+            for (int next : out[v])
+            {
+                layer[next] = std::max(layer[next], layer[v] + 1);
+                if (--inDegree[next] == 0)
+                {
+                    ready.push_back(next);
+                }
+            }
+        }
+        return layer;
+    }
+
+    struct LayeredGraph
+    {
+        std::vector<int> Layer;
+        std::vector<std::vector<int>> Up;
+        std::vector<std::vector<int>> Down;
+        std::vector<std::vector<int>> Layers;
+        std::vector<int> Position;
+    };
+
+    void SortLayer(LayeredGraph &graph, int layerIndex, bool useUp)
+    {
+        std::vector<int> &layer = graph.Layers[layerIndex];
+        std::vector<QPair<double, int>> keyed;
+        keyed.reserve(layer.size());
+        for (int v : layer)
+        {
+            const std::vector<int> &neighbours = useUp ? graph.Up[v] : graph.Down[v];
+            double barycenter = graph.Position[v];
+            if (!neighbours.empty())
+            {
+                double sum = 0;
+                for (int n : neighbours)
+                {
+                    sum += graph.Position[n];
+                }
+                barycenter = sum / neighbours.size();
+            }
+            keyed.push_back(qMakePair(barycenter, v));
+        }
+        std::stable_sort(keyed.begin(), keyed.end(), [](const QPair<double, int> &a, const QPair<double, int> &b) {
+            return a.first < b.first;
+        });
+        for (int i = 0; i < int(keyed.size()); ++i)
+        {
+            layer[i] = keyed[i].second;
+            graph.Position[layer[i]] = i;
+        }
+    }
+
+    // a layer only reads the positions of its neighbour layers, so all layers
+    // of the same parity can be reordered at the same time
+    void ParallelSweep(LayeredGraph &graph, bool useUp)
+    {
+        for (int parity = 0; parity < 2; ++parity)
+        {
+            QVector<int> layerIndices;
+            for (int l = parity; l < int(graph.Layers.size()); l += 2)
+            {
+                layerIndices.append(l);
+            }
+            QtConcurrent::blockingMap(layerIndices, [&graph, useUp](int &l) {
+                SortLayer(graph, l, useUp);
+            });
+        }
+    }
+}
+
+QVector<QPointF> ComputeLayeredLayout(int nodeCount, const QVector<QPair<int, int>> &edges,
+                                      const QSizeF &spacing, int sweeps)
+{
+    std::vector<QPair<int, int>> dag = BreakCycles(nodeCount, edges);
+    std::vector<int> nodeLayer = AssignLayers(nodeCount, dag);
+
+    // split edges spanning several layers with dummy vertices so crossing
+    // reduction sees them
+    LayeredGraph graph;
+    graph.Layer = nodeLayer;
+    graph.Up.resize(nodeCount);
+    graph.Down.resize(nodeCount);
+    for (const QPair<int, int> &edge : dag)
+    {
+        int from = edge.first;
+        for (int l = nodeLayer[edge.first] + 1; l < nodeLayer[edge.second]; ++l)
+        {
+            int dummy = int(graph.Layer.size());
+            graph.Layer.push_back(l);
+            graph.Up.push_back(std::vector<int>(1, from));
+            graph.Down.push_back(std::vector<int>());
+            graph.Down[from].push_back(dummy);
+            from = dummy;
+        }
+        graph.Down[from].push_back(edge.second);
+        graph.Up[edge.second].push_back(from);
+    }
+
+    const int vertexCount = int(graph.Layer.size());
+    int layerCount = 0;
+    for (int l : graph.Layer)
+    {
+        layerCount = std::max(layerCount, l + 1);
+    }
+
+    // initial order from a depth first walk keeps connected units together
+    graph.Layers.resize(layerCount);
+    graph.Position.assign(vertexCount, 0);
+    std::vector<char> placed(vertexCount, 0);
+    std::vector<int> stack;
+    for (int root = 0; root < vertexCount; ++root)
+    {
+        if (placed[root] || !graph.Up[root].empty())
+        {
+            continue;
+        }
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            int v = stack.back();
+            stack.pop_back();
+            if (placed[v])
+            {
+                continue;
+            }
+            placed[v] = 1;
+            graph.Position[v] = int(graph.Layers[graph.Layer[v]].size());
+            graph.Layers[graph.Layer[v]].push_back(v);
+            for (auto it = graph.Down[v].rbegin(); it != graph.Down[v].rend(); ++it)
+            {
+                stack.push_back(*it);
+            }
+        }
+    }
+
+    for (int i = 0; i < sweeps; ++i)
+    {
+        ParallelSweep(graph, true);
+        ParallelSweep(graph, false);
+    }
+
+    size_t widest = 0;
+    for (const std::vector<int> &layer : graph.Layers)
+    {
+        widest = std::max(widest, layer.size());
+    }
+
+    QVector<QPointF> positions(nodeCount);
+    for (int v = 0; v < nodeCount; ++v)
+    {
+        const int l = graph.Layer[v];
+        const double offset = (double(widest) - graph.Layers[l].size()) / 2.0;
+        positions[v] = QPointF(l * spacing.width(), (graph.Position[v] + offset) * spacing.height());
+    }
+    return positions;
+}
@@ -0,0 +1,15 @@
+#ifndef LAYEREDLAYOUT_H
+#define LAYEREDLAYOUT_H
+
+#include <QPair>
+#include <QPointF>
+#include <QSizeF>
+#include <QVector>
+
+// Sugiyama style layout: flow runs left to right, one column per layer.
+// Edges are (from, to) node indices, cycles are allowed. Crossing reduction
+// works on alternating odd/even layers so each half-sweep runs in parallel.
+QVector<QPointF> ComputeLayeredLayout(int nodeCount, const QVector<QPair<int, int>> &edges,
+                                      const QSizeF &spacing, int sweeps = 8);
+
+#endif // LAYEREDLAYOUT_H
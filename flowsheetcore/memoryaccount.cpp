@@ -0,0 +1,141 @@
+#include "memoryaccount.h"
+#include <QAtomicInteger>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+namespace
+{
+    QAtomicInteger<qint64> CHARGED_BYTES[MemoryAccount::CategoryCount];
+    QAtomicInteger<qint64> CHARGED_OBJECTS[MemoryAccount::CategoryCount];
+
+    const char *CATEGORY_NAMES[MemoryAccount::CategoryCount] = {
+        "units", "unit_widgets", "unit_pixmaps", "lines", "undo_history",
+        "paged_records", "telemetry_history", "cached_results", "solver_buffers"
+    };
+}
+
+void MemoryAccount::Charge(Category category, qint64 bytes, int objects)
+{
+    CHARGED_BYTES[category].fetchAndAddRelaxed(bytes);
+    if (objects != 0)
+    {
+        CHARGED_OBJECTS[category].fetchAndAddRelaxed(objects);
+    }
+}
+
+qint64 MemoryAccount::Bytes(Category category)
+{
+    return CHARGED_BYTES[category].loadAcquire();
+}
+
+qint64 MemoryAccount::Objects(Category category)
+{
+    return CHARGED_OBJECTS[category].loadAcquire();
+}
+
+qint64 MemoryAccount::TotalBytes()
+{
+    qint64 total = 0;
+    for (int category = 0; category < CategoryCount; ++category)
+    {
+        total += Bytes(Category(category));
+    }
+    return total;
+}
+
+QString MemoryAccount::Name(Category category)
+{
+    return QString::fromLatin1(CATEGORY_NAMES[category]);
+}
+
+qint64 MemoryAccount::ResidentBytes()
+{
+#ifdef Q_OS_LINUX
+    // second field of statm is the resident set in pages
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly))
+    {
+        return -1;
+    }
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    bool ok = false;
+    const qint64 pages = fields.size() > 1 ? fields.at(1).toLongLong(&ok) : 0;
+    return ok ? pages * sysconf(_SC_PAGESIZE) : -1;
+#else
+    return -1;
+#endif
+}
+
+QByteArray MemoryAccount::ToJson()
+{
+    QJsonArray categories;
+    for (int category = 0; category < CategoryCount; ++category)
+    {
+        QJsonObject entry;
+        entry["name"] = Name(Category(category));
+        entry["objects"] = Objects(Category(category));
+        entry["bytes"] = Bytes(Category(category));
+        categories.append(entry);
+    }
+    QJsonObject report;
+    report["categories"] = categories;
+    report["accounted_bytes"] = TotalBytes();
+    report["resident_bytes"] = ResidentBytes();
+    return QJsonDocument(report).toJson();
+}
+
+MemoryCharge::MemoryCharge(MemoryAccount::Category category, qint64 bytes, int objects)
+    : Category(category), ChargedBytes(bytes), ChargedObjects(objects)
+{
+    MemoryAccount::Charge(Category, ChargedBytes, ChargedObjects);
+}
+
+MemoryCharge::MemoryCharge(const MemoryCharge &other)
+    : MemoryCharge(other.Category, other.ChargedBytes, other.ChargedObjects)
+{
+}
+
+MemoryCharge &MemoryCharge::operator=(const MemoryCharge &other)
+{
+    if (this != &other)
+    {
+        MemoryAccount::Charge(Category, -ChargedBytes, -ChargedObjects);
+        Category = other.Category;
+        ChargedBytes = other.ChargedBytes;
+        ChargedObjects = other.ChargedObjects;
+        MemoryAccount::Charge(Category, ChargedBytes, ChargedObjects);
+    }
+    return *this;
+}
+
+MemoryCharge::~MemoryCharge()
+{
+    MemoryAccount::Charge(Category, -ChargedBytes, -ChargedObjects);
+}
+
+void MemoryCharge::Set(qint64 bytes)
+{
+    Set(bytes, ChargedObjects);
+}
+
+void MemoryCharge::Set(qint64 bytes, int objects)
+{
+    MemoryAccount::Charge(Category, bytes - ChargedBytes, objects - ChargedObjects);
+    ChargedBytes = bytes;
+    ChargedObjects = objects;
+}
+
+void MemoryCharge::Add(qint64 bytes, int objects)
+{
+    Set(ChargedBytes + bytes, ChargedObjects + objects);
+}
+
+qint64 MemoryCharge::Get() const
+{
+    return ChargedBytes;
+}
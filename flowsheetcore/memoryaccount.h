@@ -0,0 +1,63 @@
+#ifndef MEMORYACCOUNT_H
+#define MEMORYACCOUNT_H
+
+#include <QByteArray>
+#include <QString>
+
+// Running totals of what each part of the application holds. Objects and
+// bytes are charged by the owners themselves, so the figures are what the
+// code accounts for: shallow object sizes and the payload of the containers
+// and images behind them, not allocator overhead or Qt's private data.
+// Totals are atomic and may be charged from worker threads.
+class MemoryAccount
+{
+public:
+    enum Category
+    {
+        Units,
+        UnitWidgets,
+        UnitPixmaps,
+        Lines,
+        UndoHistory,
+        PagedRecords,
+        TelemetryHistory,
+        CachedResults,
+        SolverBuffers,
+        CategoryCount
+    };
+
+    static void Charge(Category category, qint64 bytes, int objects = 0);
+    static qint64 Bytes(Category category);
+    static qint64 Objects(Category category);
+    static qint64 TotalBytes();
+    static QString Name(Category category);
+
+    // resident set of the process as the kernel reports it, -1 where it cannot be read
+    static qint64 ResidentBytes();
+    // the totals and the resident set as JSON, for tools comparing runs
+    static QByteArray ToJson();
+};
+
+// Holds a charge for as long as it lives. Owners keep one as a member, so an
+// instance is counted on construction and refunded on destruction whatever
+// path deletes it; a copy charges again, as a detached copy of the data would.
+class MemoryCharge
+{
+public:
+    explicit MemoryCharge(MemoryAccount::Category category, qint64 bytes = 0, int objects = 0);
+    MemoryCharge(const MemoryCharge &other);
+    MemoryCharge &operator=(const MemoryCharge &other);
+    ~MemoryCharge();
+
+    void Set(qint64 bytes);
+    void Set(qint64 bytes, int objects);
+    void Add(qint64 bytes, int objects = 0);
+    qint64 Get() const;
+
+private:
+    MemoryAccount::Category Category;
+    qint64 ChargedBytes;
+    int ChargedObjects;
+};
+
+#endif // MEMORYACCOUNT_H
@@ -0,0 +1,352 @@
+#include "montecarlo.h"
+#include "memoryaccount.h"
+#include <QStringList>
+#include <QThread>
+#include <QtConcurrent>
+#include <QtNumeric>
+#include <cmath>
+#include <limits>
+#include <random>
+
+namespace
+{
+    const int CHUNK_SAMPLES = 1024;
+    const int CHUNKS_PER_THREAD = 4;
+    // buckets grow by 1 %, their midpoint is within half a percent of any sample in them
+    const double LOG_GROWTH = std::log1p(0.01);
+    const double MIN_MAGNITUDE = 1e-9;
+    const int BUCKET_BIAS = 100000;
+
+    // keys sort in the same order as the values they hold, 0 is the bucket around zero
+    int BucketOf(double value)
+    {
+        double magnitude = std::fabs(value);
+        if (magnitude < MIN_MAGNITUDE)
+        {
+            return 0;
+        }
+        int index = qBound(1 - BUCKET_BIAS, int(std::floor(std::log(magnitude) / LOG_GROWTH)), BUCKET_BIAS - 1);
+        return value > 0 ? index + BUCKET_BIAS : -(index + BUCKET_BIAS);
+    }
+
+    double BucketValue(int key)
+    {
+        if (key == 0)
+        {
+            return 0.0;
+        }
+        double magnitude = std::exp((std::abs(key) - BUCKET_BIAS + 0.5) * LOG_GROWTH);
+        return key > 0 ? magnitude : -magnitude;
+    }
+
+    // feed rates are never negative, a wide normal is truncated at zero
+    double Draw(const FeedDistribution &distribution, std::mt19937_64 &generator)
+    {
+        const double a = distribution.A;
+        const double b = distribution.B;
+        const double c = distribution.C;
+        double value = a;
+        switch (distribution.Kind)
+        {
+        case FeedDistribution::Normal:
+            if (b > 0.0)
+            {
+                value = std::normal_distribution<double>(a, b)(generator);
+            }
+            break;
+        case FeedDistribution::Uniform:
+            if (b > a)
+            {
+                value = std::uniform_real_distribution<double>(a, b)(generator);
+            }
+            break;
+        case FeedDistribution::Triangular:
+            if (c > a)
+            {
+                double u = std::uniform_real_distribution<double>(0.0, 1.0)(generator);
+                value = u < (b - a) / (c - a) ? a + std::sqrt(u * (c - a) * (b - a))
+                                              : c - std::sqrt((1.0 - u) * (c - a) * (c - b));
+            }
+            break;
+        }
+        return qMax(value, 0.0);
+    }
+}
+
+bool FeedDistribution::Parse(const QString &line, FeedDistribution &distribution)
+{
+    QStringList fields = line.split(',');
+    if (fields.size() < 4)
+    {
+        return false;
+    }
+    bool ok = true;
+    auto number = [&](int field) {
+        bool fieldOk = false;
+        double value = fields.value(field).trimmed().toDouble(&fieldOk);
+        ok = ok && fieldOk;
+        return value;
+    };
+
+    distribution.ItemId = fields.at(0).trimmed().toULongLong(&ok);
+    QString shape = fields.at(1).trimmed().toLower();
+    distribution.A = number(2);
+    distribution.B = number(3);
+    distribution.C = 0.0;
+    if (shape == "normal" && fields.size() == 4)
+    {
+        distribution.Kind = Normal;
+        return ok && distribution.B >= 0.0;
+    }
+    if (shape == "uniform" && fields.size() == 4)
+    {
+        distribution.Kind = Uniform;
+        return ok && distribution.A <= distribution.B;
+    }
+    if (shape == "triangular" && fields.size() == 5)
+    {
+        distribution.Kind = Triangular;
+        distribution.C = number(4);
+        return ok && distribution.A <= distribution.B && distribution.B <= distribution.C;
+    }
+    return false;
+}
+
+QString FeedDistribution::ToString() const
+{
+    switch (Kind)
+    {
+    case Uniform:
+        return QString("%1,uniform,%2,%3").arg(ItemId).arg(A).arg(B);
+    case Triangular:
+        return QString("%1,triangular,%2,%3,%4").arg(ItemId).arg(A).arg(B).arg(C);
+    default:
+        return QString("%1,normal,%2,%3").arg(ItemId).arg(A).arg(B);
+    }
+}
+
+void StreamingStatistics::Add(double value, bool inSpecification)
+{
+    if (!qIsFinite(value))
+    {
+        ++NonFinite;
+        return;
+    }
+    ++Count;
+    if (inSpecification)
+    {
+        ++InSpecification;
+    }
+    Min = Count == 1 ? value : qMin(Min, value);
+    Max = Count == 1 ? value : qMax(Max, value);
+    double delta = value - Mean;
+    Mean += delta / Count;
+    M2 += delta * (value - Mean);
+    ++Buckets[BucketOf(value)];
+}
+
+void StreamingStatistics::Merge(const StreamingStatistics &other)
+{
+    NonFinite += other.NonFinite;
+    if (other.Count == 0)
+    {
+        return;
+    }
+    if (Count == 0)
+    {
+        quint64 nonFinite = NonFinite;
+        *this = other;
+        NonFinite = nonFinite;
+        return;
+    }
+
+    const double total = double(Count + other.Count);
+    const double delta = other.Mean - Mean;
+    Mean += delta * other.Count / total;
+    M2 += other.M2 + delta * delta * Count * other.Count / total;
+    Count += other.Count;
+    InSpecification += other.InSpecification;
+    Min = qMin(Min, other.Min);
+    Max = qMax(Max, other.Max);
+    for (auto it = other.Buckets.constBegin(); it != other.Buckets.constEnd(); ++it)
+    {
+        Buckets[it.key()] += it.value();
+    }
+}
+
+quint64 StreamingStatistics::GetCount() const
+{
+    return Count;
+}
+
+quint64 StreamingStatistics::GetNonFinite() const
+{
+    return NonFinite;
+}
+
+double StreamingStatistics::GetMean() const
+{
+    return Mean;
+}
+
+double StreamingStatistics::GetStandardDeviation() const
+{
+    return Count > 1 ? std::sqrt(M2 / (Count - 1)) : 0.0;
+}
+
+double StreamingStatistics::GetMin() const
+{
+    return Min;
+}
+
+double StreamingStatistics::GetMax() const
+{
+    return Max;
+}
+
+// a sample the flowsheet could not solve is out of specification
+double StreamingStatistics::GetCompliance() const
+{
+    return Count + NonFinite > 0 ? double(InSpecification) / (Count + NonFinite) : 0.0;
+}
+
+double StreamingStatistics::Percentile(double fraction) const
+{
+    if (Count == 0)
+    {
+        return qQNaN();
+    }
+    const quint64 rank = quint64(qBound(0.0, fraction, 1.0) * (Count - 1));
+    quint64 seen = 0;
+    for (auto it = Buckets.constBegin(); it != Buckets.constEnd(); ++it)
+    {
+        seen += it.value();
+        if (seen > rank)
+        {
+            return qBound(Min, BucketValue(it.key()), Max);
+        }
+    }
+    return Max;
+}
+
+MonteCarloAnalysis::MonteCarloAnalysis(const CompiledFlowsheet &flowsheet, const QVector<FeedDistribution> &feeds)
+    : Flowsheet(flowsheet)
+    , Feeds(feeds)
+    , FeedNodes(feeds.size())
+    , SpecificationLow(-std::numeric_limits<double>::infinity())
+    , SpecificationHigh(std::numeric_limits<double>::infinity())
+{
+    for (int node = 0; node < Flowsheet.NodeCount(); ++node)
+    {
+        for (int feed = 0; feed < Feeds.size(); ++feed)
+        {
+            if (Feeds.at(feed).ItemId == Flowsheet.GetItemId(node))
+            {
+                FeedNodes[feed].append(node);
+            }
+        }
+    }
+}
+
+void MonteCarloAnalysis::SetSpecification(double low, double high)
+{
+    SpecificationLow = low;
+    SpecificationHigh = high;
+}
+
+QStringList MonteCarloAnalysis::SampleColumns() const
+{
+    QStringList columns("sample");
+    for (const FeedDistribution &feed : Feeds)
+    {
+        columns.append(QString("feed %1 (tph)").arg(feed.ItemId));
+    }
+    columns.append("product");
+    return columns;
+}
+
+QVector<int> MonteCarloAnalysis::IntegerSampleColumns() const
+{
+    return QVector<int>{0};
+}
+
+StreamingStatistics MonteCarloAnalysis::Run(int samples, quint64 seed, ResultWriter *writer) const
+{
+    // chunks run in waves so samples reach the writer in order with a fixed buffer
+    const int chunkCount = (samples + CHUNK_SAMPLES - 1) / CHUNK_SAMPLES;
+    const int wave = qMax(1, QThread::idealThreadCount()) * CHUNKS_PER_THREAD;
+    const int stride = Feeds.size() + 2;
+    QVector<int> chunks;
+    QVector<StreamingStatistics> results;
+    QVector<double> rows;
+    MemoryCharge rowsCharge(MemoryAccount::SolverBuffers);
+    StreamingStatistics total;
+    for (int first = 0; first < chunkCount; first += wave)
+    {
+        const int count = qMin(wave, chunkCount - first);
+        const int waveSamples = qMin(count * CHUNK_SAMPLES, samples - first * CHUNK_SAMPLES);
+        chunks.resize(count);
+        results.fill(StreamingStatistics(), count);
+        for (int i = 0; i < count; ++i)
+        {
+            chunks[i] = first + i;
+        }
+        if (writer)
+        {
+            rows.resize(waveSamples * stride);
+            rowsCharge.Set(rows.capacity() * sizeof(double));
+        }
+        StreamingStatistics *result = results.data();
+        double *data = writer ? rows.data() : nullptr;
+        QtConcurrent::blockingMap(chunks, [&](int &chunk) {
+            const int index = chunk - first;
+            result[index] = RunChunk(chunk, qMin(CHUNK_SAMPLES, samples - chunk * CHUNK_SAMPLES), seed,
+                                     data ? data + index * CHUNK_SAMPLES * stride : nullptr);
+        });
+
+        // merged in chunk order so the floating point sums do not depend on scheduling
+        for (const StreamingStatistics &chunk : results)
+        {
+            total.Merge(chunk);
+        }
+        if (writer && !writer->WriteRows(rows.constData(), waveSamples))
+        {
+            writer = nullptr;
+        }
+    }
+    return total;
+}
+
+StreamingStatistics MonteCarloAnalysis::RunChunk(int chunk, int samples, quint64 seed, double *rows) const
+{
+    std::seed_seq sequence{quint32(seed), quint32(seed >> 32), quint32(chunk)};
+    std::mt19937_64 generator(sequence);
+    QVector<double> values = Flowsheet.GetValues();
+    StreamingStatistics statistics;
+    for (int sample = 0; sample < samples; ++sample)
+    {
+        if (rows)
+        {
+            *rows++ = double(chunk) * CHUNK_SAMPLES + sample;
+        }
+        for (int feed = 0; feed < Feeds.size(); ++feed)
+        {
+            double rate = Draw(Feeds.at(feed), generator);
+            for (int node : FeedNodes.at(feed))
+            {
+                values[node] = rate;
+            }
+            if (rows)
+            {
+                *rows++ = rate;
+            }
+        }
+        double product = Flowsheet.Evaluate(values);
+        statistics.Add(product, product >= SpecificationLow && product <= SpecificationHigh);
+        if (rows)
+        {
+            *rows++ = product;
+        }
+    }
+    return statistics;
+}
@@ -0,0 +1,85 @@
+#ifndef MONTECARLO_H
+#define MONTECARLO_H
+
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "compiledflowsheet.h"
+#include "resultwriter.h"
+
+// Distribution of one feed unit, read from "id,normal,mean,sd",
+// "id,uniform,min,max" or "id,triangular,min,mode,max".
+struct FeedDistribution
+{
+    enum Shape
+    {
+        Normal,
+        Uniform,
+        Triangular
+    };
+
+    quint64 ItemId;
+    Shape Kind;
+    double A;
+    double B;
+    double C;
+
+    static bool Parse(const QString &line, FeedDistribution &distribution);
+    QString ToString() const;
+};
+
+// Running moments and a log-bucketed histogram of a stream of samples. Two
+// instances merge exactly, percentiles are within half a percent of the sample.
+class StreamingStatistics
+{
+public:
+    void Add(double value, bool inSpecification);
+    void Merge(const StreamingStatistics &other);
+
+    quint64 GetCount() const;
+    quint64 GetNonFinite() const;
+    double GetMean() const;
+    double GetStandardDeviation() const;
+    double GetMin() const;
+    double GetMax() const;
+    double GetCompliance() const;
+    double Percentile(double fraction) const;
+
+private:
+    quint64 Count = 0;
+    quint64 NonFinite = 0;
+    quint64 InSpecification = 0;
+    double Mean = 0.0;
+    double M2 = 0.0;
+    double Min = 0.0;
+    double Max = 0.0;
+    QMap<int, quint64> Buckets;
+};
+
+// Solves the compiled flowsheet for random feed realisations. Samples are
+// drawn in fixed chunks, each with its own generator seeded from the run seed
+// and the chunk number, so a run repeats exactly on any number of threads.
+class MonteCarloAnalysis
+{
+public:
+    MonteCarloAnalysis(const CompiledFlowsheet &flowsheet, const QVector<FeedDistribution> &feeds);
+
+    void SetSpecification(double low, double high);
+    // every sample is also written as a row of SampleColumns() when a writer is
+    // given; after a failed write the writer is left alone and its Close() fails
+    StreamingStatistics Run(int samples, quint64 seed, ResultWriter *writer = nullptr) const;
+    QStringList SampleColumns() const;
+    QVector<int> IntegerSampleColumns() const;
+
+private:
+    StreamingStatistics RunChunk(int chunk, int samples, quint64 seed, double *rows) const;
+
+    CompiledFlowsheet Flowsheet;
+    QVector<FeedDistribution> Feeds;
+    QVector<QVector<int>> FeedNodes;
+    double SpecificationLow;
+    double SpecificationHigh;
+};
+
+#endif // MONTECARLO_H
@@ -0,0 +1,177 @@
+#include "parameterblock.h"
+
+namespace
+{
+    const QVector<EquipmentSchema> &Schemas()
+    {
+        // index matches the row + 1 of the equipment list in MainWindow, 0 is for
+        // items that carry no type (older scene files)
+        static const QVector<EquipmentSchema> schemas = {
+            {"Generic",    EquipmentRole::Generic,  {"Value"}, {}},
+            {"Loader",     EquipmentRole::Feed,     {"Value", "Capacity (tph)"}, {"Units"}},
+            {"Pit",        EquipmentRole::Feed,     {"Value", "Feed Rate (tph)"}, {}},
+            {"Split",      EquipmentRole::Process,  {"Value", "Split Ratio"}, {}},
+            {"Combine",    EquipmentRole::Process,  {"Value"}, {}},
+            {"Bin",        EquipmentRole::Storage,  {"Value", "Capacity (t)"}, {}},
+            {"Screen",     EquipmentRole::Process,  {"Value", "Aperture (mm)", "Efficiency"}, {"Decks"}},
+            {"Crusher",    EquipmentRole::Process,  {"Value", "Closed Side Setting (mm)", "Capacity (tph)"}, {}},
+            {"Conveyor",   EquipmentRole::Conveyor, {"Value", "Length (m)", "Belt Speed (m/s)"}, {}},
+            {"Surge Pile", EquipmentRole::Storage,  {"Value", "Capacity (t)"}, {}},
+            {"Stockpile",  EquipmentRole::Storage,  {"Value", "Capacity (t)"}, {}},
+            {"Water",      EquipmentRole::Process,  {"Value", "Flow (l/min)"}, {}},
+            {"Belt Scale", EquipmentRole::Process,  {"Value"}, {}},
+            {"Utility",    EquipmentRole::Generic,  {"Value"}, {}},
+            {"Blend",      EquipmentRole::Process,  {"Value", "Blend Ratio"}, {}}
+        };
+        return schemas;
+    }
+}
+
+const EquipmentSchema &ParameterBlock::Schema(int equipmentType)
+{
+    const QVector<EquipmentSchema> &schemas = Schemas();
+    if (equipmentType < 0 || equipmentType >= schemas.size())
+    {
+        return schemas.at(0);
+    }
+    return schemas.at(equipmentType);
+}
+
+int ParameterBlock::EquipmentTypeCount()
+{
+    return Schemas().size();
+}
+
+ParameterBlock::ParameterBlock(int equipmentType)
+    : EquipmentType(equipmentType)
+    , Doubles(Schema(equipmentType).DoubleNames.size(), 0.0)
+    , Ints(Schema(equipmentType).IntNames.size(), 0)
+    , AssignedDoubles(0)
+    , AssignedInts(0)
+{
+
+}
+
+int ParameterBlock::GetEquipmentType() const
+{
+    return EquipmentType;
+}
+
+const EquipmentSchema &ParameterBlock::GetSchema() const
+{
+    return Schema(EquipmentType);
+}
+
+int ParameterBlock::DoubleCount() const
+{
+    return Doubles.size();
+}
+
+int ParameterBlock::DoubleIndex(const QString &name) const
+{
+    return GetSchema().DoubleNames.indexOf(name);
+}
+
+double ParameterBlock::GetDouble(int index) const
+{
+    return Doubles.at(index);
+}
+
+void ParameterBlock::SetDouble(int index, double value)
+{
+    Doubles[index] = value;
+    AssignedDoubles |= (1u << index);
+}
+
+bool ParameterBlock::IsDoubleAssigned(int index) const
+{
+    return AssignedDoubles & (1u << index);
+}
+
+const double *ParameterBlock::DoubleData() const
+{
+    return Doubles.constData();
+}
+
+int ParameterBlock::IntCount() const
+{
+    return Ints.size();
+}
+
+int ParameterBlock::IntIndex(const QString &name) const
+{
+    return GetSchema().IntNames.indexOf(name);
+}
+
+int ParameterBlock::GetInt(int index) const
+{
+    return Ints.at(index);
+}
+
+void ParameterBlock::SetInt(int index, int value)
+{
+    Ints[index] = value;
+    AssignedInts |= (1u << index);
+}
+
+bool ParameterBlock::IsIntAssigned(int index) const
+{
+    return AssignedInts & (1u << index);
+}
+
+const int *ParameterBlock::IntData() const
+{
+    return Ints.constData();
+}
+
+QString ParameterBlock::ToDisplayString() const
+{
+    const EquipmentSchema &schema = GetSchema();
+    QStringList lines;
+    for (int i = 0; i < Doubles.size(); ++i)
+    {
+        if (IsDoubleAssigned(i))
+        {
+            lines << QString("%1: %2").arg(schema.DoubleNames.at(i)).arg(Doubles.at(i));
+        }
+    }
+    for (int i = 0; i < Ints.size(); ++i)
+    {
+        if (IsIntAssigned(i))
+        {
+            lines << QString("%1: %2").arg(schema.IntNames.at(i)).arg(Ints.at(i));
+        }
+    }
+    return lines.join('\n');
+}
+
+void ParameterBlock::write(QDataStream &out) const
+{
+    out << qint32(EquipmentType);
+    out << Doubles << Ints;
+    out << AssignedDoubles << AssignedInts;
+}
+
+void ParameterBlock::read(QDataStream &in)
+{
+    qint32 equipmentType;
+    QVector<double> doubles;
+    QVector<int> ints;
+    quint32 assignedDoubles, assignedInts;
+
+    in >> equipmentType >> doubles >> ints >> assignedDoubles >> assignedInts;
+
+    // the schema of this build decides the layout, values of parameters that
+    // no longer exist are dropped
+    *this = ParameterBlock(equipmentType);
+    for (int i = 0; i < qMin(doubles.size(), Doubles.size()); ++i)
+    {
+        Doubles[i] = doubles.at(i);
+    }
+    for (int i = 0; i < qMin(ints.size(), Ints.size()); ++i)
+    {
+        Ints[i] = ints.at(i);
+    }
+    AssignedDoubles = assignedDoubles & ((1u << Doubles.size()) - 1);
+    AssignedInts = assignedInts & ((1u << Ints.size()) - 1);
+}
@@ -0,0 +1,69 @@
+#ifndef PARAMETERBLOCK_H
+#define PARAMETERBLOCK_H
+
+#include <QDataStream>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+enum class EquipmentRole
+{
+    Generic,
+    Feed,
+    Process,
+    Conveyor,
+    Storage
+};
+
+struct EquipmentSchema
+{
+    QString TypeName;
+    EquipmentRole Role;
+    QStringList DoubleNames;
+    QStringList IntNames;
+};
+
+// Typed parameters of one unit. Values are kept in contiguous arrays laid out
+// by the schema of the equipment type so the evaluator can index them directly.
+class ParameterBlock
+{
+public:
+    // every schema starts with the operand used by the evaluator
+    enum CommonDouble { Value = 0 };
+
+    static const EquipmentSchema &Schema(int equipmentType);
+    static int EquipmentTypeCount();
+
+    explicit ParameterBlock(int equipmentType = 0);
+
+    int GetEquipmentType() const;
+    const EquipmentSchema &GetSchema() const;
+
+    int DoubleCount() const;
+    int DoubleIndex(const QString &name) const;
+    double GetDouble(int index) const;
+    void SetDouble(int index, double value);
+    bool IsDoubleAssigned(int index) const;
+    const double *DoubleData() const;
+
+    int IntCount() const;
+    int IntIndex(const QString &name) const;
+    int GetInt(int index) const;
+    void SetInt(int index, int value);
+    bool IsIntAssigned(int index) const;
+    const int *IntData() const;
+
+    QString ToDisplayString() const;
+
+    void write(QDataStream &out) const;
+    void read(QDataStream &in);
+
+private:
+    int EquipmentType;
+    QVector<double> Doubles;
+    QVector<int> Ints;
+    quint32 AssignedDoubles;
+    quint32 AssignedInts;
+};
+
+#endif // PARAMETERBLOCK_H
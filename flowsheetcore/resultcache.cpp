@@ -0,0 +1,237 @@
+#include "resultcache.h"
+#include <QHash>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // FNV-1a, unlike qHash it is not seeded per process so keys can be saved
+    const quint64 FNV_OFFSET = 14695981039346656037ULL;
+    const quint64 FNV_PRIME = 1099511628211ULL;
+
+    quint64 Mix(quint64 hash, quint64 value)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            hash ^= (value >> (8 * i)) & 0xff;
+            hash *= FNV_PRIME;
+        }
+        return hash;
+    }
+
+    quint64 DoubleBits(double value)
+    {
+        quint64 bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    // a plugin taking over a type, or a new build of it, must not be answered with results saved before
+    quint64 ModelKey(const EquipmentModel *model, QHash<const EquipmentModel *, quint64> *keys)
+    {
+        auto it = keys->constFind(model);
+        if (it != keys->constEnd())
+        {
+            return it.value();
+        }
+        quint64 hash = FNV_OFFSET;
+        for (char byte : model->Name().toUtf8() + '\0' + model->Version().toUtf8())
+        {
+            hash = (hash ^ quint8(byte)) * FNV_PRIME;
+        }
+        keys->insert(model, hash);
+        return hash;
+    }
+
+    // key, value and the links of QCache's node and its hash entry
+    const qint64 ENTRY_BYTES = sizeof(quint64) + sizeof(double) + 6 * sizeof(void *);
+}
+
+ResultCache::ResultCache(int maxEntries)
+    : Results(maxEntries)
+    , Hits(0)
+    , Misses(0)
+    , Charge(MemoryAccount::CachedResults)
+{
+}
+
+QVector<quint64> ResultCache::NodeKeys(const CompiledFlowsheet &flowsheet)
+{
+    const int nodeCount = flowsheet.NodeCount();
+    QVector<quint64> local(nodeCount);
+    QVector<QVector<int>> inlets(nodeCount);
+    QVector<int> pending(nodeCount, 0);
+    QHash<const EquipmentModel *, quint64> modelKeys;
+    for (int node = 0; node < nodeCount; ++node)
+    {
+        quint64 hash = Mix(FNV_OFFSET, quint64(flowsheet.GetEquipmentType(node)));
+        hash = Mix(hash, ModelKey(flowsheet.GetModel(node), &modelKeys));
+        hash = Mix(hash, quint64(CompiledFlowsheet::Operation(flowsheet.GetItemId(node))));
+        hash = Mix(hash, DoubleBits(flowsheet.GetValues().at(node)));
+        // models may read every parameter, not only the value
+        int count = 0;
+        const double *doubles = flowsheet.GetDoubles(node, count);
+        for (int i = 0; i < count; ++i)
+        {
+            hash = Mix(hash, DoubleBits(doubles[i]));
+        }
+        const int *ints = flowsheet.GetInts(node, count);
+        for (int i = 0; i < count; ++i)
+        {
+            hash = Mix(hash, quint64(quint32(ints[i])));
+        }
+        local[node] = hash;
+    }
+    QVector<QVector<int>> outlets(nodeCount);
+    for (const CompiledFlowsheet::Edge &edge : flowsheet.GetEdges())
+    {
+        inlets[edge.End].append(edge.Start);
+        outlets[edge.Start].append(edge.End);
+        ++pending[edge.End];
+    }
+
+    // upstream units are hashed first; on a loop the unit closing it enters with its local hash only
+    QVector<quint64> keys(nodeCount, 0);
+    QVector<bool> done(nodeCount, false);
+    QVector<int> ready;
+    for (int node = 0; node < nodeCount; ++node)
+    {
+        if (pending.at(node) == 0)
+        {
+            ready.append(node);
+        }
+    }
+    int next = 0;
+    int finished = 0;
+    QVector<quint64> upstream;
+    while (finished < nodeCount)
+    {
+        if (next == ready.size())
+        {
+            ready.append(int(std::find(done.begin(), done.end(), false) - done.begin()));
+        }
+        int node = ready.at(next++);
+        if (done.at(node))
+        {
+            continue;
+        }
+
+        upstream.clear();
+        for (int from : inlets.at(node))
+        {
+            upstream.append(done.at(from) ? keys.at(from) : local.at(from));
+        }
+        std::sort(upstream.begin(), upstream.end());
+        quint64 key = local.at(node);
+        for (quint64 hash : upstream)
+        {
+            key = Mix(key, hash);
+        }
+        keys[node] = key;
+        done[node] = true;
+        ++finished;
+
+        for (int to : outlets.at(node))
+        {
+            if (!done.at(to) && --pending[to] == 0)
+            {
+                ready.append(to);
+            }
+        }
+    }
+    return keys;
+}
+
+double ResultCache::Evaluate(const CompiledFlowsheet &flowsheet)
+{
+    const QVector<quint64> keys = NodeKeys(flowsheet);
+    const QVector<CompiledFlowsheet::Edge> &edges = flowsheet.GetEdges();
+    QVector<QVector<int>> inlets(flowsheet.NodeCount());
+    for (int e = 0; e < edges.size(); ++e)
+    {
+        inlets[edges.at(e).End].append(e);
+    }
+
+    // the streams into every missed unit are solved together, one model call per equipment type
+    double result = flowsheet.GetConstant();
+    QVector<int> missed;
+    QVector<int> missedEdges;
+    for (int node = 0; node < inlets.size(); ++node)
+    {
+        if (inlets.at(node).isEmpty())
+        {
+            continue;
+        }
+        if (double *cached = Results.object(keys.at(node)))
+        {
+            ++Hits;
+            result += *cached;
+            continue;
+        }
+        ++Misses;
+        missed.append(node);
+        missedEdges += inlets.at(node);
+    }
+
+    const QVector<double> streams = flowsheet.EdgeResults(missedEdges, flowsheet.GetValues());
+    int stream = 0;
+    for (int node : missed)
+    {
+        double inflow = 0.0;
+        for (int i = 0; i < inlets.at(node).size(); ++i)
+        {
+            inflow += streams.at(stream++);
+        }
+        Results.insert(keys.at(node), new double(inflow));
+        result += inflow;
+    }
+    Charge.Set(Results.size() * ENTRY_BYTES, Results.size());
+    return result;
+}
+
+quint64 ResultCache::GetHits() const
+{
+    return Hits;
+}
+
+quint64 ResultCache::GetMisses() const
+{
+    return Misses;
+}
+
+int ResultCache::GetSize() const
+{
+    return Results.size();
+}
+
+void ResultCache::Clear()
+{
+    Results.clear();
+    Hits = 0;
+    Misses = 0;
+    Charge.Set(0, 0);
+}
+
+void ResultCache::write(QDataStream &out) const
+{
+    const QList<quint64> keys = Results.keys();
+    out << qint32(keys.size());
+    for (quint64 key : keys)
+    {
+        out << key << *Results.object(key);
+    }
+}
+
+void ResultCache::read(QDataStream &in)
+{
+    qint32 count;
+    in >> count;
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+    {
+        quint64 key;
+        double value;
+        in >> key >> value;
+        Results.insert(key, new double(value));
+    }
+    Charge.Set(Results.size() * ENTRY_BYTES, Results.size());
+}
@@ -0,0 +1,38 @@
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <QCache>
+#include <QDataStream>
+#include <QVector>
+#include "compiledflowsheet.h"
+#include "memoryaccount.h"
+
+// Memoised evaluation. The result of the edges entering a unit is stored under
+// a Merkle hash of the unit's equipment type, model, operation and value and
+// of the hashes of the units feeding it, so an edit only misses on the edited
+// unit and what lies downstream of it. Keys depend on content only and stay valid
+// across undo, redo and reloading; the least recently used entries go first.
+class ResultCache
+{
+public:
+    explicit ResultCache(int maxEntries = 20000);
+
+    double Evaluate(const CompiledFlowsheet &flowsheet);
+    static QVector<quint64> NodeKeys(const CompiledFlowsheet &flowsheet);
+
+    quint64 GetHits() const;
+    quint64 GetMisses() const;
+    int GetSize() const;
+    void Clear();
+
+    void write(QDataStream &out) const;
+    void read(QDataStream &in);
+
+private:
+    QCache<quint64, double> Results;
+    quint64 Hits;
+    quint64 Misses;
+    MemoryCharge Charge;
+};
+
+#endif // RESULTCACHE_H
@@ -0,0 +1,214 @@
+#include "resultwriter.h"
+#include <QFileInfo>
+#include <QtEndian>
+#include <cstring>
+
+ResultWriter::~ResultWriter()
+{
+}
+
+ResultWriter *ResultWriter::Create(const QString &fileName)
+{
+    if (QFileInfo(fileName).suffix().compare("afcol", Qt::CaseInsensitive) == 0)
+    {
+        return new ColumnarResultWriter();
+    }
+    return new CsvResultWriter();
+}
+
+QString ResultWriter::FileFilter()
+{
+    return QObject::tr("CSV (*.csv);;Columnar (*.afcol)");
+}
+
+void ResultWriter::SetIntegerColumns(const QVector<int> &columns)
+{
+    IntegerColumns = columns;
+}
+
+const QString &ResultWriter::GetErrorString() const
+{
+    return ErrorString;
+}
+
+bool ResultWriter::Fail(const QFile &file)
+{
+    if (ErrorString.isEmpty())
+    {
+        ErrorString = QObject::tr("Could not write %1: %2").arg(file.fileName(), file.errorString());
+    }
+    return false;
+}
+
+bool ResultWriter::IsInteger(int column) const
+{
+    return IntegerColumns.contains(column);
+}
+
+CsvResultWriter::~CsvResultWriter()
+{
+    Close();
+}
+
+bool CsvResultWriter::Open(const QString &fileName, const QStringList &columns)
+{
+    File.setFileName(fileName);
+    if (!File.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        return Fail(File);
+    }
+    Out.setDevice(&File);
+    Out.setRealNumberPrecision(10);
+    ColumnCount = columns.size();
+
+    QStringList header;
+    for (const QString &column : columns)
+    {
+        header.append(QString(column).replace(',', ' '));
+    }
+    Out << header.join(',') << '\n';
+    return true;
+}
+
+bool CsvResultWriter::WriteRows(const double *rows, int rowCount)
+{
+    for (int row = 0; row < rowCount; ++row)
+    {
+        const double *values = rows + row * ColumnCount;
+        for (int column = 0; column < ColumnCount; ++column)
+        {
+            if (column > 0)
+            {
+                Out << ',';
+            }
+            if (IsInteger(column))
+            {
+                Out << qint64(values[column]);
+            }
+            else
+            {
+                Out << values[column];
+            }
+        }
+        Out << '\n';
+    }
+    return Out.status() == QTextStream::Ok || Fail(File);
+}
+
+bool CsvResultWriter::Close()
+{
+    if (!File.isOpen())
+    {
+        return ErrorString.isEmpty();
+    }
+    Out.flush();
+    bool ok = File.error() == QFile::NoError;
+    File.close();
+    return (ok || Fail(File)) && ErrorString.isEmpty();
+}
+
+ColumnarResultWriter::~ColumnarResultWriter()
+{
+    Close();
+}
+
+bool ColumnarResultWriter::Open(const QString &fileName, const QStringList &columns)
+{
+    File.setFileName(fileName);
+    if (!File.open(QIODevice::WriteOnly))
+    {
+        return Fail(File);
+    }
+    Out.setDevice(&File);
+    Out.setByteOrder(QDataStream::LittleEndian);
+    ColumnCount = columns.size();
+    const int rowBytes = qMax(ColumnCount, 1) * int(sizeof(double));
+    GroupRows = qMax(1, qMin(ROW_GROUP_BYTES / rowBytes, int(ROW_GROUP_ROWS)));
+    Pending.reserve(GroupRows * ColumnCount);
+    Column.resize(GroupRows);
+
+    // per column: name, then 0 for double or 1 for int64
+    Out << MAGIC << quint32(ColumnCount);
+    for (int column = 0; column < ColumnCount; ++column)
+    {
+        QByteArray name = columns.at(column).toUtf8();
+        Out << quint32(name.size());
+        Out.writeRawData(name.constData(), name.size());
+        Out << quint8(IsInteger(column) ? 1 : 0);
+    }
+    return Out.status() == QDataStream::Ok || Fail(File);
+}
+
+bool ColumnarResultWriter::WriteRows(const double *rows, int rowCount)
+{
+    while (rowCount > 0)
+    {
+        int room = GroupRows - Pending.size() / qMax(ColumnCount, 1);
+        int take = qMin(room, rowCount);
+        const int used = Pending.size();
+        Pending.resize(used + take * ColumnCount);
+        std::memcpy(Pending.data() + used, rows, take * ColumnCount * sizeof(double));
+        rows += take * ColumnCount;
+        rowCount -= take;
+        if (take == room && !FlushRowGroup())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ColumnarResultWriter::FlushRowGroup()
+{
+    const int rows = ColumnCount > 0 ? Pending.size() / ColumnCount : 0;
+    if (rows == 0)
+    {
+        return true;
+    }
+
+    GroupOffsets.append(File.pos());
+    Out << quint32(rows);
+    for (int column = 0; column < ColumnCount; ++column)
+    {
+        // transpose into one contiguous run per column
+        const bool integer = IsInteger(column);
+        for (int row = 0; row < rows; ++row)
+        {
+            const double value = Pending.at(row * ColumnCount + column);
+            quint64 bits;
+            if (integer)
+            {
+                bits = quint64(qint64(value));
+            }
+            else
+            {
+                std::memcpy(&bits, &value, sizeof(bits));
+            }
+            Column[row] = qToLittleEndian(bits);
+        }
+        Out.writeRawData(reinterpret_cast<const char *>(Column.constData()), rows * int(sizeof(quint64)));
+    }
+    RowCount += rows;
+    Pending.resize(0);
+    return Out.status() == QDataStream::Ok || Fail(File);
+}
+
+bool ColumnarResultWriter::Close()
+{
+    if (!File.isOpen())
+    {
+        return ErrorString.isEmpty();
+    }
+    bool ok = FlushRowGroup();
+
+    // footer: group offsets, group count, total rows, footer start, magic
+    qint64 footer = File.pos();
+    for (qint64 offset : GroupOffsets)
+    {
+        Out << offset;
+    }
+    Out << quint32(GroupOffsets.size()) << RowCount << footer << MAGIC;
+    ok = ok && Out.status() == QDataStream::Ok && File.error() == QFile::NoError;
+    File.close();
+    return (ok || Fail(File)) && ErrorString.isEmpty();
+}
@@ -0,0 +1,84 @@
+#ifndef RESULTWRITER_H
+#define RESULTWRITER_H
+
+#include <QDataStream>
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+#include <QVector>
+
+// Sink for tables of doubles produced a batch at a time. Rows are handed over
+// row-major and leave memory as soon as the format allows, so a sweep of any
+// length is written with a fixed buffer. Columns marked as integer (ids,
+// counters) are written as whole numbers. The first error sticks, Close()
+// reports it even when later writes were skipped.
+class ResultWriter
+{
+public:
+    virtual ~ResultWriter();
+
+    // picks the format from the suffix, .afcol is columnar and anything else CSV
+    static ResultWriter *Create(const QString &fileName);
+    static QString FileFilter();
+
+    // before Open(), indices into its column list
+    void SetIntegerColumns(const QVector<int> &columns);
+    virtual bool Open(const QString &fileName, const QStringList &columns) = 0;
+    virtual bool WriteRows(const double *rows, int rowCount) = 0;
+    virtual bool Close() = 0;
+    const QString &GetErrorString() const;
+
+protected:
+    bool Fail(const QFile &file);
+    bool IsInteger(int column) const;
+
+    QString ErrorString;
+    QVector<int> IntegerColumns;
+};
+
+class CsvResultWriter : public ResultWriter
+{
+public:
+    ~CsvResultWriter();
+
+    bool Open(const QString &fileName, const QStringList &columns) override;
+    bool WriteRows(const double *rows, int rowCount) override;
+    bool Close() override;
+
+private:
+    QFile File;
+    QTextStream Out;
+    int ColumnCount = 0;
+};
+
+// Binary columnar file: a header with the column names and types, row groups
+// holding each column as a contiguous little-endian double or int64 array, and
+// a footer that indexes the row groups. Rows are buffered until a group is
+// full; groups are sized to a byte budget so wide tables do not buffer more.
+class ColumnarResultWriter : public ResultWriter
+{
+public:
+    static const quint32 MAGIC = 0x41464332;   // "AFC2"
+    static const int ROW_GROUP_ROWS = 65536;
+    static const int ROW_GROUP_BYTES = 8 * 1024 * 1024;
+
+    ~ColumnarResultWriter();
+
+    bool Open(const QString &fileName, const QStringList &columns) override;
+    bool WriteRows(const double *rows, int rowCount) override;
+    bool Close() override;
+
+private:
+    bool FlushRowGroup();
+
+    QFile File;
+    QDataStream Out;
+    int ColumnCount = 0;
+    int GroupRows = 0;
+    QVector<double> Pending;
+    QVector<quint64> Column;
+    QVector<qint64> GroupOffsets;
+    quint64 RowCount = 0;
+};
+
+#endif // RESULTWRITER_H
@@ -0,0 +1,623 @@
+#include "scenediff.h"
+#include "itemid.h"
+#include "parameterblock.h"
+#include <QDataStream>
+#include <QDomDocument>
+#include <QFile>
+#include <QFileInfo>
+#include <QMultiHash>
+#include <QSet>
+#include <QTextStream>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // must follow the scene format written by CustomGraphicsView
+    const char *SCENE_HEADER = "AggFlowScene";
+    const qint32 NEWEST_SCENE_VERSION = 6;
+    // records are copied as read, so only files with 64 bit ids can be
+    // written back; the editor upgrades older ones when it saves them
+    const qint32 OLDEST_WRITABLE_SCENE_VERSION = WIDE_ITEM_ID_VERSION;
+    const char PNG_SIGNATURE[] = "\x89PNG\r\n\x1a\n";
+
+    bool SetError(QString *error, const QString &message)
+    {
+        if (error)
+        {
+            *error = message;
+        }
+        return false;
+    }
+
+    // unit images are streamed as a null marker and a bare PNG, skipped chunk by chunk
+    bool SkipImage(QDataStream &in)
+    {
+        qint32 present;
+        in >> present;
+        if (!present)
+        {
+            return in.status() == QDataStream::Ok;
+        }
+        char signature[8];
+        if (in.readRawData(signature, 8) != 8 || std::memcmp(signature, PNG_SIGNATURE, 8) != 0)
+        {
+            return false;
+        }
+        for (;;)
+        {
+            uchar header[8];
+            if (in.readRawData(reinterpret_cast<char *>(header), 8) != 8)
+            {
+                return false;
+            }
+            quint32 length = (quint32(header[0]) << 24) | (quint32(header[1]) << 16) | (quint32(header[2]) << 8) | header[3];
+            if (in.skipRawData(int(length) + 4) != int(length) + 4)
+            {
+                return false;
+            }
+            if (std::memcmp(header + 4, "IEND", 4) == 0)
+            {
+                return true;
+            }
+        }
+    }
+
+    QByteArray NodeContent(bool group, const QString &text, const ParameterBlock &parameters, const QByteArray &groupContents)
+    {
+        QByteArray content;
+        QDataStream out(&content, QIODevice::WriteOnly);
+        out << group << text;
+        parameters.write(out);
+        out << groupContents;
+        return content;
+    }
+
+    bool SameNode(const DiffNode *a, const DiffNode *b)
+    {
+        if (!a || !b)
+        {
+            return a == b;
+        }
+        return a->Content == b->Content && a->Pos == b->Pos;
+    }
+
+    QString NodeName(const DiffNode &node)
+    {
+        QString type = ParameterBlock::Schema(node.EquipmentType).TypeName;
+        return node.Text.isEmpty() ? QString("%1 %2").arg(type).arg(node.ItemId)
+                                   : QString("%1 %2 \"%3\"").arg(type).arg(node.ItemId).arg(node.Text);
+    }
+
+    QString EdgeName(const DiffEdge &edge, bool byUnits)
+    {
+        if (byUnits)
+        {
+            return QString("%1 -> %2%3").arg(edge.StartItemId).arg(edge.EndItemId).arg(edge.Tear ? " (tear)" : "");
+        }
+        return QString("(%1, %2) -> (%3, %4)").arg(edge.Line.x1()).arg(edge.Line.y1()).arg(edge.Line.x2()).arg(edge.Line.y2());
+    }
+}
+
+bool SceneSnapshot::Load(const QString &fileName, QString *error)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return SetError(error, QString("Could not read %1: %2").arg(fileName, file.errorString()));
+    }
+    QByteArray data = file.readAll();
+    bool xml = QFileInfo(fileName).suffix().compare("xml", Qt::CaseInsensitive) == 0;
+    return xml ? LoadXml(data, error) : LoadScene(data, error);
+}
+
+bool SceneSnapshot::LoadScene(const QByteArray &data, QString *error)
+{
+    Nodes.clear();
+    Edges.clear();
+    LineEnds = true;
+
+    QDataStream in(data);
+    qint32 version = 1;
+    OldestVersion = version;
+    while (!in.atEnd())
+    {
+        const qint64 start = in.device()->pos();
+        QString tag;
+        in >> tag;
+        if (tag == SCENE_HEADER)
+        {
+            in >> version;
+            if (version > NEWEST_SCENE_VERSION)
+            {
+                return SetError(error, QString("Scene format version %1 is newer than this build").arg(version));
+            }
+            OldestVersion = version;
+            continue;
+        }
+
+        if (tag == "CustomPixmapItem" || tag == "GroupItem")
+        {
+            DiffNode node;
+            bool startConnected, endConnected;
+            in >> node.Pos;
+            if (!SkipImage(in))
+            {
+                return SetError(error, "Damaged unit image in scene file");
+            }
+            in >> node.Text;
+            ReadItemId(in, version);
+            node.ItemId = ReadItemId(in, version);
+            in >> startConnected >> endConnected;
+            ParameterBlock parameters;
+            if (version >= 2)
+            {
+                parameters.read(in);
+            }
+            QByteArray contents;
+            if (tag == "GroupItem")
+            {
+                qint32 childCount, linkCount;
+                QPointF origin;
+                double cachedResult;
+                in >> contents >> childCount >> origin >> cachedResult >> linkCount;
+                for (qint32 i = 0; i < linkCount && in.status() == QDataStream::Ok; ++i)
+                {
+                    bool innerIsStart, groupIsFirst, outerIsStart;
+                    ReadItemId(in, version);
+                    in >> innerIsStart >> groupIsFirst;
+                    ReadItemId(in, version);
+                    in >> outerIsStart;
+                    ReadItemId(in, version);
+                    ParameterBlock inner;
+                    inner.read(in);
+                }
+            }
+            node.EquipmentType = parameters.GetEquipmentType();
+            node.Content = NodeContent(tag == "GroupItem", node.Text, parameters, contents);
+            node.Record = data.mid(int(start), int(in.device()->pos() - start));
+            Nodes.insert(node.ItemId, node);
+        }
+        else if (tag == "ArrowLineItem")
+        {
+            DiffEdge edge;
+            bool flag;
+            in >> edge.Line;
+            edge.StartItemId = ReadItemId(in, version);
+            in >> flag >> flag;
+            edge.EndItemId = ReadItemId(in, version);
+            in >> flag >> flag;
+            edge.StartOnStartCircle = false;
+            edge.EndOnStartCircle = false;
+            edge.Tear = false;
+            if (version >= 3)
+            {
+                in >> edge.StartOnStartCircle >> edge.EndOnStartCircle;
+            }
+            if (version >= 5)
+            {
+                in >> edge.Tear;
+            }
+            edge.Record = data.mid(int(start), int(in.device()->pos() - start));
+            Edges.append(edge);
+        }
+        else if (tag == "ResultCache")
+        {
+            qint32 count;
+            in >> count;
+            in.skipRawData(count * int(sizeof(quint64) + sizeof(double)));
+        }
+        else
+        {
+            return SetError(error, QString("Unknown record \"%1\" in scene file").arg(tag));
+        }
+
+        if (in.status() != QDataStream::Ok)
+        {
+            return SetError(error, "Scene file is truncated or damaged");
+        }
+    }
+    return true;
+}
+
+bool SceneSnapshot::LoadXml(const QByteArray &data, QString *error)
+{
+    Nodes.clear();
+    Edges.clear();
+    LineEnds = false;
+    OldestVersion = 0;
+
+    QDomDocument doc;
+    QString message;
+    int line = 0;
+    if (!doc.setContent(data, &message, &line))
+    {
+        return SetError(error, QString("XML error on line %1: %2").arg(line).arg(message));
+    }
+
+    for (QDomElement element = doc.documentElement().firstChildElement(); !element.isNull(); element = element.nextSiblingElement())
+    {
+        if (element.tagName() == "CustomPixmapItem")
+        {
+            DiffNode node;
+            node.ItemId = element.attribute("id").toULongLong();
+            node.Pos = QPointF(element.attribute("x").toDouble(), element.attribute("y").toDouble());
+            node.Text = element.attribute("text");
+
+            QDomElement paramElement = element.firstChildElement("Parameters");
+            ParameterBlock parameters(paramElement.attribute("type", "0").toInt());
+            for (QDomElement value = paramElement.firstChildElement(); !value.isNull(); value = value.nextSiblingElement())
+            {
+                if (value.tagName() == "Double")
+                {
+                    int index = parameters.DoubleIndex(value.attribute("name"));
+                    if (index >= 0)
+                    {
+                        parameters.SetDouble(index, value.attribute("value").toDouble());
+                    }
+                }
+                else if (value.tagName() == "Int")
+                {
+                    int index = parameters.IntIndex(value.attribute("name"));
+                    if (index >= 0)
+                    {
+                        parameters.SetInt(index, value.attribute("value").toInt());
+                    }
+                }
+            }
+            QByteArray group = QByteArray::fromBase64(element.attribute("group").toLatin1());
+            node.EquipmentType = parameters.GetEquipmentType();
+            node.Content = NodeContent(element.hasAttribute("group"), node.Text, parameters, group);
+            Nodes.insert(node.ItemId, node);
+        }
+        else if (element.tagName() == "ArrowLineItem")
+        {
+            DiffEdge edge = {0, 0, false, false, element.attribute("tear").toInt() != 0,
+                             QLineF(element.attribute("startX").toDouble(), element.attribute("startY").toDouble(),
+                                    element.attribute("endX").toDouble(), element.attribute("endY").toDouble()),
+                             QByteArray()};
+            Edges.append(edge);
+        }
+    }
+    return true;
+}
+
+bool SceneSnapshot::Save(const QString &fileName, QString *error) const
+{
+    if (OldestVersion < OLDEST_WRITABLE_SCENE_VERSION)
+    {
+        return SetError(error, QString("Scene format version %1 cannot be written back, open and save the file "
+                                       "in the editor first").arg(OldestVersion));
+    }
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        return SetError(error, QString("Could not write %1: %2").arg(fileName, file.errorString()));
+    }
+    QDataStream out(&file);
+    out << QString(SCENE_HEADER) << NEWEST_SCENE_VERSION;
+    for (const DiffNode &node : Nodes)
+    {
+        if (node.Record.isEmpty())
+        {
+            return SetError(error, "Only binary scene files can be written back");
+        }
+        out.writeRawData(node.Record.constData(), node.Record.size());
+    }
+    for (const DiffEdge &edge : Edges)
+    {
+        out.writeRawData(edge.Record.constData(), edge.Record.size());
+    }
+    return out.status() == QDataStream::Ok || SetError(error, file.errorString());
+}
+
+bool SceneSnapshot::HasLineEnds() const
+{
+    return LineEnds;
+}
+
+const QHash<quint64, DiffNode> &SceneSnapshot::GetNodes() const
+{
+    return Nodes;
+}
+
+const QVector<DiffEdge> &SceneSnapshot::GetEdges() const
+{
+    return Edges;
+}
+
+QByteArray SceneSnapshot::EdgeKey(const DiffEdge &edge, bool byUnits, const QHash<quint64, quint64> &itemIds)
+{
+    QByteArray key;
+    QDataStream out(&key, QIODevice::WriteOnly);
+    if (byUnits)
+    {
+        out << itemIds.value(edge.StartItemId, edge.StartItemId) << edge.StartOnStartCircle
+            << itemIds.value(edge.EndItemId, edge.EndItemId) << edge.EndOnStartCircle << edge.Tear;
+    }
+    else
+    {
+        // XML keeps the end points as written text, a hundredth is enough to tell lines apart
+        out << qRound64(edge.Line.x1() * 100) << qRound64(edge.Line.y1() * 100)
+            << qRound64(edge.Line.x2() * 100) << qRound64(edge.Line.y2() * 100) << edge.Tear;
+    }
+    return key;
+}
+
+SceneDiff SceneDiff::Compare(const SceneSnapshot &before, const SceneSnapshot &after)
+{
+    SceneDiff diff;
+    const QHash<quint64, DiffNode> &beforeNodes = before.GetNodes();
+    const QHash<quint64, DiffNode> &afterNodes = after.GetNodes();
+
+    QList<quint64> unmatched;
+    for (const DiffNode &node : beforeNodes)
+    {
+        auto it = afterNodes.constFind(node.ItemId);
+        if (it == afterNodes.constEnd())
+        {
+            unmatched.append(node.ItemId);
+            continue;
+        }
+        if (it->Content != node.Content)
+        {
+            diff.ChangedNodes.append(node.ItemId);
+        }
+        if (it->Pos != node.Pos)
+        {
+            diff.MovedNodes.append(node.ItemId);
+        }
+    }
+
+    QMultiHash<QByteArray, quint64> newByContent;
+    for (const DiffNode &node : afterNodes)
+    {
+        if (!beforeNodes.contains(node.ItemId))
+        {
+            newByContent.insert(node.Content, node.ItemId);
+        }
+    }
+    for (quint64 itemId : unmatched)
+    {
+        const DiffNode &node = beforeNodes[itemId];
+        auto it = newByContent.find(node.Content);
+        if (it == newByContent.end())
+        {
+            diff.RemovedNodes.append(itemId);
+            continue;
+        }
+        diff.Renumbered.insert(itemId, it.value());
+        if (afterNodes[it.value()].Pos != node.Pos)
+        {
+            diff.MovedNodes.append(it.value());
+        }
+        newByContent.erase(it);
+    }
+    diff.AddedNodes = newByContent.values();
+
+    // connections are counted as a multiset, two lines may join the same circles
+    const bool byUnits = before.HasLineEnds() && after.HasLineEnds();
+    QHash<QByteArray, int> remaining;
+    for (const DiffEdge &edge : before.GetEdges())
+    {
+        ++remaining[SceneSnapshot::EdgeKey(edge, byUnits, diff.Renumbered)];
+    }
+    for (const DiffEdge &edge : after.GetEdges())
+    {
+        int &count = remaining[SceneSnapshot::EdgeKey(edge, byUnits)];
+        if (count > 0)
+        {
+            --count;
+        }
+        else
+        {
+            diff.AddedEdges.append(edge);
+        }
+    }
+    for (const DiffEdge &edge : before.GetEdges())
+    {
+        int &count = remaining[SceneSnapshot::EdgeKey(edge, byUnits, diff.Renumbered)];
+        if (count > 0)
+        {
+            --count;
+            diff.RemovedEdges.append(edge);
+        }
+    }
+
+    std::sort(diff.AddedNodes.begin(), diff.AddedNodes.end());
+    std::sort(diff.RemovedNodes.begin(), diff.RemovedNodes.end());
+    std::sort(diff.ChangedNodes.begin(), diff.ChangedNodes.end());
+    std::sort(diff.MovedNodes.begin(), diff.MovedNodes.end());
+    return diff;
+}
+
+bool SceneDiff::IsEmpty() const
+{
+    return AddedNodes.isEmpty() && RemovedNodes.isEmpty() && ChangedNodes.isEmpty() && MovedNodes.isEmpty()
+           && Renumbered.isEmpty() && AddedEdges.isEmpty() && RemovedEdges.isEmpty();
+}
+
+QString SceneDiff::ToText(const SceneSnapshot &before, const SceneSnapshot &after) const
+{
+    const bool byUnits = before.HasLineEnds() && after.HasLineEnds();
+    QString text;
+    QTextStream out(&text);
+    for (quint64 itemId : AddedNodes)
+    {
+        out << "+ unit " << NodeName(after.GetNodes()[itemId]) << '\n';
+    }
+    for (quint64 itemId : RemovedNodes)
+    {
+        out << "- unit " << NodeName(before.GetNodes()[itemId]) << '\n';
+    }
+    for (quint64 itemId : ChangedNodes)
+    {
+        out << "~ unit " << NodeName(after.GetNodes()[itemId]) << '\n';
+    }
+    for (quint64 itemId : MovedNodes)
+    {
+        out << "> unit " << NodeName(after.GetNodes()[itemId]) << " moved\n";
+    }
+    for (auto it = Renumbered.constBegin(); it != Renumbered.constEnd(); ++it)
+    {
+        out << "= unit " << it.key() << " is now " << it.value() << '\n';
+    }
+    for (const DiffEdge &edge : AddedEdges)
+    {
+        out << "+ line " << EdgeName(edge, byUnits) << '\n';
+    }
+    for (const DiffEdge &edge : RemovedEdges)
+    {
+        out << "- line " << EdgeName(edge, byUnits) << '\n';
+    }
+    out << QString("%1 added, %2 removed, %3 changed, %4 moved units; %5 added, %6 removed lines\n")
+               .arg(AddedNodes.size()).arg(RemovedNodes.size()).arg(ChangedNodes.size()).arg(MovedNodes.size())
+               .arg(AddedEdges.size()).arg(RemovedEdges.size());
+    out.flush();
+    return text;
+}
+
+SceneSnapshot SceneMerge::Merge(const SceneSnapshot &base, const SceneSnapshot &ours, const SceneSnapshot &theirs,
+                                QStringList *conflicts)
+{
+    SceneSnapshot merged;
+    merged.OldestVersion = qMin(base.OldestVersion, qMin(ours.OldestVersion, theirs.OldestVersion));
+    QSet<quint64> itemIds;
+    for (const QHash<quint64, DiffNode> *nodes : {&base.Nodes, &ours.Nodes, &theirs.Nodes})
+    {
+        for (auto it = nodes->constBegin(); it != nodes->constEnd(); ++it)
+        {
+            itemIds.insert(it.key());
+        }
+    }
+
+    for (quint64 itemId : itemIds)
+    {
+        auto find = [itemId](const SceneSnapshot &snapshot) {
+            auto it = snapshot.Nodes.constFind(itemId);
+            return it == snapshot.Nodes.constEnd() ? nullptr : &it.value();
+        };
+        const DiffNode *b = find(base);
+        const DiffNode *o = find(ours);
+        const DiffNode *t = find(theirs);
+        const DiffNode *chosen = o;
+        if (!SameNode(o, t) && SameNode(o, b))
+        {
+            chosen = t;
+        }
+        else if (!SameNode(o, t) && !SameNode(t, b))
+        {
+            chosen = o ? o : t;
+            if (conflicts)
+            {
+                conflicts->append(QString("unit %1 was changed on both sides").arg(itemId));
+            }
+        }
+        if (chosen)
+        {
+            merged.Nodes.insert(itemId, *chosen);
+        }
+    }
+
+    // lines are a multiset: each key gets the count a side changed it to,
+    // or the base count moved by both sides' changes when both did
+    QHash<QByteArray, int> baseCounts, ourCounts, theirCounts;
+    for (const DiffEdge &edge : base.Edges)
+    {
+        ++baseCounts[SceneSnapshot::EdgeKey(edge, true)];
+    }
+    for (const DiffEdge &edge : ours.Edges)
+    {
+        ++ourCounts[SceneSnapshot::EdgeKey(edge, true)];
+    }
+    for (const DiffEdge &edge : theirs.Edges)
+    {
+        ++theirCounts[SceneSnapshot::EdgeKey(edge, true)];
+    }
+    QHash<QByteArray, int> remaining;
+    auto keep = [&](const DiffEdge &edge) {
+        const QByteArray key = SceneSnapshot::EdgeKey(edge, true);
+        auto left = remaining.find(key);
+        if (left == remaining.end())
+        {
+            const int b = baseCounts.value(key);
+            const int o = ourCounts.value(key);
+            const int t = theirCounts.value(key);
+            int count = o;
+            if (o != t && o == b)
+            {
+                count = t;
+            }
+            else if (o != t && t != b)
+            {
+                count = qMax(0, o + t - b);
+            }
+            left = remaining.insert(key, count);
+        }
+        if (left.value() > 0 && merged.Nodes.contains(edge.StartItemId) && merged.Nodes.contains(edge.EndItemId))
+        {
+            --left.value();
+            merged.Edges.append(edge);
+        }
+    };
+    for (const DiffEdge &edge : ours.Edges)
+    {
+        keep(edge);
+    }
+    for (const DiffEdge &edge : theirs.Edges)
+    {
+        keep(edge);
+    }
+    return merged;
+}
+
+bool IsSceneDiffCommand(int argc, char *argv[])
+{
+    return argc > 1 && (std::strcmp(argv[1], "--diff") == 0 || std::strcmp(argv[1], "--merge") == 0);
+}
+
+int RunSceneDiffCommand(const QStringList &arguments)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    QString error;
+    const QString command = arguments.value(1);
+
+    if (command == "--diff" && arguments.size() == 4)
+    {
+        SceneSnapshot before, after;
+        if (!before.Load(arguments.at(2), &error) || !after.Load(arguments.at(3), &error))
+        {
+            err << error << '\n';
+            return 2;
+        }
+        SceneDiff diff = SceneDiff::Compare(before, after);
+        out << diff.ToText(before, after);
+        return diff.IsEmpty() ? 0 : 1;
+    }
+    if (command == "--merge" && arguments.size() == 6)
+    {
+        SceneSnapshot base, ours, theirs;
+        if (!base.Load(arguments.at(2), &error) || !ours.Load(arguments.at(3), &error) || !theirs.Load(arguments.at(4), &error))
+        {
+            err << error << '\n';
+            return 2;
+        }
+        QStringList conflicts;
+        SceneSnapshot merged = SceneMerge::Merge(base, ours, theirs, &conflicts);
+        if (!merged.Save(arguments.at(5), &error))
+        {
+            err << error << '\n';
+            return 2;
+        }
+        for (const QString &conflict : conflicts)
+        {
+            out << "conflict: " << conflict << '\n';
+        }
+        return conflicts.isEmpty() ? 0 : 1;
+    }
+
+    err << "usage: " << arguments.value(0) << " --diff before after\n"
+        << "       " << arguments.value(0) << " --merge base ours theirs output\n";
+    return 2;
+}
@@ -0,0 +1,96 @@
+#ifndef SCENEDIFF_H
+#define SCENEDIFF_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QLineF>
+#include <QPointF>
+#include <QStringList>
+#include <QVector>
+
+struct DiffNode
+{
+    quint64 ItemId;
+    QString Text;
+    int EquipmentType;
+    QPointF Pos;
+    QByteArray Content;     // type, parameters, name and group contents; the position is compared apart
+    QByteArray Record;      // the record as stored, empty for XML files
+};
+
+struct DiffEdge
+{
+    quint64 StartItemId;
+    quint64 EndItemId;
+    bool StartOnStartCircle;
+    bool EndOnStartCircle;
+    bool Tear;
+    QLineF Line;
+    QByteArray Record;
+};
+
+// Units and connections of a flowsheet file read straight from its records,
+// without creating items or decoding the unit images. Binary scenes know the
+// units at both ends of a line, XML files only its end points.
+class SceneSnapshot
+{
+public:
+    bool Load(const QString &fileName, QString *error = nullptr);
+    bool LoadScene(const QByteArray &data, QString *error = nullptr);
+    bool LoadXml(const QByteArray &data, QString *error = nullptr);
+    bool Save(const QString &fileName, QString *error = nullptr) const;
+
+    bool HasLineEnds() const;
+    const QHash<quint64, DiffNode> &GetNodes() const;
+    const QVector<DiffEdge> &GetEdges() const;
+
+    // a connection is known by its units and circles, or by its end points when either file lacks them
+    static QByteArray EdgeKey(const DiffEdge &edge, bool byUnits, const QHash<quint64, quint64> &itemIds = QHash<quint64, quint64>());
+
+private:
+    friend class SceneMerge;
+
+    QHash<quint64, DiffNode> Nodes;
+    QVector<DiffEdge> Edges;
+    bool LineEnds = true;
+    // oldest format the records came from, a merge mixes three files
+    qint32 OldestVersion = 0;
+};
+
+// Differences from one snapshot to another. Units are paired by item id; the
+// ones left over on both sides are paired by identical content, which finds
+// units that were only renumbered. Every step is a hash lookup.
+class SceneDiff
+{
+public:
+    static SceneDiff Compare(const SceneSnapshot &before, const SceneSnapshot &after);
+
+    QList<quint64> AddedNodes;       // ids in the after snapshot
+    QList<quint64> RemovedNodes;     // ids in the before snapshot
+    QList<quint64> ChangedNodes;     // ids in the after snapshot
+    QList<quint64> MovedNodes;       // ids in the after snapshot
+    QHash<quint64, quint64> Renumbered;   // before id to after id
+    QVector<DiffEdge> AddedEdges;
+    QVector<DiffEdge> RemovedEdges;
+
+    bool IsEmpty() const;
+    QString ToText(const SceneSnapshot &before, const SceneSnapshot &after) const;
+};
+
+// Three way merge of binary scenes by item id. A side that left a unit or a
+// connection as it was in the base takes the other side's version. A unit both
+// sides changed differently is reported as a conflict and keeps our version,
+// or theirs when we removed it. Parallel lines between the same circles are
+// counted, so each side's added or removed duplicates carry over.
+class SceneMerge
+{
+public:
+    static SceneSnapshot Merge(const SceneSnapshot &base, const SceneSnapshot &ours, const SceneSnapshot &theirs,
+                               QStringList *conflicts);
+};
+
+// headless entry point: --diff before after, --merge base ours theirs output
+bool IsSceneDiffCommand(int argc, char *argv[]);
+int RunSceneDiffCommand(const QStringList &arguments);
+
+#endif // SCENEDIFF_H
@@ -0,0 +1,186 @@
+#include "searchindex.h"
+#include "parameterblock.h"
+#include <QRegularExpression>
+#include <algorithm>
+
+namespace
+{
+    const int EXACT_ID_SCORE = 3000;
+    const int WHOLE_NAME_SCORE = 2000;
+    const int PREFIX_SCORE = 1000;
+    const int FUZZY_SCORE = 900;
+    // share of the query's trigrams a unit must have to count as a misspelling of it
+    const double MIN_SIMILARITY = 0.5;
+    // a one letter prefix on a large plant would otherwise walk most of the words
+    const int MAX_PREFIX_TERMS = 20000;
+
+    QStringList WordsOf(const QString &text)
+    {
+        static const QRegularExpression separators("[^\\w]+");
+        return text.toLower().split(separators, QString::SkipEmptyParts);
+    }
+
+    quint64 Trigram(QChar a, QChar b, QChar c)
+    {
+        return (quint64(a.unicode()) << 32) | (quint64(b.unicode()) << 16) | quint64(c.unicode());
+    }
+}
+
+void SearchIndex::SetUnit(quint64 itemId, const QString &name, int equipmentType)
+{
+    auto existing = Entries.constFind(itemId);
+    if (existing != Entries.constEnd() && existing->Name == name && existing->EquipmentType == equipmentType)
+    {
+        return;
+    }
+    RemoveUnit(itemId);
+
+    Entry entry;
+    entry.Name = name;
+    entry.EquipmentType = equipmentType;
+    entry.Terms = TermsOf(itemId, name, equipmentType);
+    entry.Trigrams = TrigramsOf(WordsOf(name + ' ' + ParameterBlock::Schema(equipmentType).TypeName));
+    for (const QString &term : entry.Terms)
+    {
+        Terms.insert(term, itemId);
+    }
+    for (quint64 trigram : entry.Trigrams)
+    {
+        Postings[trigram].insert(itemId);
+    }
+    Entries.insert(itemId, entry);
+}
+
+void SearchIndex::RemoveUnit(quint64 itemId)
+{
+    auto it = Entries.find(itemId);
+    if (it == Entries.end())
+    {
+        return;
+    }
+    for (const QString &term : it->Terms)
+    {
+        Terms.remove(term, itemId);
+    }
+    for (quint64 trigram : it->Trigrams)
+    {
+        auto posting = Postings.find(trigram);
+        posting->remove(itemId);
+        if (posting->isEmpty())
+        {
+            Postings.erase(posting);
+        }
+    }
+    Entries.erase(it);
+}
+
+void SearchIndex::Clear()
+{
+    Entries.clear();
+    Terms.clear();
+    Postings.clear();
+}
+
+int SearchIndex::Size() const
+{
+    return Entries.size();
+}
+
+QVector<SearchMatch> SearchIndex::Find(const QString &query, int limit) const
+{
+    const QString text = query.trimmed().toLower();
+    if (text.isEmpty())
+    {
+        return QVector<SearchMatch>();
+    }
+
+    QHash<quint64, int> scores;
+    auto offer = [&](quint64 itemId, int score) {
+        int &best = scores[itemId];
+        best = qMax(best, score);
+    };
+
+    bool numeric = false;
+    quint64 itemId = text.toULongLong(&numeric);
+    if (numeric && Entries.contains(itemId))
+    {
+        offer(itemId, EXACT_ID_SCORE);
+    }
+
+    // shorter completions of the prefix rank first
+    int scanned = 0;
+    for (auto it = Terms.lowerBound(text); it != Terms.constEnd() && it.key().startsWith(text) && scanned < MAX_PREFIX_TERMS;
+         ++it, ++scanned)
+    {
+        const bool wholeName = it.key() == text && text == Entries.constFind(it.value())->Name.trimmed().toLower();
+        offer(it.value(), wholeName ? WHOLE_NAME_SCORE : PREFIX_SCORE - qMin(it.key().length() - text.length(), 99));
+    }
+
+    const QSet<quint64> trigrams = TrigramsOf(WordsOf(text));
+    QHash<quint64, int> shared;
+    for (quint64 trigram : trigrams)
+    {
+        auto posting = Postings.constFind(trigram);
+        if (posting != Postings.constEnd())
+        {
+            for (quint64 candidate : *posting)
+            {
+                ++shared[candidate];
+            }
+        }
+    }
+    for (auto it = shared.constBegin(); it != shared.constEnd(); ++it)
+    {
+        double similarity = double(it.value()) / trigrams.size();
+        if (similarity >= MIN_SIMILARITY)
+        {
+            offer(it.key(), int(FUZZY_SCORE * similarity));
+        }
+    }
+
+    QVector<SearchMatch> matches;
+    matches.reserve(scores.size());
+    for (auto it = scores.constBegin(); it != scores.constEnd(); ++it)
+    {
+        const Entry &entry = Entries.value(it.key());
+        matches.append({it.key(), entry.Name, entry.EquipmentType, it.value()});
+    }
+    auto better = [](const SearchMatch &a, const SearchMatch &b) {
+        return a.Score != b.Score ? a.Score > b.Score : a.ItemId < b.ItemId;
+    };
+    if (matches.size() > limit)
+    {
+        std::partial_sort(matches.begin(), matches.begin() + limit, matches.end(), better);
+        matches.resize(limit);
+    }
+    else
+    {
+        std::sort(matches.begin(), matches.end(), better);
+    }
+    return matches;
+}
+
+QStringList SearchIndex::TermsOf(quint64 itemId, const QString &name, int equipmentType)
+{
+    const QString typeName = ParameterBlock::Schema(equipmentType).TypeName.toLower();
+    QStringList terms = WordsOf(name);
+    terms << name.trimmed().toLower() << typeName << WordsOf(typeName) << QString::number(itemId);
+    terms.removeAll(QString());
+    terms.removeDuplicates();
+    return terms;
+}
+
+// words are padded the way pg_trgm does, so the first letters weigh more than the rest
+QSet<quint64> SearchIndex::TrigramsOf(const QStringList &words)
+{
+    QSet<quint64> trigrams;
+    for (const QString &word : words)
+    {
+        const QString padded = "  " + word + ' ';
+        for (int i = 0; i + 2 < padded.length(); ++i)
+        {
+            trigrams.insert(Trigram(padded.at(i), padded.at(i + 1), padded.at(i + 2)));
+        }
+    }
+    return trigrams;
+}
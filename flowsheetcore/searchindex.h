@@ -0,0 +1,51 @@
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <QHash>
+#include <QMultiMap>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+struct SearchMatch
+{
+    quint64 ItemId;
+    QString Name;
+    int EquipmentType;
+    int Score;
+};
+
+// In-memory index over unit names, item ids and equipment type names. Words
+// are kept sorted for prefix lookups and split into trigrams for fuzzy ones,
+// so a query touches the units sharing its letters rather than every unit.
+// Renaming a unit updates only its own entries.
+class SearchIndex
+{
+public:
+    void SetUnit(quint64 itemId, const QString &name, int equipmentType);
+    void RemoveUnit(quint64 itemId);
+    void Clear();
+    int Size() const;
+
+    // best matches first: exact id, then prefixes of words, then similar spellings
+    QVector<SearchMatch> Find(const QString &query, int limit) const;
+
+private:
+    struct Entry
+    {
+        QString Name;
+        int EquipmentType;
+        QStringList Terms;
+        QSet<quint64> Trigrams;
+    };
+
+    static QStringList TermsOf(quint64 itemId, const QString &name, int equipmentType);
+    static QSet<quint64> TrigramsOf(const QStringList &words);
+
+    QHash<quint64, Entry> Entries;
+    QMultiMap<QString, quint64> Terms;
+    QHash<quint64, QSet<quint64>> Postings;
+};
+
+#endif // SEARCHINDEX_H
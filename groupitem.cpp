@@ -0,0 +1,188 @@
+#include "groupitem.h"
+#include "arrowlineitem.h"
+#include "itemid.h"
+
+namespace
+{
+    void DescribeCircle(QGraphicsEllipseItem *circle, quint64 *itemId, bool *isStartCircle)
+    {
+        CustomPixmapItem *item = static_cast<CustomPixmapItem *>(circle->parentItem());
+        *itemId = item->GetItemId();
+        *isStartCircle = item->GetStartCircle() == circle;
+    }
+}
+
+GroupItem::GroupItem()
+    : CustomPixmapItem(QPixmap(":/icons/images/in_line_equipment.png"))
+    , ContentsCharge(MemoryAccount::Units)
+    , ChildCount(0)
+    , CachedResult(0.0)
+{
+
+}
+
+void GroupItem::SetContents(const QByteArray &contents, int childCount, const QPointF &origin)
+{
+    Contents = contents;
+    ContentsCharge.Set(Contents.size());
+    ChildCount = childCount;
+    Origin = origin;
+}
+
+const QByteArray &GroupItem::GetContents() const
+{
+    return Contents;
+}
+
+int GroupItem::GetChildCount() const
+{
+    return ChildCount;
+}
+
+QPointF GroupItem::GetOrigin() const
+{
+    return Origin;
+}
+
+void GroupItem::SetCachedResult(double result)
+{
+    CachedResult = result;
+}
+
+double GroupItem::GetCachedResult() const
+{
+    return CachedResult;
+}
+
+void GroupItem::AddLink(const GroupLink &link, ArrowLineItem *line)
+{
+    Links.append(link);
+    LineLinks.insert(line, Links.size() - 1);
+}
+
+bool GroupItem::BindLine(ArrowLineItem *line)
+{
+    if (LineLinks.contains(line))
+    {
+        return true;
+    }
+
+    bool groupIsFirst = line->GetStartCircle()->parentItem() == this;
+    QGraphicsEllipseItem *outerCircle = groupIsFirst ? line->GetEndCircle() : line->GetStartCircle();
+    quint64 outerItemId;
+    bool outerIsStartCircle;
+    DescribeCircle(outerCircle, &outerItemId, &outerIsStartCircle);
+
+    QList<int> used = LineLinks.values();
+    for (int i = 0; i < Links.size(); ++i)
+    {
+        const GroupLink &link = Links.at(i);
+        if (link.GroupIsFirst == groupIsFirst && link.OuterItemId == outerItemId
+                && link.OuterIsStartCircle == outerIsStartCircle && !used.contains(i))
+        {
+            LineLinks.insert(line, i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void GroupItem::UnbindLine(ArrowLineItem *line)
+{
+    LineLinks.remove(line);
+}
+
+void GroupItem::RemoveLine(ArrowLineItem *line)
+{
+    auto it = LineLinks.find(line);
+    if (it == LineLinks.end())
+    {
+        return;
+    }
+    int index = it.value();
+    LineLinks.erase(it);
+    Links.remove(index);
+    for (int &linkIndex : LineLinks)
+    {
+        if (linkIndex > index)
+        {
+            --linkIndex;
+        }
+    }
+}
+
+const GroupLink *GroupItem::LinkForLine(ArrowLineItem *line) const
+{
+    auto it = LineLinks.constFind(line);
+    return it == LineLinks.constEnd() ? nullptr : &Links.at(it.value());
+}
+
+const QVector<GroupLink> &GroupItem::GetLinks() const
+{
+    return Links;
+}
+
+void GroupItem::RemapLinks(const QHash<quint64, quint64> &itemIds)
+{
+    for (GroupLink &link : Links)
+    {
+        link.InnerItemId = itemIds.value(link.InnerItemId, link.InnerItemId);
+        link.OuterItemId = itemIds.value(link.OuterItemId, link.OuterItemId);
+        link.EvalItemId = itemIds.value(link.EvalItemId, link.EvalItemId);
+    }
+}
+
+void GroupItem::writeGroup(QDataStream &out) const
+{
+    writeGroup(out, Contents);
+}
+
+void GroupItem::writeGroup(QDataStream &out, const QByteArray &contents) const
+{
+    out << contents << qint32(ChildCount) << Origin << CachedResult;
+
+    // links whose line is paged out or not read yet keep their stored outer side,
+    // bound ones take it from the line because the other unit may have been grouped since
+    QHash<int, ArrowLineItem *> lineOfLink;
+    for (auto it = LineLinks.constBegin(); it != LineLinks.constEnd(); ++it)
+    {
+        lineOfLink.insert(it.value(), it.key());
+    }
+
+    out << qint32(Links.size());
+    for (int i = 0; i < Links.size(); ++i)
+    {
+        GroupLink link = Links.at(i);
+        if (ArrowLineItem *line = lineOfLink.value(i))
+        {
+            QGraphicsEllipseItem *outerCircle = link.GroupIsFirst ? line->GetEndCircle() : line->GetStartCircle();
+            DescribeCircle(outerCircle, &link.OuterItemId, &link.OuterIsStartCircle);
+        }
+
+        out << link.InnerItemId << link.InnerIsStartCircle << link.GroupIsFirst
+            << link.OuterItemId << link.OuterIsStartCircle << link.EvalItemId;
+        link.InnerParameters.write(out);
+    }
+}
+
+void GroupItem::readGroup(QDataStream &in, int version)
+{
+    qint32 childCount, linkCount;
+    in >> Contents >> childCount >> Origin >> CachedResult >> linkCount;
+    ContentsCharge.Set(Contents.size());
+    ChildCount = childCount;
+
+    Links.clear();
+    LineLinks.clear();
+    for (int i = 0; i < linkCount && !in.atEnd(); ++i)
+    {
+        GroupLink link;
+        link.InnerItemId = ReadItemId(in, version);
+        in >> link.InnerIsStartCircle >> link.GroupIsFirst;
+        link.OuterItemId = ReadItemId(in, version);
+        in >> link.OuterIsStartCircle;
+        link.EvalItemId = ReadItemId(in, version);
+        link.InnerParameters.read(in);
+        Links.append(link);
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef GROUPITEM_H
+#define GROUPITEM_H
+
+#include "custompixmapitem.h"
+#include <QByteArray>
+#include <QHash>
+#include <QVector>
+
+class ArrowLineItem;
+
+// A line that crossed the group boundary when it was collapsed. The line now
+// ends at the group, the link remembers where it has to go back to and what
+// the solver needs of the hidden unit.
+struct GroupLink
+{
+    quint64 InnerItemId;
+    bool InnerIsStartCircle;
+    bool GroupIsFirst;
+    quint64 OuterItemId;
+    bool OuterIsStartCircle;
+    // unit the solver sees, differs from InnerItemId when the inner unit is a nested group
+    quint64 EvalItemId;
+    ParameterBlock InnerParameters;
+};
+
+// Collapsed sub-circuit. Its units and internal lines are kept serialized in
+// the scene file record format and only turned back into items on expand.
+class GroupItem : public CustomPixmapItem
+{
+    Q_OBJECT
+public:
+    GroupItem();
+
+    void SetContents(const QByteArray &contents, int childCount, const QPointF &origin);
+    const QByteArray &GetContents() const;
+    int GetChildCount() const;
+    QPointF GetOrigin() const;
+
+    void SetCachedResult(double result);
+    double GetCachedResult() const;
+
+    void AddLink(const GroupLink &link, ArrowLineItem *line);
+    bool BindLine(ArrowLineItem *line);
+    // unbinding keeps the link for when the line comes back, removing drops it
+    void UnbindLine(ArrowLineItem *line);
+    void RemoveLine(ArrowLineItem *line);
+    const GroupLink *LinkForLine(ArrowLineItem *line) const;
+    const QVector<GroupLink> &GetLinks() const;
+    // applied after the contents were given fresh unit ids
+    void RemapLinks(const QHash<quint64, quint64> &itemIds);
+
+    void writeGroup(QDataStream &out) const;
+    // same record with other contents, the clipboard passes them compacted
+    void writeGroup(QDataStream &out, const QByteArray &contents) const;
+    void readGroup(QDataStream &in, int version);
+
+private:
+    QByteArray Contents;
+    // the serialized contents count towards the units they stand for
+    MemoryCharge ContentsCharge;
+    int ChildCount;
+    QPointF Origin;
+    double CachedResult;
+    QVector<GroupLink> Links;
+    QHash<ArrowLineItem *, int> LineLinks;
+};
+
+#endif // GROUPITEM_H
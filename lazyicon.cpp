@@ -0,0 +1,97 @@
+#include "lazyicon.h"
+#include <QApplication>
+#include <QImageReader>
+#include <QPainter>
+#include <QPixmapCache>
+#include <QStyle>
+#include <QStyleOption>
+
+LazyIconEngine::LazyIconEngine(const QString &fileName)
+    : FileName(fileName)
+{
+
+}
+
+void LazyIconEngine::paint(QPainter *painter, const QRect &rect, QIcon::Mode mode, QIcon::State state)
+{
+    QPixmap image = pixmap(rect.size(), mode, state);
+    QSize size = image.size();
+    painter->drawPixmap(QRect(rect.x() + (rect.width() - size.width()) / 2,
+                              rect.y() + (rect.height() - size.height()) / 2,
+                              size.width(), size.height()), image);
+}
+
+QPixmap LazyIconEngine::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state)
+{
+    const QSize actual = actualSize(size, mode, state);
+    if (actual.isEmpty())
+    {
+        return QPixmap();
+    }
+    const quint64 key = (quint64(actual.width()) << 34) | (quint64(actual.height()) << 4) | quint64(mode);
+    auto cached = Pixmaps.constFind(key);
+    if (cached != Pixmaps.constEnd())
+    {
+        return cached.value();
+    }
+    // engines made for the same file hand out the same pixmap, so units
+    // dropped from one palette entry share a single decoded image
+    const QString sharedKey = QString("lazyicon:%1:%2").arg(FileName).arg(key);
+    QPixmap result;
+    if (QPixmapCache::find(sharedKey, &result))
+    {
+        Pixmaps.insert(key, result);
+        return result;
+    }
+
+    QImageReader reader(FileName);
+    if (actual != Source)
+    {
+        reader.setScaledSize(actual);
+    }
+    result = QPixmap::fromImage(reader.read());
+    if (mode != QIcon::Normal && !result.isNull())
+    {
+        QStyleOption option(0);
+        option.palette = QGuiApplication::palette();
+        result = QApplication::style()->generatedIconPixmap(mode, result, &option);
+    }
+    Pixmaps.insert(key, result);
+    QPixmapCache::insert(sharedKey, result);
+    return result;
+}
+
+QSize LazyIconEngine::actualSize(const QSize &size, QIcon::Mode, QIcon::State)
+{
+    // never scaled up, like QIcon with a single file
+    const QSize source = SourceSize();
+    if (source.width() <= size.width() && source.height() <= size.height())
+    {
+        return source;
+    }
+    return source.scaled(size, Qt::KeepAspectRatio);
+}
+
+QIconEngine *LazyIconEngine::clone() const
+{
+    return new LazyIconEngine(*this);
+}
+
+QSize LazyIconEngine::SourceSize()
+{
+    // the header alone gives the size
+    if (!Source.isValid())
+    {
+        Source = QImageReader(FileName).size();
+        if (!Source.isValid())
+        {
+            Source = QSize(0, 0);
+        }
+    }
+    return Source;
+}
+
+QIcon LazyIcon(const QString &fileName)
+{
+    return QIcon(new LazyIconEngine(fileName));
+}
@@ -0,0 +1,33 @@
+#ifndef LAZYICON_H
+#define LAZYICON_H
+
+#include <QHash>
+#include <QIcon>
+#include <QIconEngine>
+#include <QPixmap>
+
+// Icon engine that leaves its image file alone until a pixmap is asked for,
+// then decodes it straight at the requested size. QIcon(fileName) decodes the
+// whole file when the icon is made, which for palettes and context menus is
+// long before anything is shown.
+class LazyIconEngine : public QIconEngine
+{
+public:
+    explicit LazyIconEngine(const QString &fileName);
+
+    void paint(QPainter *painter, const QRect &rect, QIcon::Mode mode, QIcon::State state) override;
+    QPixmap pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state) override;
+    QSize actualSize(const QSize &size, QIcon::Mode mode, QIcon::State state) override;
+    QIconEngine *clone() const override;
+
+private:
+    QSize SourceSize();
+
+    QString FileName;
+    QSize Source;
+    QHash<quint64, QPixmap> Pixmaps;
+};
+
+QIcon LazyIcon(const QString &fileName);
+
+#endif // LAZYICON_H
@@ -1,12 +1,84 @@
+#include "equipmentmodel.h"
 #include "mainwindow.h"
+#include "memorypanel.h"
+#include "scenediff.h"
+#include "sceneexporter.h"
+#include "startupprobe.h"
 
 #include <QApplication>
+#include <QDebug>
+#include <QResource>
+
+namespace
+{
+    // the equipment art is a compressed bundle next to the binary, mapped at
+    // runtime instead of being linked in
+    void RegisterEquipmentArt()
+    {
+        const QString bundle = QCoreApplication::applicationDirPath() + "/equipment.rcc";
+        if (!QResource::registerResource(bundle))
+        {
+            qWarning() << "Could not register" << bundle << "- equipment icons will be missing";
+        }
+    }
+
+    // compiled equipment models are plugins in equipment/ next to the binary,
+    // AGGFLOW_EQUIPMENT_MODELS points elsewhere
+    void RegisterEquipmentModels()
+    {
+        QString directory = qEnvironmentVariable("AGGFLOW_EQUIPMENT_MODELS");
+        if (directory.isEmpty())
+        {
+            directory = QCoreApplication::applicationDirPath() + "/equipment";
+        }
+        EquipmentModelRegistry::Instance().LoadPlugins(directory);
+    }
+}
 
 int main(int argc, char *argv[])
 {
+    StartupProbe::Instance().Mark("main");
+
+    // diff and merge run headless, without a display
+    if (IsSceneDiffCommand(argc, argv))
+    {
+        QCoreApplication app(argc, argv);
+        return RunSceneDiffCommand(app.arguments());
+    }
+
+    // units carry widgets, so drawings need QApplication, just not a display
+    if (IsSceneExportCommand(argc, argv))
+    {
+        if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        }
+        QApplication app(argc, argv);
+        RegisterEquipmentArt();
+        return RunSceneExportCommand(app.arguments());
+    }
+
+    if (IsMemoryReportCommand(argc, argv))
+    {
+        if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        }
+        QApplication app(argc, argv);
+        RegisterEquipmentArt();
+        return RunMemoryReportCommand(app.arguments());
+    }
+
     QApplication app(argc, argv);
+    StartupProbe::Instance().Mark("application");
+    RegisterEquipmentArt();
+    StartupProbe::Instance().Mark("resources");
+    RegisterEquipmentModels();
+    StartupProbe::Instance().Mark("equipment models");
 
     MainWindow mainWindow;
+    StartupProbe::Instance().Mark("window built");
+    StartupProbe::Instance().WatchFirstFrame(&mainWindow);
     mainWindow.show();
 
     return app.exec();
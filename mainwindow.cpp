@@ -6,6 +6,11 @@
 #include <QDrag>
 #include <QMenuBar>
 #include <QVBoxLayout>
+#include "resultwriter.h"
+#include "memorypanel.h"
+#include "minimapwidget.h"
+#include "sceneexporter.h"
+#include <QInputDialog>
 #include <QStandardItemModel>
 #include <QLabel>
 #include <QXmlStreamWriter>
@@ -50,7 +55,6 @@ MainWindow::MainWindow(QWidget *parent)
 void MainWindow::onClear()
 {
     graphicsView->ClearScene();
-    CustomPixmapItem::GlobalItemId = 0;
     status->setText("Result : 0");
     statusBar()->showMessage(tr("Scene cleared"), 2000);
 }
@@ -59,31 +63,20 @@ void MainWindow::SetupUI()
 {
 
     QStringList labels;
-    QList<QIcon> icons;
+    QStringList iconFiles;
     labels << "Item 1" << "Item 2" << "Item 3"<< "Item 4"
            << "Item 5" << "Item 6" << "Item 7"<< "Item 8"
            << "Item 9" << "Item 10" << "Item 11" << "Item 12"
            << "Item 13"<< "Item 14" ;//<< "Item 15" << "Item 16";
 
-    icons << QIcon(":/icons/images/parent/parent_1.png")
-          << QIcon(":/icons/images/parent/parent_2.png")
-          << QIcon(":/icons/images/parent/parent_3.png")
-          << QIcon(":/icons/images/parent/parent_4.png")
-          << QIcon(":/icons/images/parent/parent_5.png")
-          << QIcon(":/icons/images/parent/parent_6.png")
-          << QIcon(":/icons/images/parent/parent_7.png")
-          << QIcon(":/icons/images/parent/parent_8.png")
-          << QIcon(":/icons/images/parent/parent_9.png")
-          << QIcon(":/icons/images/parent/parent_10.png")
-          << QIcon(":/icons/images/parent/parent_11.png")
-          << QIcon(":/icons/images/parent/parent_12.png")
-          << QIcon(":/icons/images/parent/parent_13.png")
-          << QIcon(":/icons/images/parent/parent_14.png");
-          // << QIcon(":/icons/images/new/parent_15.png")
-          // << QIcon(":/icons/images/new/parent_16.png");
+    // the palette row is the equipment type less one, see IconListModel
+    for (int equipmentType = 1; equipmentType <= labels.size(); ++equipmentType)
+    {
+        iconFiles << CustomPixmapItem::IconFileFor(equipmentType);
+    }
 
     IconListModel *model = new IconListModel(this);
-    model->setData(labels, icons);
+    model->setData(labels, iconFiles);
 
     listView->setModel(model);
     listView->setIconSize(QSize(40, 40));
@@ -110,6 +103,18 @@ void MainWindow::SetupUI()
 
     hlayout->setSpacing(7);
 
+    minimapDock = new QDockWidget(tr("Overview"), this);
+    minimapDock->setObjectName("minimapDock");
+    minimapDock->setWidget(new MinimapWidget(graphicsView, minimapDock));
+    addDockWidget(Qt::RightDockWidgetArea, minimapDock);
+
+    // hidden until asked for, it only refreshes while shown
+    memoryDock = new QDockWidget(tr("Memory"), this);
+    memoryDock->setObjectName("memoryDock");
+    memoryDock->setWidget(new MemoryPanel(memoryDock));
+    addDockWidget(Qt::RightDockWidgetArea, memoryDock);
+    memoryDock->hide();
+
     setMinimumSize(800, 600);
     statusBar();
 }
@@ -119,6 +124,8 @@ void MainWindow::createMenus()
     fileMenu = menuBar()->addMenu(tr("&File"));
     fileMenu->addAction(saveAction);
     fileMenu->addAction(saveAsAction);
+    fileMenu->addAction(exportAction);
+    fileMenu->addAction(exportDrawingAction);
     fileMenu->addSeparator();
     fileMenu->addAction(loadAction);
     fileMenu->addAction(clearAction);
@@ -133,7 +140,18 @@ void MainWindow::createMenus()
     viewMenu = menuBar()->addMenu(tr("&View"));
     viewMenu->addAction(zoomInAction);
     viewMenu->addAction(zoomOutAction);
+    viewMenu->addAction(minimapDock->toggleViewAction());
+    viewMenu->addAction(memoryDock->toggleViewAction());
     viewMenu->addSeparator();
+    viewMenu->addAction(routingAction);
+    viewMenu->addAction(autoLayoutAction);
+    viewMenu->addAction(tiledSceneAction);
+    viewMenu->addSeparator();
+    viewMenu->addAction(simulateAction);
+    viewMenu->addAction(monteCarloAction);
+    viewMenu->addSeparator();
+    viewMenu->addAction(compareAction);
+    viewMenu->addAction(clearComparisonAction);
 }
 
 void MainWindow::createActions()
@@ -141,19 +159,27 @@ void MainWindow::createActions()
     saveAction = new QAction(tr("&Save"), this);
     saveAction->setShortcuts(QKeySequence::Save);
     saveAction->setStatusTip(tr("Ctrl+S"));
-    saveAction->setIcon(QIcon(":/icons/images/save.png"));
+    saveAction->setIcon(LazyIcon(":/icons/images/save.png"));
     connect(saveAction, &QAction::triggered, this, &MainWindow::onSave);
 
     saveAsAction = new QAction(tr("&Save As"), this);
     saveAsAction->setShortcuts(QKeySequence::SaveAs);
     saveAsAction->setShortcut(tr("Ctrl+Shift+S"));
-    saveAsAction->setIcon(QIcon(":/icons/images/save_as.png"));
+    saveAsAction->setIcon(LazyIcon(":/icons/images/save_as.png"));
     connect(saveAsAction, &QAction::triggered, this, &MainWindow::onSaveAs);
 
+    exportAction = new QAction(tr("&Export Results..."), this);
+    exportAction->setStatusTip(tr("Write the stream table to CSV or a columnar file"));
+    connect(exportAction, &QAction::triggered, this, &MainWindow::onExport);
+
+    exportDrawingAction = new QAction(tr("Export &Drawing..."), this);
+    exportDrawingAction->setStatusTip(tr("Write the flowsheet as a PNG, SVG or PDF drawing"));
+    connect(exportDrawingAction, &QAction::triggered, this, &MainWindow::onExportDrawing);
+
     loadAction = new QAction(tr("&Load"), this);
     loadAction->setShortcuts(QKeySequence::Open);
     loadAction->setStatusTip(tr("Ctrl+O"));
-    loadAction->setIcon(QIcon(":/icons/images/loading.png"));
+    loadAction->setIcon(LazyIcon(":/icons/images/loading.png"));
     connect(loadAction, &QAction::triggered, this, &MainWindow::onLoad);
 
     clearAction = new QAction(tr("&Clear"), this);
@@ -168,29 +194,59 @@ void MainWindow::createActions()
     undoAction = new QAction(tr("&Undo"), this);
     undoAction->setShortcut(tr("Ctrl+Z"));
     undoAction->setStatusTip(tr("Undo last operation"));
-    undoAction->setIcon(QIcon(":/icons/images/undo.png"));
+    undoAction->setIcon(LazyIcon(":/icons/images/undo.png"));
     connect(undoAction, &QAction::triggered, graphicsView, &CustomGraphicsView::UndoTriggered);
 
     redoAction = new QAction(tr("&Redo"), this);
     redoAction->setShortcut(tr("Ctrl+Shift+Z"));
     redoAction->setStatusTip(tr("Redo last operation"));
-    redoAction->setIcon(QIcon(":/icons/images/redo.png"));
+    redoAction->setIcon(LazyIcon(":/icons/images/redo.png"));
     connect(redoAction, &QAction::triggered, graphicsView, &CustomGraphicsView::RedoTriggered);
 
     zoomInAction = new QAction(tr("&Zoom In"), this);
     zoomInAction->setStatusTip(tr("Zoom In"));
-    zoomInAction->setIcon(QIcon(":/icons/images/zoom_in.png"));
+    zoomInAction->setIcon(LazyIcon(":/icons/images/zoom_in.png"));
     connect(zoomInAction, &QAction::triggered, this, &MainWindow::zoomIn);
 
     zoomOutAction = new QAction(tr("&Zoom Out"), this);
     zoomOutAction->setStatusTip(tr("Zoom Out"));
-    zoomOutAction->setIcon(QIcon(":/icons/images/zoom_out.png"));
+    zoomOutAction->setIcon(LazyIcon(":/icons/images/zoom_out.png"));
     connect(zoomOutAction, &QAction::triggered, this, &MainWindow::zoomOut);
 
     zoomToFitAction = new QAction(tr("&Zoom to Fit"), this);
     zoomToFitAction->setStatusTip(tr("Zoom to Fit"));
-    zoomToFitAction->setIcon(QIcon(":/icons/images/zoom_to_fit.PNG"));
+    zoomToFitAction->setIcon(LazyIcon(":/icons/images/zoom_to_fit.PNG"));
     connect(zoomToFitAction, &QAction::triggered, this, &MainWindow::zoomToFit);
+
+    routingAction = new QAction(tr("&Orthogonal Routing"), this);
+    routingAction->setStatusTip(tr("Route lines around equipment"));
+    routingAction->setCheckable(true);
+    routingAction->setChecked(true);
+    connect(routingAction, &QAction::toggled, graphicsView, &CustomGraphicsView::SetOrthogonalRouting);
+
+    autoLayoutAction = new QAction(tr("&Auto Layout"), this);
+    autoLayoutAction->setStatusTip(tr("Arrange units in layers following the flow"));
+    connect(autoLayoutAction, &QAction::triggered, graphicsView, &CustomGraphicsView::AutoLayout);
+
+    tiledSceneAction = new QAction(tr("&Tiled Scene"), this);
+    tiledSceneAction->setStatusTip(tr("Keep only the units around the viewport in the scene"));
+    tiledSceneAction->setCheckable(true);
+    connect(tiledSceneAction, &QAction::toggled, graphicsView, &CustomGraphicsView::SetTiledMode);
+
+    simulateAction = new QAction(tr("&Simulate..."), this);
+    simulateAction->setStatusTip(tr("Run the plant over simulated time, run again to cancel"));
+    connect(simulateAction, &QAction::triggered, graphicsView, &CustomGraphicsView::RunSimulation);
+
+    monteCarloAction = new QAction(tr("&Monte Carlo..."), this);
+    monteCarloAction->setStatusTip(tr("Solve the flowsheet for random feed rates and summarise the product"));
+    connect(monteCarloAction, &QAction::triggered, graphicsView, &CustomGraphicsView::RunMonteCarlo);
+
+    compareAction = new QAction(tr("&Compare With File..."), this);
+    compareAction->setStatusTip(tr("Outline what differs from a saved flowsheet"));
+    connect(compareAction, &QAction::triggered, this, &MainWindow::onCompare);
+
+    clearComparisonAction = new QAction(tr("C&lear Comparison"), this);
+    connect(clearComparisonAction, &QAction::triggered, graphicsView, &CustomGraphicsView::ClearComparison);
 }
 
 void MainWindow::createToolbar()
@@ -206,11 +262,54 @@ void MainWindow::createToolbar()
     editToolBar->addAction(zoomOutAction);
     editToolBar->addAction(zoomToFitAction);
     editToolBar->addSeparator();
+
+    searchEdit = new QLineEdit(editToolBar);
+    searchEdit->setPlaceholderText(tr("Find unit by name, id or type"));
+    searchEdit->setClearButtonEnabled(true);
+    searchEdit->setMaximumWidth(240);
+    searchModel = new QStandardItemModel(this);
+    // the index has ranked the matches already, the completer only shows them;
+    // picking one puts its id in the box so Return finds the same unit again
+    QCompleter *completer = new QCompleter(searchModel, this);
+    completer->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+    completer->setCompletionRole(Qt::UserRole);
+    searchEdit->setCompleter(completer);
+    connect(searchEdit, &QLineEdit::textEdited, this, &MainWindow::onSearchEdited);
+    connect(searchEdit, &QLineEdit::returnPressed, this, &MainWindow::onSearch);
+    connect(completer, QOverload<const QModelIndex &>::of(&QCompleter::activated), this, &MainWindow::onSearchActivated);
+    editToolBar->addWidget(searchEdit);
     removeToolBar(editToolBar);
     addToolBar(editToolBar);
     editToolBar->show();
 }
 
+void MainWindow::onSearchEdited(const QString &text)
+{
+    searchModel->clear();
+    for (const SearchMatch &match : graphicsView->SearchUnits(text, 20))
+    {
+        QString label = match.Name.isEmpty() ? ParameterBlock::Schema(match.EquipmentType).TypeName
+                                             : match.Name;
+        QStandardItem *row = new QStandardItem(QString("%1  (#%2)").arg(label).arg(match.ItemId));
+        row->setData(QString::number(match.ItemId), Qt::UserRole);
+        searchModel->appendRow(row);
+    }
+}
+
+void MainWindow::onSearch()
+{
+    QVector<SearchMatch> matches = graphicsView->SearchUnits(searchEdit->text(), 1);
+    if (matches.isEmpty() || !graphicsView->FocusUnit(matches.first().ItemId))
+    {
+        statusBar()->showMessage(tr("No unit matches \"%1\"").arg(searchEdit->text()), 2000);
+    }
+}
+
+void MainWindow::onSearchActivated(const QModelIndex &index)
+{
+    graphicsView->FocusUnit(index.data(Qt::UserRole).toULongLong());
+}
+
 void MainWindow::setCurrentFile(const QString &fileName)
 {
     currentFile = fileName;
@@ -246,6 +345,44 @@ void MainWindow::onSaveAs()
     onSave();
 }
 
+void MainWindow::onExport()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Export Results"), "", ResultWriter::FileFilter());
+    if (fileName.isEmpty())
+        return;
+    graphicsView->ExportResults(fileName);
+}
+
+void MainWindow::onExportDrawing()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Export Drawing"), "", SceneExporter::FileFilter());
+    if (fileName.isEmpty())
+        return;
+    int dpi = 300;
+    if (!fileName.endsWith(".svg", Qt::CaseInsensitive))
+    {
+        bool ok = false;
+        dpi = QInputDialog::getInt(this, tr("Export Drawing"), tr("Resolution (dpi):"), dpi, 30, 2400, 1, &ok);
+        if (!ok)
+            return;
+    }
+    QString error;
+    if (!graphicsView->ExportDrawing(fileName, dpi, &error))
+    {
+        QMessageBox::warning(this, tr("Export Drawing"), error);
+        return;
+    }
+    statusBar()->showMessage(tr("Drawing exported"), 2000);
+}
+
+void MainWindow::onCompare()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Compare With File"), "", tr("Scene Files (*.scene);;XML Files (*.xml)"));
+    if (fileName.isEmpty())
+        return;
+    graphicsView->CompareWithFile(fileName);
+}
+
 void MainWindow::onLoad()
 {
     graphicsView->ClearScene();
@@ -286,125 +423,125 @@ void MainWindow::onItemClicked(const QModelIndex &index)
 
     switch (index.row()) {
     case 0:
-        menuIcons = {QIcon(":/icons/images/parent/Child1/child_1_1.png"),
-                     QIcon(":/icons/images/parent/Child1/child_1_2.png"),
-                     QIcon(":/icons/images/parent/Child1/child_1_3.png"),
-                     QIcon(":/icons/images/parent/Child1/child_1_4.png"),
-                     QIcon(":/icons/images/parent/Child1/child_1_5.png"),
-                     QIcon(":/icons/images/parent/Child1/child_1_6.png"),
-                     QIcon(":/icons/images/parent/Child1/child_1_7.png")};
+        menuIcons = {LazyIcon(":/icons/images/parent/Child1/child_1_1.png"),
+                     LazyIcon(":/icons/images/parent/Child1/child_1_2.png"),
+                     LazyIcon(":/icons/images/parent/Child1/child_1_3.png"),
+                     LazyIcon(":/icons/images/parent/Child1/child_1_4.png"),
+                     LazyIcon(":/icons/images/parent/Child1/child_1_5.png"),
+                     LazyIcon(":/icons/images/parent/Child1/child_1_6.png"),
+                     LazyIcon(":/icons/images/parent/Child1/child_1_7.png")};
         break;
     case 1:
-        menuIcons = {QIcon(":/icons/images/parent/Child2/child_2_1.png"),
-                     QIcon(":/icons/images/parent/Child2/child_2_2.png"),
-                     QIcon(":/icons/images/parent/Child2/child_2_2.png"),
-                     QIcon(":/icons/images/parent/Child2/child_2_3.png"),
-                     QIcon(":/icons/images/parent/Child2/child_2_4.png"),
-                     QIcon(":/icons/images/parent/Child2/child_2_5.png"),
-                     QIcon(":/icons/images/parent/Child2/child_2_6.png"),
-                     QIcon(":/icons/images/parent/Child2/child_2_7.png")};
+        menuIcons = {LazyIcon(":/icons/images/parent/Child2/child_2_1.png"),
+                     LazyIcon(":/icons/images/parent/Child2/child_2_2.png"),
+                     LazyIcon(":/icons/images/parent/Child2/child_2_2.png"),
+                     LazyIcon(":/icons/images/parent/Child2/child_2_3.png"),
+                     LazyIcon(":/icons/images/parent/Child2/child_2_4.png"),
+                     LazyIcon(":/icons/images/parent/Child2/child_2_5.png"),
+                     LazyIcon(":/icons/images/parent/Child2/child_2_6.png"),
+                     LazyIcon(":/icons/images/parent/Child2/child_2_7.png")};
         break;
     case 2:
-        menuIcons = {QIcon(":/icons/images/parent/Child3/child_3_1.png"),
-                     QIcon(":/icons/images/parent/Child3/child_3_2.png"),
-                     QIcon(":/icons/images/parent/Child3/child_3_3.png"),
-                     QIcon(":/icons/images/parent/Child3/child_3_4.png"),
-                     QIcon(":/icons/images/parent/Child3/child_3_5.png"),
-                     QIcon(":/icons/images/parent/Child3/child_3_6.png"),
-                     QIcon(":/icons/images/parent/Child3/child_3_7.png"),
-                     QIcon(":/icons/images/parent/Child3/child_3_8.png")};
+        menuIcons = {LazyIcon(":/icons/images/parent/Child3/child_3_1.png"),
+                     LazyIcon(":/icons/images/parent/Child3/child_3_2.png"),
+                     LazyIcon(":/icons/images/parent/Child3/child_3_3.png"),
+                     LazyIcon(":/icons/images/parent/Child3/child_3_4.png"),
+                     LazyIcon(":/icons/images/parent/Child3/child_3_5.png"),
+                     LazyIcon(":/icons/images/parent/Child3/child_3_6.png"),
+                     LazyIcon(":/icons/images/parent/Child3/child_3_7.png"),
+                     LazyIcon(":/icons/images/parent/Child3/child_3_8.png")};
         break;
     case 3:
-        menuIcons = {QIcon(":/icons/images/parent/Child4/child4_1.png"),
-                     QIcon(":/icons/images/parent/Child4/child4_2.png"),
-                     QIcon(":/icons/images/parent/Child4/child4_3.png"),
-                     QIcon(":/icons/images/parent/Child4/child4_4.png"),
-                     QIcon(":/icons/images/parent/Child4/child4_5.png")};
+        menuIcons = {LazyIcon(":/icons/images/parent/Child4/child4_1.png"),
+                     LazyIcon(":/icons/images/parent/Child4/child4_2.png"),
+                     LazyIcon(":/icons/images/parent/Child4/child4_3.png"),
+                     LazyIcon(":/icons/images/parent/Child4/child4_4.png"),
+                     LazyIcon(":/icons/images/parent/Child4/child4_5.png")};
         break;
     case 4:
-        menuIcons = {QIcon(":/icons/images/parent/Child5/child_5_1.png"),
-                     QIcon(":/icons/images/parent/Child5/child_5_2.png"),
-                     QIcon(":/icons/images/parent/Child5/child_5_3.png"),
-                     QIcon(":/icons/images/parent/Child5/child_5_4.png"),
-                     QIcon(":/icons/images/parent/Child5/child_5_5.png"),
-                     QIcon(":/icons/images/parent/Child5/child_5_6.png")};
+        menuIcons = {LazyIcon(":/icons/images/parent/Child5/child_5_1.png"),
+                     LazyIcon(":/icons/images/parent/Child5/child_5_2.png"),
+                     LazyIcon(":/icons/images/parent/Child5/child_5_3.png"),
+                     LazyIcon(":/icons/images/parent/Child5/child_5_4.png"),
+                     LazyIcon(":/icons/images/parent/Child5/child_5_5.png"),
+                     LazyIcon(":/icons/images/parent/Child5/child_5_6.png")};
         break;
     case 5:
-        menuIcons = {QIcon(":/icons/images/parent/Child6/child_6_1.png"),
-                     QIcon(":/icons/images/parent/Child6/child_6_2.png"),
-                     QIcon(":/icons/images/parent/Child6/child_6_2.png"),
-                     QIcon(":/icons/images/parent/Child6/child_6_3.png"),
-                     QIcon(":/icons/images/parent/Child6/child_6_4.png"),
-                     QIcon(":/icons/images/parent/Child6/child_6_5.png"),
-                     QIcon(":/icons/images/parent/Child6/child_6_6.png"),
-                     QIcon(":/icons/images/parent/Child6/child_6_7.png"),
-                     QIcon(":/icons/images/parent/Child6/child_6_8.png"),
-                     QIcon(":/icons/images/parent/Child6/child_6_9.png")};
+        menuIcons = {LazyIcon(":/icons/images/parent/Child6/child_6_1.png"),
+                     LazyIcon(":/icons/images/parent/Child6/child_6_2.png"),
+                     LazyIcon(":/icons/images/parent/Child6/child_6_2.png"),
+                     LazyIcon(":/icons/images/parent/Child6/child_6_3.png"),
+                     LazyIcon(":/icons/images/parent/Child6/child_6_4.png"),
+                     LazyIcon(":/icons/images/parent/Child6/child_6_5.png"),
+                     LazyIcon(":/icons/images/parent/Child6/child_6_6.png"),
+                     LazyIcon(":/icons/images/parent/Child6/child_6_7.png"),
+                     LazyIcon(":/icons/images/parent/Child6/child_6_8.png"),
+                     LazyIcon(":/icons/images/parent/Child6/child_6_9.png")};
         break;
     case 6:
-        menuIcons = {QIcon(":/icons/images/parent/Child7/child_7_1.png"),
-                     QIcon(":/icons/images/parent/Child7/child_7_2.png"),
-                     QIcon(":/icons/images/parent/Child7/child_7_2.png"),
-                     QIcon(":/icons/images/parent/Child7/child_7_3.png"),
-                     QIcon(":/icons/images/parent/Child7/child_7_4.png"),
-                     QIcon(":/icons/images/parent/Child7/child_7_5.png"),
-                     QIcon(":/icons/images/parent/Child7/child_7_6.png"),
-                     QIcon(":/icons/images/parent/Child7/child_7_7.png")};
+        menuIcons = {LazyIcon(":/icons/images/parent/Child7/child_7_1.png"),
+                     LazyIcon(":/icons/images/parent/Child7/child_7_2.png"),
+                     LazyIcon(":/icons/images/parent/Child7/child_7_2.png"),
+                     LazyIcon(":/icons/images/parent/Child7/child_7_3.png"),
+                     LazyIcon(":/icons/images/parent/Child7/child_7_4.png"),
+                     LazyIcon(":/icons/images/parent/Child7/child_7_5.png"),
+                     LazyIcon(":/icons/images/parent/Child7/child_7_6.png"),
+                     LazyIcon(":/icons/images/parent/Child7/child_7_7.png")};
         break;
     case 7:
-        menuIcons = {QIcon(":/icons/images/parent/Child8/child_8_1.png"),
-                     QIcon(":/icons/images/parent/Child8/child_8_2.png"),
-                     QIcon(":/icons/images/parent/Child8/child_8_3.png"),
-                     QIcon(":/icons/images/parent/Child8/child_8_4.png"),
-                     QIcon(":/icons/images/parent/Child8/child_8_5.png"),
-                     QIcon(":/icons/images/parent/Child8/child_8_6.png"),
-                     QIcon(":/icons/images/parent/Child8/child_8_7.png"),
-                     QIcon(":/icons/images/parent/Child8/child_8_8.png"),
-                     QIcon(":/icons/images/parent/Child8/child_8_9.png")};
+        menuIcons = {LazyIcon(":/icons/images/parent/Child8/child_8_1.png"),
+                     LazyIcon(":/icons/images/parent/Child8/child_8_2.png"),
+                     LazyIcon(":/icons/images/parent/Child8/child_8_3.png"),
+                     LazyIcon(":/icons/images/parent/Child8/child_8_4.png"),
+                     LazyIcon(":/icons/images/parent/Child8/child_8_5.png"),
+                     LazyIcon(":/icons/images/parent/Child8/child_8_6.png"),
+                     LazyIcon(":/icons/images/parent/Child8/child_8_7.png"),
+                     LazyIcon(":/icons/images/parent/Child8/child_8_8.png"),
+                     LazyIcon(":/icons/images/parent/Child8/child_8_9.png")};
         break;
     case 8:
-        menuIcons = {QIcon(":/icons/images/parent/Child9/child_9_1.png"),
-                     QIcon(":/icons/images/parent/Child9/child_9_2.png")};
+        menuIcons = {LazyIcon(":/icons/images/parent/Child9/child_9_1.png"),
+                     LazyIcon(":/icons/images/parent/Child9/child_9_2.png")};
         break;
     case 9:
-        menuIcons = {QIcon(":/icons/images/parent/Child10/child_10_1.png"),
-                     QIcon(":/icons/images/parent/Child10/child_10_2.png"),
-                     QIcon(":/icons/images/parent/Child10/child_10_3.png"),
-                     QIcon(":/icons/images/parent/Child10/child_10_4.png"),
-                     QIcon(":/icons/images/parent/Child10/child_10_5.png")};
+        menuIcons = {LazyIcon(":/icons/images/parent/Child10/child_10_1.png"),
+                     LazyIcon(":/icons/images/parent/Child10/child_10_2.png"),
+                     LazyIcon(":/icons/images/parent/Child10/child_10_3.png"),
+                     LazyIcon(":/icons/images/parent/Child10/child_10_4.png"),
+                     LazyIcon(":/icons/images/parent/Child10/child_10_5.png")};
         break;
     case 10:
-        menuIcons = {QIcon(":/icons/images/parent/Child11/child_11_1.png"),
-                     QIcon(":/icons/images/parent/Child11/child_11_2.png"),
-                     QIcon(":/icons/images/parent/Child11/child_11_3.png"),
-                     QIcon(":/icons/images/parent/Child11/child_11_4.png"),
-                     QIcon(":/icons/images/parent/Child11/child_11_5.png"),
-                     QIcon(":/icons/images/parent/Child11/child_11_6.png"),
-                     QIcon(":/icons/images/parent/Child11/child_11_7.png"),
-                     QIcon(":/icons/images/parent/Child11/child_11_8.png")};
+        menuIcons = {LazyIcon(":/icons/images/parent/Child11/child_11_1.png"),
+                     LazyIcon(":/icons/images/parent/Child11/child_11_2.png"),
+                     LazyIcon(":/icons/images/parent/Child11/child_11_3.png"),
+                     LazyIcon(":/icons/images/parent/Child11/child_11_4.png"),
+                     LazyIcon(":/icons/images/parent/Child11/child_11_5.png"),
+                     LazyIcon(":/icons/images/parent/Child11/child_11_6.png"),
+                     LazyIcon(":/icons/images/parent/Child11/child_11_7.png"),
+                     LazyIcon(":/icons/images/parent/Child11/child_11_8.png")};
         break;
     case 11:
-        menuIcons = {QIcon(":/icons/images/parent/Child12/child_12_1.png")};
+        menuIcons = {LazyIcon(":/icons/images/parent/Child12/child_12_1.png")};
         break;
     case 12:
-        menuIcons = {QIcon(":/icons/images/parent/Child13/child_13_1.png"),
-                     QIcon(":/icons/images/parent/Child13/child_13_2.png"),
-                     QIcon(":/icons/images/parent/Child13/child_13_3.png"),
-                     QIcon(":/icons/images/parent/Child13/child_13_4.png")};
+        menuIcons = {LazyIcon(":/icons/images/parent/Child13/child_13_1.png"),
+                     LazyIcon(":/icons/images/parent/Child13/child_13_2.png"),
+                     LazyIcon(":/icons/images/parent/Child13/child_13_3.png"),
+                     LazyIcon(":/icons/images/parent/Child13/child_13_4.png")};
         break;
     case 13:
-        menuIcons = {QIcon(":/icons/images/parent/Child14/child_14_1.png"),
-                     QIcon(":/icons/images/parent/Child14/child_14_2.png"),
-                     QIcon(":/icons/images/parent/Child14/child_14_3.png"),
-                     QIcon(":/icons/images/parent/Child14/child_14_4.png"),
-                     QIcon(":/icons/images/parent/Child14/child_14_5.png"),
-                     QIcon(":/icons/images/parent/Child14/child_14_6.png"),
-                     QIcon(":/icons/images/parent/Child14/child_14_7.png"),
-                     QIcon(":/icons/images/parent/Child14/child_14_8.png"),
-                     QIcon(":/icons/images/parent/Child14/child_14_9.png"),
-                     QIcon(":/icons/images/parent/Child14/child_14_10.png"),
-                     QIcon(":/icons/images/parent/Child14/child_14_11.png"),
-                     QIcon(":/icons/images/parent/Child14/child_14_12.png")};
+        menuIcons = {LazyIcon(":/icons/images/parent/Child14/child_14_1.png"),
+                     LazyIcon(":/icons/images/parent/Child14/child_14_2.png"),
+                     LazyIcon(":/icons/images/parent/Child14/child_14_3.png"),
+                     LazyIcon(":/icons/images/parent/Child14/child_14_4.png"),
+                     LazyIcon(":/icons/images/parent/Child14/child_14_5.png"),
+                     LazyIcon(":/icons/images/parent/Child14/child_14_6.png"),
+                     LazyIcon(":/icons/images/parent/Child14/child_14_7.png"),
+                     LazyIcon(":/icons/images/parent/Child14/child_14_8.png"),
+                     LazyIcon(":/icons/images/parent/Child14/child_14_9.png"),
+                     LazyIcon(":/icons/images/parent/Child14/child_14_10.png"),
+                     LazyIcon(":/icons/images/parent/Child14/child_14_11.png"),
+                     LazyIcon(":/icons/images/parent/Child14/child_14_12.png")};
         break;
 
     default:
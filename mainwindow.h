@@ -12,6 +12,9 @@
 #include <QLabel>
 #include <QStringList>
 #include <QList>
+#include <QLineEdit>
+#include <QCompleter>
+#include <QDockWidget>
 
 class MainWindow : public QMainWindow
 {
@@ -24,6 +27,9 @@ private slots:
     void onClear();
     void onSave();
     void onSaveAs();
+    void onExport();
+    void onExportDrawing();
+    void onCompare();
     void onLoad();
     void onOldPos(QString data);
     void onNewPos(QString data);
@@ -34,6 +40,9 @@ private slots:
     void zoomIn();
     void zoomOut();
     void zoomToFit();
+    void onSearchEdited(const QString &text);
+    void onSearch();
+    void onSearchActivated(const QModelIndex &index);
 
 private:
     void SetupUI();
@@ -59,6 +68,8 @@ private:
     QMenu *resultMenu;
     QAction *saveAction;
     QAction *saveAsAction;
+    QAction *exportAction;
+    QAction *exportDrawingAction;
     QAction *loadAction;
     QAction *clearAction;
     QAction *exitAction;
@@ -67,7 +78,18 @@ private:
     QAction *zoomInAction;
     QAction *zoomOutAction;
     QAction *zoomToFitAction;
+    QAction *routingAction;
+    QAction *autoLayoutAction;
+    QAction *tiledSceneAction;
+    QAction *simulateAction;
+    QAction *monteCarloAction;
+    QAction *compareAction;
+    QAction *clearComparisonAction;
     QAction *runAction;
+    QLineEdit *searchEdit;
+    QDockWidget *minimapDock;
+    QDockWidget *memoryDock;
+    QStandardItemModel *searchModel;
     QString currentFile;
     qreal zoomFactor;
 };
@@ -0,0 +1,150 @@
+#include "memorypanel.h"
+#include "customgraphicsview.h"
+#include "memoryaccount.h"
+#include <QFile>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QHeaderView>
+#include <QLabel>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QTableWidget>
+#include <QTextStream>
+#include <QVBoxLayout>
+#include <cstring>
+
+namespace
+{
+    const int REFRESH_INTERVAL_MS = 1000;
+
+    QString FormatBytes(qint64 bytes)
+    {
+        if (bytes < 0)
+        {
+            return QStringLiteral("-");
+        }
+        if (bytes < 1024)
+        {
+            return QString("%1 B").arg(bytes);
+        }
+        if (bytes < 1024 * 1024)
+        {
+            return QString("%1 KiB").arg(bytes / 1024.0, 0, 'f', 1);
+        }
+        return QString("%1 MiB").arg(bytes / (1024.0 * 1024.0), 0, 'f', 1);
+    }
+
+    QTableWidgetItem *NumberItem(const QString &text)
+    {
+        QTableWidgetItem *item = new QTableWidgetItem(text);
+        item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        return item;
+    }
+}
+
+MemoryPanel::MemoryPanel(QWidget *parent)
+    : QWidget(parent)
+    , Table(new QTableWidget(MemoryAccount::CategoryCount, 3, this))
+    , Summary(new QLabel(this))
+{
+    Table->setHorizontalHeaderLabels({tr("Category"), tr("Objects"), tr("Bytes")});
+    Table->verticalHeader()->hide();
+    Table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    Table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    Table->setSelectionMode(QAbstractItemView::NoSelection);
+
+    QPushButton *saveButton = new QPushButton(tr("Save Report..."), this);
+    connect(saveButton, &QPushButton::clicked, this, &MemoryPanel::onSaveReport);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(Table);
+    layout->addWidget(Summary);
+    layout->addWidget(saveButton);
+
+    RefreshTimer.setInterval(REFRESH_INTERVAL_MS);
+    connect(&RefreshTimer, &QTimer::timeout, this, &MemoryPanel::Refresh);
+    Refresh();
+}
+
+void MemoryPanel::Refresh()
+{
+    for (int row = 0; row < MemoryAccount::CategoryCount; ++row)
+    {
+        MemoryAccount::Category category = MemoryAccount::Category(row);
+        Table->setItem(row, 0, new QTableWidgetItem(MemoryAccount::Name(category)));
+        Table->setItem(row, 1, NumberItem(QString::number(MemoryAccount::Objects(category))));
+        Table->setItem(row, 2, NumberItem(FormatBytes(MemoryAccount::Bytes(category))));
+    }
+    Summary->setText(tr("Accounted %1 of %2 resident")
+                     .arg(FormatBytes(MemoryAccount::TotalBytes()), FormatBytes(MemoryAccount::ResidentBytes())));
+}
+
+void MemoryPanel::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    Refresh();
+    RefreshTimer.start();
+}
+
+void MemoryPanel::hideEvent(QHideEvent *event)
+{
+    QWidget::hideEvent(event);
+    RefreshTimer.stop();
+}
+
+void MemoryPanel::onSaveReport()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Save Memory Report"), "", tr("JSON Files (*.json)"));
+    if (fileName.isEmpty())
+        return;
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(MemoryAccount::ToJson()) < 0)
+    {
+        QMessageBox::warning(this, tr("Save Memory Report"), tr("Could not write %1: %2").arg(fileName, file.errorString()));
+    }
+}
+
+bool IsMemoryReportCommand(int argc, char *argv[])
+{
+    return argc > 1 && std::strcmp(argv[1], "--memory-report") == 0;
+}
+
+int RunMemoryReportCommand(const QStringList &arguments)
+{
+    QTextStream err(stderr);
+    if (arguments.size() < 3 || arguments.size() > 4)
+    {
+        err << "usage: " << arguments.value(0) << " --memory-report scene [output.json]\n";
+        return 2;
+    }
+
+    const QString sceneFile = arguments.at(2);
+    if (!QFileInfo(sceneFile).isReadable())
+    {
+        err << "Could not read " << sceneFile << '\n';
+        return 2;
+    }
+    CustomGraphicsView view;
+    if (QFileInfo(sceneFile).suffix().compare("xml", Qt::CaseInsensitive) == 0)
+    {
+        view.loadFromXml(sceneFile);
+    }
+    else
+    {
+        view.loadFromFile(sceneFile);
+    }
+
+    const QByteArray report = MemoryAccount::ToJson();
+    if (arguments.size() < 4)
+    {
+        QTextStream(stdout) << report;
+        return 0;
+    }
+    QFile file(arguments.at(3));
+    if (!file.open(QIODevice::WriteOnly) || file.write(report) < 0)
+    {
+        err << "Could not write " << arguments.at(3) << ": " << file.errorString() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,40 @@
+#ifndef MEMORYPANEL_H
+#define MEMORYPANEL_H
+
+#include <QStringList>
+#include <QTimer>
+#include <QWidget>
+
+class QLabel;
+class QTableWidget;
+
+// Live view of the memory account: objects and bytes per category next to
+// the process's resident set, refreshed while the panel is visible. The same
+// figures can be saved as the JSON report the headless command prints.
+class MemoryPanel : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit MemoryPanel(QWidget *parent = nullptr);
+
+public slots:
+    void Refresh();
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private slots:
+    void onSaveReport();
+
+private:
+    QTableWidget *Table;
+    QLabel *Summary;
+    QTimer RefreshTimer;
+};
+
+// headless entry point: --memory-report scene [output.json]
+bool IsMemoryReportCommand(int argc, char *argv[]);
+int RunMemoryReportCommand(const QStringList &arguments);
+
+#endif // MEMORYPANEL_H
@@ -0,0 +1,278 @@
+#include "minimapwidget.h"
+#include "customgraphicsview.h"
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <QtConcurrent>
+#include <cmath>
+
+namespace
+{
+    // scene units per tile and its side in pixels, an eighth of full size
+    const qreal TILE_SCENE_SIZE = 1024.0;
+    const int TILE_PIXELS = 128;
+    const int MAX_BATCH_TILES = 32;
+    const int EXTENT_MARGIN = 4;
+
+    quint64 TileKey(qint32 x, qint32 y)
+    {
+        return (quint64(quint32(x)) << 32) | quint32(y);
+    }
+}
+
+OverviewTile RenderOverviewTile(const OverviewJob &job)
+{
+    OverviewTile tile = {job.Key, job.Generation, QImage()};
+    if (job.Shapes.isEmpty())
+    {
+        return tile;
+    }
+
+    tile.Image = QImage(TILE_PIXELS, TILE_PIXELS, QImage::Format_ARGB32_Premultiplied);
+    tile.Image.fill(Qt::transparent);
+    QPainter painter(&tile.Image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.scale(TILE_PIXELS / job.Rect.width(), TILE_PIXELS / job.Rect.height());
+    painter.translate(-job.Rect.topLeft());
+
+    QPen linePen(QColor(40, 70, 160), 0);
+    for (const OverviewShape &shape : job.Shapes)
+    {
+        if (shape.Rect.isNull())
+        {
+            painter.setPen(linePen);
+            painter.setBrush(Qt::NoBrush);
+            painter.drawPolyline(shape.Path);
+        }
+        else
+        {
+            painter.setPen(Qt::NoPen);
+            painter.setBrush(shape.Paged ? QColor(170, 170, 170) : QColor(80, 80, 80));
+            painter.drawRect(shape.Rect);
+        }
+    }
+    return tile;
+}
+
+MinimapWidget::MinimapWidget(CustomGraphicsView *view, QWidget *parent)
+    : QWidget(parent)
+    , View(view)
+    , NextGeneration(0)
+{
+    setMinimumSize(120, 80);
+    setCursor(Qt::PointingHandCursor);
+    connect(View->scene(), &QGraphicsScene::changed, this, &MinimapWidget::onSceneChanged);
+    connect(View, &CustomGraphicsView::sceneReset, this, &MinimapWidget::Reset);
+    connect(&Watcher, &QFutureWatcher<OverviewTile>::finished, this, &MinimapWidget::onBatchFinished);
+
+    // the viewport outline follows scrolling and zooming
+    auto repaint = [this]() { update(); };
+    connect(View->horizontalScrollBar(), &QScrollBar::valueChanged, this, repaint);
+    connect(View->verticalScrollBar(), &QScrollBar::valueChanged, this, repaint);
+    connect(View->horizontalScrollBar(), &QScrollBar::rangeChanged, this, repaint);
+    connect(View->verticalScrollBar(), &QScrollBar::rangeChanged, this, repaint);
+
+    MarkDirty(View->scene()->itemsBoundingRect());
+}
+
+MinimapWidget::~MinimapWidget()
+{
+    Watcher.waitForFinished();
+}
+
+QSize MinimapWidget::sizeHint() const
+{
+    return QSize(240, 160);
+}
+
+void MinimapWidget::Reset()
+{
+    // results of a batch still running are dropped with their generations
+    Tiles.clear();
+    Generations.clear();
+    Pending.clear();
+    UpdateExtent();
+    update();
+}
+
+void MinimapWidget::onSceneChanged(const QList<QRectF> &regions)
+{
+    for (const QRectF &region : regions)
+    {
+        MarkDirty(region);
+    }
+    StartBatch();
+}
+
+void MinimapWidget::MarkDirty(const QRectF &region)
+{
+    if (region.isEmpty())
+    {
+        return;
+    }
+    const qint32 x0 = qint32(std::floor(region.left() / TILE_SCENE_SIZE));
+    const qint32 x1 = qint32(std::floor(region.right() / TILE_SCENE_SIZE));
+    const qint32 y0 = qint32(std::floor(region.top() / TILE_SCENE_SIZE));
+    const qint32 y1 = qint32(std::floor(region.bottom() / TILE_SCENE_SIZE));
+    for (qint32 x = x0; x <= x1; ++x)
+    {
+        for (qint32 y = y0; y <= y1; ++y)
+        {
+            quint64 key = TileKey(x, y);
+            Generations[key] = ++NextGeneration;
+            Pending.insert(key);
+        }
+    }
+}
+
+void MinimapWidget::StartBatch()
+{
+    // a hidden overview only collects dirty tiles, it catches up when shown
+    if (Watcher.isRunning() || Pending.isEmpty() || !isVisible())
+    {
+        return;
+    }
+
+    QVector<OverviewJob> jobs;
+    jobs.reserve(qMin(Pending.size(), MAX_BATCH_TILES));
+    for (auto it = Pending.begin(); it != Pending.end() && jobs.size() < MAX_BATCH_TILES;)
+    {
+        QRectF rect = TileRect(*it);
+        jobs.append({*it, Generations.value(*it), rect, ShapesIn(rect)});
+        it = Pending.erase(it);
+    }
+    Watcher.setFuture(QtConcurrent::mapped(jobs, RenderOverviewTile));
+}
+
+void MinimapWidget::onBatchFinished()
+{
+    const QList<OverviewTile> tiles = Watcher.future().results();
+    for (const OverviewTile &tile : tiles)
+    {
+        // the tile was touched again while this batch was running
+        auto it = Generations.find(tile.Key);
+        if (it == Generations.end() || it.value() != tile.Generation)
+        {
+            continue;
+        }
+        Generations.erase(it);
+        if (tile.Image.isNull())
+        {
+            Tiles.remove(tile.Key);
+        }
+        else
+        {
+            Tiles.insert(tile.Key, tile.Image);
+        }
+    }
+    UpdateExtent();
+    update();
+    StartBatch();
+}
+
+QVector<OverviewShape> MinimapWidget::ShapesIn(const QRectF &rect) const
+{
+    QVector<OverviewShape> shapes;
+    for (QGraphicsItem *item : View->scene()->items(rect, Qt::IntersectsItemBoundingRect, Qt::AscendingOrder))
+    {
+        // members of a group are drawn as the group
+        if (item->parentItem() || !item->isVisible())
+        {
+            continue;
+        }
+        if (ArrowLineItem *line = dynamic_cast<ArrowLineItem *>(item))
+        {
+            QPolygonF path = line->GetRoute();
+            if (path.isEmpty())
+            {
+                path << line->line().p1() << line->line().p2();
+            }
+            shapes.append({QRectF(), line->mapToScene(path), false});
+        }
+        else if (dynamic_cast<CustomPixmapItem *>(item))
+        {
+            shapes.append({item->sceneBoundingRect(), QPolygonF(), false});
+        }
+    }
+    for (const QRectF &unit : View->PagedUnitRects(rect))
+    {
+        shapes.append({unit, QPolygonF(), true});
+    }
+    return shapes;
+}
+
+QRectF MinimapWidget::TileRect(quint64 key) const
+{
+    qint32 x = qint32(quint32(key >> 32));
+    qint32 y = qint32(quint32(key));
+    return QRectF(x * TILE_SCENE_SIZE, y * TILE_SCENE_SIZE, TILE_SCENE_SIZE, TILE_SCENE_SIZE);
+}
+
+void MinimapWidget::UpdateExtent()
+{
+    Extent = View->sceneRect();
+    for (auto it = Tiles.constBegin(); it != Tiles.constEnd(); ++it)
+    {
+        Extent = Extent.united(TileRect(it.key()));
+    }
+}
+
+void MinimapWidget::paintEvent(QPaintEvent *)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::white);
+    if (Extent.isEmpty())
+    {
+        UpdateExtent();
+    }
+
+    QRectF target = QRectF(rect()).adjusted(EXTENT_MARGIN, EXTENT_MARGIN, -EXTENT_MARGIN, -EXTENT_MARGIN);
+    qreal scale = qMin(target.width() / Extent.width(), target.height() / Extent.height());
+    SceneToWidget = QTransform::fromTranslate(-Extent.center().x(), -Extent.center().y())
+                    * QTransform::fromScale(scale, scale)
+                    * QTransform::fromTranslate(target.center().x(), target.center().y());
+
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    for (auto it = Tiles.constBegin(); it != Tiles.constEnd(); ++it)
+    {
+        painter.drawImage(SceneToWidget.mapRect(TileRect(it.key())), it.value());
+    }
+
+    QRectF visible = View->mapToScene(View->viewport()->rect()).boundingRect();
+    QPen pen(Qt::red, 1);
+    painter.setPen(pen);
+    painter.setBrush(Qt::NoBrush);
+    painter.drawRect(SceneToWidget.mapRect(visible));
+}
+
+void MinimapWidget::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton)
+    {
+        PanTo(event->pos());
+    }
+}
+
+void MinimapWidget::mouseMoveEvent(QMouseEvent *event)
+{
+    if (event->buttons() & Qt::LeftButton)
+    {
+        PanTo(event->pos());
+    }
+}
+
+void MinimapWidget::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    StartBatch();
+}
+
+void MinimapWidget::PanTo(const QPoint &pos)
+{
+    bool invertible = false;
+    QTransform widgetToScene = SceneToWidget.inverted(&invertible);
+    if (invertible)
+    {
+        View->PanTo(widgetToScene.map(QPointF(pos)));
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef MINIMAPWIDGET_H
+#define MINIMAPWIDGET_H
+
+#include <QFutureWatcher>
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QPolygonF>
+#include <QRectF>
+#include <QSet>
+#include <QTransform>
+#include <QVector>
+#include <QWidget>
+
+class CustomGraphicsView;
+
+// Unit box or line as the overview draws it. Rect is null for lines.
+struct OverviewShape
+{
+    QRectF Rect;
+    QPolygonF Path;
+    bool Paged;
+};
+
+struct OverviewJob
+{
+    quint64 Key;
+    int Generation;
+    QRectF Rect;
+    QVector<OverviewShape> Shapes;
+};
+
+struct OverviewTile
+{
+    quint64 Key;
+    int Generation;
+    QImage Image;
+};
+
+// Paints one tile of the overview. Pure function, safe to call from worker threads.
+OverviewTile RenderOverviewTile(const OverviewJob &job);
+
+// Overview of the whole flowsheet drawn from low resolution tiles. The scene's
+// changed regions mark tiles dirty; their shapes are copied on the GUI thread
+// and painted into images on the global thread pool, a bounded batch at a
+// time, so an edit only costs the tiles it touched. Clicking or dragging pans
+// the view.
+class MinimapWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit MinimapWidget(CustomGraphicsView *view, QWidget *parent = nullptr);
+    ~MinimapWidget();
+
+    QSize sizeHint() const override;
+
+public slots:
+    void Reset();
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+
+private slots:
+    void onSceneChanged(const QList<QRectF> &regions);
+    void onBatchFinished();
+
+private:
+    void MarkDirty(const QRectF &region);
+    void StartBatch();
+    QVector<OverviewShape> ShapesIn(const QRectF &rect) const;
+    QRectF TileRect(quint64 key) const;
+    void UpdateExtent();
+    void PanTo(const QPoint &pos);
+
+    CustomGraphicsView *View;
+    QHash<quint64, QImage> Tiles;
+    QHash<quint64, int> Generations;
+    QSet<quint64> Pending;
+    QFutureWatcher<OverviewTile> Watcher;
+    int NextGeneration;
+    QRectF Extent;
+    // scene to widget mapping of the last paint, used to map clicks back
+    QTransform SceneToWidget;
+};
+
+#endif // MINIMAPWIDGET_H
@@ -0,0 +1,187 @@
+#include "nodeindex.h"
+#include "custompixmapitem.h"
+
+namespace
+{
+    const int MIN_SLOT_BITS = 4;
+    // Fibonacci hashing spreads consecutive ids over the whole table
+    const quint64 HASH_MULTIPLIER = Q_UINT64_C(11400714819323198485);
+}
+
+NodeIndex::NodeIndex()
+{
+    Clear();
+}
+
+bool NodeIndex::Insert(CustomPixmapItem *node)
+{
+    const quint64 itemId = node->GetItemId();
+    int slot = Locate(itemId);
+    if (slot >= 0 && Slots.at(slot).Status == ResidentSlot && Slots.at(slot).Node != node)
+    {
+        return false;
+    }
+    slot = Claim(itemId);
+    Slot &entry = Slots[slot];
+    if (entry.Status != ResidentSlot)
+    {
+        ++ResidentCount;
+    }
+    entry.Status = ResidentSlot;
+    entry.Node = node;
+    return true;
+}
+
+void NodeIndex::MarkPaged(quint64 itemId)
+{
+    Slot &entry = Slots[Claim(itemId)];
+    if (entry.Status == ResidentSlot)
+    {
+        --ResidentCount;
+    }
+    entry.Status = PagedSlot;
+    entry.Node = nullptr;
+}
+
+void NodeIndex::Remove(quint64 itemId)
+{
+    int slot = Locate(itemId);
+    if (slot < 0)
+    {
+        return;
+    }
+    Slot &entry = Slots[slot];
+    if (entry.Status == ResidentSlot)
+    {
+        --ResidentCount;
+    }
+    // a tombstone keeps the probe chains through this slot intact
+    entry.Status = DeletedSlot;
+    entry.Node = nullptr;
+}
+
+void NodeIndex::Clear()
+{
+    Slots = QVector<Slot>(1 << MIN_SLOT_BITS, {0, EmptySlot, nullptr});
+    Shift = 64 - MIN_SLOT_BITS;
+    Used = 0;
+    ResidentCount = 0;
+}
+
+CustomPixmapItem *NodeIndex::Find(quint64 itemId) const
+{
+    int slot = Locate(itemId);
+    return slot >= 0 ? Slots.at(slot).Node : nullptr;
+}
+
+NodeIndex::State NodeIndex::StateOf(quint64 itemId) const
+{
+    int slot = Locate(itemId);
+    if (slot < 0)
+    {
+        return Missing;
+    }
+    return Slots.at(slot).Status == ResidentSlot ? Resident : Paged;
+}
+
+int NodeIndex::Size() const
+{
+    return ResidentCount;
+}
+
+QList<CustomPixmapItem *> NodeIndex::ResidentNodes() const
+{
+    QList<CustomPixmapItem *> nodes;
+    nodes.reserve(ResidentCount);
+    for (const Slot &entry : Slots)
+    {
+        if (entry.Status == ResidentSlot)
+        {
+            nodes.append(entry.Node);
+        }
+    }
+    return nodes;
+}
+
+int NodeIndex::Home(quint64 itemId) const
+{
+    return int((itemId * HASH_MULTIPLIER) >> Shift);
+}
+
+int NodeIndex::Locate(quint64 itemId) const
+{
+    const int mask = Slots.size() - 1;
+    for (int slot = Home(itemId);; slot = (slot + 1) & mask)
+    {
+        const Slot &entry = Slots.at(slot);
+        if (entry.Status == EmptySlot)
+        {
+            return -1;
+        }
+        if (entry.Status != DeletedSlot && entry.ItemId == itemId)
+        {
+            return slot;
+        }
+    }
+}
+
+int NodeIndex::Claim(quint64 itemId)
+{
+    int slot = Locate(itemId);
+    if (slot >= 0)
+    {
+        return slot;
+    }
+    if ((Used + 1) * 2 > Slots.size())
+    {
+        Rehash();
+    }
+
+    const int mask = Slots.size() - 1;
+    for (slot = Home(itemId);; slot = (slot + 1) & mask)
+    {
+        Slot &entry = Slots[slot];
+        if (entry.Status == EmptySlot || entry.Status == DeletedSlot)
+        {
+            if (entry.Status == EmptySlot)
+            {
+                ++Used;
+            }
+            entry.ItemId = itemId;
+            return slot;
+        }
+    }
+}
+
+void NodeIndex::Rehash()
+{
+    // sized for the live entries, so a table full of tombstones shrinks back
+    QVector<Slot> live;
+    for (const Slot &entry : Slots)
+    {
+        if (entry.Status == ResidentSlot || entry.Status == PagedSlot)
+        {
+            live.append(entry);
+        }
+    }
+    int bits = MIN_SLOT_BITS;
+    while ((1 << bits) < (live.size() + 1) * 4)
+    {
+        ++bits;
+    }
+    const int capacity = 1 << bits;
+    Shift = 64 - bits;
+
+    Slots = QVector<Slot>(capacity, {0, EmptySlot, nullptr});
+    Used = live.size();
+    const int mask = capacity - 1;
+    for (const Slot &entry : live)
+    {
+        int slot = Home(entry.ItemId);
+        while (Slots.at(slot).Status != EmptySlot)
+        {
+            slot = (slot + 1) & mask;
+        }
+        Slots[slot] = entry;
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef NODEINDEX_H
+#define NODEINDEX_H
+
+#include <QList>
+#include <QVector>
+
+class CustomPixmapItem;
+
+// Item id to unit lookup shared by the loaders, the solver, the undo commands
+// and the comparison outlines. Open addressing with linear probing over a
+// power of two table kept at most half full, so a lookup is one multiply and
+// usually one cache line. Paged out units keep a slot without a unit, which
+// tells a missing id from one that only has to be read back.
+class NodeIndex
+{
+public:
+    enum State
+    {
+        Missing,
+        Resident,
+        Paged
+    };
+
+    NodeIndex();
+
+    // false when another resident unit already holds the id
+    bool Insert(CustomPixmapItem *node);
+    void MarkPaged(quint64 itemId);
+    void Remove(quint64 itemId);
+    void Clear();
+
+    CustomPixmapItem *Find(quint64 itemId) const;
+    State StateOf(quint64 itemId) const;
+    int Size() const;
+    QList<CustomPixmapItem *> ResidentNodes() const;
+
+private:
+    enum SlotState : quint8
+    {
+        EmptySlot,
+        ResidentSlot,
+        PagedSlot,
+        DeletedSlot
+    };
+
+    struct Slot
+    {
+        quint64 ItemId;
+        SlotState Status;
+        CustomPixmapItem *Node;
+    };
+
+    int Home(quint64 itemId) const;
+    int Locate(quint64 itemId) const;
+    int Claim(quint64 itemId);
+    void Rehash();
+
+    QVector<Slot> Slots;
+    int Shift;
+    // occupied slots, tombstones included, and residents alone
+    int Used;
+    int ResidentCount;
+};
+
+#endif // NODEINDEX_H
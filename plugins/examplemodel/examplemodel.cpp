@@ -0,0 +1,90 @@
+#include "examplemodel.h"
+#include "dualnumber.h"
+#include <QtNumeric>
+#include <algorithm>
+
+namespace
+{
+    // equipment types and parameter slots, see the schemas in parameterblock.cpp
+    const int SCREEN_TYPE = 6;
+    const int SCREEN_EFFICIENCY = 2;
+    const int CRUSHER_TYPE = 7;
+    const int CRUSHER_CAPACITY = 2;
+
+    // a parameter of stream i, or the fallback when the unit has none set
+    double Parameter(const EquipmentBatch &batch, int i, int slot, double fallback)
+    {
+        if (slot >= batch.DoubleCount)
+        {
+            return fallback;
+        }
+        const double value = batch.Doubles[i * batch.DoubleCount + slot];
+        return qIsNaN(value) ? fallback : value;
+    }
+
+    bool IsSet(const EquipmentBatch &batch, int i, int slot)
+    {
+        return slot < batch.DoubleCount && !qIsNaN(batch.Doubles[i * batch.DoubleCount + slot]);
+    }
+
+    int ParameterSlot(int equipmentType)
+    {
+        return equipmentType == CRUSHER_TYPE ? CRUSHER_CAPACITY : SCREEN_EFFICIENCY;
+    }
+
+    // what a stream delivers, given what it is fed and the unit's capacity or efficiency
+    template <typename T>
+    T Output(int equipmentType, const T &fed, const T &parameter)
+    {
+        return equipmentType == CRUSHER_TYPE ? qMin(fed, parameter) : fed * parameter;
+    }
+}
+
+QString ExampleModel::Name() const
+{
+    return QStringLiteral("example");
+}
+
+QString ExampleModel::Version() const
+{
+    return QStringLiteral("1");
+}
+
+QVector<int> ExampleModel::EquipmentTypes() const
+{
+    return {SCREEN_TYPE, CRUSHER_TYPE};
+}
+
+void ExampleModel::Evaluate(int equipmentType, const EquipmentBatch &batch, double *outputs) const
+{
+    for (int i = 0; i < batch.Count; ++i)
+    {
+        const double fed = batch.Inlets[i];
+        const double fallback = equipmentType == CRUSHER_TYPE ? fed : 1.0;
+        outputs[i] = Output(equipmentType, fed, Parameter(batch, i, ParameterSlot(equipmentType), fallback));
+    }
+}
+
+void ExampleModel::Differentiate(int equipmentType, const EquipmentBatch &batch,
+                                 double *byInlet, double *byUnit, double *byDoubles) const
+{
+    typedef DualNumber<double> Dual;
+    const int slot = ParameterSlot(equipmentType);
+    std::fill(byDoubles, byDoubles + batch.Count * batch.DoubleCount, 0.0);
+    for (int i = 0; i < batch.Count; ++i)
+    {
+        // input 0 is what the stream is fed, 1 the parameter when it is set
+        const Dual fed = Dual::Variable(batch.Inlets[i], 0);
+        const bool set = IsSet(batch, i, slot);
+        const Dual parameter = set ? Dual::Variable(batch.Doubles[i * batch.DoubleCount + slot], 1)
+                                   : (equipmentType == CRUSHER_TYPE ? fed : Dual(1.0));
+        const Dual output = Output(equipmentType, fed, parameter);
+        byInlet[i] = output.Derivative(0);
+        // the unit's own value is not used
+        byUnit[i] = 0.0;
+        if (set)
+        {
+            byDoubles[i * batch.DoubleCount + slot] = output.Derivative(1);
+        }
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef EXAMPLEMODEL_H
+#define EXAMPLEMODEL_H
+
+#include <QObject>
+#include "equipmentmodel.h"
+
+// Minimal plugin showing how a model reads the unit parameters: crushers pass
+// what they are fed up to their capacity, screens pass their efficiency's
+// share. Parameters left unset fall back to passing everything. The arithmetic
+// is written once as a template, so the partials come from dual numbers.
+class ExampleModel : public QObject, public EquipmentModel
+{
+    Q_OBJECT
+    Q_PLUGIN_METADATA(IID EquipmentModel_iid FILE "examplemodel.json")
+    Q_INTERFACES(EquipmentModel)
+
+public:
+    QString Name() const override;
+    QString Version() const override;
+    QVector<int> EquipmentTypes() const override;
+    void Evaluate(int equipmentType, const EquipmentBatch &batch, double *outputs) const override;
+    void Differentiate(int equipmentType, const EquipmentBatch &batch,
+                       double *byInlet, double *byUnit, double *byDoubles) const override;
+};
+
+#endif // EXAMPLEMODEL_H
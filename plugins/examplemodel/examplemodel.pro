@@ -0,0 +1,31 @@
+# Example equipment model plugin. It only needs the EquipmentModel interface
+# and DualNumber, which are header only, so it does not link flowsheetcore.
+# Built into the equipment directory beside the editor, where main.cpp loads
+# it from.
+QT       = core
+
+TEMPLATE = lib
+CONFIG += plugin c++11
+TARGET = examplemodel
+
+INCLUDEPATH += $$PWD/../../flowsheetcore
+DEPENDPATH += $$PWD/../../flowsheetcore
+
+SOURCES += \
+    examplemodel.cpp
+
+HEADERS += \
+    examplemodel.h
+
+DISTFILES += \
+    examplemodel.json
+
+DESTDIR = $$OUT_PWD/../../equipment
+win32 {
+    CONFIG(debug, debug|release): DESTDIR = $$OUT_PWD/../../debug/equipment
+    else: DESTDIR = $$OUT_PWD/../../release/equipment
+}
+
+qnx: target.path = /tmp/FinalAggFlowTest/bin/equipment
+else: unix:!android: target.path = /opt/FinalAggFlowTest/bin/equipment
+!isEmpty(target.path): INSTALLS += target
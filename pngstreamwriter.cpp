@@ -0,0 +1,311 @@
+#include "pngstreamwriter.h"
+#include <QVector>
+#include <QtEndian>
+
+namespace
+{
+    const quint32 ADLER_BASE = 65521;
+    const int MIN_MATCH = 3;
+    const int MAX_MATCH = 258;
+    // compressed bytes gathered before an IDAT chunk is written
+    const int CHUNK_BYTES = 1 << 20;
+
+    const int LENGTH_BASE[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                               35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    const int LENGTH_EXTRA[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+    quint32 Crc32(const QByteArray &data, quint32 crc = 0xffffffffu)
+    {
+        static const QVector<quint32> table = []() {
+            QVector<quint32> t(256);
+            for (quint32 n = 0; n < 256; ++n)
+            {
+                quint32 c = n;
+                for (int k = 0; k < 8; ++k)
+                {
+                    c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                }
+                t[int(n)] = c;
+            }
+            return t;
+        }();
+        for (char byte : data)
+        {
+            crc = table.at(int((crc ^ quint8(byte)) & 0xff)) ^ (crc >> 8);
+        }
+        return crc;
+    }
+
+    // checksum of two pieces from their own checksums, as zlib's adler32_combine
+    quint32 CombineAdler(quint32 first, quint32 second, quint64 secondLength)
+    {
+        quint64 rem = secondLength % ADLER_BASE;
+        quint64 sum1 = first & 0xffff;
+        quint64 sum2 = (rem * sum1) % ADLER_BASE;
+        sum1 += (second & 0xffff) + ADLER_BASE - 1;
+        sum2 += (first >> 16) + (second >> 16) + ADLER_BASE - rem;
+        sum1 %= ADLER_BASE;
+        sum2 %= ADLER_BASE;
+        return quint32(sum1 | (sum2 << 16));
+    }
+
+    class FixedDeflater
+    {
+    public:
+        explicit FixedDeflater(QByteArray *out) : Out(out)
+        {
+            // BFINAL 0, BTYPE 01
+            WriteBits(2, 3);
+        }
+
+        void Feed(const uchar *data, int size)
+        {
+            for (int i = 0; i < size; ++i)
+            {
+                const uchar byte = data[i];
+                A = (A + byte) % ADLER_BASE;
+                B = (B + A) % ADLER_BASE;
+                if (HasLast && byte == Last)
+                {
+                    if (++Run == MAX_MATCH)
+                    {
+                        FlushRun();
+                    }
+                    continue;
+                }
+                FlushRun();
+                WriteLiteral(byte);
+                Last = byte;
+                HasLast = true;
+            }
+            Length += quint64(size);
+        }
+
+        // ends the block and pads with an empty stored block, as a zlib sync flush
+        void Finish()
+        {
+            FlushRun();
+            WriteCode(0, 7);
+            WriteBits(0, 3);
+            if (BitCount > 0)
+            {
+                WriteBits(0, 8 - BitCount);
+            }
+            Out->append(char(0x00)).append(char(0x00)).append(char(0xff)).append(char(0xff));
+        }
+
+        quint32 Adler() const { return (B << 16) | A; }
+        quint64 GetLength() const { return Length; }
+
+    private:
+        void FlushRun()
+        {
+            if (Run >= MIN_MATCH)
+            {
+                WriteMatch(Run);
+            }
+            else
+            {
+                for (int i = 0; i < Run; ++i)
+                {
+                    WriteLiteral(Last);
+                }
+            }
+            Run = 0;
+        }
+
+        void WriteLiteral(uchar byte)
+        {
+            if (byte < 144)
+            {
+                WriteCode(0x30 + byte, 8);
+            }
+            else
+            {
+                WriteCode(0x190 + (byte - 144), 9);
+            }
+        }
+
+        // distance is always 1, distance code 0 in five bits
+        void WriteMatch(int length)
+        {
+            int index = 28;
+            while (LENGTH_BASE[index] > length)
+            {
+                --index;
+            }
+            int symbol = 257 + index;
+            if (symbol < 280)
+            {
+                WriteCode(symbol - 256, 7);
+            }
+            else
+            {
+                WriteCode(0xc0 + (symbol - 280), 8);
+            }
+            WriteBits(quint32(length - LENGTH_BASE[index]), LENGTH_EXTRA[index]);
+            WriteCode(0, 5);
+        }
+
+        // Huffman codes go most significant bit first
+        void WriteCode(quint32 code, int length)
+        {
+            quint32 reversed = 0;
+            for (int i = 0; i < length; ++i)
+            {
+                reversed = (reversed << 1) | ((code >> i) & 1);
+            }
+            WriteBits(reversed, length);
+        }
+
+        void WriteBits(quint32 value, int count)
+        {
+            Bits |= quint64(value) << BitCount;
+            BitCount += count;
+            while (BitCount >= 8)
+            {
+                Out->append(char(Bits & 0xff));
+                Bits >>= 8;
+                BitCount -= 8;
+            }
+        }
+
+        QByteArray *Out;
+        quint64 Bits = 0;
+        int BitCount = 0;
+        uchar Last = 0;
+        bool HasLast = false;
+        int Run = 0;
+        quint32 A = 1;
+        quint32 B = 0;
+        quint64 Length = 0;
+    };
+}
+
+PngStreamWriter::Band PngStreamWriter::EncodeBand(const QImage &band)
+{
+    const QImage image = band.format() == QImage::Format_RGB32 ? band : band.convertToFormat(QImage::Format_RGB32);
+    const int width = image.width();
+    Band result;
+    FixedDeflater deflater(&result.Deflate);
+    QByteArray row(1 + 3 * width, Qt::Uninitialized);
+    uchar *bytes = reinterpret_cast<uchar *>(row.data());
+    for (int y = 0; y < image.height(); ++y)
+    {
+        // Sub filter: each byte less the same channel of the pixel to its left
+        const QRgb *pixels = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+        bytes[0] = 1;
+        QRgb left = 0;
+        for (int x = 0; x < width; ++x)
+        {
+            const QRgb pixel = pixels[x];
+            bytes[1 + 3 * x] = uchar(qRed(pixel) - qRed(left));
+            bytes[2 + 3 * x] = uchar(qGreen(pixel) - qGreen(left));
+            bytes[3 + 3 * x] = uchar(qBlue(pixel) - qBlue(left));
+            left = pixel;
+        }
+        deflater.Feed(bytes, row.size());
+    }
+    deflater.Finish();
+    result.Adler = deflater.Adler();
+    result.Length = deflater.GetLength();
+    return result;
+}
+
+PngStreamWriter::~PngStreamWriter()
+{
+    if (File.isOpen())
+    {
+        File.close();
+    }
+}
+
+bool PngStreamWriter::Open(const QString &fileName, int width, int height)
+{
+    File.setFileName(fileName);
+    if (!File.open(QIODevice::WriteOnly))
+    {
+        return Fail();
+    }
+    Adler = 1;
+    Started = false;
+
+    QByteArray header(13, '\0');
+    qToBigEndian(quint32(width), reinterpret_cast<uchar *>(header.data()));
+    qToBigEndian(quint32(height), reinterpret_cast<uchar *>(header.data() + 4));
+    header[8] = 8;   // bits per channel
+    header[9] = 2;   // truecolour
+    if (File.write("\x89PNG\r\n\x1a\n", 8) != 8 || !WriteChunk("IHDR", header))
+    {
+        return Fail();
+    }
+    return true;
+}
+
+bool PngStreamWriter::WriteBand(const Band &band)
+{
+    QByteArray data;
+    if (!Started)
+    {
+        // zlib header: deflate, 32K window, no dictionary
+        data.append(char(0x78)).append(char(0x01));
+        Started = true;
+    }
+    data.append(band.Deflate);
+    Adler = CombineAdler(Adler, band.Adler, band.Length);
+    for (int offset = 0; offset < data.size(); offset += CHUNK_BYTES)
+    {
+        if (!WriteChunk("IDAT", data.mid(offset, CHUNK_BYTES)))
+        {
+            return Fail();
+        }
+    }
+    return true;
+}
+
+bool PngStreamWriter::Close()
+{
+    if (!File.isOpen())
+    {
+        return true;
+    }
+    // an empty final block, then the checksum of everything deflated
+    QByteArray tail;
+    if (!Started)
+    {
+        tail.append(char(0x78)).append(char(0x01));
+    }
+    tail.append(char(0x03)).append(char(0x00));
+    QByteArray adler(4, '\0');
+    qToBigEndian(Adler, reinterpret_cast<uchar *>(adler.data()));
+    tail.append(adler);
+    bool ok = WriteChunk("IDAT", tail) && WriteChunk("IEND", QByteArray());
+    File.close();
+    return ok ? true : Fail();
+}
+
+const QString &PngStreamWriter::GetErrorString() const
+{
+    return ErrorString;
+}
+
+bool PngStreamWriter::WriteChunk(const char *type, const QByteArray &data)
+{
+    QByteArray chunk(4, '\0');
+    qToBigEndian(quint32(data.size()), reinterpret_cast<uchar *>(chunk.data()));
+    QByteArray body = QByteArray(type, 4) + data;
+    QByteArray crc(4, '\0');
+    qToBigEndian(Crc32(body) ^ 0xffffffffu, reinterpret_cast<uchar *>(crc.data()));
+    chunk.append(body).append(crc);
+    return File.write(chunk) == chunk.size();
+}
+
+bool PngStreamWriter::Fail()
+{
+    if (ErrorString.isEmpty())
+    {
+        ErrorString = QObject::tr("Could not write %1: %2").arg(File.fileName(), File.errorString());
+    }
+    return false;
+}
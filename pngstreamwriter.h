@@ -0,0 +1,43 @@
+#ifndef PNGSTREAMWRITER_H
+#define PNGSTREAMWRITER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QImage>
+#include <QString>
+
+// RGB PNG written a horizontal band at a time, for images too large to hold
+// whole. Each band is deflated on its own and ends on a byte boundary, so
+// bands can be encoded on any thread and appended in order as IDAT chunks.
+// The encoder uses the fixed Huffman table and only repeats of the previous
+// byte; after the Sub filter that covers the flat areas a drawing is made of.
+class PngStreamWriter
+{
+public:
+    struct Band
+    {
+        QByteArray Deflate;
+        quint32 Adler;
+        quint64 Length;
+    };
+
+    static Band EncodeBand(const QImage &band);
+
+    ~PngStreamWriter();
+
+    bool Open(const QString &fileName, int width, int height);
+    bool WriteBand(const Band &band);
+    bool Close();
+    const QString &GetErrorString() const;
+
+private:
+    bool WriteChunk(const char *type, const QByteArray &data);
+    bool Fail();
+
+    QFile File;
+    QString ErrorString;
+    quint32 Adler = 1;
+    bool Started = false;
+};
+
+#endif // PNGSTREAMWRITER_H
@@ -0,0 +1,221 @@
+#include "sceneexporter.h"
+#include "customgraphicsview.h"
+#include "pngstreamwriter.h"
+#include <QFileInfo>
+#include <QPainter>
+#include <QPdfWriter>
+#include <QPicture>
+#include <QSvgGenerator>
+#include <QTextStream>
+#include <QThread>
+#include <QtConcurrent>
+#include <QtMath>
+#include <cstring>
+
+namespace
+{
+    const qreal SCENE_UNITS_PER_INCH = 96.0;
+    // pixels of one band, its height follows from the drawing's width
+    const qint64 BAND_BYTES = 16 << 20;
+    const int MIN_BAND_ROWS = 16;
+    const int MAX_BAND_ROWS = 512;
+    const int MAX_PNG_SIDE = 0x7fffffff;
+    // larger pages are refused by common PDF readers
+    const qreal MAX_PDF_PAGE_INCHES = 200.0;
+    const int DEFAULT_EXPORT_DPI = 300;
+
+    struct BandJob
+    {
+        int Width;
+        int Rows;
+        QPicture Picture;
+    };
+
+    // in-memory pictures keep the unit pixmaps shared, replaying only reads them
+    PngStreamWriter::Band RenderBand(const BandJob &job)
+    {
+        QImage image(job.Width, job.Rows, QImage::Format_RGB32);
+        image.fill(Qt::white);
+        QPainter painter(&image);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        painter.drawPicture(0, 0, job.Picture);
+        painter.end();
+        return PngStreamWriter::EncodeBand(image);
+    }
+}
+
+SceneExporter::SceneExporter(QGraphicsScene *scene)
+    : Scene(scene)
+{
+
+}
+
+QString SceneExporter::FileFilter()
+{
+    return QObject::tr("PNG (*.png);;SVG (*.svg);;PDF (*.pdf)");
+}
+
+bool SceneExporter::Export(const QString &fileName, const QRectF &source, int dpi)
+{
+    ErrorString.clear();
+    if (source.isEmpty())
+    {
+        ErrorString = QObject::tr("There is nothing to export");
+        return false;
+    }
+    const QString suffix = QFileInfo(fileName).suffix().toLower();
+    if (suffix == "svg")
+    {
+        return ExportSvg(fileName, source);
+    }
+    if (suffix == "pdf")
+    {
+        return ExportPdf(fileName, source, dpi);
+    }
+    return ExportPng(fileName, source, dpi);
+}
+
+const QString &SceneExporter::GetErrorString() const
+{
+    return ErrorString;
+}
+
+bool SceneExporter::ExportPng(const QString &fileName, const QRectF &source, int dpi)
+{
+    const qreal scale = dpi / SCENE_UNITS_PER_INCH;
+    const qreal width = std::ceil(source.width() * scale);
+    const qreal height = std::ceil(source.height() * scale);
+    if (width > MAX_PNG_SIDE || height > MAX_PNG_SIDE)
+    {
+        ErrorString = QObject::tr("%1 x %2 pixels is beyond what a PNG can hold, lower the resolution")
+                      .arg(width, 0, 'f', 0).arg(height, 0, 'f', 0);
+        return false;
+    }
+
+    PngStreamWriter writer;
+    if (!writer.Open(fileName, int(width), int(height)))
+    {
+        ErrorString = writer.GetErrorString();
+        return false;
+    }
+
+    const int bandRows = int(qBound(qint64(MIN_BAND_ROWS), BAND_BYTES / (qint64(width) * 4), qint64(MAX_BAND_ROWS)));
+    const int bandsInFlight = qMax(1, QThread::idealThreadCount());
+    for (int top = 0; top < int(height);)
+    {
+        // the scene can only be walked here, the pool gets recorded pictures
+        QVector<BandJob> jobs;
+        while (jobs.size() < bandsInFlight && top < int(height))
+        {
+            BandJob job = {int(width), qMin(bandRows, int(height) - top), QPicture()};
+            QRectF strip(source.left(), source.top() + top / scale, width / scale, job.Rows / scale);
+            QPainter recorder(&job.Picture);
+            recorder.setRenderHint(QPainter::Antialiasing);
+            Scene->render(&recorder, QRectF(0, 0, job.Width, job.Rows), strip, Qt::IgnoreAspectRatio);
+            recorder.end();
+            jobs.append(job);
+            top += job.Rows;
+        }
+
+        const QVector<PngStreamWriter::Band> bands = QtConcurrent::blockingMapped<QVector<PngStreamWriter::Band>>(jobs, RenderBand);
+        for (const PngStreamWriter::Band &band : bands)
+        {
+            if (!writer.WriteBand(band))
+            {
+                ErrorString = writer.GetErrorString();
+                return false;
+            }
+        }
+    }
+    if (!writer.Close())
+    {
+        ErrorString = writer.GetErrorString();
+        return false;
+    }
+    return true;
+}
+
+bool SceneExporter::ExportSvg(const QString &fileName, const QRectF &source)
+{
+    QSvgGenerator generator;
+    generator.setFileName(fileName);
+    generator.setTitle(QFileInfo(fileName).completeBaseName());
+    generator.setResolution(int(SCENE_UNITS_PER_INCH));
+    generator.setSize(source.size().toSize());
+    generator.setViewBox(QRectF(QPointF(0, 0), source.size()));
+
+    QPainter painter;
+    if (!painter.begin(&generator))
+    {
+        ErrorString = QObject::tr("Could not write %1").arg(fileName);
+        return false;
+    }
+    Scene->render(&painter, QRectF(QPointF(0, 0), source.size()), source);
+    return painter.end();
+}
+
+bool SceneExporter::ExportPdf(const QString &fileName, const QRectF &source, int dpi)
+{
+    QSizeF inches = source.size() / SCENE_UNITS_PER_INCH;
+    if (inches.width() > MAX_PDF_PAGE_INCHES || inches.height() > MAX_PDF_PAGE_INCHES)
+    {
+        inches.scale(MAX_PDF_PAGE_INCHES, MAX_PDF_PAGE_INCHES, Qt::KeepAspectRatio);
+    }
+
+    QPdfWriter writer(fileName);
+    writer.setTitle(QFileInfo(fileName).completeBaseName());
+    writer.setResolution(dpi);
+    writer.setPageSize(QPageSize(inches, QPageSize::Inch));
+    writer.setPageMargins(QMarginsF(0, 0, 0, 0));
+
+    QPainter painter;
+    if (!painter.begin(&writer))
+    {
+        ErrorString = QObject::tr("Could not write %1").arg(fileName);
+        return false;
+    }
+    Scene->render(&painter, QRectF(0, 0, writer.width(), writer.height()), source);
+    return painter.end();
+}
+
+bool IsSceneExportCommand(int argc, char *argv[])
+{
+    return argc > 1 && std::strcmp(argv[1], "--export") == 0;
+}
+
+int RunSceneExportCommand(const QStringList &arguments)
+{
+    QTextStream err(stderr);
+    bool dpiOk = true;
+    const int dpi = arguments.size() > 4 ? arguments.at(4).toInt(&dpiOk) : DEFAULT_EXPORT_DPI;
+    if (arguments.size() < 4 || arguments.size() > 5 || !dpiOk || dpi <= 0)
+    {
+        err << "usage: " << arguments.value(0) << " --export scene output.png|svg|pdf [dpi]\n";
+        return 2;
+    }
+
+    const QString sceneFile = arguments.at(2);
+    if (!QFileInfo(sceneFile).isReadable())
+    {
+        err << "Could not read " << sceneFile << '\n';
+        return 2;
+    }
+    CustomGraphicsView view;
+    if (QFileInfo(sceneFile).suffix().compare("xml", Qt::CaseInsensitive) == 0)
+    {
+        view.loadFromXml(sceneFile);
+    }
+    else
+    {
+        view.loadFromFile(sceneFile);
+    }
+
+    QString error;
+    if (!view.ExportDrawing(arguments.at(3), dpi, &error))
+    {
+        err << error << '\n';
+        return 1;
+    }
+    return 0;
+}
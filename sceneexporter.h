@@ -0,0 +1,38 @@
+#ifndef SCENEEXPORTER_H
+#define SCENEEXPORTER_H
+
+#include <QGraphicsScene>
+#include <QRectF>
+#include <QString>
+#include <QStringList>
+
+// Drawing of a scene region, format picked by suffix: .svg and .pdf are
+// vector, anything else a PNG at the given resolution. A scene unit is taken
+// as 1/96 inch. The PNG is rendered in horizontal bands: each band's scene
+// content is recorded into a QPicture on the GUI thread, then rasterised and
+// deflated on the global thread pool, and written in order, so only a few
+// bands are ever in memory.
+class SceneExporter
+{
+public:
+    explicit SceneExporter(QGraphicsScene *scene);
+
+    static QString FileFilter();
+
+    bool Export(const QString &fileName, const QRectF &source, int dpi);
+    const QString &GetErrorString() const;
+
+private:
+    bool ExportPng(const QString &fileName, const QRectF &source, int dpi);
+    bool ExportSvg(const QString &fileName, const QRectF &source);
+    bool ExportPdf(const QString &fileName, const QRectF &source, int dpi);
+
+    QGraphicsScene *Scene;
+    QString ErrorString;
+};
+
+// headless entry point: --export scene output [dpi]
+bool IsSceneExportCommand(int argc, char *argv[]);
+int RunSceneExportCommand(const QStringList &arguments);
+
+#endif // SCENEEXPORTER_H
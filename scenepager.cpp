@@ -0,0 +1,189 @@
+#include "scenepager.h"
+#include <QDataStream>
+#include <cmath>
+
+namespace
+{
+    quint64 ChunkKey(qint32 x, qint32 y)
+    {
+        return (quint64(quint32(x)) << 32) | quint32(y);
+    }
+
+    qint64 RecordBytes(const PagedNode &node)
+    {
+        return sizeof(PagedNode) + node.Record.size();
+    }
+
+    qint64 RecordBytes(const PagedEdge &edge)
+    {
+        return sizeof(PagedEdge) + edge.Record.size();
+    }
+}
+
+ScenePager::ScenePager(qreal chunkSize)
+    : ChunkSize(chunkSize)
+    , NextEdgeSlot(0)
+    , Charge(MemoryAccount::PagedRecords)
+{
+
+}
+
+qreal ScenePager::GetChunkSize() const
+{
+    return ChunkSize;
+}
+
+quint64 ScenePager::ChunkOf(const QPointF &pos) const
+{
+    return ChunkKey(qint32(std::floor(pos.x() / ChunkSize)), qint32(std::floor(pos.y() / ChunkSize)));
+}
+
+QSet<quint64> ScenePager::ChunksIn(const QRectF &rect) const
+{
+    QSet<quint64> chunks;
+    const qint32 x0 = qint32(std::floor(rect.left() / ChunkSize));
+    const qint32 x1 = qint32(std::floor(rect.right() / ChunkSize));
+    const qint32 y0 = qint32(std::floor(rect.top() / ChunkSize));
+    const qint32 y1 = qint32(std::floor(rect.bottom() / ChunkSize));
+    for (qint32 x = x0; x <= x1; ++x)
+    {
+        for (qint32 y = y0; y <= y1; ++y)
+        {
+            chunks.insert(ChunkKey(x, y));
+        }
+    }
+    return chunks;
+}
+
+void ScenePager::StoreNode(const PagedNode &node)
+{
+    quint64 chunk = ChunkOf(node.Pos);
+    NodesByChunk[chunk].append(node);
+    ChunkOfItem.insert(node.ItemId, chunk);
+    Charge.Add(RecordBytes(node), 1);
+}
+
+bool ScenePager::HasChunk(quint64 chunk) const
+{
+    return NodesByChunk.contains(chunk);
+}
+
+QList<PagedNode> ScenePager::TakeChunk(quint64 chunk)
+{
+    QList<PagedNode> nodes = NodesByChunk.take(chunk);
+    for (const PagedNode &node : nodes)
+    {
+        ChunkOfItem.remove(node.ItemId);
+        Charge.Add(-RecordBytes(node), -1);
+    }
+    return nodes;
+}
+
+QList<quint64> ScenePager::Chunks() const
+{
+    return NodesByChunk.keys();
+}
+
+bool ScenePager::IsEvicted(quint64 itemId) const
+{
+    return ChunkOfItem.contains(itemId);
+}
+
+QList<PagedNode> ScenePager::NodesIn(const QRectF &rect) const
+{
+    QList<PagedNode> nodes;
+    for (quint64 chunk : ChunksIn(rect))
+    {
+        for (const PagedNode &node : NodesByChunk.value(chunk))
+        {
+            if (rect.contains(node.Pos))
+            {
+                nodes.append(node);
+            }
+        }
+    }
+    return nodes;
+}
+
+bool ScenePager::NodePosition(quint64 itemId, QPointF *pos) const
+{
+    auto chunk = ChunkOfItem.constFind(itemId);
+    if (chunk == ChunkOfItem.constEnd())
+    {
+        return false;
+    }
+    for (const PagedNode &node : NodesByChunk.value(chunk.value()))
+    {
+        if (node.ItemId == itemId)
+        {
+            *pos = node.Pos;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ScenePager::StoreEdge(const PagedEdge &edge)
+{
+    int slot = NextEdgeSlot++;
+    EdgesBySlot.insert(slot, edge);
+    EdgeSlotsByItem.insert(edge.StartItemId, slot);
+    if (edge.EndItemId != edge.StartItemId)
+    {
+        EdgeSlotsByItem.insert(edge.EndItemId, slot);
+    }
+    Charge.Add(RecordBytes(edge), 1);
+}
+
+QList<PagedEdge> ScenePager::TakeResidentEdges(const QList<quint64> &itemIds)
+{
+    QList<PagedEdge> edges;
+    for (quint64 itemId : itemIds)
+    {
+        const QList<int> edgeSlots = EdgeSlotsByItem.values(itemId);
+        for (int slot : edgeSlots)
+        {
+            auto it = EdgesBySlot.find(slot);
+            if (it == EdgesBySlot.end() || IsEvicted(it->StartItemId) || IsEvicted(it->EndItemId))
+            {
+                continue;
+            }
+            edges.append(it.value());
+            Charge.Add(-RecordBytes(it.value()), -1);
+            EdgeSlotsByItem.remove(it->StartItemId, slot);
+            EdgeSlotsByItem.remove(it->EndItemId, slot);
+            EdgesBySlot.erase(it);
+        }
+    }
+    return edges;
+}
+
+int ScenePager::NodeCount() const
+{
+    return ChunkOfItem.size();
+}
+
+void ScenePager::writeRecords(QDataStream &out) const
+{
+    for (auto it = NodesByChunk.constBegin(); it != NodesByChunk.constEnd(); ++it)
+    {
+        for (const PagedNode &node : it.value())
+        {
+            out.writeRawData(node.Record.constData(), node.Record.size());
+        }
+    }
+    for (const PagedEdge &edge : EdgesBySlot)
+    {
+        out.writeRawData(edge.Record.constData(), edge.Record.size());
+    }
+}
+
+void ScenePager::Clear()
+{
+    NodesByChunk.clear();
+    ChunkOfItem.clear();
+    EdgesBySlot.clear();
+    EdgeSlotsByItem.clear();
+    NextEdgeSlot = 0;
+    Charge.Set(0, 0);
+}
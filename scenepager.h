@@ -0,0 +1,71 @@
+#ifndef SCENEPAGER_H
+#define SCENEPAGER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QPointF>
+#include <QRectF>
+#include <QSet>
+#include "memoryaccount.h"
+#include "parameterblock.h"
+
+// Unit paged out of the scene. Record holds the item in the scene file record
+// format, the other fields are what is shown without materializing it.
+struct PagedNode
+{
+    quint64 ItemId;
+    QPointF Pos;
+    ParameterBlock Parameters;
+    QByteArray Record;
+};
+
+// Line with at least one paged out end. Its connection stays in the flowsheet
+// model, the line drawing it is read back from Record.
+struct PagedEdge
+{
+    quint64 StartItemId;
+    quint64 EndItemId;
+    quint64 ConnectionId;
+    QByteArray Record;
+};
+
+// Spatial chunk store for the tiled scene mode. Units are bucketed by the
+// chunk their position falls in; a chunk is either fully resident in the
+// scene or fully stored here.
+class ScenePager
+{
+public:
+    explicit ScenePager(qreal chunkSize = 1000.0);
+
+    qreal GetChunkSize() const;
+    quint64 ChunkOf(const QPointF &pos) const;
+    QSet<quint64> ChunksIn(const QRectF &rect) const;
+
+    void StoreNode(const PagedNode &node);
+    bool HasChunk(quint64 chunk) const;
+    QList<PagedNode> TakeChunk(quint64 chunk);
+    QList<quint64> Chunks() const;
+    bool IsEvicted(quint64 itemId) const;
+    bool NodePosition(quint64 itemId, QPointF *pos) const;
+    QList<PagedNode> NodesIn(const QRectF &rect) const;
+
+    void StoreEdge(const PagedEdge &edge);
+    // edges of the given units whose other end is resident
+    QList<PagedEdge> TakeResidentEdges(const QList<quint64> &itemIds);
+
+    int NodeCount() const;
+    void writeRecords(QDataStream &out) const;
+    void Clear();
+
+private:
+    qreal ChunkSize;
+    QHash<quint64, QList<PagedNode>> NodesByChunk;
+    QHash<quint64, quint64> ChunkOfItem;
+    QHash<int, PagedEdge> EdgesBySlot;
+    QMultiHash<quint64, int> EdgeSlotsByItem;
+    int NextEdgeSlot;
+    MemoryCharge Charge;
+};
+
+#endif // SCENEPAGER_H
@@ -0,0 +1,169 @@
+#include "sensitivitydialog.h"
+#include <QHash>
+#include <QHeaderView>
+#include <QLabel>
+#include <QTreeWidget>
+#include <QtNumeric>
+#include <QVBoxLayout>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const int TOP_UNITS = 10;
+
+    QString NodeLabel(const CompiledFlowsheet &flowsheet, int node)
+    {
+        return QString("%1 %2").arg(ParameterBlock::Schema(flowsheet.GetEquipmentType(node)).TypeName).arg(flowsheet.GetItemId(node));
+    }
+
+    QString Number(double value)
+    {
+        return qIsNaN(value) ? QString() : QString::number(value, 'g', 6);
+    }
+
+    // the partial at key in a gradient sorted by key, NaN when the stream does not depend on it
+    double Lookup(const CompiledFlowsheet::SparseGradient &gradient, int key)
+    {
+        auto it = std::lower_bound(gradient.begin(), gradient.end(), key,
+                                   [](const QPair<int, double> &partial, int k) { return partial.first < k; });
+        return it != gradient.end() && it->first == key ? it->second : qQNaN();
+    }
+}
+
+SensitivityDialog::SensitivityDialog(const CompiledFlowsheet &flowsheet, quint64 focusItemId, QWidget *parent)
+    : QDialog(parent)
+    , Tree(new QTreeWidget(this))
+{
+    setWindowTitle(tr("Feed Stream Sensitivity"));
+    setAttribute(Qt::WA_DeleteOnClose);
+
+    int focusNode = -1;
+    for (int node = 0; node < flowsheet.NodeCount(); ++node)
+    {
+        if (flowsheet.GetItemId(node) == focusItemId)
+        {
+            focusNode = node;
+            break;
+        }
+    }
+
+    Tree->setColumnCount(3);
+    Tree->setHeaderLabels({tr("Stream / unit"), tr("Value"), tr("Sensitivity")});
+    Tree->setUniformRowHeights(true);
+
+    QVector<double> dense;
+    QVector<double> denseParameters;
+    const double result = flowsheet.Gradient(dense, &denseParameters);
+    CompiledFlowsheet::SparseGradient plant;
+    for (int node = 0; node < dense.size(); ++node)
+    {
+        if (dense.at(node) != 0.0)
+        {
+            plant.append(qMakePair(node, dense.at(node)));
+        }
+    }
+    CompiledFlowsheet::SparseGradient plantParameters;
+    for (int index = 0; index < denseParameters.size(); ++index)
+    {
+        if (denseParameters.at(index) != 0.0)
+        {
+            plantParameters.append(qMakePair(index, denseParameters.at(index)));
+        }
+    }
+    AddStream(flowsheet, tr("Plant result"), result, plant, plantParameters, focusNode);
+
+    const QVector<int> productNodes = flowsheet.ProductNodes();
+    QVector<CompiledFlowsheet::SparseGradient> gradients;
+    QVector<CompiledFlowsheet::SparseGradient> parameterGradients;
+    const QVector<double> products = flowsheet.ProductGradients(productNodes, gradients, &parameterGradients);
+    for (int i = 0; i < productNodes.size(); ++i)
+    {
+        AddStream(flowsheet, NodeLabel(flowsheet, productNodes.at(i)), products.at(i), gradients.at(i),
+                  parameterGradients.at(i), focusNode);
+    }
+    Tree->expandToDepth(0);
+    for (int column = 0; column < Tree->columnCount(); ++column)
+    {
+        Tree->resizeColumnToContents(column);
+    }
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(new QLabel(tr("Change of each stream per unit change of a unit's value or parameter, for the %1 units "
+                                    "it depends on most. A blank means the stream does not depend on it.").arg(TOP_UNITS), this));
+    layout->addWidget(Tree);
+    resize(720, 360);
+}
+
+void SensitivityDialog::AddStream(const CompiledFlowsheet &flowsheet, const QString &name, double value,
+                                  const CompiledFlowsheet::SparseGradient &gradient,
+                                  const CompiledFlowsheet::SparseGradient &parameterGradient, int focusNode)
+{
+    QTreeWidgetItem *stream = new QTreeWidgetItem(Tree, {name, QString::number(value, 'g', 6), QString()});
+
+    // units are ranked by the largest of their partials, value or parameter
+    QHash<int, double> weights;
+    for (const QPair<int, double> &partial : gradient)
+    {
+        weights[partial.first] = qMax(weights.value(partial.first), std::abs(partial.second));
+    }
+    for (const QPair<int, double> &partial : parameterGradient)
+    {
+        int parameter = 0;
+        const int node = flowsheet.ParameterNode(partial.first, parameter);
+        weights[node] = qMax(weights.value(node), std::abs(partial.second));
+    }
+    QVector<QPair<int, double>> top;
+    top.reserve(weights.size());
+    for (auto it = weights.constBegin(); it != weights.constEnd(); ++it)
+    {
+        top.append(qMakePair(it.key(), it.value()));
+    }
+
+    // largest first, only the head is sorted; ties by node so the order does not follow the hash
+    const int shown = qMin(TOP_UNITS, top.size());
+    std::partial_sort(top.begin(), top.begin() + shown, top.end(),
+                      [](const QPair<int, double> &a, const QPair<int, double> &b)
+                      { return a.second != b.second ? a.second > b.second : a.first < b.first; });
+    top.resize(shown);
+
+    bool focusShown = false;
+    for (const QPair<int, double> &unit : top)
+    {
+        focusShown = focusShown || unit.first == focusNode;
+    }
+    if (!focusShown && focusNode >= 0)
+    {
+        // the focused unit is listed whether it matters or not
+        top.append(qMakePair(focusNode, 0.0));
+    }
+
+    for (const QPair<int, double> &entry : top)
+    {
+        const int node = entry.first;
+        QTreeWidgetItem *unit = new QTreeWidgetItem(stream, {NodeLabel(flowsheet, node),
+                                                             QString::number(flowsheet.GetValues().at(node), 'g', 6),
+                                                             Number(Lookup(gradient, node))});
+        const EquipmentSchema &schema = ParameterBlock::Schema(flowsheet.GetEquipmentType(node));
+        int count = 0;
+        const double *doubles = flowsheet.GetDoubles(node, count);
+        for (int parameter = 0; parameter < count && parameter < schema.DoubleNames.size(); ++parameter)
+        {
+            if (parameter != ParameterBlock::Value)
+            {
+                new QTreeWidgetItem(unit, {schema.DoubleNames.at(parameter), Number(doubles[parameter]),
+                                           Number(Lookup(parameterGradient, flowsheet.ParameterIndex(node, parameter)))});
+            }
+        }
+        if (node == focusNode)
+        {
+            QFont font = unit->font(0);
+            font.setBold(true);
+            for (int column = 0; column < Tree->columnCount(); ++column)
+            {
+                unit->setFont(column, font);
+            }
+            unit->setExpanded(true);
+        }
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef SENSITIVITYDIALOG_H
+#define SENSITIVITYDIALOG_H
+
+#include <QDialog>
+#include "compiledflowsheet.h"
+
+class QTreeWidget;
+class QTreeWidgetItem;
+
+// Sensitivity of the plant result and of every product stream to the value
+// and each parameter of every unit, from one pass over the models' partials.
+// Only the units a stream is most sensitive to are listed, and the focused
+// unit, each with its parameters below it.
+class SensitivityDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    SensitivityDialog(const CompiledFlowsheet &flowsheet, quint64 focusItemId, QWidget *parent = nullptr);
+
+private:
+    void AddStream(const CompiledFlowsheet &flowsheet, const QString &name, double value,
+                   const CompiledFlowsheet::SparseGradient &gradient,
+                   const CompiledFlowsheet::SparseGradient &parameterGradient, int focusNode);
+
+    QTreeWidget *Tree;
+};
+
+#endif // SENSITIVITYDIALOG_H
@@ -0,0 +1,92 @@
+#ifndef SPSCRINGBUFFER_H
+#define SPSCRINGBUFFER_H
+
+#include <QAtomicInteger>
+#include <QVector>
+
+// Bounded queue for exactly one producer thread and one consumer thread.
+// Head is only written by the consumer and Tail only by the producer, so
+// neither side takes a lock. Capacity is rounded up to a power of two.
+template <typename T>
+class SpscRingBuffer
+{
+public:
+    explicit SpscRingBuffer(int capacity)
+        : Mask(RoundUp(capacity) - 1)
+        , Slots(int(Mask + 1))
+        , Data(Slots.data())
+        , Head(0)
+        , Tail(0)
+    {
+
+    }
+
+    int Capacity() const
+    {
+        return int(Mask + 1);
+    }
+
+    // producer side
+    bool TryPush(const T &value)
+    {
+        const quint32 tail = Tail.load();
+        if (tail - Head.loadAcquire() > Mask)
+        {
+            return false;
+        }
+        Data[tail & Mask] = value;
+        Tail.storeRelease(tail + 1);
+        return true;
+    }
+
+    // consumer side
+    bool TryPop(T &value)
+    {
+        const quint32 head = Head.load();
+        if (head == Tail.loadAcquire())
+        {
+            return false;
+        }
+        value = Data[head & Mask];
+        Head.storeRelease(head + 1);
+        return true;
+    }
+
+    // consumer side, appends at most maxCount values and returns how many
+    int PopInto(QVector<T> &values, int maxCount)
+    {
+        const quint32 head = Head.load();
+        const quint32 available = Tail.loadAcquire() - head;
+        const quint32 count = qMin(available, quint32(maxCount));
+        values.reserve(values.size() + int(count));
+        for (quint32 i = 0; i < count; ++i)
+        {
+            values.append(Data[(head + i) & Mask]);
+        }
+        Head.storeRelease(head + count);
+        return int(count);
+    }
+
+private:
+    static quint32 RoundUp(int capacity)
+    {
+        quint32 size = 2;
+        while (size < quint32(capacity))
+        {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    const quint32 Mask;
+    QVector<T> Slots;
+    // taken once so neither thread goes through QVector's detach check
+    T *Data;
+    // padded onto separate cache lines so the two threads do not false share
+    char HeadPadding[64];
+    QAtomicInteger<quint32> Head;
+    char TailPadding[64];
+    QAtomicInteger<quint32> Tail;
+};
+
+#endif // SPSCRINGBUFFER_H
@@ -0,0 +1,75 @@
+#include "startupprobe.h"
+#include <QDebug>
+#include <QEvent>
+#include <QFile>
+#include <QTextStream>
+#include <QTimer>
+#include <QWidget>
+
+StartupProbe &StartupProbe::Instance()
+{
+    static StartupProbe probe;
+    return probe;
+}
+
+StartupProbe::StartupProbe()
+{
+    Clock.start();
+}
+
+void StartupProbe::Mark(const char *phase)
+{
+    Marks.append(qMakePair(QByteArray(phase), Clock.elapsed()));
+}
+
+void StartupProbe::WatchFirstFrame(QWidget *window)
+{
+    Window = window;
+    Window->installEventFilter(this);
+}
+
+bool StartupProbe::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == Window && event->type() == QEvent::Paint)
+    {
+        Window->removeEventFilter(this);
+        Window = nullptr;
+        // the frame reaches the screen when the backing store is flushed after painting
+        QTimer::singleShot(0, this, [this]() {
+            Mark("first frame");
+            Report();
+        });
+    }
+    return false;
+}
+
+void StartupProbe::Report()
+{
+    QStringList phases;
+    QStringList times;
+    for (const QPair<QByteArray, qint64> &mark : Marks)
+    {
+        qInfo().noquote() << QString("startup: %1 ms %2").arg(mark.second, 6).arg(QString(mark.first));
+        phases.append(QString(mark.first));
+        times.append(QString::number(mark.second));
+    }
+
+    const QString logName = qEnvironmentVariable("AGGFLOW_STARTUP_LOG");
+    if (logName.isEmpty())
+    {
+        return;
+    }
+    QFile log(logName);
+    bool fresh = !log.exists();
+    if (!log.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text))
+    {
+        qWarning() << "Could not open startup log" << logName;
+        return;
+    }
+    QTextStream out(&log);
+    if (fresh)
+    {
+        out << phases.join(',') << '\n';
+    }
+    out << times.join(',') << '\n';
+}
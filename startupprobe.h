@@ -0,0 +1,37 @@
+#ifndef STARTUPPROBE_H
+#define STARTUPPROBE_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QPair>
+#include <QStringList>
+#include <QVector>
+
+class QWidget;
+
+// Milliseconds from main() to named startup phases and to the first frame of
+// a watched window. The timeline is printed once the frame is up; when
+// AGGFLOW_STARTUP_LOG names a file, one CSV line per start is appended to it
+// so builds can be compared over repeated cold starts.
+class StartupProbe : public QObject
+{
+public:
+    static StartupProbe &Instance();
+
+    void Mark(const char *phase);
+    void WatchFirstFrame(QWidget *window);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    StartupProbe();
+    void Report();
+
+    QElapsedTimer Clock;
+    QVector<QPair<QByteArray, qint64>> Marks;
+    QWidget *Window = nullptr;
+};
+
+#endif // STARTUPPROBE_H
@@ -0,0 +1,249 @@
+#include "telemetry.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QLocalSocket>
+#include <QDebug>
+
+namespace
+{
+    const int RING_CAPACITY = 1 << 16;
+    const int TICK_INTERVAL_MS = 100;
+    const char* SIGNAL_NAMES[] = {"tonnage", "amps", "level"};
+    const char* SIGNAL_UNITS[] = {"tph", "A", "t"};
+}
+
+QString TelemetrySample::SignalName(int signal)
+{
+    return signal >= 0 && signal < SignalCount ? QString(SIGNAL_NAMES[signal]) : QString::number(signal);
+}
+
+QString TelemetrySample::SignalUnit(int signal)
+{
+    return signal >= 0 && signal < SignalCount ? QString(SIGNAL_UNITS[signal]) : QString();
+}
+
+TelemetryReader::TelemetryReader(SpscRingBuffer<TelemetrySample> *ring, SourceKind kind, const QString &source,
+                                 double replaySpeed, QObject *parent)
+    : QThread(parent)
+    , Ring(ring)
+    , Kind(kind)
+    , Source(source)
+    , ReplaySpeed(replaySpeed)
+    , SkippedLines(0)
+    , FirstTimestamp(-1)
+{
+
+}
+
+quint64 TelemetryReader::GetSkippedLines() const
+{
+    return SkippedLines.load();
+}
+
+void TelemetryReader::run()
+{
+    if (Kind == CaptureFile)
+    {
+        ReadFile();
+    }
+    else
+    {
+        ReadSocket();
+    }
+}
+
+bool TelemetryReader::Push(const QByteArray &line)
+{
+    QList<QByteArray> fields = line.trimmed().split(',');
+    if (fields.size() != 4 || fields.first().startsWith('#'))
+    {
+        SkippedLines.fetchAndAddRelaxed(1);
+        return true;
+    }
+
+    TelemetrySample sample;
+    bool timeOk, idOk, valueOk;
+    sample.Timestamp = fields.at(0).toLongLong(&timeOk);
+    sample.ItemId = fields.at(1).toULongLong(&idOk);
+    sample.Value = fields.at(3).toDouble(&valueOk);
+    sample.SignalId = -1;
+    QByteArray signal = fields.at(2).trimmed().toLower();
+    for (int i = 0; i < TelemetrySample::SignalCount; ++i)
+    {
+        if (signal == SIGNAL_NAMES[i])
+        {
+            sample.SignalId = i;
+        }
+    }
+    if (!timeOk || !idOk || !valueOk || sample.SignalId < 0)
+    {
+        SkippedLines.fetchAndAddRelaxed(1);
+        return true;
+    }
+
+    while (!Ring->TryPush(sample))
+    {
+        if (isInterruptionRequested())
+        {
+            return false;
+        }
+        QThread::usleep(200);
+    }
+    return true;
+}
+
+void TelemetryReader::ReadFile()
+{
+    QFile file(Source);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        emit Failed(tr("Could not open capture %1").arg(Source));
+        return;
+    }
+
+    // a speed of 0 replays as fast as the ring is drained
+    QElapsedTimer clock;
+    clock.start();
+    while (!file.atEnd() && !isInterruptionRequested())
+    {
+        QByteArray line = file.readLine();
+        if (ReplaySpeed > 0)
+        {
+            bool ok;
+            qint64 timestamp = line.left(line.indexOf(',')).toLongLong(&ok);
+            if (ok)
+            {
+                if (FirstTimestamp < 0)
+                {
+                    FirstTimestamp = timestamp;
+                }
+                qint64 due = qint64((timestamp - FirstTimestamp) / ReplaySpeed);
+                while (clock.elapsed() < due && !isInterruptionRequested())
+                {
+                    QThread::msleep(qMin<qint64>(due - clock.elapsed(), 20));
+                }
+            }
+        }
+        if (!Push(line))
+        {
+            return;
+        }
+    }
+}
+
+void TelemetryReader::ReadSocket()
+{
+    QLocalSocket socket;
+    socket.connectToServer(Source, QIODevice::ReadOnly);
+    if (!socket.waitForConnected(3000))
+    {
+        emit Failed(tr("Could not connect to %1: %2").arg(Source, socket.errorString()));
+        return;
+    }
+
+    while (!isInterruptionRequested() && socket.state() == QLocalSocket::ConnectedState)
+    {
+        socket.waitForReadyRead(100);
+        while (socket.canReadLine())
+        {
+            if (!Push(socket.readLine()))
+            {
+                return;
+            }
+        }
+    }
+}
+
+TelemetryMonitor::TelemetryMonitor(QObject *parent)
+    : QObject(parent)
+    , Ring(RING_CAPACITY)
+    , Reader(nullptr)
+    , SampleCount(0)
+{
+    Timer.setInterval(TICK_INTERVAL_MS);
+    connect(&Timer, &QTimer::timeout, this, &TelemetryMonitor::onTick);
+}
+
+TelemetryMonitor::~TelemetryMonitor()
+{
+    Stop();
+}
+
+bool TelemetryMonitor::StartReplay(const QString &fileName, double speed)
+{
+    return Start(TelemetryReader::CaptureFile, fileName, speed);
+}
+
+bool TelemetryMonitor::StartSocket(const QString &serverName)
+{
+    return Start(TelemetryReader::LocalSocket, serverName, 0.0);
+}
+
+bool TelemetryMonitor::Start(TelemetryReader::SourceKind kind, const QString &source, double speed)
+{
+    if (Reader)
+    {
+        return false;
+    }
+
+    // whatever the last reader left behind belongs to the last run
+    QVector<TelemetrySample> stale;
+    Ring.PopInto(stale, Ring.Capacity());
+
+    SampleCount = 0;
+    FailureMessage.clear();
+    Reader = new TelemetryReader(&Ring, kind, source, speed, this);
+    connect(Reader, &TelemetryReader::Failed, this, &TelemetryMonitor::onReaderFailed);
+    connect(Reader, &QThread::finished, this, &TelemetryMonitor::onReaderFinished);
+    Reader->start();
+    Timer.start();
+    return true;
+}
+
+void TelemetryMonitor::Stop()
+{
+    if (!Reader)
+    {
+        return;
+    }
+
+    Reader->requestInterruption();
+    Reader->wait();
+    delete Reader;
+    Reader = nullptr;
+    Timer.stop();
+    onTick();
+    emit Stopped(FailureMessage);
+}
+
+bool TelemetryMonitor::IsRunning() const
+{
+    return Reader != nullptr;
+}
+
+quint64 TelemetryMonitor::GetSampleCount() const
+{
+    return SampleCount;
+}
+
+void TelemetryMonitor::onTick()
+{
+    QVector<TelemetrySample> samples;
+    SampleCount += Ring.PopInto(samples, RING_CAPACITY);
+    emit SamplesDrained(samples);
+}
+
+void TelemetryMonitor::onReaderFinished()
+{
+    // a finished replay still has samples queued, drain them before stopping
+    if (Reader && !Reader->isRunning())
+    {
+        QTimer::singleShot(TICK_INTERVAL_MS, this, &TelemetryMonitor::Stop);
+    }
+}
+
+void TelemetryMonitor::onReaderFailed(const QString &message)
+{
+    FailureMessage = message;
+    qWarning() << message;
+}
@@ -0,0 +1,91 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
+#include "spscringbuffer.h"
+
+struct TelemetrySample
+{
+    enum Signal { Tonnage, AmpDraw, Level, SignalCount };
+
+    static QString SignalName(int signal);
+    static QString SignalUnit(int signal);
+
+    qint64 Timestamp;   // msecs, as given by the source
+    quint64 ItemId;
+    qint32 SignalId;
+    double Value;
+};
+
+// Producer thread. Reads "timestamp,itemId,signal,value" lines from a capture
+// file or a local socket and pushes them into the ring. When the ring is full
+// the reader waits instead of dropping, the socket buffer takes up the slack.
+class TelemetryReader : public QThread
+{
+    Q_OBJECT
+public:
+    enum SourceKind { CaptureFile, LocalSocket };
+
+    TelemetryReader(SpscRingBuffer<TelemetrySample> *ring, SourceKind kind, const QString &source,
+                    double replaySpeed, QObject *parent = nullptr);
+
+    quint64 GetSkippedLines() const;
+
+signals:
+    void Failed(const QString &message);
+
+protected:
+    void run() override;
+
+private:
+    bool Push(const QByteArray &line);
+    void ReadFile();
+    void ReadSocket();
+
+    SpscRingBuffer<TelemetrySample> *Ring;
+    SourceKind Kind;
+    QString Source;
+    double ReplaySpeed;
+    QAtomicInteger<quint64> SkippedLines;
+    qint64 FirstTimestamp;
+};
+
+// Owns the ring and the reader and drains the ring on the GUI thread at a
+// fixed rate, so a fast source never drives repaints directly.
+class TelemetryMonitor : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TelemetryMonitor(QObject *parent = nullptr);
+    ~TelemetryMonitor();
+
+    bool StartReplay(const QString &fileName, double speed);
+    bool StartSocket(const QString &serverName);
+    void Stop();
+    bool IsRunning() const;
+    quint64 GetSampleCount() const;
+
+signals:
+    // every sample taken off the ring since the previous tick, in arrival order
+    void SamplesDrained(const QVector<TelemetrySample> &samples);
+    void Stopped(const QString &message);
+
+private slots:
+    void onTick();
+    void onReaderFinished();
+    void onReaderFailed(const QString &message);
+
+private:
+    bool Start(TelemetryReader::SourceKind kind, const QString &source, double speed);
+
+    SpscRingBuffer<TelemetrySample> Ring;
+    TelemetryReader *Reader;
+    QTimer Timer;
+    quint64 SampleCount;
+    QString FailureMessage;
+};
+
+#endif // TELEMETRY_H
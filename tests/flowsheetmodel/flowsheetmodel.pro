@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_flowsheetmodel
+
+SOURCES += \
+    tst_flowsheetmodel.cpp
@@ -0,0 +1,203 @@
+#include <QtTest>
+#include <algorithm>
+#include "flowsheetmodel.h"
+
+namespace
+{
+    typedef FlowsheetModel::Port Port;
+
+    FlowsheetModel::Connection Flow(quint64 from, quint64 to)
+    {
+        return {from, Port::Outlet, to, Port::Inlet, false, from, to};
+    }
+
+    ParameterBlock Unit(double value)
+    {
+        ParameterBlock parameters;
+        parameters.SetDouble(ParameterBlock::Value, value);
+        return parameters;
+    }
+
+    // ids of the connections at one port, read from the compressed table
+    QVector<quint64> At(const FlowsheetModel &model, quint64 itemId, Port port)
+    {
+        const FlowsheetModel::Adjacency &ports = model.PortConnections();
+        const int slot = PortSlot(model.NodeOf(itemId), port);
+        QVector<quint64> connectionIds;
+        for (int i = ports.Offsets.at(slot); i < ports.Offsets.at(slot + 1); ++i)
+        {
+            connectionIds.append(model.GetConnectionId(ports.Targets.at(i)));
+        }
+        std::sort(connectionIds.begin(), connectionIds.end());
+        return connectionIds;
+    }
+
+    QVector<quint64> Downstream(const FlowsheetModel &model, quint64 itemId)
+    {
+        const FlowsheetModel::Adjacency &flow = model.Downstream();
+        const int node = model.NodeOf(itemId);
+        QVector<quint64> itemIds;
+        for (int i = flow.Offsets.at(node); i < flow.Offsets.at(node + 1); ++i)
+        {
+            itemIds.append(model.GetItemId(flow.Targets.at(i)));
+        }
+        return itemIds;
+    }
+}
+
+class TestFlowsheetModel : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void removeNodeMovesLastRowIntoGap();
+    void connectionIdsSurviveRemoval();
+    void portConnectionsFollowEdits();
+    void removeNodeDropsItsConnections();
+    void downstreamStartsAtOutletEnd();
+    void compileSkipsMissingEnds();
+};
+
+void TestFlowsheetModel::removeNodeMovesLastRowIntoGap()
+{
+    FlowsheetModel model;
+    model.SetNode(10, Unit(1.0));
+    model.SetNode(20, Unit(2.0));
+    model.SetNode(30, Unit(3.0));
+
+    model.RemoveNode(10);
+    QCOMPARE(model.NodeCount(), 2);
+    QCOMPARE(model.NodeOf(10), -1);
+    QCOMPARE(model.NodeOf(30), 0);
+    QCOMPARE(model.NodeOf(20), 1);
+    QCOMPARE(model.GetItemId(0), quint64(30));
+    QCOMPARE(model.GetParameters(0).GetDouble(ParameterBlock::Value), 3.0);
+
+    // the last row goes without a swap
+    model.RemoveNode(20);
+    QCOMPARE(model.NodeCount(), 1);
+    QCOMPARE(model.NodeOf(30), 0);
+    model.RemoveNode(99);
+    QCOMPARE(model.NodeCount(), 1);
+}
+
+void TestFlowsheetModel::connectionIdsSurviveRemoval()
+{
+    FlowsheetModel model;
+    for (quint64 itemId = 1; itemId <= 4; ++itemId)
+    {
+        model.SetNode(itemId, Unit(double(itemId)));
+    }
+    const quint64 first = model.AddConnection(Flow(1, 2));
+    const quint64 second = model.AddConnection(Flow(2, 3));
+    const quint64 third = model.AddConnection(Flow(3, 4));
+    QVERIFY(first != 0 && first != second && second != third);
+
+    model.RemoveConnection(first);
+    QCOMPARE(model.ConnectionCount(), 2);
+    QCOMPARE(model.ConnectionOf(first), -1);
+    QCOMPARE(model.ConnectionOf(third), 0);
+    QVERIFY(model.GetConnection(model.ConnectionOf(second)) == Flow(2, 3));
+    QVERIFY(model.GetConnection(model.ConnectionOf(third)) == Flow(3, 4));
+
+    // ids are not handed out again
+    const quint64 fourth = model.AddConnection(Flow(4, 1));
+    QVERIFY(fourth != first && fourth != second && fourth != third);
+}
+
+void TestFlowsheetModel::portConnectionsFollowEdits()
+{
+    FlowsheetModel model;
+    for (quint64 itemId = 1; itemId <= 3; ++itemId)
+    {
+        model.SetNode(itemId, Unit(double(itemId)));
+    }
+    const quint64 in = model.AddConnection(Flow(1, 2));
+    const quint64 out = model.AddConnection(Flow(2, 3));
+    // a second line between the same ports is a connection of its own
+    const quint64 twice = model.AddConnection(Flow(2, 3));
+
+    QCOMPARE(At(model, 2, Port::Inlet), QVector<quint64>({in}));
+    QCOMPARE(At(model, 2, Port::Outlet), QVector<quint64>({out, twice}));
+    QCOMPARE(At(model, 3, Port::Inlet), QVector<quint64>({out, twice}));
+    QCOMPARE(At(model, 1, Port::Inlet), QVector<quint64>());
+    QCOMPARE(model.PortConnections().Offsets.size(), 3 * FlowsheetModel::PORTS_PER_NODE + 1);
+
+    // the table is rebuilt after every kind of edit
+    model.RemoveConnection(out);
+    QCOMPARE(At(model, 2, Port::Outlet), QVector<quint64>({twice}));
+    model.SetNode(4, Unit(4.0));
+    const quint64 loop = model.AddConnection({4, Port::Outlet, 4, Port::Inlet, true, 4, 4});
+    QCOMPARE(At(model, 4, Port::Outlet), QVector<quint64>({loop}));
+    QCOMPARE(At(model, 4, Port::Inlet), QVector<quint64>({loop}));
+    QCOMPARE(model.ConnectionsAt(4), QVector<quint64>({loop}));
+    model.RemoveNode(1);
+    QCOMPARE(At(model, 2, Port::Inlet), QVector<quint64>());
+    QCOMPARE(At(model, 3, Port::Inlet), QVector<quint64>({twice}));
+    QCOMPARE(model.PortConnections().Offsets.size(), 3 * FlowsheetModel::PORTS_PER_NODE + 1);
+}
+
+void TestFlowsheetModel::removeNodeDropsItsConnections()
+{
+    FlowsheetModel model;
+    for (quint64 itemId = 1; itemId <= 3; ++itemId)
+    {
+        model.SetNode(itemId, Unit(double(itemId)));
+    }
+    const quint64 first = model.AddConnection(Flow(1, 2));
+    const quint64 second = model.AddConnection(Flow(2, 3));
+    const quint64 back = model.AddConnection(Flow(3, 1));
+
+    QVector<quint64> atTwo = model.ConnectionsAt(2);
+    std::sort(atTwo.begin(), atTwo.end());
+    QCOMPARE(atTwo, QVector<quint64>({first, second}));
+
+    model.RemoveNode(2);
+    QCOMPARE(model.ConnectionCount(), 1);
+    QCOMPARE(model.ConnectionOf(first), -1);
+    QCOMPARE(model.ConnectionOf(second), -1);
+    QCOMPARE(model.ConnectionOf(back), 0);
+    QCOMPARE(model.ConnectionsAt(1), QVector<quint64>({back}));
+    QCOMPARE(model.ConnectionsAt(2), QVector<quint64>());
+}
+
+void TestFlowsheetModel::downstreamStartsAtOutletEnd()
+{
+    FlowsheetModel model;
+    for (quint64 itemId = 1; itemId <= 3; ++itemId)
+    {
+        model.SetNode(itemId, Unit(double(itemId)));
+    }
+    model.AddConnection(Flow(1, 2));
+    // drawn from the inlet of 3 to the outlet of 2, material still runs from 2 to 3
+    model.AddConnection({3, Port::Inlet, 2, Port::Outlet, false, 3, 2});
+
+    QCOMPARE(Downstream(model, 1), QVector<quint64>({2}));
+    QCOMPARE(Downstream(model, 2), QVector<quint64>({3}));
+    QCOMPARE(Downstream(model, 3), QVector<quint64>());
+
+    model.RemoveNode(2);
+    QCOMPARE(Downstream(model, 1), QVector<quint64>());
+    QCOMPARE(model.Downstream().Targets.size(), 0);
+}
+
+void TestFlowsheetModel::compileSkipsMissingEnds()
+{
+    FlowsheetModel model;
+    model.SetNode(1, Unit(4.0));
+    model.SetNode(2, Unit(6.0));
+    model.AddConnection(Flow(1, 2));
+    // a connection to a unit the model does not hold yet
+    model.AddConnection(Flow(2, 7));
+    model.SetGroup(5, Unit(0.0), 2.5, QVector<FlowsheetModel::GroupLink>());
+
+    CompiledFlowsheet flowsheet = model.Compile();
+    QCOMPARE(flowsheet.EdgeCount(), 1);
+    QCOMPARE(flowsheet.NodeCount(), 2);
+    QCOMPARE(flowsheet.GetConstant(), 2.5);
+    QCOMPARE(flowsheet.GetItemId(flowsheet.GetEdges().at(0).Start), quint64(1));
+    QCOMPARE(flowsheet.GetItemId(flowsheet.GetEdges().at(0).End), quint64(2));
+}
+
+QTEST_APPLESS_MAIN(TestFlowsheetModel)
+#include "tst_flowsheetmodel.moc"
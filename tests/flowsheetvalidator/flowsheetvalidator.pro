@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_flowsheetvalidator
+
+SOURCES += \
+    tst_flowsheetvalidator.cpp
@@ -0,0 +1,289 @@
+#include <QtTest>
+#include <algorithm>
+#include "flowsheetvalidator.h"
+
+namespace
+{
+    typedef FlowsheetValidator::Edge Edge;
+
+    // equipment types by role, as listed in parameterblock.cpp
+    const int PIT_TYPE = 2;
+    const int COMBINE_TYPE = 4;
+    const int CRUSHER_TYPE = 7;
+    const int STOCKPILE_TYPE = 10;
+
+    // a unit with every parameter set, so only the connections can break a rule
+    ParameterBlock Unit(int equipmentType)
+    {
+        ParameterBlock parameters(equipmentType);
+        for (int i = 0; i < parameters.DoubleCount(); ++i)
+        {
+            parameters.SetDouble(i, 1.0);
+        }
+        return parameters;
+    }
+
+    // material from the outlet of one unit into the inlet of the next
+    Edge Flow(quint64 from, quint64 to, bool tear = false)
+    {
+        return {from, true, to, false, tear};
+    }
+
+    QList<quint64> Changed(FlowsheetValidator &validator)
+    {
+        QList<quint64> changed = validator.TakeChanged();
+        std::sort(changed.begin(), changed.end());
+        return changed;
+    }
+
+    // a pit feeding the units from 2 up, which are combines
+    void AddUnits(FlowsheetValidator &validator, quint64 last)
+    {
+        validator.SetNode(1, Unit(PIT_TYPE));
+        for (quint64 itemId = 2; itemId <= last; ++itemId)
+        {
+            validator.SetNode(itemId, Unit(COMBINE_TYPE));
+        }
+    }
+}
+
+class TestFlowsheetValidator : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void unconnectedUnitsAndMissingParameters();
+    void connectionsJoiningTwoOutlets();
+    void feedIsWithdrawnFromLoops();
+    void removingEdgeSplitsCycle();
+    void tearStreamBreaksCycle();
+    void joiningCyclesAndSplittingThemAgain();
+    void selfLoopIsCycle();
+    void removedUnitLeavesCycleAndComesBack();
+};
+
+void TestFlowsheetValidator::unconnectedUnitsAndMissingParameters()
+{
+    FlowsheetValidator validator;
+    ParameterBlock crusher(CRUSHER_TYPE);
+    crusher.SetDouble(ParameterBlock::Value, 1.0);
+    validator.SetNode(1, crusher);
+    validator.SetNode(2, Unit(COMBINE_TYPE), true);
+    // only units whose violations changed are reported
+    QCOMPARE(Changed(validator), QList<quint64>({1}));
+
+    QCOMPARE(validator.GetViolations(1), quint32(FlowsheetValidator::DanglingPort | FlowsheetValidator::MissingParameter));
+    QCOMPARE(validator.GetMessages(1), QStringList({"Inlet not connected", "Outlet not connected",
+                                                    "Missing Closed Side Setting (mm), Capacity (tph)"}));
+    // groups are not checked themselves
+    QCOMPARE(validator.GetViolations(2), quint32(0));
+    QCOMPARE(validator.ViolatingUnitCount(), 1);
+
+    // and they feed what they are drawn into
+    validator.AddEdge(Flow(2, 1));
+    QCOMPARE(Changed(validator), QList<quint64>({1}));
+    QCOMPARE(validator.GetMessages(1), QStringList({"Outlet not connected", "Missing Closed Side Setting (mm), Capacity (tph)"}));
+
+    validator.RemoveNode(1);
+    QCOMPARE(Changed(validator), QList<quint64>({1}));
+    QCOMPARE(validator.GetViolations(1), quint32(0));
+    QCOMPARE(validator.ViolatingUnitCount(), 0);
+}
+
+void TestFlowsheetValidator::connectionsJoiningTwoOutlets()
+{
+    FlowsheetValidator validator;
+    AddUnits(validator, 3);
+    validator.AddEdge(Flow(1, 2));
+    validator.AddEdge(Flow(2, 3));
+    validator.SetNode(4, Unit(STOCKPILE_TYPE));
+    validator.AddEdge(Flow(3, 4));
+    Changed(validator);
+    QCOMPARE(validator.ViolatingUnitCount(), 0);
+
+    const Edge outlets = {3, true, 2, true, false};
+    validator.AddEdge(outlets);
+    QCOMPARE(Changed(validator), QList<quint64>({2, 3}));
+    QCOMPARE(validator.GetViolations(2), quint32(FlowsheetValidator::PortDirection));
+    QCOMPARE(validator.GetMessages(3), QStringList({"1 connection(s) join two inlets or two outlets"}));
+    // no material runs along it
+    QCOMPARE(validator.GetViolations(4), quint32(0));
+
+    validator.RemoveEdge(outlets);
+    QCOMPARE(Changed(validator), QList<quint64>({2, 3}));
+    QCOMPARE(validator.ViolatingUnitCount(), 0);
+}
+
+void TestFlowsheetValidator::feedIsWithdrawnFromLoops()
+{
+    // 1 -> 2 -> 3 -> 4, with a torn recycle from 3 back to 2
+    FlowsheetValidator validator;
+    AddUnits(validator, 3);
+    validator.SetNode(4, Unit(STOCKPILE_TYPE));
+    validator.AddEdge(Flow(1, 2));
+    validator.AddEdge(Flow(2, 3));
+    validator.AddEdge(Flow(3, 2, true));
+    validator.AddEdge(Flow(3, 4));
+    Changed(validator);
+    QCOMPARE(validator.ViolatingUnitCount(), 0);
+
+    // the recycle still reaches 2, but the loop must not keep itself fed
+    validator.RemoveEdge(Flow(1, 2));
+    QCOMPARE(Changed(validator), QList<quint64>({1, 2, 3, 4}));
+    for (quint64 itemId = 2; itemId <= 4; ++itemId)
+    {
+        QCOMPARE(validator.GetViolations(itemId), quint32(FlowsheetValidator::NoFeed));
+    }
+    QCOMPARE(validator.GetMessages(1), QStringList({"Outlet not connected"}));
+
+    validator.AddEdge(Flow(1, 2));
+    QCOMPARE(Changed(validator), QList<quint64>({1, 2, 3, 4}));
+    QCOMPARE(validator.ViolatingUnitCount(), 0);
+}
+
+void TestFlowsheetValidator::removingEdgeSplitsCycle()
+{
+    // 2 -> 3 -> 4 -> 2 and 4 -> 5 -> 4 make one strongly connected set
+    FlowsheetValidator validator;
+    AddUnits(validator, 5);
+    validator.AddEdge(Flow(1, 2));
+    validator.AddEdge(Flow(2, 3));
+    validator.AddEdge(Flow(3, 4));
+    validator.AddEdge(Flow(4, 2));
+    validator.AddEdge(Flow(4, 5));
+    validator.AddEdge(Flow(5, 4));
+    QCOMPARE(Changed(validator), QList<quint64>({2, 3, 4, 5}));
+    for (quint64 itemId = 2; itemId <= 5; ++itemId)
+    {
+        QCOMPARE(validator.GetViolations(itemId), quint32(FlowsheetValidator::UntornCycle));
+        QCOMPARE(validator.GetMessages(itemId), QStringList({"Recycle loop without a tear stream"}));
+    }
+    QCOMPARE(validator.GetViolations(1), quint32(0));
+    QCOMPARE(validator.ViolatingUnitCount(), 4);
+
+    // what is left of the cycle is the loop through 5 only
+    validator.RemoveEdge(Flow(4, 2));
+    QCOMPARE(Changed(validator), QList<quint64>({2, 3}));
+    QCOMPARE(validator.GetViolations(2), quint32(0));
+    QCOMPARE(validator.GetViolations(3), quint32(0));
+    QCOMPARE(validator.GetViolations(4), quint32(FlowsheetValidator::UntornCycle));
+    QCOMPARE(validator.GetViolations(5), quint32(FlowsheetValidator::UntornCycle));
+    QCOMPARE(validator.ViolatingUnitCount(), 2);
+
+    // an edge that is not there changes nothing
+    validator.RemoveEdge(Flow(4, 2));
+    QVERIFY(Changed(validator).isEmpty());
+}
+
+void TestFlowsheetValidator::tearStreamBreaksCycle()
+{
+    FlowsheetValidator validator;
+    AddUnits(validator, 5);
+    validator.AddEdge(Flow(1, 2));
+    validator.AddEdge(Flow(2, 3));
+    validator.AddEdge(Flow(3, 4));
+    validator.AddEdge(Flow(4, 5));
+    validator.AddEdge(Flow(5, 4));
+    Changed(validator);
+    QCOMPARE(validator.ViolatingUnitCount(), 2);
+
+    // tearing the recycle is a remove and an add, as the editor does it
+    validator.RemoveEdge(Flow(5, 4));
+    validator.AddEdge(Flow(5, 4, true));
+    QCOMPARE(Changed(validator), QList<quint64>({4, 5}));
+    QCOMPARE(validator.ViolatingUnitCount(), 0);
+
+    // a loop closed over the tear does not take 5 in
+    validator.AddEdge(Flow(4, 2));
+    QCOMPARE(Changed(validator), QList<quint64>({2, 3, 4}));
+    QCOMPARE(validator.GetViolations(5), quint32(0));
+    QCOMPARE(validator.ViolatingUnitCount(), 3);
+
+    validator.RemoveEdge(Flow(4, 2));
+    validator.AddEdge(Flow(4, 2, true));
+    QCOMPARE(Changed(validator), QList<quint64>({2, 3, 4}));
+    QCOMPARE(validator.ViolatingUnitCount(), 0);
+}
+
+void TestFlowsheetValidator::joiningCyclesAndSplittingThemAgain()
+{
+    // loops 2 <-> 3 and 4 <-> 5, both fed by the pit
+    FlowsheetValidator validator;
+    AddUnits(validator, 5);
+    validator.AddEdge(Flow(1, 2));
+    validator.AddEdge(Flow(1, 4));
+    validator.AddEdge(Flow(2, 3));
+    validator.AddEdge(Flow(3, 2));
+    validator.AddEdge(Flow(4, 5));
+    validator.AddEdge(Flow(5, 4));
+    Changed(validator);
+    QCOMPARE(validator.ViolatingUnitCount(), 4);
+
+    // 2 -> 3 -> 4 -> 5 -> 2 absorbs both loops
+    validator.AddEdge(Flow(3, 4));
+    validator.AddEdge(Flow(5, 2));
+    QVERIFY(Changed(validator).isEmpty());
+
+    // so tearing the first loop's recycle leaves all four in the joined one
+    validator.RemoveEdge(Flow(3, 2));
+    validator.AddEdge(Flow(3, 2, true));
+    QVERIFY(Changed(validator).isEmpty());
+    QCOMPARE(validator.ViolatingUnitCount(), 4);
+
+    // and removing the connection that joined them frees 2 and 3 only
+    validator.RemoveEdge(Flow(5, 2));
+    QCOMPARE(Changed(validator), QList<quint64>({2, 3}));
+    QCOMPARE(validator.GetViolations(4), quint32(FlowsheetValidator::UntornCycle));
+    QCOMPARE(validator.GetViolations(5), quint32(FlowsheetValidator::UntornCycle));
+    QCOMPARE(validator.ViolatingUnitCount(), 2);
+}
+
+void TestFlowsheetValidator::selfLoopIsCycle()
+{
+    FlowsheetValidator validator;
+    AddUnits(validator, 2);
+    validator.SetNode(3, Unit(STOCKPILE_TYPE));
+    validator.AddEdge(Flow(1, 2));
+    validator.AddEdge(Flow(2, 3));
+    Changed(validator);
+
+    validator.AddEdge(Flow(2, 2));
+    QCOMPARE(Changed(validator), QList<quint64>({2}));
+    QCOMPARE(validator.GetViolations(2), quint32(FlowsheetValidator::UntornCycle));
+
+    validator.RemoveEdge(Flow(2, 2));
+    QCOMPARE(Changed(validator), QList<quint64>({2}));
+    QCOMPARE(validator.ViolatingUnitCount(), 0);
+}
+
+void TestFlowsheetValidator::removedUnitLeavesCycleAndComesBack()
+{
+    FlowsheetValidator validator;
+    AddUnits(validator, 3);
+    validator.AddEdge(Flow(1, 2));
+    validator.AddEdge(Flow(2, 3));
+    validator.AddEdge(Flow(3, 2));
+    Changed(validator);
+    QCOMPARE(validator.ViolatingUnitCount(), 2);
+
+    // paged out, its connections stay drawn
+    validator.RemoveNode(3);
+    QCOMPARE(Changed(validator), QList<quint64>({2, 3}));
+    QCOMPARE(validator.GetViolations(2), quint32(0));
+    QCOMPARE(validator.GetViolations(3), quint32(0));
+    QCOMPARE(validator.ViolatingUnitCount(), 0);
+
+    // read back, the loop is found again from them
+    validator.SetNode(3, Unit(COMBINE_TYPE));
+    QCOMPARE(Changed(validator), QList<quint64>({2, 3}));
+    QCOMPARE(validator.GetViolations(2), quint32(FlowsheetValidator::UntornCycle));
+    QCOMPARE(validator.GetViolations(3), quint32(FlowsheetValidator::UntornCycle));
+    QCOMPARE(validator.ViolatingUnitCount(), 2);
+
+    validator.Clear();
+    QCOMPARE(Changed(validator), QList<quint64>({2, 3}));
+    QCOMPARE(validator.ViolatingUnitCount(), 0);
+}
+
+QTEST_APPLESS_MAIN(TestFlowsheetValidator)
+#include "tst_flowsheetvalidator.moc"
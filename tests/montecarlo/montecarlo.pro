@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_montecarlo
+
+SOURCES += \
+    tst_montecarlo.cpp
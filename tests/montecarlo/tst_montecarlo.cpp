@@ -0,0 +1,194 @@
+#include <QtTest>
+#include <algorithm>
+#include <cmath>
+#include "montecarlo.h"
+
+namespace
+{
+    // the histogram promises half a percent, a little is left for rounding
+    const double PERCENTILE_TOLERANCE = 0.0051;
+
+    // what Percentile reports for the sorted samples, exactly
+    double ExactPercentile(QVector<double> samples, double fraction)
+    {
+        std::sort(samples.begin(), samples.end());
+        return samples.at(int(fraction * (samples.size() - 1)));
+    }
+
+    bool WithinTolerance(double estimate, double exact)
+    {
+        return std::fabs(estimate - exact) <= PERCENTILE_TOLERANCE * std::fabs(exact) + 1e-9;
+    }
+
+    StreamingStatistics Collect(const QVector<double> &samples)
+    {
+        StreamingStatistics statistics;
+        for (double sample : samples)
+        {
+            statistics.Add(sample, sample >= 0.0);
+        }
+        return statistics;
+    }
+}
+
+class TestMonteCarlo : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void momentsMatchSamples();
+    void percentilesWithinHalfPercent_data();
+    void percentilesWithinHalfPercent();
+    void mergeEqualsOneStream();
+    void unsolvedSamplesAreOutOfSpecification();
+    void emptyStatistics();
+    void runRepeatsForSeed();
+};
+
+void TestMonteCarlo::momentsMatchSamples()
+{
+    QVector<double> samples;
+    for (int i = 1; i <= 1000; ++i)
+    {
+        samples.append(double(i));
+    }
+    const StreamingStatistics statistics = Collect(samples);
+    QCOMPARE(statistics.GetCount(), quint64(1000));
+    QCOMPARE(statistics.GetMean(), 500.5);
+    // sample variance of 1..n is n (n + 1) / 12
+    QCOMPARE(statistics.GetStandardDeviation(), std::sqrt(1000.0 * 1001.0 / 12.0));
+    QCOMPARE(statistics.GetMin(), 1.0);
+    QCOMPARE(statistics.GetMax(), 1000.0);
+    QCOMPARE(statistics.GetCompliance(), 1.0);
+}
+
+void TestMonteCarlo::percentilesWithinHalfPercent_data()
+{
+    QTest::addColumn<QVector<double>>("samples");
+
+    QVector<double> spread;
+    for (int i = 0; i < 10000; ++i)
+    {
+        spread.append(0.5 + 97.0 * std::pow(i / 10000.0, 3.0));
+    }
+    QTest::newRow("positive") << spread;
+
+    QVector<double> mixed;
+    for (int i = -500; i <= 500; ++i)
+    {
+        mixed.append(i * 0.37);
+    }
+    QTest::newRow("signs and zero") << mixed;
+
+    QVector<double> wide;
+    for (int i = 0; i < 2000; ++i)
+    {
+        wide.append(std::pow(10.0, -6.0 + 12.0 * i / 2000.0));
+    }
+    QTest::newRow("twelve decades") << wide;
+}
+
+void TestMonteCarlo::percentilesWithinHalfPercent()
+{
+    QFETCH(QVector<double>, samples);
+    const StreamingStatistics statistics = Collect(samples);
+    for (double fraction : {0.0, 0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99, 1.0})
+    {
+        const double estimate = statistics.Percentile(fraction);
+        const double exact = ExactPercentile(samples, fraction);
+        QVERIFY2(WithinTolerance(estimate, exact),
+                 qPrintable(QString("p%1 is %2, the samples give %3").arg(fraction * 100).arg(estimate).arg(exact)));
+        QVERIFY(estimate >= statistics.GetMin() && estimate <= statistics.GetMax());
+    }
+}
+
+void TestMonteCarlo::mergeEqualsOneStream()
+{
+    QVector<double> samples;
+    for (int i = 0; i < 5000; ++i)
+    {
+        samples.append(std::sin(i * 0.01) * 40.0 + i * 0.002);
+    }
+    const StreamingStatistics whole = Collect(samples);
+
+    StreamingStatistics merged = Collect(samples.mid(0, 1234));
+    merged.Merge(Collect(samples.mid(1234)));
+
+    QCOMPARE(merged.GetCount(), whole.GetCount());
+    QCOMPARE(merged.GetMin(), whole.GetMin());
+    QCOMPARE(merged.GetMax(), whole.GetMax());
+    QCOMPARE(merged.GetCompliance(), whole.GetCompliance());
+    QVERIFY(std::fabs(merged.GetMean() - whole.GetMean()) < 1e-9);
+    QVERIFY(std::fabs(merged.GetStandardDeviation() - whole.GetStandardDeviation()) < 1e-9);
+    // the buckets add up exactly, so the percentiles are the same
+    for (double fraction : {0.0, 0.05, 0.5, 0.95, 1.0})
+    {
+        QCOMPARE(merged.Percentile(fraction), whole.Percentile(fraction));
+    }
+}
+
+void TestMonteCarlo::unsolvedSamplesAreOutOfSpecification()
+{
+    StreamingStatistics statistics;
+    statistics.Add(qQNaN(), true);
+    statistics.Add(qInf(), true);
+    statistics.Add(4.0, true);
+    statistics.Add(6.0, false);
+
+    QCOMPARE(statistics.GetCount(), quint64(2));
+    QCOMPARE(statistics.GetNonFinite(), quint64(2));
+    QCOMPARE(statistics.GetMean(), 5.0);
+    QCOMPARE(statistics.GetCompliance(), 0.25);
+}
+
+void TestMonteCarlo::emptyStatistics()
+{
+    StreamingStatistics empty;
+    QVERIFY(qIsNaN(empty.Percentile(0.5)));
+    QCOMPARE(empty.GetCompliance(), 0.0);
+
+    StreamingStatistics unsolved;
+    unsolved.Add(qQNaN(), false);
+    StreamingStatistics solved = Collect({1.0, 2.0});
+    // merging into nothing keeps what was counted already
+    unsolved.Merge(solved);
+    QCOMPARE(unsolved.GetCount(), quint64(2));
+    QCOMPARE(unsolved.GetNonFinite(), quint64(1));
+    solved.Merge(empty);
+    QCOMPARE(solved.GetCount(), quint64(2));
+    QCOMPARE(solved.GetMean(), 1.5);
+}
+
+void TestMonteCarlo::runRepeatsForSeed()
+{
+    CompiledFlowsheet flowsheet;
+    ParameterBlock feed;
+    feed.SetDouble(ParameterBlock::Value, 100.0);
+    ParameterBlock product;
+    product.SetDouble(ParameterBlock::Value, 2.0);
+    const int feedNode = flowsheet.AddNode(1, feed);
+    flowsheet.AddEdge(feedNode, flowsheet.AddNode(2, product));
+
+    FeedDistribution distribution;
+    QVERIFY(FeedDistribution::Parse("1,normal,100,10", distribution));
+    MonteCarloAnalysis analysis(flowsheet, {distribution});
+    analysis.SetSpecification(150.0, 250.0);
+
+    // more than one chunk, so the chunk seeds and the merge order both count
+    const StreamingStatistics first = analysis.Run(5000, 42);
+    const StreamingStatistics again = analysis.Run(5000, 42);
+    const StreamingStatistics other = analysis.Run(5000, 43);
+    QCOMPARE(first.GetCount(), quint64(5000));
+    QCOMPARE(again.GetMean(), first.GetMean());
+    QCOMPARE(again.GetStandardDeviation(), first.GetStandardDeviation());
+    QCOMPARE(again.Percentile(0.9), first.Percentile(0.9));
+    QVERIFY(other.GetMean() != first.GetMean());
+
+    // unit 2 multiplies its feed by 2
+    QVERIFY(std::fabs(first.GetMean() - 200.0) < 2.0);
+    QVERIFY(std::fabs(first.GetStandardDeviation() - 20.0) < 2.0);
+    QVERIFY(first.GetCompliance() > 0.9);
+}
+
+QTEST_APPLESS_MAIN(TestMonteCarlo)
+#include "tst_montecarlo.moc"
@@ -0,0 +1,20 @@
+# NodeIndex lives in the editor and holds units, so the unit item is built in.
+include(../tests.pri)
+
+QT += gui widgets
+
+TARGET = tst_nodeindex
+
+INCLUDEPATH += $$PWD/../..
+DEPENDPATH += $$PWD/../..
+
+SOURCES += \
+    tst_nodeindex.cpp \
+    ../../custompixmapitem.cpp \
+    ../../lazyicon.cpp \
+    ../../nodeindex.cpp
+
+HEADERS += \
+    ../../custompixmapitem.h \
+    ../../lazyicon.h \
+    ../../nodeindex.h
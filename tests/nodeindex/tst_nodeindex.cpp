@@ -0,0 +1,190 @@
+#include <QtTest>
+#include "custompixmapitem.h"
+#include "nodeindex.h"
+
+namespace
+{
+    // the smallest table and its hash, as in nodeindex.cpp; ids with the same home collide there
+    const int MIN_SLOTS = 16;
+    const quint64 HASH_MULTIPLIER = Q_UINT64_C(11400714819323198485);
+
+    int Home(quint64 itemId)
+    {
+        return int((itemId * HASH_MULTIPLIER) >> 60);
+    }
+
+    // the first count ids from 1 on that share a home in the smallest table
+    QVector<quint64> CollidingIds(int count)
+    {
+        QVector<quint64> itemIds;
+        const int home = Home(1);
+        for (quint64 itemId = 1; itemIds.size() < count; ++itemId)
+        {
+            if (Home(itemId) == home)
+            {
+                itemIds.append(itemId);
+            }
+        }
+        return itemIds;
+    }
+}
+
+class TestNodeIndex : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void cleanup();
+
+    void findsInsertedUnits();
+    void rejectsSecondUnitOnTakenId();
+    void removeKeepsProbeChainThroughTombstone();
+    void insertReusesTombstone();
+    void pagedUnitsAreKnownButNotFound();
+    void growsAndShrinksWithLiveEntries();
+
+private:
+    CustomPixmapItem *MakeUnit(quint64 itemId);
+
+    QList<CustomPixmapItem *> Units;
+};
+
+void TestNodeIndex::cleanup()
+{
+    qDeleteAll(Units);
+    Units.clear();
+}
+
+CustomPixmapItem *TestNodeIndex::MakeUnit(quint64 itemId)
+{
+    CustomPixmapItem *unit = new CustomPixmapItem(QPixmap());
+    unit->SetItemId(itemId);
+    Units.append(unit);
+    return unit;
+}
+
+void TestNodeIndex::findsInsertedUnits()
+{
+    NodeIndex index;
+    CustomPixmapItem *first = MakeUnit(1);
+    CustomPixmapItem *second = MakeUnit(Q_UINT64_C(1) << 40);
+    QVERIFY(index.Insert(first));
+    QVERIFY(index.Insert(second));
+
+    QCOMPARE(index.Find(1), first);
+    QCOMPARE(index.Find(Q_UINT64_C(1) << 40), second);
+    QCOMPARE(index.Find(2), static_cast<CustomPixmapItem *>(nullptr));
+    QCOMPARE(index.StateOf(2), NodeIndex::Missing);
+    QCOMPARE(index.Size(), 2);
+}
+
+void TestNodeIndex::rejectsSecondUnitOnTakenId()
+{
+    NodeIndex index;
+    CustomPixmapItem *first = MakeUnit(5);
+    CustomPixmapItem *second = MakeUnit(5);
+    QVERIFY(index.Insert(first));
+    QVERIFY(!index.Insert(second));
+    // the same unit again is not a clash
+    QVERIFY(index.Insert(first));
+    QCOMPARE(index.Find(5), first);
+    QCOMPARE(index.Size(), 1);
+}
+
+void TestNodeIndex::removeKeepsProbeChainThroughTombstone()
+{
+    const QVector<quint64> itemIds = CollidingIds(3);
+    NodeIndex index;
+    for (quint64 itemId : itemIds)
+    {
+        QVERIFY(index.Insert(MakeUnit(itemId)));
+    }
+
+    index.Remove(itemIds.at(1));
+    QCOMPARE(index.StateOf(itemIds.at(1)), NodeIndex::Missing);
+    QCOMPARE(index.Find(itemIds.at(1)), static_cast<CustomPixmapItem *>(nullptr));
+    // the last id was probed past the removed one
+    QCOMPARE(index.Find(itemIds.at(2)), Units.at(2));
+    QCOMPARE(index.Find(itemIds.at(0)), Units.at(0));
+    QCOMPARE(index.Size(), 2);
+}
+
+void TestNodeIndex::insertReusesTombstone()
+{
+    const QVector<quint64> itemIds = CollidingIds(4);
+    NodeIndex index;
+    for (int i = 0; i < 3; ++i)
+    {
+        QVERIFY(index.Insert(MakeUnit(itemIds.at(i))));
+    }
+    index.Remove(itemIds.at(1));
+
+    CustomPixmapItem *fourth = MakeUnit(itemIds.at(3));
+    QVERIFY(index.Insert(fourth));
+    QCOMPARE(index.Find(itemIds.at(3)), fourth);
+    QCOMPARE(index.Find(itemIds.at(2)), Units.at(2));
+    QCOMPARE(index.StateOf(itemIds.at(1)), NodeIndex::Missing);
+
+    // and the removed id comes back on a fresh unit
+    CustomPixmapItem *again = MakeUnit(itemIds.at(1));
+    QVERIFY(index.Insert(again));
+    QCOMPARE(index.Find(itemIds.at(1)), again);
+    QCOMPARE(index.Size(), 4);
+    QCOMPARE(index.ResidentNodes().size(), 4);
+}
+
+void TestNodeIndex::pagedUnitsAreKnownButNotFound()
+{
+    NodeIndex index;
+    CustomPixmapItem *unit = MakeUnit(9);
+    QVERIFY(index.Insert(unit));
+    index.MarkPaged(9);
+    QCOMPARE(index.StateOf(9), NodeIndex::Paged);
+    QCOMPARE(index.Find(9), static_cast<CustomPixmapItem *>(nullptr));
+    QCOMPARE(index.Size(), 0);
+
+    // a unit read back takes its slot again
+    QVERIFY(index.Insert(unit));
+    QCOMPARE(index.StateOf(9), NodeIndex::Resident);
+    QCOMPARE(index.Size(), 1);
+}
+
+void TestNodeIndex::growsAndShrinksWithLiveEntries()
+{
+    const int count = 20 * MIN_SLOTS;
+    NodeIndex index;
+    for (int i = 1; i <= count; ++i)
+    {
+        QVERIFY(index.Insert(MakeUnit(quint64(i))));
+    }
+    for (int i = 1; i <= count; i += 2)
+    {
+        index.Remove(quint64(i));
+    }
+    // removed and inserted again, each id should land back in a tombstone rather than use up the table
+    for (int round = 0; round < 4; ++round)
+    {
+        for (int i = 2; i <= count; i += 2)
+        {
+            index.Remove(quint64(i));
+            QVERIFY(index.Insert(Units.at(i - 1)));
+        }
+    }
+
+    // the odd ids are tombstones that a rehash on growth drops
+    for (int i = count + 1; i <= 2 * count; ++i)
+    {
+        QVERIFY(index.Insert(MakeUnit(quint64(i))));
+        index.Remove(quint64(i));
+    }
+
+    QCOMPARE(index.Size(), count / 2);
+    QCOMPARE(index.ResidentNodes().size(), count / 2);
+    for (int i = 1; i <= count; ++i)
+    {
+        QCOMPARE(index.Find(quint64(i)), i % 2 == 0 ? Units.at(i - 1) : static_cast<CustomPixmapItem *>(nullptr));
+    }
+}
+
+QTEST_MAIN(TestNodeIndex)
+#include "tst_nodeindex.moc"
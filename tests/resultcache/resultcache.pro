@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_resultcache
+
+SOURCES += \
+    tst_resultcache.cpp
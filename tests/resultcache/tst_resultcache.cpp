@@ -0,0 +1,170 @@
+#include <QtTest>
+#include "resultcache.h"
+
+namespace
+{
+    const int SCREEN_TYPE = 6;
+    const int SCREEN_EFFICIENCY = 2;
+
+    ParameterBlock Unit(double value, int equipmentType = 0)
+    {
+        ParameterBlock parameters(equipmentType);
+        parameters.SetDouble(ParameterBlock::Value, value);
+        return parameters;
+    }
+
+    // a chain 1 -> 2 -> 3 and a separate pair 4 -> 5, with the given value on unit 2
+    CompiledFlowsheet ChainAndPair(double middle)
+    {
+        CompiledFlowsheet flowsheet;
+        const int first = flowsheet.AddNode(1, Unit(3.0));
+        const int second = flowsheet.AddNode(2, Unit(middle));
+        const int third = flowsheet.AddNode(3, Unit(2.0));
+        const int fourth = flowsheet.AddNode(4, Unit(5.0));
+        const int fifth = flowsheet.AddNode(5, Unit(7.0));
+        flowsheet.AddEdge(first, second);
+        flowsheet.AddEdge(second, third);
+        flowsheet.AddEdge(fourth, fifth);
+        return flowsheet;
+    }
+}
+
+class TestResultCache : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void keysFollowContentNotNodeOrder();
+    void editChangesKeysDownstreamOnly();
+    void parametersEnterKeys();
+    void evaluateHitsWhatDidNotChange();
+    void loopsGetStableKeys();
+    void savedResultsAreHitAfterReading();
+};
+
+void TestResultCache::keysFollowContentNotNodeOrder()
+{
+    const CompiledFlowsheet forward = ChainAndPair(4.0);
+
+    // the same plant with its nodes added the other way round
+    CompiledFlowsheet backward;
+    const int fifth = backward.AddNode(5, Unit(7.0));
+    const int fourth = backward.AddNode(4, Unit(5.0));
+    const int third = backward.AddNode(3, Unit(2.0));
+    const int second = backward.AddNode(2, Unit(4.0));
+    const int first = backward.AddNode(1, Unit(3.0));
+    backward.AddEdge(fourth, fifth);
+    backward.AddEdge(second, third);
+    backward.AddEdge(first, second);
+
+    const QVector<quint64> forwardKeys = ResultCache::NodeKeys(forward);
+    const QVector<quint64> backwardKeys = ResultCache::NodeKeys(backward);
+    QCOMPARE(forwardKeys.size(), 5);
+    for (int node = 0; node < 5; ++node)
+    {
+        QCOMPARE(forwardKeys.at(node), backwardKeys.at(4 - node));
+    }
+    QCOMPARE(ResultCache::NodeKeys(forward), forwardKeys);
+}
+
+void TestResultCache::editChangesKeysDownstreamOnly()
+{
+    const QVector<quint64> before = ResultCache::NodeKeys(ChainAndPair(4.0));
+    const QVector<quint64> after = ResultCache::NodeKeys(ChainAndPair(6.0));
+
+    QCOMPARE(after.at(0), before.at(0));
+    QVERIFY(after.at(1) != before.at(1));
+    QVERIFY(after.at(2) != before.at(2));
+    QCOMPARE(after.at(3), before.at(3));
+    QCOMPARE(after.at(4), before.at(4));
+}
+
+void TestResultCache::parametersEnterKeys()
+{
+    ParameterBlock screen = Unit(1.0, SCREEN_TYPE);
+    CompiledFlowsheet unset;
+    int feed = unset.AddNode(1, Unit(2.0));
+    unset.AddEdge(feed, unset.AddNode(2, screen));
+
+    screen.SetDouble(SCREEN_EFFICIENCY, 0.8);
+    CompiledFlowsheet set;
+    feed = set.AddNode(1, Unit(2.0));
+    set.AddEdge(feed, set.AddNode(2, screen));
+
+    const QVector<quint64> unsetKeys = ResultCache::NodeKeys(unset);
+    const QVector<quint64> setKeys = ResultCache::NodeKeys(set);
+    QCOMPARE(setKeys.at(0), unsetKeys.at(0));
+    QVERIFY(setKeys.at(1) != unsetKeys.at(1));
+}
+
+void TestResultCache::evaluateHitsWhatDidNotChange()
+{
+    ResultCache cache;
+    const CompiledFlowsheet before = ChainAndPair(4.0);
+    QCOMPARE(cache.Evaluate(before), before.Evaluate());
+    // units with an inlet are cached, the feeds are not
+    QCOMPARE(cache.GetMisses(), quint64(3));
+    QCOMPARE(cache.GetHits(), quint64(0));
+    QCOMPARE(cache.GetSize(), 3);
+
+    QCOMPARE(cache.Evaluate(before), before.Evaluate());
+    QCOMPARE(cache.GetHits(), quint64(3));
+
+    // the edit misses on the edited unit and the one below it
+    const CompiledFlowsheet after = ChainAndPair(6.0);
+    QCOMPARE(cache.Evaluate(after), after.Evaluate());
+    QCOMPARE(cache.GetMisses(), quint64(5));
+    QCOMPARE(cache.GetHits(), quint64(4));
+
+    // and undoing it is answered from the cache
+    QCOMPARE(cache.Evaluate(before), before.Evaluate());
+    QCOMPARE(cache.GetMisses(), quint64(5));
+    QCOMPARE(cache.GetHits(), quint64(7));
+}
+
+void TestResultCache::loopsGetStableKeys()
+{
+    // 1 -> 2 -> 3 -> 2, with 4 feeding the loop
+    CompiledFlowsheet flowsheet;
+    const int first = flowsheet.AddNode(1, Unit(3.0));
+    const int second = flowsheet.AddNode(2, Unit(4.0));
+    const int third = flowsheet.AddNode(3, Unit(2.0));
+    const int fourth = flowsheet.AddNode(4, Unit(5.0));
+    flowsheet.AddEdge(first, second);
+    flowsheet.AddEdge(second, third);
+    flowsheet.AddEdge(third, second);
+    flowsheet.AddEdge(fourth, third);
+
+    const QVector<quint64> keys = ResultCache::NodeKeys(flowsheet);
+    QCOMPARE(keys.size(), 4);
+    QCOMPARE(ResultCache::NodeKeys(flowsheet), keys);
+    QVERIFY(keys.at(1) != keys.at(2));
+
+    ResultCache cache;
+    QCOMPARE(cache.Evaluate(flowsheet), flowsheet.Evaluate());
+    QCOMPARE(cache.Evaluate(flowsheet), flowsheet.Evaluate());
+    QCOMPARE(cache.GetHits(), quint64(2));
+}
+
+void TestResultCache::savedResultsAreHitAfterReading()
+{
+    const CompiledFlowsheet flowsheet = ChainAndPair(4.0);
+    ResultCache cache;
+    cache.Evaluate(flowsheet);
+
+    QByteArray saved;
+    {
+        QDataStream out(&saved, QIODevice::WriteOnly);
+        cache.write(out);
+    }
+    ResultCache reloaded;
+    QDataStream in(saved);
+    reloaded.read(in);
+    QCOMPARE(reloaded.GetSize(), 3);
+    QCOMPARE(reloaded.Evaluate(flowsheet), flowsheet.Evaluate());
+    QCOMPARE(reloaded.GetHits(), quint64(3));
+    QCOMPARE(reloaded.GetMisses(), quint64(0));
+}
+
+QTEST_APPLESS_MAIN(TestResultCache)
+#include "tst_resultcache.moc"
@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_resultwriter
+
+SOURCES += \
+    tst_resultwriter.cpp
@@ -0,0 +1,208 @@
+#include <QtTest>
+#include <QScopedPointer>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <cmath>
+#include <cstring>
+#include "resultwriter.h"
+
+namespace
+{
+    // what the trailer after the group offsets holds: group count, rows, footer start, magic
+    const int TRAILER_BYTES = 4 + 8 + 8 + 4;
+
+    // row index, a double and a value that is not a whole number anywhere
+    QVector<double> Rows(int first, int count)
+    {
+        QVector<double> rows;
+        for (int row = first; row < first + count; ++row)
+        {
+            rows << double(row) << row * 0.5 << std::sin(row * 0.001) * 1e6;
+        }
+        return rows;
+    }
+
+    // one row group of an .afcol file, read back column by column
+    struct RowGroup
+    {
+        quint32 Rows;
+        QVector<QVector<quint64>> Columns;
+    };
+}
+
+class TestResultWriter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void columnarRoundTrip();
+    void columnarEmptyTable();
+    void csvWritesIntegersAndEscapesNames();
+    void firstErrorSticks();
+
+private:
+    QScopedPointer<QTemporaryDir> Directory;
+};
+
+void TestResultWriter::init()
+{
+    Directory.reset(new QTemporaryDir());
+    QVERIFY(Directory->isValid());
+}
+
+void TestResultWriter::columnarRoundTrip()
+{
+    const QString fileName = Directory->filePath("sweep.afcol");
+    QScopedPointer<ResultWriter> writer(ResultWriter::Create(fileName));
+    QVERIFY(dynamic_cast<ColumnarResultWriter *>(writer.data()));
+    writer->SetIntegerColumns({0});
+    QVERIFY(writer->Open(fileName, {"sample", "feed", "product"}));
+
+    // in uneven batches across two full row groups and a partial one
+    const int rowCount = 2 * ColumnarResultWriter::ROW_GROUP_ROWS + 1000;
+    for (int first = 0; first < rowCount; first += 7001)
+    {
+        const int count = qMin(7001, rowCount - first);
+        const QVector<double> rows = Rows(first, count);
+        QVERIFY(writer->WriteRows(rows.constData(), count));
+    }
+    QVERIFY2(writer->Close(), qPrintable(writer->GetErrorString()));
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QDataStream in(&file);
+    in.setByteOrder(QDataStream::LittleEndian);
+
+    quint32 magic = 0;
+    quint32 columnCount = 0;
+    in >> magic >> columnCount;
+    QCOMPARE(magic, quint32(ColumnarResultWriter::MAGIC));
+    QCOMPARE(columnCount, quint32(3));
+    QStringList names;
+    QVector<quint8> types;
+    for (quint32 column = 0; column < columnCount; ++column)
+    {
+        quint32 size = 0;
+        in >> size;
+        QByteArray name(int(size), '\0');
+        in.readRawData(name.data(), int(size));
+        quint8 type = 0;
+        in >> type;
+        names.append(QString::fromUtf8(name));
+        types.append(type);
+    }
+    QCOMPARE(names, QStringList({"sample", "feed", "product"}));
+    QCOMPARE(types, QVector<quint8>({1, 0, 0}));
+    const qint64 headerEnd = file.pos();
+
+    // the trailer is found from the end of the file, the offsets just before it
+    QVERIFY(file.seek(file.size() - TRAILER_BYTES));
+    quint32 groupCount = 0;
+    quint64 totalRows = 0;
+    qint64 footer = 0;
+    in >> groupCount >> totalRows >> footer >> magic;
+    QCOMPARE(magic, quint32(ColumnarResultWriter::MAGIC));
+    QCOMPARE(groupCount, quint32(3));
+    QCOMPARE(totalRows, quint64(rowCount));
+    QCOMPARE(footer + groupCount * qint64(sizeof(qint64)) + TRAILER_BYTES, file.size());
+
+    QVERIFY(file.seek(footer));
+    QVector<qint64> offsets(int(groupCount));
+    for (qint64 &offset : offsets)
+    {
+        in >> offset;
+    }
+    QCOMPARE(offsets.first(), headerEnd);
+
+    int row = 0;
+    for (int group = 0; group < offsets.size(); ++group)
+    {
+        QVERIFY(file.seek(offsets.at(group)));
+        RowGroup rows;
+        in >> rows.Rows;
+        QCOMPARE(int(rows.Rows), group < 2 ? int(ColumnarResultWriter::ROW_GROUP_ROWS) : 1000);
+        for (quint32 column = 0; column < columnCount; ++column)
+        {
+            QVector<quint64> values(int(rows.Rows));
+            in.readRawData(reinterpret_cast<char *>(values.data()), values.size() * int(sizeof(quint64)));
+            for (quint64 &value : values)
+            {
+                value = qFromLittleEndian(value);
+            }
+            rows.Columns.append(values);
+        }
+        // each group ends where the next starts, the last where the footer does
+        QCOMPARE(file.pos(), group + 1 < offsets.size() ? offsets.at(group + 1) : footer);
+
+        const QVector<double> expected = Rows(row, int(rows.Rows));
+        for (int i = 0; i < int(rows.Rows); ++i)
+        {
+            QCOMPARE(qint64(rows.Columns.at(0).at(i)), qint64(row + i));
+            for (int column = 1; column < 3; ++column)
+            {
+                double value;
+                const quint64 bits = rows.Columns.at(column).at(i);
+                std::memcpy(&value, &bits, sizeof(value));
+                QCOMPARE(value, expected.at(i * 3 + column));
+            }
+        }
+        row += int(rows.Rows);
+    }
+    QCOMPARE(row, rowCount);
+}
+
+void TestResultWriter::columnarEmptyTable()
+{
+    const QString fileName = Directory->filePath("empty.afcol");
+    ColumnarResultWriter writer;
+    QVERIFY(writer.Open(fileName, {"sample"}));
+    QVERIFY(writer.Close());
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QDataStream in(&file);
+    in.setByteOrder(QDataStream::LittleEndian);
+    QVERIFY(file.seek(file.size() - TRAILER_BYTES));
+    quint32 groupCount = 1;
+    quint64 totalRows = 1;
+    qint64 footer = 0;
+    quint32 magic = 0;
+    in >> groupCount >> totalRows >> footer >> magic;
+    QCOMPARE(groupCount, quint32(0));
+    QCOMPARE(totalRows, quint64(0));
+    QCOMPARE(footer, file.size() - TRAILER_BYTES);
+    QCOMPARE(magic, quint32(ColumnarResultWriter::MAGIC));
+}
+
+void TestResultWriter::csvWritesIntegersAndEscapesNames()
+{
+    const QString fileName = Directory->filePath("sweep.csv");
+    QScopedPointer<ResultWriter> writer(ResultWriter::Create(fileName));
+    QVERIFY(dynamic_cast<CsvResultWriter *>(writer.data()));
+    writer->SetIntegerColumns({0});
+    QVERIFY(writer->Open(fileName, {"sample", "feed, tph", "product"}));
+    const double rows[] = {0.0, 1.5, -2.25, 1.0, 100.0, 3.0};
+    QVERIFY(writer->WriteRows(rows, 2));
+    QVERIFY(writer->Close());
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly | QIODevice::Text));
+    const QStringList lines = QString::fromUtf8(file.readAll()).split('\n', QString::SkipEmptyParts);
+    QCOMPARE(lines, QStringList({"sample,feed  tph,product", "0,1.5,-2.25", "1,100,3"}));
+}
+
+void TestResultWriter::firstErrorSticks()
+{
+    // a directory cannot be opened as a file
+    ColumnarResultWriter writer;
+    QVERIFY(!writer.Open(Directory->path(), {"sample"}));
+    const QString error = writer.GetErrorString();
+    QVERIFY(!error.isEmpty());
+    QVERIFY(!writer.Close());
+    QCOMPARE(writer.GetErrorString(), error);
+}
+
+QTEST_APPLESS_MAIN(TestResultWriter)
+#include "tst_resultwriter.moc"
@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_scenediff
+
+SOURCES += \
+    tst_scenediff.cpp
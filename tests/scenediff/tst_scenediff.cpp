@@ -0,0 +1,280 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <algorithm>
+#include "itemid.h"
+#include "parameterblock.h"
+#include "scenediff.h"
+
+namespace
+{
+    struct Unit
+    {
+        quint64 ItemId;
+        QString Text;
+        QPointF Pos;
+        double Value;
+    };
+
+    struct Line
+    {
+        quint64 StartItemId;
+        quint64 EndItemId;
+        bool Tear;
+    };
+
+    // a binary scene as CustomGraphicsView writes it, with the units left without an image
+    QByteArray SceneData(const QVector<Unit> &units, const QVector<Line> &lines, qint32 version = WIDE_ITEM_ID_VERSION)
+    {
+        QByteArray data;
+        QDataStream out(&data, QIODevice::WriteOnly);
+        auto writeItemId = [&out, version](quint64 itemId) {
+            if (version >= WIDE_ITEM_ID_VERSION)
+            {
+                out << itemId;
+            }
+            else
+            {
+                out << qint32(itemId);
+            }
+        };
+        out << QString("AggFlowScene") << version;
+        for (const Unit &unit : units)
+        {
+            ParameterBlock parameters;
+            parameters.SetDouble(ParameterBlock::Value, unit.Value);
+            out << QString("CustomPixmapItem") << unit.Pos << qint32(0) << unit.Text;
+            writeItemId(0);
+            writeItemId(unit.ItemId);
+            out << true << true;
+            parameters.write(out);
+        }
+        for (const Line &line : lines)
+        {
+            out << QString("ArrowLineItem") << QLineF(0.0, 0.0, 10.0, 10.0);
+            writeItemId(line.StartItemId);
+            out << true << false;
+            writeItemId(line.EndItemId);
+            out << false << true << false << true << line.Tear;
+        }
+        return data;
+    }
+
+    SceneSnapshot Snapshot(const QVector<Unit> &units, const QVector<Line> &lines)
+    {
+        SceneSnapshot snapshot;
+        QString error;
+        if (!snapshot.LoadScene(SceneData(units, lines), &error))
+        {
+            qWarning("%s", qPrintable(error));
+        }
+        return snapshot;
+    }
+
+    // start and end ids of each line, sorted so the order of the records does not count
+    QVector<QPair<quint64, quint64>> Ends(const SceneSnapshot &snapshot)
+    {
+        QVector<QPair<quint64, quint64>> ends;
+        for (const DiffEdge &edge : snapshot.GetEdges())
+        {
+            ends.append(qMakePair(edge.StartItemId, edge.EndItemId));
+        }
+        std::sort(ends.begin(), ends.end());
+        return ends;
+    }
+
+    // three units in a row, 1 -> 2 -> 3
+    const QVector<Unit> BASE_UNITS = {{1, "feed", QPointF(0, 0), 100.0},
+                                      {2, "crusher", QPointF(100, 0), 2.0},
+                                      {3, "stockpile", QPointF(200, 0), 1.0}};
+    const QVector<Line> BASE_LINES = {{1, 2, false}, {2, 3, false}};
+}
+
+class TestSceneDiff : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void loadReadsUnitsAndLines();
+    void compareFindsEditsMovesAndRenumbering();
+    void compareOfSameSceneIsEmpty();
+    void mergeTakesEachSidesChanges();
+    void mergeReportsUnitChangedOnBothSides();
+    void mergeDropsLinesToRemovedUnits();
+    void mergeCountsParallelLines();
+    void mergedSceneSavesAndLoadsBack();
+    void oldScenesAreNotWrittenBack();
+};
+
+void TestSceneDiff::loadReadsUnitsAndLines()
+{
+    const SceneSnapshot snapshot = Snapshot(BASE_UNITS, BASE_LINES);
+    QVERIFY(snapshot.HasLineEnds());
+    QCOMPARE(snapshot.GetNodes().size(), 3);
+    QCOMPARE(snapshot.GetNodes().value(2).Text, QString("crusher"));
+    QCOMPARE(snapshot.GetNodes().value(3).Pos, QPointF(200, 0));
+    QVERIFY(!snapshot.GetNodes().value(1).Record.isEmpty());
+    QCOMPARE(Ends(snapshot), (QVector<QPair<quint64, quint64>>({{1, 2}, {2, 3}})));
+    QVERIFY(!snapshot.GetEdges().at(0).StartOnStartCircle);
+    QVERIFY(snapshot.GetEdges().at(0).EndOnStartCircle);
+
+    SceneSnapshot damaged;
+    QString error;
+    QVERIFY(!damaged.LoadScene(SceneData(BASE_UNITS, BASE_LINES).left(60), &error));
+    QVERIFY(!error.isEmpty());
+}
+
+void TestSceneDiff::compareFindsEditsMovesAndRenumbering()
+{
+    const SceneSnapshot before = Snapshot(BASE_UNITS, BASE_LINES);
+    // 1 moved, 2 renamed, 3 pasted back as 7, 8 added and fed from 2
+    const SceneSnapshot after = Snapshot({{1, "feed", QPointF(0, 50), 100.0},
+                                          {2, "jaw crusher", QPointF(100, 0), 2.0},
+                                          {7, "stockpile", QPointF(200, 0), 1.0},
+                                          {8, "screen", QPointF(200, 100), 0.5}},
+                                         {{1, 2, false}, {2, 7, false}, {2, 8, false}});
+
+    const SceneDiff diff = SceneDiff::Compare(before, after);
+    QCOMPARE(diff.MovedNodes, QList<quint64>({1}));
+    QCOMPARE(diff.ChangedNodes, QList<quint64>({2}));
+    QCOMPARE(diff.Renumbered.size(), 1);
+    QCOMPARE(diff.Renumbered.value(3), quint64(7));
+    QCOMPARE(diff.AddedNodes, QList<quint64>({8}));
+    QVERIFY(diff.RemovedNodes.isEmpty());
+    // the line to the renumbered unit is the same line
+    QCOMPARE(diff.AddedEdges.size(), 1);
+    QCOMPARE(diff.AddedEdges.at(0).EndItemId, quint64(8));
+    QVERIFY(diff.RemovedEdges.isEmpty());
+    QVERIFY(diff.ToText(before, after).endsWith("1 added, 0 removed, 1 changed, 1 moved units; 1 added, 0 removed lines\n"));
+}
+
+void TestSceneDiff::compareOfSameSceneIsEmpty()
+{
+    const SceneSnapshot before = Snapshot(BASE_UNITS, BASE_LINES);
+    QVector<Line> reversed = BASE_LINES;
+    std::reverse(reversed.begin(), reversed.end());
+    QVERIFY(SceneDiff::Compare(before, Snapshot(BASE_UNITS, reversed)).IsEmpty());
+
+    // a tear on a line is a different connection
+    const SceneDiff torn = SceneDiff::Compare(before, Snapshot(BASE_UNITS, {{1, 2, false}, {2, 3, true}}));
+    QCOMPARE(torn.AddedEdges.size(), 1);
+    QCOMPARE(torn.RemovedEdges.size(), 1);
+    QVERIFY(torn.AddedEdges.at(0).Tear);
+}
+
+void TestSceneDiff::mergeTakesEachSidesChanges()
+{
+    const SceneSnapshot base = Snapshot(BASE_UNITS, BASE_LINES);
+    QVector<Unit> ourUnits = BASE_UNITS;
+    ourUnits[0].Pos = QPointF(0, 50);
+    const SceneSnapshot ours = Snapshot(ourUnits, BASE_LINES);
+    QVector<Unit> theirUnits = BASE_UNITS;
+    theirUnits[1].Value = 3.0;
+    theirUnits.append(Unit{4, "screen", QPointF(300, 0), 0.5});
+    const SceneSnapshot theirs = Snapshot(theirUnits, {{1, 2, false}, {2, 3, false}, {3, 4, false}});
+
+    QStringList conflicts;
+    const SceneSnapshot merged = SceneMerge::Merge(base, ours, theirs, &conflicts);
+    QVERIFY(conflicts.isEmpty());
+    QCOMPARE(merged.GetNodes().size(), 4);
+    QCOMPARE(merged.GetNodes().value(1).Pos, QPointF(0, 50));
+    QCOMPARE(merged.GetNodes().value(2).Content, theirs.GetNodes().value(2).Content);
+    QVERIFY(merged.GetNodes().contains(4));
+    QCOMPARE(Ends(merged), (QVector<QPair<quint64, quint64>>({{1, 2}, {2, 3}, {3, 4}})));
+}
+
+void TestSceneDiff::mergeReportsUnitChangedOnBothSides()
+{
+    const SceneSnapshot base = Snapshot(BASE_UNITS, BASE_LINES);
+    // both renamed the crusher, and we removed the stockpile they moved
+    QVector<Unit> ourUnits = BASE_UNITS;
+    ourUnits[1].Text = "primary";
+    ourUnits.removeLast();
+    const SceneSnapshot ours = Snapshot(ourUnits, {{1, 2, false}});
+    QVector<Unit> theirUnits = BASE_UNITS;
+    theirUnits[1].Text = "secondary";
+    theirUnits[2].Pos = QPointF(200, 80);
+    const SceneSnapshot theirs = Snapshot(theirUnits, BASE_LINES);
+
+    QStringList conflicts;
+    const SceneSnapshot merged = SceneMerge::Merge(base, ours, theirs, &conflicts);
+    conflicts.sort();
+    QCOMPARE(conflicts, QStringList({"unit 2 was changed on both sides", "unit 3 was changed on both sides"}));
+    QCOMPARE(merged.GetNodes().value(2).Text, QString("primary"));
+    // the removed unit comes back as they left it
+    QVERIFY(merged.GetNodes().contains(3));
+    QCOMPARE(merged.GetNodes().value(3).Pos, QPointF(200, 80));
+
+    // the same edit on both sides is no conflict
+    conflicts.clear();
+    SceneMerge::Merge(base, theirs, theirs, &conflicts);
+    QVERIFY(conflicts.isEmpty());
+}
+
+void TestSceneDiff::mergeDropsLinesToRemovedUnits()
+{
+    const SceneSnapshot base = Snapshot(BASE_UNITS, BASE_LINES);
+    QVector<Unit> ourUnits = BASE_UNITS;
+    ourUnits.removeLast();
+    const SceneSnapshot ours = Snapshot(ourUnits, {{1, 2, false}});
+    // they only drew a second line into the unit we removed
+    const SceneSnapshot theirs = Snapshot(BASE_UNITS, {{1, 2, false}, {2, 3, false}, {1, 3, false}});
+
+    QStringList conflicts;
+    const SceneSnapshot merged = SceneMerge::Merge(base, ours, theirs, &conflicts);
+    QVERIFY(conflicts.isEmpty());
+    QVERIFY(!merged.GetNodes().contains(3));
+    QCOMPARE(Ends(merged), (QVector<QPair<quint64, quint64>>({{1, 2}})));
+}
+
+void TestSceneDiff::mergeCountsParallelLines()
+{
+    const SceneSnapshot base = Snapshot(BASE_UNITS, {{1, 2, false}, {1, 2, false}, {2, 3, false}});
+    // we removed one of the doubled lines, they added a third one and removed 2 -> 3
+    const SceneSnapshot ours = Snapshot(BASE_UNITS, {{1, 2, false}, {2, 3, false}});
+    const SceneSnapshot theirs = Snapshot(BASE_UNITS, {{1, 2, false}, {1, 2, false}, {1, 2, false}});
+
+    const SceneSnapshot merged = SceneMerge::Merge(base, ours, theirs, nullptr);
+    QCOMPARE(Ends(merged), (QVector<QPair<quint64, quint64>>({{1, 2}, {1, 2}})));
+
+    // lines both sides added to the same circles add up
+    const SceneSnapshot both = SceneMerge::Merge(base, theirs, Snapshot(BASE_UNITS, {{1, 2, false}, {1, 2, false},
+                                                                                     {1, 2, false}, {1, 2, false}}), nullptr);
+    QCOMPARE(Ends(both), (QVector<QPair<quint64, quint64>>({{1, 2}, {1, 2}, {1, 2}, {1, 2}, {1, 2}})));
+}
+
+void TestSceneDiff::mergedSceneSavesAndLoadsBack()
+{
+    const SceneSnapshot base = Snapshot(BASE_UNITS, BASE_LINES);
+    QVector<Unit> theirUnits = BASE_UNITS;
+    theirUnits[2].Value = 4.0;
+    const SceneSnapshot merged = SceneMerge::Merge(base, base, Snapshot(theirUnits, BASE_LINES), nullptr);
+
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    const QString fileName = directory.filePath("merged.afs");
+    QString error;
+    QVERIFY2(merged.Save(fileName, &error), qPrintable(error));
+
+    SceneSnapshot loaded;
+    QVERIFY2(loaded.Load(fileName, &error), qPrintable(error));
+    QVERIFY(SceneDiff::Compare(merged, loaded).IsEmpty());
+    QCOMPARE(loaded.GetNodes().value(3).Content, merged.GetNodes().value(3).Content);
+    QCOMPARE(Ends(loaded), Ends(base));
+}
+
+void TestSceneDiff::oldScenesAreNotWrittenBack()
+{
+    SceneSnapshot old;
+    QString error;
+    QVERIFY2(old.LoadScene(SceneData(BASE_UNITS, BASE_LINES, WIDE_ITEM_ID_VERSION - 1), &error), qPrintable(error));
+    QCOMPARE(old.GetNodes().size(), 3);
+    QCOMPARE(Ends(old), Ends(Snapshot(BASE_UNITS, BASE_LINES)));
+
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    QVERIFY(!old.Save(directory.filePath("old.afs"), &error));
+    QVERIFY(error.contains(QString::number(WIDE_ITEM_ID_VERSION - 1)));
+}
+
+QTEST_APPLESS_MAIN(TestSceneDiff)
+#include "tst_scenediff.moc"
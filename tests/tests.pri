@@ -0,0 +1,18 @@
+# Shared by every test target: Qt Test, and the flowsheet core library with
+# the modules it needs. Tests of editor classes add widgets and the sources.
+QT       += testlib concurrent xml
+QT       -= gui
+
+CONFIG += testcase c++11 console
+CONFIG -= app_bundle
+
+INCLUDEPATH += $$PWD/../flowsheetcore
+DEPENDPATH += $$PWD/../flowsheetcore
+CORE_OUT = $$OUT_PWD/../../flowsheetcore
+win32 {
+    CONFIG(debug, debug|release): CORE_OUT = $$CORE_OUT/debug
+    else: CORE_OUT = $$CORE_OUT/release
+}
+LIBS += -L$$CORE_OUT -lflowsheetcore
+win32-msvc*: PRE_TARGETDEPS += $$CORE_OUT/flowsheetcore.lib
+else: PRE_TARGETDEPS += $$CORE_OUT/libflowsheetcore.a
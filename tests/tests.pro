@@ -0,0 +1,12 @@
+# Qt Test targets, one per module, built after the flowsheet core library.
+# "make check" runs them all.
+TEMPLATE = subdirs
+
+SUBDIRS = \
+    nodeindex \
+    flowsheetmodel \
+    resultcache \
+    montecarlo \
+    resultwriter \
+    scenediff \
+    flowsheetvalidator
@@ -0,0 +1,630 @@
+#include "timeseriesstore.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QSet>
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+    const quint32 SEGMENT_MAGIC = 0x41475453;   // "AGTS"
+    const quint32 SEGMENT_VERSION = 1;
+    const quint32 INDEX_MAGIC = 0x41475449;     // "AGTI"
+    // version 1 kept 32 bit item ids
+    const quint32 INDEX_VERSION = 2;
+    const char *INDEX_FILE = "index.dat";
+
+    // file layout: header, qint64 times[Count], double values[Count], TrendBucket level0[BucketCount]
+    struct SegmentFileHeader
+    {
+        quint32 Magic;
+        quint32 Version;
+        quint32 Count;
+        quint32 BucketCount;
+        qint64 Start;
+        qint64 End;
+    };
+
+    TrendBucket MakeBucket(qint64 time, double value)
+    {
+        TrendBucket bucket = {time, time, value, value, value, 1};
+        return bucket;
+    }
+
+    void MergeBucket(TrendBucket &bucket, qint64 time, double value)
+    {
+        bucket.End = time;
+        bucket.Min = qMin(bucket.Min, value);
+        bucket.Max = qMax(bucket.Max, value);
+        bucket.Sum += value;
+        ++bucket.Count;
+    }
+
+    void MergeBuckets(TrendBucket &bucket, const TrendBucket &other)
+    {
+        bucket.End = other.End;
+        bucket.Min = qMin(bucket.Min, other.Min);
+        bucket.Max = qMax(bucket.Max, other.Max);
+        bucket.Sum += other.Sum;
+        bucket.Count += other.Count;
+    }
+
+    void WriteBuckets(QDataStream &out, const QVector<TrendBucket> &buckets)
+    {
+        out << qint32(buckets.size());
+        for (const TrendBucket &bucket : buckets)
+        {
+            out << bucket.Start << bucket.End << bucket.Min << bucket.Max << bucket.Sum << bucket.Count;
+        }
+    }
+
+    QVector<TrendBucket> ReadBuckets(QDataStream &in)
+    {
+        qint32 count;
+        in >> count;
+        QVector<TrendBucket> buckets;
+        for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+        {
+            TrendBucket bucket;
+            in >> bucket.Start >> bucket.End >> bucket.Min >> bucket.Max >> bucket.Sum >> bucket.Count;
+            buckets.append(bucket);
+        }
+        return buckets;
+    }
+
+    // Mean holds the running sum until TimeSeriesStore::Query divides it
+    void FoldInto(TrendPoint &point, double min, double max, double sum, quint32 count)
+    {
+        point.Min = qMin(point.Min, min);
+        point.Max = qMax(point.Max, max);
+        point.Mean += sum;
+        point.Count += count;
+    }
+}
+
+TimeSeriesSegment::TimeSeriesSegment()
+    : Count(0)
+    , Start(0)
+    , End(0)
+    , Charge(MemoryAccount::TelemetryHistory, sizeof(TimeSeriesSegment) + CAPACITY * (sizeof(qint64) + sizeof(double)), 1)
+{
+    Times.reserve(CAPACITY);
+    Values.reserve(CAPACITY);
+}
+
+void TimeSeriesSegment::Append(qint64 time, double value)
+{
+    if (Count == 0)
+    {
+        Start = time;
+    }
+    End = time;
+    Times.append(time);
+    Values.append(value);
+
+    for (int level = 0; level < LEVELS; ++level)
+    {
+        int bucket = Count >> (4 * (level + 1));
+        if (bucket == Levels[level].size())
+        {
+            Levels[level].append(MakeBucket(time, value));
+            Charge.Add(sizeof(TrendBucket));
+        }
+        else
+        {
+            MergeBucket(Levels[level].last(), time, value);
+        }
+    }
+    ++Count;
+}
+
+bool TimeSeriesSegment::IsFull() const
+{
+    return Count >= CAPACITY;
+}
+
+bool TimeSeriesSegment::IsCold() const
+{
+    return !FileName.isEmpty();
+}
+
+int TimeSeriesSegment::GetCount() const
+{
+    return Count;
+}
+
+qint64 TimeSeriesSegment::GetStart() const
+{
+    return Start;
+}
+
+qint64 TimeSeriesSegment::GetEnd() const
+{
+    return End;
+}
+
+const QString &TimeSeriesSegment::GetFileName() const
+{
+    return FileName;
+}
+
+bool TimeSeriesSegment::Persist(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning() << "Could not write history segment" << fileName << file.errorString();
+        return false;
+    }
+
+    SegmentFileHeader header = {SEGMENT_MAGIC, SEGMENT_VERSION, quint32(Count), quint32(Levels[0].size()), Start, End};
+    bool ok = file.write(reinterpret_cast<const char *>(&header), sizeof(header)) == qint64(sizeof(header))
+            && file.write(reinterpret_cast<const char *>(Times.constData()), Count * sizeof(qint64)) == qint64(Count * sizeof(qint64))
+            && file.write(reinterpret_cast<const char *>(Values.constData()), Count * sizeof(double)) == qint64(Count * sizeof(double))
+            && file.write(reinterpret_cast<const char *>(Levels[0].constData()), Levels[0].size() * sizeof(TrendBucket))
+               == qint64(Levels[0].size() * sizeof(TrendBucket));
+    file.close();
+    if (!ok)
+    {
+        qWarning() << "Could not write history segment" << fileName << file.errorString();
+        QFile::remove(fileName);
+        return false;
+    }
+
+    SetCold(fileName);
+    return true;
+}
+
+bool TimeSeriesSegment::Open(const QString &fileName)
+{
+    QFile file(fileName);
+    SegmentFileHeader header;
+    if (!file.open(QIODevice::ReadOnly)
+            || file.read(reinterpret_cast<char *>(&header), sizeof(header)) != qint64(sizeof(header))
+            || header.Magic != SEGMENT_MAGIC || header.Version != SEGMENT_VERSION
+            || header.Count == 0 || header.Count > quint32(CAPACITY))
+    {
+        return false;
+    }
+
+    // only the finest level is read, the coarser ones are folded from it
+    QVector<TrendBucket> finest(int(header.BucketCount));
+    const qint64 bucketBytes = finest.size() * qint64(sizeof(TrendBucket));
+    if (!file.seek(sizeof(header) + qint64(header.Count) * (sizeof(qint64) + sizeof(double)))
+            || file.read(reinterpret_cast<char *>(finest.data()), bucketBytes) != bucketBytes)
+    {
+        return false;
+    }
+    for (int level = 1; level < LEVELS; ++level)
+    {
+        Levels[level].clear();
+        for (int i = 0; i < finest.size(); ++i)
+        {
+            if (i % (1 << (4 * level)) == 0)
+            {
+                Levels[level].append(finest.at(i));
+            }
+            else
+            {
+                MergeBuckets(Levels[level].last(), finest.at(i));
+            }
+        }
+    }
+    Count = int(header.Count);
+    Start = header.Start;
+    End = header.End;
+    SetCold(fileName);
+    return true;
+}
+
+void TimeSeriesSegment::writeIndex(QDataStream &out) const
+{
+    out << QFileInfo(FileName).fileName() << qint32(Count) << Start << End;
+    WriteBuckets(out, Levels[1]);
+    WriteBuckets(out, Levels[2]);
+}
+
+bool TimeSeriesSegment::readIndex(QDataStream &in, const QString &directory)
+{
+    QString name;
+    qint32 count;
+    in >> name >> count >> Start >> End;
+    Levels[1] = ReadBuckets(in);
+    Levels[2] = ReadBuckets(in);
+    Count = count;
+    const QString fileName = QDir(directory).filePath(name);
+    if (in.status() != QDataStream::Ok || Count <= 0 || Levels[LEVELS - 1].isEmpty() || !QFile::exists(fileName))
+    {
+        return false;
+    }
+    SetCold(fileName);
+    return true;
+}
+
+void TimeSeriesSegment::SetCold(const QString &fileName)
+{
+    FileName = fileName;
+    Times = QVector<qint64>();
+    Values = QVector<double>();
+    Levels[0] = QVector<TrendBucket>();
+    Charge.Set(sizeof(TimeSeriesSegment) + (Levels[1].size() + Levels[2].size()) * sizeof(TrendBucket));
+}
+
+void TimeSeriesSegment::Fold(qint64 from, qint64 to, QVector<TrendPoint> &pixels) const
+{
+    if (Count == 0 || End < from || Start > to || pixels.isEmpty())
+    {
+        return;
+    }
+
+    const int pixelCount = pixels.size();
+    const double pixelWidth = double(qMax<qint64>(to - from, 1)) / pixelCount;
+    auto pixelOf = [&](qint64 time) {
+        return qBound(0, int((time - from) / pixelWidth), pixelCount - 1);
+    };
+
+    // a segment inside one pixel only needs its summary
+    if (Start >= from && End <= to && pixelOf(Start) == pixelOf(End))
+    {
+        const TrendBucket &summary = Levels[LEVELS - 1].first();
+        FoldInto(pixels[pixelOf(Start)], summary.Min, summary.Max, summary.Sum, summary.Count);
+        return;
+    }
+
+    const double spacing = Count > 1 ? double(End - Start) / (Count - 1) : 0.0;
+    int level = -1;
+    for (int candidate = LEVELS - 1; candidate >= 0; --candidate)
+    {
+        if (spacing * (1 << (4 * (candidate + 1))) <= pixelWidth)
+        {
+            level = candidate;
+            break;
+        }
+    }
+
+    const qint64 *times = Times.constData();
+    const double *values = Values.constData();
+    const TrendBucket *buckets = level >= 0 ? Levels[level].constData() : nullptr;
+    int bucketCount = level >= 0 ? Levels[level].size() : 0;
+
+    // the finest level and the samples of a cold segment are read from its file
+    QFile file(FileName);
+    if (IsCold() && level <= 0)
+    {
+        uchar *data = file.open(QIODevice::ReadOnly) ? file.map(0, file.size()) : nullptr;
+        const SegmentFileHeader *header = reinterpret_cast<const SegmentFileHeader *>(data);
+        if (!data || header->Magic != SEGMENT_MAGIC || header->Version != SEGMENT_VERSION || int(header->Count) != Count)
+        {
+            qWarning() << "History segment" << FileName << "is missing or damaged";
+            return;
+        }
+        times = reinterpret_cast<const qint64 *>(data + sizeof(SegmentFileHeader));
+        values = reinterpret_cast<const double *>(times + Count);
+        if (level == 0)
+        {
+            buckets = reinterpret_cast<const TrendBucket *>(values + Count);
+            bucketCount = int(header->BucketCount);
+        }
+    }
+
+    if (level < 0)
+    {
+        const qint64 *first = std::lower_bound(times, times + Count, from);
+        for (const qint64 *time = first; time != times + Count && *time <= to; ++time)
+        {
+            double value = values[time - times];
+            FoldInto(pixels[pixelOf(*time)], value, value, value, 1);
+        }
+        return;
+    }
+
+    const TrendBucket *first = std::lower_bound(buckets, buckets + bucketCount, from,
+                                                [](const TrendBucket &bucket, qint64 time) { return bucket.End < time; });
+    for (const TrendBucket *bucket = first; bucket != buckets + bucketCount && bucket->Start <= to; ++bucket)
+    {
+        FoldInto(pixels[pixelOf(bucket->Start)], bucket->Min, bucket->Max, bucket->Sum, bucket->Count);
+    }
+}
+
+TimeSeriesStore::TimeSeriesStore(const QString &directory)
+    : Directory(directory)
+{
+    QDir(Directory).mkpath(".");
+    LoadIndex();
+    // segments written after the last index, when the previous run did not exit cleanly
+    AdoptOrphans();
+}
+
+TimeSeriesStore::~TimeSeriesStore()
+{
+    for (auto it = AllSeries.begin(); it != AllSeries.end(); ++it)
+    {
+        Series &series = it.value();
+        while (series.FirstHot < series.Segments.size())
+        {
+            TimeSeriesSegment *segment = series.Segments.at(series.FirstHot);
+            if (segment->GetCount() > 0 && !segment->Persist(SegmentFileName(it.key(), series)))
+            {
+                break;
+            }
+            ++series.FirstHot;
+        }
+    }
+    SaveIndex();
+
+    for (Series &series : AllSeries)
+    {
+        qDeleteAll(series.Segments);
+    }
+}
+
+QString TimeSeriesStore::SegmentFileName(const SeriesKey &key, Series &series) const
+{
+    return QDir(Directory).filePath(QString("%1_%2_%3.seg").arg(key.first).arg(key.second).arg(series.NextFile++));
+}
+
+void TimeSeriesStore::LoadIndex()
+{
+    QFile file(QDir(Directory).filePath(INDEX_FILE));
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return;
+    }
+    QDataStream in(&file);
+    quint32 magic, version;
+    qint32 seriesCount;
+    in >> magic >> version >> seriesCount;
+    if (magic != INDEX_MAGIC || version < 1 || version > INDEX_VERSION)
+    {
+        qWarning() << "History index" << file.fileName() << "is not readable, it is rebuilt from the segments";
+        return;
+    }
+
+    for (qint32 i = 0; i < seriesCount && in.status() == QDataStream::Ok; ++i)
+    {
+        quint64 itemId;
+        qint32 signal, segmentCount;
+        quint32 nextFile;
+        if (version >= 2)
+        {
+            in >> itemId;
+        }
+        else
+        {
+            qint32 narrowId;
+            in >> narrowId;
+            itemId = quint64(quint32(narrowId));
+        }
+        in >> signal >> nextFile >> segmentCount;
+        Series &series = AllSeries[SeriesKey(itemId, signal)];
+        series.NextFile = nextFile;
+        for (qint32 j = 0; j < segmentCount && in.status() == QDataStream::Ok; ++j)
+        {
+            TimeSeriesSegment *segment = new TimeSeriesSegment();
+            if (segment->readIndex(in, Directory))
+            {
+                series.Segments.append(segment);
+            }
+            else
+            {
+                // removed by retention after the index was written
+                delete segment;
+            }
+        }
+        series.FirstHot = series.Segments.size();
+        if (series.Segments.isEmpty())
+        {
+            AllSeries.remove(SeriesKey(itemId, signal));
+        }
+    }
+}
+
+void TimeSeriesStore::SaveIndex() const
+{
+    QSaveFile file(QDir(Directory).filePath(INDEX_FILE));
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning() << "Could not write history index" << file.fileName() << file.errorString();
+        return;
+    }
+    QDataStream out(&file);
+    QList<SeriesKey> keys;
+    for (auto it = AllSeries.constBegin(); it != AllSeries.constEnd(); ++it)
+    {
+        if (!it->Segments.isEmpty() && it->Segments.first()->IsCold())
+        {
+            keys.append(it.key());
+        }
+    }
+    out << INDEX_MAGIC << INDEX_VERSION << qint32(keys.size());
+    for (const SeriesKey &key : keys)
+    {
+        const Series &series = AllSeries[key];
+        QList<const TimeSeriesSegment *> cold;
+        for (const TimeSeriesSegment *segment : series.Segments)
+        {
+            if (segment->IsCold())
+            {
+                cold.append(segment);
+            }
+        }
+        out << key.first << qint32(key.second) << series.NextFile << qint32(cold.size());
+        for (const TimeSeriesSegment *segment : cold)
+        {
+            segment->writeIndex(out);
+        }
+    }
+    if (!file.commit())
+    {
+        qWarning() << "Could not write history index" << file.fileName() << file.errorString();
+    }
+}
+
+void TimeSeriesStore::AdoptOrphans()
+{
+    QSet<QString> indexed;
+    for (const Series &series : AllSeries)
+    {
+        for (const TimeSeriesSegment *segment : series.Segments)
+        {
+            indexed.insert(QFileInfo(segment->GetFileName()).fileName());
+        }
+    }
+
+    QDir dir(Directory);
+    const QRegularExpression pattern("^(\\d+)_(\\d+)_(\\d+)\\.seg$");
+    QSet<SeriesKey> adopted;
+    for (const QString &name : dir.entryList({"*.seg"}, QDir::Files))
+    {
+        if (indexed.contains(name))
+        {
+            continue;
+        }
+        QRegularExpressionMatch match = pattern.match(name);
+        TimeSeriesSegment *segment = new TimeSeriesSegment();
+        if (!match.hasMatch() || !segment->Open(dir.filePath(name)))
+        {
+            qWarning() << "History segment" << name << "is damaged and was removed";
+            delete segment;
+            dir.remove(name);
+            continue;
+        }
+        SeriesKey key(match.captured(1).toULongLong(), match.captured(2).toInt());
+        Series &series = AllSeries[key];
+        series.Segments.append(segment);
+        series.NextFile = qMax(series.NextFile, match.captured(3).toUInt() + 1);
+        adopted.insert(key);
+    }
+
+    for (const SeriesKey &key : adopted)
+    {
+        Series &series = AllSeries[key];
+        std::sort(series.Segments.begin(), series.Segments.end(),
+                  [](const TimeSeriesSegment *a, const TimeSeriesSegment *b) { return a->GetStart() < b->GetStart(); });
+        series.FirstHot = series.Segments.size();
+    }
+}
+
+void TimeSeriesStore::Append(quint64 itemId, int signal, qint64 time, double value)
+{
+    SeriesKey key(itemId, signal);
+    Series &series = AllSeries[key];
+    // a segment reopened from an earlier run may be short, but it is on disk
+    if (series.Segments.isEmpty() || series.Segments.last()->IsFull() || series.Segments.last()->IsCold())
+    {
+        series.Segments.append(new TimeSeriesSegment());
+    }
+
+    // the pyramid needs ordered times, a sample from the past is stamped with the latest time
+    TimeSeriesSegment *segment = series.Segments.last();
+    if (segment->GetCount() > 0)
+    {
+        time = qMax(time, segment->GetEnd());
+    }
+    else if (series.Segments.size() > 1)
+    {
+        time = qMax(time, series.Segments.at(series.Segments.size() - 2)->GetEnd());
+    }
+    segment->Append(time, value);
+
+    if (segment->IsFull())
+    {
+        Age(key, series);
+    }
+}
+
+void TimeSeriesStore::Age(const SeriesKey &key, Series &series)
+{
+    const qint64 latest = series.Segments.last()->GetEnd();
+    while (series.FirstHot < series.Segments.size() - 1)
+    {
+        TimeSeriesSegment *segment = series.Segments.at(series.FirstHot);
+        if (segment->GetEnd() >= latest - HOT_WINDOW_MS)
+        {
+            break;
+        }
+        if (!segment->Persist(SegmentFileName(key, series)))
+        {
+            break;
+        }
+        ++series.FirstHot;
+    }
+
+    while (series.FirstHot > 0 && series.Segments.first()->GetEnd() < latest - RETENTION_MS)
+    {
+        TimeSeriesSegment *segment = series.Segments.takeFirst();
+        QFile::remove(segment->GetFileName());
+        delete segment;
+        --series.FirstHot;
+    }
+}
+
+bool TimeSeriesStore::HasSeries(quint64 itemId, int signal) const
+{
+    return AllSeries.contains(SeriesKey(itemId, signal));
+}
+
+QList<int> TimeSeriesStore::Signals(quint64 itemId) const
+{
+    QList<int> signalIds;
+    for (auto it = AllSeries.constBegin(); it != AllSeries.constEnd(); ++it)
+    {
+        if (it.key().first == itemId)
+        {
+            signalIds.append(it.key().second);
+        }
+    }
+    std::sort(signalIds.begin(), signalIds.end());
+    return signalIds;
+}
+
+qint64 TimeSeriesStore::LatestTime(quint64 itemId, int signal) const
+{
+    auto it = AllSeries.constFind(SeriesKey(itemId, signal));
+    return it == AllSeries.constEnd() || it->Segments.isEmpty() ? 0 : it->Segments.last()->GetEnd();
+}
+
+QVector<TrendPoint> TimeSeriesStore::Query(quint64 itemId, int signal, qint64 from, qint64 to, int pixels) const
+{
+    TrendPoint empty = {std::numeric_limits<double>::max(), std::numeric_limits<double>::lowest(), 0.0, 0};
+    QVector<TrendPoint> points(qMax(pixels, 1), empty);
+
+    auto it = AllSeries.constFind(SeriesKey(itemId, signal));
+    if (it != AllSeries.constEnd())
+    {
+        for (const TimeSeriesSegment *segment : it->Segments)
+        {
+            segment->Fold(from, to, points);
+        }
+    }
+
+    for (TrendPoint &point : points)
+    {
+        if (point.Count > 0)
+        {
+            point.Mean /= point.Count;
+        }
+    }
+    return points;
+}
+
+void TimeSeriesStore::Clear()
+{
+    for (Series &series : AllSeries)
+    {
+        for (TimeSeriesSegment *segment : series.Segments)
+        {
+            if (segment->IsCold())
+            {
+                QFile::remove(segment->GetFileName());
+            }
+            delete segment;
+        }
+    }
+    AllSeries.clear();
+    QFile::remove(QDir(Directory).filePath(INDEX_FILE));
+}
@@ -0,0 +1,114 @@
+#ifndef TIMESERIESSTORE_H
+#define TIMESERIESSTORE_H
+
+#include <QDataStream>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QVector>
+#include "memoryaccount.h"
+
+// Aggregate of a run of samples. Plain data so cold segments can be mapped
+// straight from disk.
+struct TrendBucket
+{
+    qint64 Start;
+    qint64 End;
+    double Min;
+    double Max;
+    double Sum;
+    quint32 Count;
+};
+
+struct TrendPoint
+{
+    double Min;
+    double Max;
+    double Mean;
+    quint32 Count;
+};
+
+// Fixed-size block of one signal. Samples are kept in columns, every level of
+// the pyramid aggregates FANOUT entries of the level below it. A cold segment
+// has its samples and finest level on disk and only the coarse levels in memory.
+class TimeSeriesSegment
+{
+public:
+    static const int CAPACITY = 4096;
+    static const int FANOUT = 16;
+    static const int LEVELS = 3;    // 16, 256 and 4096 samples per bucket
+
+    TimeSeriesSegment();
+
+    void Append(qint64 time, double value);
+    bool IsFull() const;
+    bool IsCold() const;
+    int GetCount() const;
+    qint64 GetStart() const;
+    qint64 GetEnd() const;
+
+    bool Persist(const QString &fileName);
+    // a cold segment from an earlier run, from its file or from the store's index
+    bool Open(const QString &fileName);
+    void writeIndex(QDataStream &out) const;
+    bool readIndex(QDataStream &in, const QString &directory);
+    const QString &GetFileName() const;
+    // folds the entries overlapping [from, to] into pixels, at the coarsest level that still resolves a pixel
+    void Fold(qint64 from, qint64 to, QVector<TrendPoint> &pixels) const;
+
+private:
+    void SetCold(const QString &fileName);
+
+    QVector<qint64> Times;
+    QVector<double> Values;
+    QVector<TrendBucket> Levels[LEVELS];
+    int Count;
+    qint64 Start;
+    qint64 End;
+    QString FileName;
+    // the sample columns are reserved whole, the pyramid is charged as it grows
+    MemoryCharge Charge;
+};
+
+// History of every (unit, signal) reported while monitoring. The last
+// HotWindow is kept at full resolution in memory, older segments are written
+// to the history directory and dropped after the retention period. On exit
+// the hot segments are written too and an index of all segments is saved next
+// to them, so the history is there again on the next start.
+class TimeSeriesStore
+{
+public:
+    explicit TimeSeriesStore(const QString &directory);
+    ~TimeSeriesStore();
+
+    void Append(quint64 itemId, int signal, qint64 time, double value);
+    bool HasSeries(quint64 itemId, int signal) const;
+    QList<int> Signals(quint64 itemId) const;
+    qint64 LatestTime(quint64 itemId, int signal) const;
+    QVector<TrendPoint> Query(quint64 itemId, int signal, qint64 from, qint64 to, int pixels) const;
+    void Clear();
+
+    static const qint64 HOT_WINDOW_MS = 8LL * 3600 * 1000;
+    static const qint64 RETENTION_MS = 31LL * 24 * 3600 * 1000;
+
+private:
+    typedef QPair<quint64, int> SeriesKey;
+    struct Series
+    {
+        QList<TimeSeriesSegment *> Segments;
+        int FirstHot = 0;
+        quint32 NextFile = 0;
+    };
+
+    void Age(const SeriesKey &key, Series &series);
+    QString SegmentFileName(const SeriesKey &key, Series &series) const;
+    void LoadIndex();
+    void SaveIndex() const;
+    void AdoptOrphans();
+
+    QString Directory;
+    QHash<SeriesKey, Series> AllSeries;
+};
+
+#endif // TIMESERIESSTORE_H
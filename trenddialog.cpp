@@ -0,0 +1,162 @@
+#include "trenddialog.h"
+#include "telemetry.h"
+#include <QComboBox>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QPainter>
+#include <QVBoxLayout>
+#include <limits>
+
+namespace
+{
+    const int MARGIN = 30;
+}
+
+TrendPlot::TrendPlot(const TimeSeriesStore *store, quint64 itemId, QWidget *parent)
+    : QWidget(parent)
+    , Store(store)
+    , ItemId(itemId)
+    , Signal(0)
+    , WindowMs(TimeSeriesStore::HOT_WINDOW_MS)
+{
+    setMinimumSize(480, 240);
+    setAutoFillBackground(true);
+    setBackgroundRole(QPalette::Base);
+}
+
+void TrendPlot::SetSignal(int signal)
+{
+    Signal = signal;
+    update();
+}
+
+void TrendPlot::SetWindow(qint64 windowMs)
+{
+    WindowMs = windowMs;
+    update();
+}
+
+void TrendPlot::paintEvent(QPaintEvent *)
+{
+    QPainter painter(this);
+    QRect area = rect().adjusted(MARGIN, MARGIN / 2, -MARGIN / 2, -MARGIN);
+    painter.setPen(palette().color(QPalette::Mid));
+    painter.drawRect(area);
+
+    if (!Store->HasSeries(ItemId, Signal) || area.width() <= 0)
+    {
+        painter.drawText(area, Qt::AlignCenter, tr("No readings"));
+        return;
+    }
+
+    // the window ends at the newest sample, replayed captures carry their own clock
+    qint64 to = Store->LatestTime(ItemId, Signal);
+    qint64 from = to - WindowMs;
+    QVector<TrendPoint> points = Store->Query(ItemId, Signal, from, to, area.width());
+
+    double low = std::numeric_limits<double>::max();
+    double high = std::numeric_limits<double>::lowest();
+    for (const TrendPoint &point : points)
+    {
+        if (point.Count > 0)
+        {
+            low = qMin(low, point.Min);
+            high = qMax(high, point.Max);
+        }
+    }
+    if (low > high)
+    {
+        painter.drawText(area, Qt::AlignCenter, tr("No readings in this window"));
+        return;
+    }
+    if (qFuzzyCompare(low, high))
+    {
+        low -= 1.0;
+        high += 1.0;
+    }
+
+    auto yOf = [&](double value) {
+        return area.bottom() - (value - low) / (high - low) * area.height();
+    };
+
+    QPolygonF mean;
+    for (int x = 0; x < points.size(); ++x)
+    {
+        const TrendPoint &point = points.at(x);
+        if (point.Count == 0)
+        {
+            continue;
+        }
+        painter.setPen(QColor(120, 160, 220));
+        painter.drawLine(QPointF(area.left() + x, yOf(point.Min)), QPointF(area.left() + x, yOf(point.Max)));
+        mean.append(QPointF(area.left() + x, yOf(point.Mean)));
+    }
+    painter.setPen(QPen(Qt::darkBlue, 1.5));
+    painter.drawPolyline(mean);
+
+    painter.setPen(palette().color(QPalette::Text));
+    QString unit = TelemetrySample::SignalUnit(Signal);
+    painter.drawText(QRect(0, area.top() - MARGIN / 2, area.left() + 200, MARGIN / 2), Qt::AlignLeft | Qt::AlignVCenter,
+                     QString("%1 %2").arg(high, 0, 'f', 1).arg(unit));
+    painter.drawText(QRect(0, area.bottom(), area.left() + 200, MARGIN / 2), Qt::AlignLeft | Qt::AlignVCenter,
+                     QString("%1 %2").arg(low, 0, 'f', 1).arg(unit));
+}
+
+TrendDialog::TrendDialog(const TimeSeriesStore *store, quint64 itemId, const QString &title, QWidget *parent)
+    : QDialog(parent)
+    , Plot(new TrendPlot(store, itemId, this))
+    , SignalBox(new QComboBox(this))
+    , WindowBox(new QComboBox(this))
+{
+    setWindowTitle(tr("Trend - %1").arg(title));
+    setAttribute(Qt::WA_DeleteOnClose);
+
+    for (int signal : store->Signals(itemId))
+    {
+        SignalBox->addItem(TelemetrySample::SignalName(signal), signal);
+    }
+    WindowBox->addItem(tr("10 minutes"), qint64(10) * 60 * 1000);
+    WindowBox->addItem(tr("1 hour"), qint64(3600) * 1000);
+    WindowBox->addItem(tr("Shift (8 hours)"), TimeSeriesStore::HOT_WINDOW_MS);
+    WindowBox->addItem(tr("Day"), qint64(24) * 3600 * 1000);
+    WindowBox->addItem(tr("Week"), qint64(7) * 24 * 3600 * 1000);
+    WindowBox->addItem(tr("Month"), TimeSeriesStore::RETENTION_MS);
+    WindowBox->setCurrentIndex(2);
+
+    QHBoxLayout *controls = new QHBoxLayout();
+    controls->addWidget(new QLabel(tr("Signal:"), this));
+    controls->addWidget(SignalBox);
+    controls->addWidget(new QLabel(tr("Window:"), this));
+    controls->addWidget(WindowBox);
+    controls->addStretch();
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addLayout(controls);
+    layout->addWidget(Plot);
+
+    connect(SignalBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &TrendDialog::onSignalChanged);
+    connect(WindowBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &TrendDialog::onWindowChanged);
+    onSignalChanged(SignalBox->currentIndex());
+    onWindowChanged(WindowBox->currentIndex());
+
+    // readings keep arriving while the dialog is open
+    RefreshTimer.setInterval(1000);
+    connect(&RefreshTimer, &QTimer::timeout, Plot, QOverload<>::of(&QWidget::update));
+    RefreshTimer.start();
+}
+
+void TrendDialog::onSignalChanged(int index)
+{
+    if (index >= 0)
+    {
+        Plot->SetSignal(SignalBox->itemData(index).toInt());
+    }
+}
+
+void TrendDialog::onWindowChanged(int index)
+{
+    if (index >= 0)
+    {
+        Plot->SetWindow(WindowBox->itemData(index).toLongLong());
+    }
+}
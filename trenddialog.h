@@ -0,0 +1,48 @@
+#ifndef TRENDDIALOG_H
+#define TRENDDIALOG_H
+
+#include <QDialog>
+#include <QTimer>
+#include <QWidget>
+#include "timeseriesstore.h"
+
+class QComboBox;
+
+// Min/max band and mean line of one signal, queried at one point per pixel.
+class TrendPlot : public QWidget
+{
+    Q_OBJECT
+public:
+    TrendPlot(const TimeSeriesStore *store, quint64 itemId, QWidget *parent = nullptr);
+
+    void SetSignal(int signal);
+    void SetWindow(qint64 windowMs);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    const TimeSeriesStore *Store;
+    quint64 ItemId;
+    int Signal;
+    qint64 WindowMs;
+};
+
+class TrendDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    TrendDialog(const TimeSeriesStore *store, quint64 itemId, const QString &title, QWidget *parent = nullptr);
+
+private slots:
+    void onSignalChanged(int index);
+    void onWindowChanged(int index);
+
+private:
+    TrendPlot *Plot;
+    QComboBox *SignalBox;
+    QComboBox *WindowBox;
+    QTimer RefreshTimer;
+};
+
+#endif // TRENDDIALOG_H